@@ -0,0 +1,9 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+// each benchmark logs what it measured, none of them pass or fail
+
+void benchmark_crc(void);
+void benchmark_pipeline(void);
+
+#endif /* BENCHMARK_H_ */
@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "benchmark.h"
+#include "crc.h"
+
+#define ROUNDS 10000
+
+static const char * TAG = "benchmark_crc";
+
+// bit serial shift register the table driven crc5 replaced
+static uint8_t reference_crc5(const uint8_t * data, uint8_t len)
+{
+    uint8_t crcin[5] = {1, 1, 1, 1, 1};
+    uint8_t crcout[5];
+
+    for (int i = 0; i < len * 8; i++) {
+        uint8_t din = (data[i / 8] & (0x80 >> (i % 8))) != 0;
+        crcout[0] = crcin[4] ^ din;
+        crcout[1] = crcin[0];
+        crcout[2] = crcin[1] ^ crcin[4] ^ din;
+        crcout[3] = crcin[2];
+        crcout[4] = crcin[3];
+        memcpy(crcin, crcout, 5);
+    }
+
+    return (crcin[4] << 4) | (crcin[3] << 3) | (crcin[2] << 2) | (crcin[1] << 1) | crcin[0];
+}
+
+// byte at a time crc16 the slice-by-4 version replaced
+static uint16_t reference_crc16(uint16_t crc, const uint8_t * data, uint16_t len)
+{
+    while (len-- > 0) {
+        crc ^= *data++ << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// per frame cost of the table kernels against the bitwise ones they replaced
+void benchmark_crc(void)
+{
+    // BM1370 job and register write sizes, crc over everything after the preamble
+    uint8_t job[84];
+    uint8_t cmd[9];
+    volatile uint32_t sink = 0;
+
+    esp_fill_random(job, sizeof(job));
+    esp_fill_random(cmd, sizeof(cmd));
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < ROUNDS; i++) {
+        sink += reference_crc16(0xFFFF, job, sizeof(job));
+    }
+    int64_t reference_job = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < ROUNDS; i++) {
+        sink += crc16_false(job, sizeof(job));
+    }
+    int64_t table_job = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < ROUNDS; i++) {
+        sink += reference_crc5(cmd, sizeof(cmd));
+    }
+    int64_t reference_cmd = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < ROUNDS; i++) {
+        sink += crc5(cmd, sizeof(cmd));
+    }
+    int64_t table_cmd = esp_timer_get_time() - start;
+
+    ESP_LOGI(TAG, "crc16 job frame: %.3f us (bitwise %.3f us)", (double) table_job / ROUNDS, (double) reference_job / ROUNDS);
+    ESP_LOGI(TAG, "crc5 command frame: %.3f us (bitwise %.3f us)", (double) table_cmd / ROUNDS, (double) reference_cmd / ROUNDS);
+}
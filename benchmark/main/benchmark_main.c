@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "benchmark.h"
+
+static void print_banner(const char *text);
+
+void app_main(void)
+{
+    print_banner("Running the benchmarks");
+
+    benchmark_crc();
+    benchmark_pipeline();
+
+    print_banner("Done");
+    exit(0);
+}
+
+static void print_banner(const char *text)
+{
+    printf("\n#### %s #####\n\n", text);
+}
@@ -0,0 +1,195 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#include "asic_emulator.h"
+#include "asic_task.h"
+#include "benchmark.h"
+#include "bm1370.h"
+#include "mining.h"
+#include "serial.h"
+#include "stratum_api.h"
+
+// jobs sent, each is hashed for a job interval before the next one replaces it
+#define PIPELINE_JOBS 20
+#define PIPELINE_JOB_INTERVAL_MS 1000
+#define PIPELINE_FREQUENCY 100
+#define PIPELINE_POOL_PORT 3333
+
+static const char * TAG = "benchmark_pipeline";
+
+static const char * extranonce = "e9695791";
+static const int extranonce_2_len = 4;
+
+static const char * notify_line =
+    "{\"id\":null,\"method\":\"mining.notify\",\"params\":"
+    "[\"1b4c3d9041\","
+    "\"ef4b9a48c7986466de4adc002f7337a6e121bc43000376ea0000000000000000\","
+    "\"01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4b03a5020cfabe6d6d379ae882651f6469f2ed6b8b40a4f9a4b41fd838a3ad6de8cba775f4e8f1d3080100000000000000\","
+    "\"41903d4c1b2f736c7573682f0000000003ca890d27000000001976a9147c154ed1dc59609e3d26abb2df2ea3d587cd8c4188ac00000000000000002c6a4c2952534b424c4f434b3a4cb4cb2ddfc37c41baf5ef6b6b4899e3253a8f1dfc7e5dd68a5b5b27005014ef0000000000000000266a24aa21a9ed5caa249f1af9fbf71c986fea8e076ca34ae3514fb2f86400561b28c7b15949bf00000000\","
+    "[\"ae23055e00f0f697cc3640124812d96d4fe8bdfa03484c1c638ce5a1c0e9aa81\",\"980fb87cb61021dd7afd314fcb0dabd096f3d56a7377f6f320684652e7410a21\",\"a52e9868343c55ce405be8971ff340f562ae9ab6353f07140d01666180e19b52\",\"7435bdfa004e603953b2ed39f118803934d9cf17b06d979ceb682f2251bafac2\",\"2a91f061a22d27cb8f44eea79938fb241ebeb359891aa907f05ffde7ed44e52e\",\"302401f80eb5e958155135e25200bb8ea181ad2d05e804a531c7314d86403cdc\",\"318ecb6161eb9b4cfd802bd730e2d36c167ddf102e70aa7b4158e2870dd47392\",\"1114332a9858e0cf84b2425bb1e59eaabf91dd102d114aa443d57fc1b3beb0c9\",\"f43f38095c810613ed795a44d9fab02ff25269706f454885db9be05cdf9c06e1\",\"3e2fc26b27fddc39668b59099cd9635761bb72ed92404204e12bdff08b16fb75\",\"463c19427286342120039a83218fa87ce45448e246895abac11fff0036076758\",\"03d287f655813e540ddb9c4e7aeb922478662b0f5d8e9d0cbd564b20146bab76\"],"
+    "\"20000004\",\"1705c739\",\"64495522\",false]}";
+
+typedef struct
+{
+    int64_t total_us;
+    int64_t max_us;
+    uint32_t count;
+} stage;
+
+static void _stage_add(stage * stage, int64_t us)
+{
+    stage->total_us += us;
+    if (us > stage->max_us) {
+        stage->max_us = us;
+    }
+    stage->count++;
+}
+
+static void _stage_log(const char * name, const stage * stage)
+{
+    if (stage->count == 0) {
+        ESP_LOGI(TAG, "%-22s no samples", name);
+        return;
+    }
+    ESP_LOGI(TAG, "%-22s mean %8.1f us, max %8lld us over %lu", name, (double) stage->total_us / stage->count,
+             (long long) stage->max_us, (unsigned long) stage->count);
+}
+
+// a UDP socket on the loopback interface stands in for the pool connection, the submit is a real socket write
+static int _pool_socket(void)
+{
+    struct sockaddr_in pool = {
+        .sin_family = AF_INET,
+        .sin_port = htons(PIPELINE_POOL_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *) &pool, sizeof(pool)) != 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// what create_jobs_task does for every job of a notification
+static bm_job * _make_job(mining_notify * notify, uint32_t extranonce_2)
+{
+    char * extranonce_2_str = extranonce_2_generate(extranonce_2, extranonce_2_len);
+    char * coinbase_tx = construct_coinbase_tx(notify->coinbase_1, notify->coinbase_2, extranonce, extranonce_2_str);
+    char * merkle_root = calculate_merkle_root_hash(coinbase_tx, (uint8_t(*)[32]) notify->merkle_branches, notify->n_merkle_branches);
+
+    bm_job * job = malloc(sizeof(bm_job));
+    *job = construct_bm_job(notify, merkle_root, 0);
+    job->extranonce2 = extranonce_2_str;
+    job->jobid = strdup(notify->job_id);
+    job->version_mask = 0;
+
+    free(coinbase_tx);
+    free(merkle_root);
+    return job;
+}
+
+// notify, job factory, UART, validation and submit against the emulated chain, timed per stage
+void benchmark_pipeline(void)
+{
+    static AsicChain chain;
+    stage parse = {0}, build = {0}, send = {0}, first_nonce = {0}, validate = {0}, submit = {0}, notify_to_submit = {0};
+    uint32_t nonces = 0;
+    int send_uid = 1;
+
+    memset(&chain, 0, sizeof(chain));
+    pthread_mutex_init(&chain.valid_jobs_lock, NULL);
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    int sock = _pool_socket();
+    if (sock < 0) {
+        ESP_LOGE(TAG, "No loopback socket for the pool");
+        return;
+    }
+
+    SERIAL_init(chain.index);
+    chain.asic_count = BM1370_init(chain.index, PIPELINE_FREQUENCY, 1);
+    if (chain.asic_count == 0) {
+        ESP_LOGE(TAG, "The emulated chain didn't come up, is CONFIG_ASIC_EMULATOR_CHIP_ID 0x1370?");
+        close(sock);
+        return;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < PIPELINE_JOBS; i++) {
+        int64_t notify_us = esp_timer_get_time();
+        StratumApiV1Message message = {0};
+        STRATUM_V1_parse(&message, notify_line);
+        mining_notify * notify = message.mining_notification;
+        // the emulated ticket mask sits far below difficulty 1, every nonce takes the submit path
+        notify->difficulty = 0;
+        int64_t parsed_us = esp_timer_get_time();
+        _stage_add(&parse, parsed_us - notify_us);
+
+        bm_job * job = _make_job(notify, i);
+        STRATUM_V1_free_mining_notify(notify);
+        int64_t built_us = esp_timer_get_time();
+        _stage_add(&build, built_us - parsed_us);
+
+        BM1370_send_work(&chain, job);
+        SERIAL_wait_tx_done(chain.index, 100);
+        int64_t sent_us = esp_timer_get_time();
+        _stage_add(&send, sent_us - built_us);
+
+        bool first = true;
+        while (esp_timer_get_time() - sent_us < PIPELINE_JOB_INTERVAL_MS * 1000LL) {
+            task_result * result = BM1370_process_work(&chain);
+            int64_t received_us = esp_timer_get_time();
+            if (result == NULL) {
+                continue;
+            }
+            if (first) {
+                _stage_add(&first_nonce, received_us - sent_us);
+            }
+
+            bm_job * active = chain.active_jobs[result->job_id];
+            test_nonce_value(active, result->nonce, result->rolled_version);
+            int64_t validated_us = esp_timer_get_time();
+            _stage_add(&validate, validated_us - received_us);
+
+            STRATUM_V1_submit_share(sock, send_uid++, "benchmark", active->jobid, active->extranonce2, active->ntime,
+                                    result->nonce, result->rolled_version ^ active->version);
+            int64_t submitted_us = esp_timer_get_time();
+            _stage_add(&submit, submitted_us - validated_us);
+            if (first) {
+                _stage_add(&notify_to_submit, submitted_us - notify_us);
+                first = false;
+            }
+            nonces++;
+        }
+    }
+    double elapsed_s = (esp_timer_get_time() - start_us) / 1e6;
+
+    ESP_LOGI(TAG, "BM1370 emulator, %u chip(s), %lu jobs in %.1f s", chain.asic_count, (unsigned long) PIPELINE_JOBS, elapsed_s);
+    _stage_log("notify parse", &parse);
+    _stage_log("job build", &build);
+    _stage_log("job send", &send);
+    _stage_log("send to first nonce", &first_nonce);
+    _stage_log("nonce validation", &validate);
+    _stage_log("share submit", &submit);
+    _stage_log("notify to first submit", &notify_to_submit);
+    ESP_LOGI(TAG, "%.1f jobs/s, %.1f nonces/s validated and submitted", PIPELINE_JOBS / elapsed_s, nonces / elapsed_s);
+
+    for (int i = 0; i < ASIC_JOB_ID_COUNT; i++) {
+        if (chain.active_jobs[i] != NULL) {
+            free_bm_job(chain.active_jobs[i]);
+        }
+    }
+    close(sock);
+}
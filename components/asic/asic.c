@@ -1,6 +1,13 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <esp_log.h>
+#include <esp_timer.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "bm1397.h"
 #include "bm1366.h"
@@ -8,29 +15,165 @@
 #include "bm1370.h"
 
 #include "asic.h"
+#include "chain_watchdog.h"
+#include "frequency_transition_bmXX.h"
+#include "job_interval.h"
+#include "serial.h"
+#include "ticket_mask.h"
+#include "utils.h"
+
+// chip id read-backs per baud step while scanning, and at the chosen rate before settling on it
+#define BAUD_PROBE_ROUNDS 16
+#define BAUD_CONFIRM_ROUNDS 64
+
+// step down a baud setting when more than this many UART errors show up in one interval
+#define LINK_CHECK_INTERVAL_US (60 * 1000000LL)
+#define LINK_MAX_ERRORS 3
 
-static const double NONCE_SPACE = 4294967296.0; //  2^32
+// how often duplicate and stale rates are checked against the job interval
+#define JOB_INTERVAL_TRIM_PERIOD_US (60 * 1000000LL)
+
+#ifdef CONFIG_ASIC_TICKET_MASK_ADAPTIVE
+#define TARGET_NONCE_RATE (CONFIG_ASIC_TARGET_NONCES_PER_MINUTE / 60.0)
+#else
+#define TARGET_NONCE_RATE 0
+#endif
+
+// the rate every chip comes out of reset at
+#define ASIC_RESET_BAUD 115200
 
 static const char *TAG = "asic";
 
+// every chain trains and monitors its own UART, the limit is the highest step that is still allowed
+// after a faster one turned out unreliable
+static int baud_step[SERIAL_MAX_CHAINS];
+static int baud_limit[SERIAL_MAX_CHAINS];
+static int64_t link_check_time_us[SERIAL_MAX_CHAINS];
+static uint32_t link_errors[SERIAL_MAX_CHAINS];
+
+// the chips roll the default mask from init until the pool sends its own
+static uint32_t chip_version_mask = STRATUM_DEFAULT_VERSION_MASK;
+static job_interval_trim interval_trim = {.factor = 1.0};
+static int64_t interval_trim_time_us;
+
+// per chip frequency caps in MHz, numbered across the chains like the telemetry, 0 follows the board frequency
+static float chip_frequency_cap[ASIC_MAX_TUNED_CHIPS];
+
+static void _set_chain_version_mask(GlobalState * GLOBAL_STATE, uint8_t chain, uint32_t mask);
+
+static set_hash_frequency_fn _hash_frequency_fn(GlobalState * GLOBAL_STATE, int * asic_type) {
+    switch (GLOBAL_STATE->asic_model) {
+        case ASIC_BM1366:
+            *asic_type = 1366;
+            return BM1366_send_hash_frequency;
+        case ASIC_BM1368:
+            *asic_type = 1368;
+            return BM1368_send_hash_frequency;
+        case ASIC_BM1370:
+            *asic_type = 1370;
+            return BM1370_send_hash_frequency;
+        case ASIC_BM1397:
+            *asic_type = 1397;
+            return BM1397_send_hash_frequency;
+        default:
+    return NULL;
+    }
+}
+
+static float _chip_target(GlobalState * GLOBAL_STATE, uint8_t chain, uint16_t chip, float board_frequency) {
+    uint8_t per_chain = ASIC_get_asic_count(GLOBAL_STATE);
+    int index = chain * per_chain + chip;
+    if (chip >= per_chain || index >= ASIC_MAX_TUNED_CHIPS || chip_frequency_cap[index] <= 0 || chip_frequency_cap[index] >= board_frequency) {
+        return board_frequency;
+    }
+    return chip_frequency_cap[index];
+}
+
+static bool _chain_has_cap(GlobalState * GLOBAL_STATE, uint8_t chain, float board_frequency) {
+    for (uint16_t chip = 0; chip < frequency_transition_chip_count(chain); chip++) {
+        if (_chip_target(GLOBAL_STATE, chain, chip, board_frequency) != board_frequency) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool _set_chain_frequency(GlobalState * GLOBAL_STATE, uint8_t chain, float board_frequency) {
+    int asic_type = 0;
+    set_hash_frequency_fn send_fn = _hash_frequency_fn(GLOBAL_STATE, &asic_type);
+    if (send_fn == NULL) {
+        ESP_LOGE(TAG, "Unknown ASIC model, cannot set frequency");
+        return false;
+    }
+
+    float targets[FREQUENCY_TRANSITION_MAX_CHIPS];
+    for (uint16_t chip = 0; chip < FREQUENCY_TRANSITION_MAX_CHIPS; chip++) {
+        targets[chip] = _chip_target(GLOBAL_STATE, chain, chip, board_frequency);
+    }
+    return do_frequency_transition_chips(chain, targets, send_fn, asic_type);
+}
+
 // .init_fn = BM1366_init,
-uint8_t ASIC_init(GlobalState * GLOBAL_STATE) {
+static uint8_t _init_chain(GlobalState * GLOBAL_STATE, uint8_t chain) {
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
-            return BM1397_init(GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_MAX_ASIC_COUNT);
+            return BM1397_init(chain, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_MAX_ASIC_COUNT);
         case DEVICE_ULTRA:
-            return BM1366_init(GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_ULTRA_ASIC_COUNT);
+            return BM1366_init(chain, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_ULTRA_ASIC_COUNT);
         case DEVICE_SUPRA:
-            return BM1368_init(GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_SUPRA_ASIC_COUNT);
+            return BM1368_init(chain, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_SUPRA_ASIC_COUNT);
         case DEVICE_GAMMA:
-            return BM1370_init(GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_GAMMA_ASIC_COUNT);
+            return BM1370_init(chain, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_GAMMA_ASIC_COUNT);
         case DEVICE_GAMMATURBO:
-            return BM1370_init(GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_GAMMATURBO_ASIC_COUNT);
+            return BM1370_init(chain, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, BITAXE_GAMMATURBO_ASIC_COUNT);
         default:
     }
     return ESP_OK;
 }
 
+// Pulses the reset of one chain and runs its init script again, the chips come back at their reset default rate
+static uint8_t _reset_chain(GlobalState * GLOBAL_STATE, uint8_t chain) {
+    AsicChain * asic_chain = &GLOBAL_STATE->ASIC_TASK_MODULE.chains[chain];
+
+    // a register read sent just before the send lock was taken may still be answering
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    baud_step[chain] = 0;
+    SERIAL_set_baud(chain, ASIC_RESET_BAUD);
+    SERIAL_clear_buffer(chain);
+
+    // the driver pulses the reset line, enumerates and ramps every chip to the board frequency
+    pthread_mutex_lock(&asic_chain->frequency_lock);
+    float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+    uint8_t chips = _init_chain(GLOBAL_STATE, chain);
+    asic_chain->asic_count = chips;
+    // the init sequence left the chips at the model's ticket mask
+    ticket_mask_init(&asic_chain->ticket_mask, GLOBAL_STATE->ASIC_difficulty, TARGET_NONCE_RATE, esp_timer_get_time());
+
+    // the drivers ramp every chip to the board frequency, pull the capped ones back down
+    if (chips > 0 && _chain_has_cap(GLOBAL_STATE, chain, frequency)) {
+        _set_chain_frequency(GLOBAL_STATE, chain, frequency);
+    }
+    pthread_mutex_unlock(&asic_chain->frequency_lock);
+
+    if (chips > 0) {
+        _set_chain_version_mask(GLOBAL_STATE, chain, chip_version_mask);
+    }
+    return chips;
+}
+
+// Initializes every chain and returns the number of chips found on all of them
+uint8_t ASIC_init(GlobalState * GLOBAL_STATE) {
+    uint8_t total = 0;
+
+    for (uint8_t chain = 0; chain < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; chain++) {
+        baud_limit[chain] = INT_MAX;
+        uint8_t chips = _reset_chain(GLOBAL_STATE, chain);
+        ESP_LOGI(TAG, "Chain %u: %u chip(s)", chain, chips);
+        total += chips;
+    }
+    return total;
+}
+
 uint8_t ASIC_get_asic_count(GlobalState * GLOBAL_STATE) {
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
@@ -66,128 +209,451 @@ uint16_t ASIC_get_small_core_count(GlobalState * GLOBAL_STATE) {
 }
 
 // .receive_result_fn = BM1366_process_work,
-task_result * ASIC_process_work(GlobalState * GLOBAL_STATE) {
+task_result * ASIC_process_work(GlobalState * GLOBAL_STATE, AsicChain * chain) {
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
-            return BM1397_process_work(GLOBAL_STATE);
+            return BM1397_process_work(chain);
         case DEVICE_ULTRA:
-            return BM1366_process_work(GLOBAL_STATE);
+            return BM1366_process_work(chain);
         case DEVICE_SUPRA:
-            return BM1368_process_work(GLOBAL_STATE);
+            return BM1368_process_work(chain);
         case DEVICE_GAMMA:
         case DEVICE_GAMMATURBO:
-            return BM1370_process_work(GLOBAL_STATE);
+            return BM1370_process_work(chain);
         default:
     }
     return NULL;
 }
 
-// .set_max_baud_fn = BM1366_set_max_baud,
-int ASIC_set_max_baud(GlobalState * GLOBAL_STATE) {
+static int _set_baud_step(GlobalState * GLOBAL_STATE, uint8_t chain, int step) {
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
-            return BM1397_set_max_baud();
+            return BM1397_set_baud_step(chain, step);
         case DEVICE_ULTRA:
-            return BM1366_set_max_baud();
+            return BM1366_set_baud_step(chain, step);
         case DEVICE_SUPRA:
-            return BM1368_set_max_baud();
+            return BM1368_set_baud_step(chain, step);
         case DEVICE_GAMMA:
         case DEVICE_GAMMATURBO:
-            return BM1370_set_max_baud();
+            return BM1370_set_baud_step(chain, step);
         default:
     return 0;
     }
 }
 
-// .set_difficulty_mask_fn = BM1366_set_job_difficulty_mask,
-void ASIC_set_job_difficulty_mask(GlobalState * GLOBAL_STATE, uint8_t mask) {
+static int _read_back_chip_ids(GlobalState * GLOBAL_STATE, uint8_t chain) {
+    uint16_t asic_count = ASIC_get_asic_count(GLOBAL_STATE);
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
-            BM1397_set_job_difficulty_mask(mask);
+            return BM1397_read_back_chip_ids(chain, asic_count);
+        case DEVICE_ULTRA:
+            return BM1366_read_back_chip_ids(chain, asic_count);
+        case DEVICE_SUPRA:
+            return BM1368_read_back_chip_ids(chain, asic_count);
+        case DEVICE_GAMMA:
+        case DEVICE_GAMMATURBO:
+            return BM1370_read_back_chip_ids(chain, asic_count);
+        default:
+    return 0;
+    }
+}
+
+// switches the chips first, at the old rate, then the UART, only ever used to go up from a known good rate
+static int _switch_baud_step(GlobalState * GLOBAL_STATE, uint8_t chain, int step) {
+    int baud = _set_baud_step(GLOBAL_STATE, chain, step);
+    if (baud == 0) {
+        return 0;
+    }
+
+    SERIAL_set_baud(chain, baud);
+    baud_step[chain] = step;
+    return baud;
+}
+
+static bool _probe_link(GlobalState * GLOBAL_STATE, uint8_t chain, int rounds) {
+    uint16_t asic_count = ASIC_get_asic_count(GLOBAL_STATE);
+
+    // give the chips a moment on the new rate and drop anything garbled by the switch
+    vTaskDelay(10 / portTICK_PERIOD_MS);
+    SERIAL_clear_buffer(chain);
+
+    for (int i = 0; i < rounds; i++) {
+        if (_read_back_chip_ids(GLOBAL_STATE, chain) != asic_count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint32_t _link_errors(uint8_t chain) {
+    return receive_work_stats(chain)->resyncs + SERIAL_get_stats(chain)->frame_errors;
+}
+
+// nothing sent before a reset can come back
+static void _forget_jobs(AsicChain * chain) {
+    pthread_mutex_lock(&chain->valid_jobs_lock);
+    for (int i = 0; i < ASIC_JOB_ID_COUNT; i++) {
+        chain->valid_jobs[i] = 0;
+    }
+    pthread_mutex_unlock(&chain->valid_jobs_lock);
+}
+
+// .set_max_baud_fn = BM1366_set_max_baud,
+// Steps up through the baud settings of the chip from the reset default, the chips must be at it, and keeps
+// the fastest one where every chip answers every register read-back. A command at a rate that fails may not
+// reach the chips, so instead of stepping down the chain is reset to the default and trained again below it.
+// Chains are trained one at a time, the UART is left at the returned rate.
+int ASIC_set_max_baud(GlobalState * GLOBAL_STATE, uint8_t chain) {
+    int baud;
+
+    while (true) {
+        int step = 0;
+        baud = ASIC_RESET_BAUD;
+        bool failed = false;
+
+        while (step < baud_limit[chain]) {
+            int next_baud = _switch_baud_step(GLOBAL_STATE, chain, step + 1);
+            if (next_baud == 0) {
+                break;
+            }
+            if (!_probe_link(GLOBAL_STATE, chain, BAUD_PROBE_ROUNDS)) {
+                ESP_LOGW(TAG, "Link training: chain %u read-back failed at %d baud", chain, next_baud);
+                failed = true;
+                break;
+            }
+            step++;
+            baud = next_baud;
+        }
+
+        // the rate that passed the scan also has to survive a longer run
+        if (!failed) {
+            if (_probe_link(GLOBAL_STATE, chain, BAUD_CONFIRM_ROUNDS)) {
+                ESP_LOGI(TAG, "Link training: chain %u settled on %d baud", chain, baud);
+                break;
+            }
+            if (step == 0) {
+                ESP_LOGE(TAG, "Link training: no reliable baud found on chain %u, staying at %d", chain, baud);
+                break;
+            }
+            ESP_LOGW(TAG, "Link training: %d baud is marginal on chain %u, stepping down", baud, chain);
+            step--;
+        }
+
+        baud_limit[chain] = step;
+        if (_reset_chain(GLOBAL_STATE, chain) == 0) {
+            ESP_LOGE(TAG, "Link training: chain %u lost its chips in the reset", chain);
+            baud = ASIC_RESET_BAUD;
+            break;
+        }
+    }
+
+    link_check_time_us[chain] = esp_timer_get_time();
+    link_errors[chain] = _link_errors(chain);
+    return baud;
+}
+
+// Called between results, falls back one baud setting when CRC or framing errors pile up
+void ASIC_check_link(GlobalState * GLOBAL_STATE, uint8_t chain) {
+    int64_t now = esp_timer_get_time();
+    if (now - link_check_time_us[chain] < LINK_CHECK_INTERVAL_US) {
+        return;
+    }
+
+    uint32_t errors = _link_errors(chain);
+    uint32_t new_errors = errors - link_errors[chain];
+    link_check_time_us[chain] = now;
+    link_errors[chain] = errors;
+
+    if (new_errors <= LINK_MAX_ERRORS || baud_step[chain] == 0) {
+        return;
+    }
+
+    ESP_LOGW(TAG, "%lu UART errors on chain %u in the last interval, lowering the baud", new_errors, chain);
+    AsicChain * asic_chain = &GLOBAL_STATE->ASIC_TASK_MODULE.chains[chain];
+
+    // ASIC_task keeps sending jobs on the chain, it waits until the chain is back
+    pthread_mutex_lock(&asic_chain->send_lock);
+    baud_limit[chain] = baud_step[chain] - 1;
+    if (_reset_chain(GLOBAL_STATE, chain) > 0) {
+        ASIC_set_max_baud(GLOBAL_STATE, chain);
+    }
+    _forget_jobs(asic_chain);
+    chain_watchdog_recovered(&asic_chain->watchdog, esp_timer_get_time());
+    pthread_mutex_unlock(&asic_chain->send_lock);
+
+    // hand the chain fresh work right away
+    xSemaphoreGive(asic_chain->semaphore);
+}
+
+// all chips on every chain answer, the responses are picked up by receive_work, a chain that is
+// training or recovering holds its send lock and is read once it is back
+void ASIC_read_register(GlobalState * GLOBAL_STATE, uint8_t register_address) {
+    for (uint8_t chain = 0; chain < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; chain++) {
+        pthread_mutex_t * send_lock = &GLOBAL_STATE->ASIC_TASK_MODULE.chains[chain].send_lock;
+        pthread_mutex_lock(send_lock);
+        switch (GLOBAL_STATE->device_model) {
+            case DEVICE_MAX:
+                BM1397_read_register(chain, register_address);
+                break;
+            case DEVICE_ULTRA:
+                BM1366_read_register(chain, register_address);
+                break;
+            case DEVICE_SUPRA:
+                BM1368_read_register(chain, register_address);
+                break;
+            case DEVICE_GAMMA:
+            case DEVICE_GAMMATURBO:
+                BM1370_read_register(chain, register_address);
+                break;
+            default:
+                break;
+        }
+        pthread_mutex_unlock(send_lock);
+    }
+}
+
+static void _set_chain_difficulty_mask(GlobalState * GLOBAL_STATE, uint8_t chain, uint32_t difficulty) {
+    switch (GLOBAL_STATE->device_model) {
+        case DEVICE_MAX:
+            BM1397_set_job_difficulty_mask(chain, difficulty);
             break;
         case DEVICE_ULTRA:
-            BM1366_set_job_difficulty_mask(mask);
+            BM1366_set_job_difficulty_mask(chain, difficulty);
             break;
         case DEVICE_SUPRA:
-            BM1368_set_job_difficulty_mask(mask);
+            BM1368_set_job_difficulty_mask(chain, difficulty);
             break;
         case DEVICE_GAMMA:
         case DEVICE_GAMMATURBO:
-            BM1370_set_job_difficulty_mask(mask);
+            BM1370_set_job_difficulty_mask(chain, difficulty);
             break;
         default:
+        return;
     }
 }
 
+// .set_difficulty_mask_fn = BM1366_set_job_difficulty_mask,
+void ASIC_set_job_difficulty_mask(GlobalState * GLOBAL_STATE, uint8_t mask) {
+    for (uint8_t chain = 0; chain < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; chain++) {
+        _set_chain_difficulty_mask(GLOBAL_STATE, chain, mask);
+        // the controller starts over from the mask it was given
+        ticket_mask_init(&GLOBAL_STATE->ASIC_TASK_MODULE.chains[chain].ticket_mask, mask, TARGET_NONCE_RATE, esp_timer_get_time());
+    }
+}
+
+void ASIC_update_ticket_mask(GlobalState * GLOBAL_STATE, AsicChain * chain) {
+    uint32_t difficulty = chain->ticket_mask.difficulty;
+
+    // the duplicate share filter is shared by every chain
+    double max_rate = SHARE_FILTER_MAX_RATE / GLOBAL_STATE->ASIC_TASK_MODULE.chain_count;
+
+    if (!ticket_mask_update(&chain->ticket_mask, esp_timer_get_time(), GLOBAL_STATE->stratum_difficulty, max_rate)) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Chain %u ticket mask difficulty %" PRIu32 " -> %" PRIu32 " (%.2f nonces/s)",
+             chain->index, difficulty, chain->ticket_mask.difficulty, chain->ticket_mask.rate);
+    _set_chain_difficulty_mask(GLOBAL_STATE, chain->index, chain->ticket_mask.difficulty);
+}
+
 // .send_work_fn = BM1366_send_work,
-void ASIC_send_work(GlobalState * GLOBAL_STATE, void * next_job) {
+void ASIC_send_work(GlobalState * GLOBAL_STATE, AsicChain * chain, void * next_job) {
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
-            BM1397_send_work(GLOBAL_STATE, next_job);
+            BM1397_send_work(chain, next_job);
             break;
         case DEVICE_ULTRA:
-            BM1366_send_work(GLOBAL_STATE, next_job);
+            BM1366_send_work(chain, next_job);
             break;
         case DEVICE_SUPRA:
-            BM1368_send_work(GLOBAL_STATE, next_job);
+            BM1368_send_work(chain, next_job);
             break;
         case DEVICE_GAMMA:
         case DEVICE_GAMMATURBO:
-            BM1370_send_work(GLOBAL_STATE, next_job);
+            BM1370_send_work(chain, next_job);
             break;
         default:
     return;
     }
 }
 
-// .set_version_mask = BM1366_set_version_mask
-void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask) {
+static void _set_chain_version_mask(GlobalState * GLOBAL_STATE, uint8_t chain, uint32_t mask) {
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
-            BM1397_set_version_mask(mask);
+            BM1397_set_version_mask(chain, mask);
             break;
         case DEVICE_ULTRA:
-            BM1366_set_version_mask(mask);
+            BM1366_set_version_mask(chain, mask);
             break;
         case DEVICE_SUPRA:
-            BM1368_set_version_mask(mask);
+            BM1368_set_version_mask(chain, mask);
             break;
         case DEVICE_GAMMA:
         case DEVICE_GAMMATURBO:
-            BM1370_set_version_mask(mask);
+            BM1370_set_version_mask(chain, mask);
             break;
         default:
-    return;
+        return;
     }
 }
 
-bool ASIC_set_frequency(GlobalState * GLOBAL_STATE, float target_frequency) {
-    ESP_LOGI(TAG, "Setting ASIC frequency to %.2f MHz", target_frequency);
-    bool success = false;
-    
+// .set_version_mask = BM1366_set_version_mask
+void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask) {
+    chip_version_mask = mask;
+    for (uint8_t chain = 0; chain < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; chain++) {
+        _set_chain_version_mask(GLOBAL_STATE, chain, mask);
+    }
+
+    // more or fewer rolled versions change how long a job lasts
+    ASIC_update_job_interval(GLOBAL_STATE);
+}
+
+// nonces per second the chain should return at the frequency of its chips and its ticket mask
+static double _expected_nonce_rate(GlobalState * GLOBAL_STATE, AsicChain * chain) {
+    double hashrate = 0;
+    for (uint16_t chip = 0; chip < frequency_transition_chip_count(chain->index); chip++) {
+        hashrate += frequency_transition_get(chain->index, chip) * 1e6 * ASIC_get_small_core_count(GLOBAL_STATE);
+    }
+    return hashrate / (chain->ticket_mask.difficulty * 4294967296.0);
+}
+
+// Resets and re-initializes one chain while the others keep hashing, the pool connection is not touched
+static void _recover_chain(GlobalState * GLOBAL_STATE, AsicChain * chain, uint32_t silence_ms) {
+    int64_t start_us = esp_timer_get_time();
+    uint8_t previous_count = chain->asic_count;
+
+    ESP_LOGW(TAG, "Chain %u silent for %" PRIu32 " ms, expected %.3f nonces/s, recovering",
+             chain->index, silence_ms, chain->watchdog.expected_rate);
+
+    pthread_mutex_lock(&chain->send_lock);
+
+    uint8_t chips = _reset_chain(GLOBAL_STATE, chain->index);
+    if (chips > 0) {
+        ASIC_set_max_baud(GLOBAL_STATE, chain->index);
+        SERIAL_clear_buffer(chain->index);
+        // training may have reset the chain again
+        chips = chain->asic_count;
+    }
+    _forget_jobs(chain);
+
+    int64_t now = esp_timer_get_time();
+    chain_watchdog_recovered(&chain->watchdog, now);
+
+    pthread_mutex_unlock(&chain->send_lock);
+
+    chain_recovery_event event = {
+        .time_us = now,
+        .chain = chain->index,
+        .silence_ms = silence_ms,
+        .asic_count = chips,
+        .duration_ms = (now - start_us) / 1000,
+        .recovered = chips > 0 && chips >= previous_count,
+    };
+    chain_recovery_log_add(&GLOBAL_STATE->ASIC_TASK_MODULE.recovery_log, &event);
+
+    if (event.recovered) {
+        ESP_LOGI(TAG, "Chain %u recovered in %" PRIu32 " ms, %u chip(s)", chain->index, event.duration_ms, chips);
+    } else {
+        ESP_LOGE(TAG, "Chain %u recovery found %u of %u chip(s)", chain->index, chips, previous_count);
+    }
+
+    // hand the chain fresh work right away
+    xSemaphoreGive(chain->semaphore);
+}
+
+void ASIC_check_stall(GlobalState * GLOBAL_STATE, AsicChain * chain) {
+#ifdef CONFIG_ASIC_STALL_RECOVERY
+    int64_t now = esp_timer_get_time();
+    chain->watchdog.expected_rate = _expected_nonce_rate(GLOBAL_STATE, chain);
+
+    if (!chain_watchdog_stalled(&chain->watchdog, now)) {
+        return;
+    }
+    _recover_chain(GLOBAL_STATE, chain, (now - chain->watchdog.last_nonce_us) / 1000);
+#endif
+}
+
+static void _update_job_interval(GlobalState * GLOBAL_STATE, float frequency) {
+    job_interval_params params = {
+        .frequency_mhz = frequency,
+        .small_core_count = ASIC_get_small_core_count(GLOBAL_STATE),
+        // every chain gets jobs of its own
+        .asic_count = ASIC_get_asic_count(GLOBAL_STATE),
+        .versions = job_interval_versions(chip_version_mask),
+        .hash_counting_number = 0,
+    };
+
     switch (GLOBAL_STATE->asic_model) {
+        case ASIC_BM1397:
+            // the version is rolled on the host, a job carries 4 midstates when the pool allows it
+            params.versions = GLOBAL_STATE->version_mask != 0 ? 4 : 1;
+            break;
         case ASIC_BM1366:
-            success = BM1366_set_frequency(target_frequency);
+            params.hash_counting_number = BM1366_HASH_COUNTING_NUMBER;
             break;
         case ASIC_BM1368:
-            success = BM1368_set_frequency(target_frequency);
+            params.hash_counting_number = BM1368_HASH_COUNTING_NUMBER;
             break;
         case ASIC_BM1370:
-            success = BM1370_set_frequency(target_frequency);
-            break;
-        case ASIC_BM1397:
-            // BM1397 doesn't have a set_frequency function yet
-            ESP_LOGE(TAG, "Frequency transition not implemented for BM1397");
-            success = false;
+            params.hash_counting_number = BM1370_HASH_COUNTING_NUMBER;
             break;
         default:
-            ESP_LOGE(TAG, "Unknown ASIC model, cannot set frequency");
-            success = false;
+            ESP_LOGW(TAG, "No job interval for ASIC model %d, keeping %.2f ms",
+                     GLOBAL_STATE->asic_model, GLOBAL_STATE->asic_job_frequency_ms);
+            return;
+    }
+
+    double interval_ms = job_interval_ms(&params, interval_trim.factor);
+    if (interval_ms != GLOBAL_STATE->asic_job_frequency_ms) {
+        ESP_LOGI(TAG, "ASIC job interval %.2f ms (%.2f MHz, %" PRIu32 " versions, trim %.2f)",
+                 interval_ms, frequency, params.versions, interval_trim.factor);
+    }
+    GLOBAL_STATE->asic_job_frequency_ms = interval_ms;
+}
+
+void ASIC_update_job_interval(GlobalState * GLOBAL_STATE) {
+    _update_job_interval(GLOBAL_STATE, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value);
+}
+
+void ASIC_trim_job_interval(GlobalState * GLOBAL_STATE) {
+#ifdef CONFIG_ASIC_JOB_INTERVAL_TRIM
+    int64_t now = esp_timer_get_time();
+    if (now - interval_trim_time_us < JOB_INTERVAL_TRIM_PERIOD_US) {
+        return;
+    }
+    interval_trim_time_us = now;
+
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    uint64_t duplicates = GLOBAL_STATE->duplicate_share_filter.duplicates;
+    double factor = interval_trim.factor;
+
+    job_interval_trim_update(&interval_trim, module->nonces_found + duplicates, duplicates,
+                             module->shares_accepted + module->shares_rejected, module->shares_stale);
+
+    if (interval_trim.factor != factor) {
+        ASIC_update_job_interval(GLOBAL_STATE);
+    }
+#endif
+}
+
+bool ASIC_set_frequency(GlobalState * GLOBAL_STATE, float target_frequency) {
+    ESP_LOGI(TAG, "Setting ASIC frequency to %.2f MHz", target_frequency);
+    bool success = true;
+
+    for (uint8_t chain = 0; chain < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; chain++) {
+        // a chain being reset by its result task ramps to the new board frequency once it is done
+        pthread_mutex_t * frequency_lock = &GLOBAL_STATE->ASIC_TASK_MODULE.chains[chain].frequency_lock;
+        pthread_mutex_lock(frequency_lock);
+        success = _set_chain_frequency(GLOBAL_STATE, chain, target_frequency);
+        pthread_mutex_unlock(frequency_lock);
+        if (!success) {
             break;
+        }
     }
     
     if (success) {
         ESP_LOGI(TAG, "Successfully transitioned to new ASIC frequency: %.2f MHz", target_frequency);
+        _update_job_interval(GLOBAL_STATE, target_frequency);
     } else {
         ESP_LOGE(TAG, "Failed to transition to new ASIC frequency: %.2f MHz", target_frequency);
     }
@@ -195,6 +661,35 @@ bool ASIC_set_frequency(GlobalState * GLOBAL_STATE, float target_frequency) {
     return success;
 }
 
+void ASIC_set_chip_frequency_caps(GlobalState * GLOBAL_STATE, const char * table) {
+    const char * p = table == NULL ? "" : table;
+
+    for (int chip = 0; chip < ASIC_MAX_TUNED_CHIPS; chip++) {
+        char * end;
+        long cap = strtol(p, &end, 10);
+        chip_frequency_cap[chip] = (end != p && cap > 0) ? (float) cap : 0;
+        if (chip_frequency_cap[chip] > 0) {
+            ESP_LOGI(TAG, "Chip %d frequency capped at %.0f MHz", chip, chip_frequency_cap[chip]);
+        }
+
+        // entries are separated by commas, an empty entry follows the board frequency
+        p = strchr(end, ',');
+        if (p == NULL) {
+            p = "";
+        } else {
+            p++;
+        }
+    }
+}
+
+float ASIC_get_chip_frequency(GlobalState * GLOBAL_STATE, uint16_t chip) {
+    uint8_t per_chain = ASIC_get_asic_count(GLOBAL_STATE);
+    if (per_chain == 0 || chip / per_chain >= GLOBAL_STATE->ASIC_TASK_MODULE.chain_count) {
+        return 0;
+    }
+    return frequency_transition_get(chip / per_chain, chip % per_chain);
+}
+
 esp_err_t ASIC_set_device_model(GlobalState * GLOBAL_STATE) {
 
     if (GLOBAL_STATE->device_model_str == NULL) {
@@ -204,7 +699,6 @@ esp_err_t ASIC_set_device_model(GlobalState * GLOBAL_STATE) {
 
     if (strcmp(GLOBAL_STATE->device_model_str, "max") == 0) {
         GLOBAL_STATE->asic_model = ASIC_BM1397;
-        GLOBAL_STATE->asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value * BM1397_SMALL_CORE_COUNT * 1000)) / (double) ASIC_get_asic_count(GLOBAL_STATE); // no version-rolling so same Nonce Space is splitted between Small Cores
         GLOBAL_STATE->ASIC_difficulty = BM1397_ASIC_DIFFICULTY;
         ESP_LOGI(TAG, "DEVICE: bitaxeMax");
         ESP_LOGI(TAG, "ASIC: %dx BM1397 (%" PRIu64 " cores)", BITAXE_MAX_ASIC_COUNT, BM1397_CORE_COUNT);
@@ -212,8 +706,6 @@ esp_err_t ASIC_set_device_model(GlobalState * GLOBAL_STATE) {
 
     } else if (strcmp(GLOBAL_STATE->device_model_str, "ultra") == 0) {
         GLOBAL_STATE->asic_model = ASIC_BM1366;
-        //GLOBAL_STATE.asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value * BM1366_CORE_COUNT * 1000)) / (double) BITAXE_ULTRA_ASIC_COUNT; // version-rolling so Small Cores have different Nonce Space
-        GLOBAL_STATE->asic_job_frequency_ms = 2000; //ms
         GLOBAL_STATE->ASIC_difficulty = BM1366_ASIC_DIFFICULTY;
         ESP_LOGI(TAG, "DEVICE: bitaxeUltra");
         ESP_LOGI(TAG, "ASIC: %dx BM1366 (%" PRIu64 " cores)", BITAXE_ULTRA_ASIC_COUNT, BM1366_CORE_COUNT);
@@ -221,8 +713,6 @@ esp_err_t ASIC_set_device_model(GlobalState * GLOBAL_STATE) {
 
     } else if (strcmp(GLOBAL_STATE->device_model_str, "supra") == 0) {
         GLOBAL_STATE->asic_model = ASIC_BM1368;
-        //GLOBAL_STATE.asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value * BM1368_CORE_COUNT * 1000)) / (double) BITAXE_SUPRA_ASIC_COUNT; // version-rolling so Small Cores have different Nonce Space
-        GLOBAL_STATE->asic_job_frequency_ms = 500; //ms
         GLOBAL_STATE->ASIC_difficulty = BM1368_ASIC_DIFFICULTY;
         ESP_LOGI(TAG, "DEVICE: bitaxeSupra");
         ESP_LOGI(TAG, "ASIC: %dx BM1368 (%" PRIu64 " cores)", BITAXE_SUPRA_ASIC_COUNT, BM1368_CORE_COUNT);
@@ -230,8 +720,6 @@ esp_err_t ASIC_set_device_model(GlobalState * GLOBAL_STATE) {
 
     } else if (strcmp(GLOBAL_STATE->device_model_str, "gamma") == 0) {
         GLOBAL_STATE->asic_model = ASIC_BM1370;
-        //GLOBAL_STATE.asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value * BM1370_CORE_COUNT * 1000)) / (double) BITAXE_GAMMA_ASIC_COUNT; // version-rolling so Small Cores have different Nonce Space
-        GLOBAL_STATE->asic_job_frequency_ms = 500; //ms
         GLOBAL_STATE->ASIC_difficulty = BM1370_ASIC_DIFFICULTY;
         ESP_LOGI(TAG, "DEVICE: bitaxeGamma");
         ESP_LOGI(TAG, "ASIC: %dx BM1370 (%" PRIu64 " cores)", BITAXE_GAMMA_ASIC_COUNT, BM1370_CORE_COUNT);
@@ -239,8 +727,6 @@ esp_err_t ASIC_set_device_model(GlobalState * GLOBAL_STATE) {
 
     } else if (strcmp(GLOBAL_STATE->device_model_str, "gammaturbo") == 0) {
         GLOBAL_STATE->asic_model = ASIC_BM1370;
-        //GLOBAL_STATE.asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value * BM1370_CORE_COUNT * 1000)) / (double) BITAXE_GAMMATURBO_ASIC_COUNT; // version-rolling so Small Cores have different Nonce Space
-        GLOBAL_STATE->asic_job_frequency_ms = 500; //ms
         GLOBAL_STATE->ASIC_difficulty = BM1370_ASIC_DIFFICULTY;
         ESP_LOGI(TAG, "DEVICE: bitaxeGammaTurbo");
         ESP_LOGI(TAG, "ASIC: %dx BM1370 (%" PRIu64 " cores)", BITAXE_GAMMATURBO_ASIC_COUNT, BM1370_CORE_COUNT);
@@ -251,5 +737,7 @@ esp_err_t ASIC_set_device_model(GlobalState * GLOBAL_STATE) {
         GLOBAL_STATE->device_model = DEVICE_UNKNOWN;
         return ESP_FAIL;
     }
+
+    ASIC_update_job_interval(GLOBAL_STATE);
     return ESP_OK;
 }
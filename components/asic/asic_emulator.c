@@ -0,0 +1,469 @@
+#include <string.h>
+
+#include "asic_emulator.h"
+#include "crc.h"
+
+#define TYPE_JOB 0x20
+#define TYPE_CMD 0x40
+
+#define GROUP_ALL 0x10
+
+#define CMD_SETADDRESS 0x00
+#define CMD_WRITE 0x01
+#define CMD_READ 0x02
+#define CMD_INACTIVE 0x03
+
+#define CHIP_ID_REGISTER 0x00
+#define PLL0_PARAMETER 0x08
+#define TICKET_MASK 0x14
+#define PLL_LOCKED 0x80000000
+
+#define RESPONSE_JOB 0x80
+
+// job payload offsets, the BM1366/68/70 job and the BM1397 job_packet share the first 14 bytes
+#define JOB_ID 0
+#define JOB_NBITS 6
+#define JOB_NTIME 10
+#define JOB_MERKLE_ROOT 14
+#define JOB_PREV_BLOCK_HASH 46
+#define JOB_VERSION 78
+#define JOB_LENGTH 82
+#define BM1397_JOB_MERKLE4 14
+#define BM1397_JOB_MIDSTATE 18
+#define BM1397_JOB_LENGTH 50
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t sha256_init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static uint32_t _be32(const uint8_t * p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static void _put_be32(uint8_t * p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+// the chips run the compression function directly on a midstate, so the emulator does too
+static void _sha256_compress(uint32_t * state, const uint8_t * block)
+{
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = _be32(block + 4 * i);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+// second half of the header hash from the midstate, then the hash of that hash
+static void _double_sha256_tail(const uint32_t * midstate, const uint8_t * tail, uint32_t * result)
+{
+    uint8_t block[64] = {0};
+    uint32_t state[8];
+
+    memcpy(state, midstate, sizeof(state));
+    memcpy(block, tail, 16);
+    block[16] = 0x80;
+    // 80 byte message
+    block[62] = 0x02;
+    block[63] = 0x80;
+    _sha256_compress(state, block);
+
+    memset(block, 0, sizeof(block));
+    for (int i = 0; i < 8; i++) {
+        _put_be32(block + 4 * i, state[i]);
+    }
+    block[32] = 0x80;
+    // 32 byte message
+    block[62] = 0x01;
+    block[63] = 0x00;
+
+    memcpy(result, sha256_init, sizeof(sha256_init));
+    _sha256_compress(result, block);
+}
+
+void asic_emulator_hash_header(const uint8_t * header, uint8_t * hash)
+{
+    uint32_t midstate[8];
+    uint32_t result[8];
+
+    memcpy(midstate, sha256_init, sizeof(midstate));
+    _sha256_compress(midstate, header);
+    _double_sha256_tail(midstate, header + 64, result);
+
+    for (int i = 0; i < 8; i++) {
+        _put_be32(hash + 4 * i, result[i]);
+    }
+}
+
+static void _push_rx(asic_emulator * emulator, const uint8_t * data, int length)
+{
+    for (int i = 0; i < length; i++) {
+        if (emulator->rx_length == ASIC_EMULATOR_RX_BUFFER) {
+            emulator->stats.rx_overflows++;
+            return;
+        }
+        emulator->rx[(emulator->rx_head + emulator->rx_length) % ASIC_EMULATOR_RX_BUFFER] = data[i];
+        emulator->rx_length++;
+    }
+}
+
+// responses end in the response type flag and a crc5 over everything after the preamble
+static void _send_response(asic_emulator * emulator, uint8_t * frame, uint8_t flags)
+{
+    uint8_t length = emulator->response_length;
+
+    for (uint8_t crc = 0; crc <= 0x1F; crc++) {
+        frame[length - 1] = flags | crc;
+        if (crc5(frame + 2, length - 2) == 0) {
+            break;
+        }
+    }
+
+    _push_rx(emulator, frame, length);
+}
+
+static uint32_t _read_register(asic_emulator * emulator, uint16_t chip, uint8_t register_address)
+{
+    switch (register_address) {
+        case CHIP_ID_REGISTER:
+            // chip id, core count byte (reads back as 0 on real chips) and the chip address
+            return ((uint32_t) emulator->config.chip_id << 16) | emulator->chip_address[chip];
+        case PLL0_PARAMETER:
+            return emulator->registers[register_address] | PLL_LOCKED;
+        default:
+            return emulator->registers[register_address];
+    }
+}
+
+static void _register_response(asic_emulator * emulator, uint16_t chip, uint8_t register_address)
+{
+    uint8_t frame[11] = {0xAA, 0x55};
+
+    _put_be32(frame + 2, _read_register(emulator, chip, register_address));
+    frame[6] = emulator->chip_address[chip];
+    frame[7] = register_address;
+    _send_response(emulator, frame, 0);
+}
+
+// the drivers write difficulty - 1 with the bits of each byte reversed, the low byte last
+static void _set_ticket_mask(asic_emulator * emulator, const uint8_t * value)
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        uint8_t byte = value[3 - i];
+        uint8_t reversed = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            reversed = (reversed << 1) | ((byte >> bit) & 1);
+        }
+        mask |= (uint32_t) reversed << (8 * i);
+    }
+
+    // the mask has no holes, each bit is one more leading zero bit than difficulty 1
+    int bits = mask == 0 ? 0 : 32 - __builtin_clz(mask);
+    int zero_bits = emulator->config.zero_bits + bits - __builtin_ctz(ASIC_EMULATOR_DEFAULT_DIFFICULTY);
+    if (zero_bits < 0) {
+        zero_bits = 0;
+    }
+    if (zero_bits > 32) {
+        zero_bits = 32;
+    }
+    emulator->zero_bits = zero_bits;
+}
+
+static void _command(asic_emulator * emulator, uint8_t header, const uint8_t * data, int length)
+{
+    if (length < 2) {
+        return;
+    }
+
+    bool all = (header & GROUP_ALL) != 0;
+
+    switch (header & 0x0F) {
+        case CMD_SETADDRESS:
+            // the first chip without an address takes it and stops forwarding the command
+            if (emulator->addressed_chips < emulator->config.asic_count) {
+                emulator->chip_address[emulator->addressed_chips++] = data[0];
+            }
+            break;
+        case CMD_WRITE:
+            // one register file for the chain, none of the drivers set chips apart yet
+            if (length >= 6) {
+                emulator->registers[data[1]] = _be32(data + 2);
+                if (data[1] == TICKET_MASK) {
+                    _set_ticket_mask(emulator, data + 2);
+                }
+            }
+            break;
+        case CMD_READ:
+            for (uint16_t chip = 0; chip < emulator->config.asic_count; chip++) {
+                if (all || emulator->chip_address[chip] == data[0]) {
+                    _register_response(emulator, chip, data[1]);
+                }
+            }
+            break;
+        case CMD_INACTIVE:
+        default:
+            break;
+    }
+}
+
+static void _word_reverse(uint8_t * dest, const uint8_t * src)
+{
+    for (int i = 0; i < 8; i++) {
+        memcpy(dest + 4 * i, src + 28 - 4 * i, 4);
+    }
+}
+
+static void _job(asic_emulator * emulator, const uint8_t * data, int length)
+{
+    if (emulator->config.chip_id == 0x1397) {
+        if (length < BM1397_JOB_LENGTH) {
+            return;
+        }
+
+        // tail of the header is merkle root word 7, ntime, nbits and the nonce
+        memcpy(emulator->tail, data + BM1397_JOB_MERKLE4, 4);
+        memcpy(emulator->tail + 4, data + JOB_NTIME, 4);
+        memcpy(emulator->tail + 8, data + JOB_NBITS, 4);
+
+        // the midstate is sent as big endian words in reverse byte order
+        uint8_t midstate[32];
+        for (int i = 0; i < 32; i++) {
+            midstate[i] = data[BM1397_JOB_MIDSTATE + 31 - i];
+        }
+        for (int i = 0; i < 8; i++) {
+            emulator->midstate[i] = _be32(midstate + 4 * i);
+        }
+    } else {
+        if (length < JOB_LENGTH) {
+            return;
+        }
+
+        // rebuild the block header, the hashes are sent with their words in reverse order
+        uint8_t header[80];
+        memcpy(header, data + JOB_VERSION, 4);
+        _word_reverse(header + 4, data + JOB_PREV_BLOCK_HASH);
+        _word_reverse(header + 36, data + JOB_MERKLE_ROOT);
+        memcpy(header + 68, data + JOB_NTIME, 4);
+        memcpy(header + 72, data + JOB_NBITS, 4);
+
+        memcpy(emulator->midstate, sha256_init, sizeof(emulator->midstate));
+        _sha256_compress(emulator->midstate, header);
+        memcpy(emulator->tail, header + 64, 12);
+    }
+
+    emulator->job_id = data[JOB_ID];
+    emulator->next_nonce = 0;
+    emulator->job_valid = true;
+    emulator->stats.jobs++;
+}
+
+static void _execute(asic_emulator * emulator, const uint8_t * frame, int length)
+{
+    uint8_t header = frame[2];
+    bool job = (header & TYPE_JOB) != 0;
+
+    if (job) {
+        uint16_t crc = ((uint16_t) frame[length - 2] << 8) | frame[length - 1];
+        if (crc16_false((uint8_t *) frame + 2, length - 4) != crc) {
+            emulator->stats.crc_errors++;
+            return;
+        }
+        _job(emulator, frame + 4, length - 6);
+    } else {
+        if (crc5((uint8_t *) frame + 2, length - 3) != frame[length - 1]) {
+            emulator->stats.crc_errors++;
+            return;
+        }
+        _command(emulator, header, frame + 4, length - 5);
+    }
+
+    emulator->stats.frames++;
+}
+
+void asic_emulator_init(asic_emulator * emulator, const asic_emulator_config * config)
+{
+    memset(emulator, 0, sizeof(asic_emulator));
+    emulator->config = *config;
+    if (emulator->config.asic_count > ASIC_EMULATOR_MAX_CHIPS) {
+        emulator->config.asic_count = ASIC_EMULATOR_MAX_CHIPS;
+    }
+    if (emulator->config.zero_bits > 32) {
+        emulator->config.zero_bits = 32;
+    }
+    emulator->zero_bits = emulator->config.zero_bits;
+    emulator->response_length = config->chip_id == 0x1397 ? 9 : 11;
+}
+
+void asic_emulator_write(asic_emulator * emulator, const uint8_t * data, int length)
+{
+    while (length > 0) {
+        int copy = sizeof(emulator->tx) - emulator->tx_length;
+        if (copy > length) {
+            copy = length;
+        }
+        memcpy(emulator->tx + emulator->tx_length, data, copy);
+        emulator->tx_length += copy;
+        data += copy;
+        length -= copy;
+
+        while (emulator->tx_length >= 4) {
+            // the length byte counts everything after the preamble
+            int frame_length = emulator->tx[3] + 2;
+
+            if (emulator->tx[0] != 0x55 || emulator->tx[1] != 0xAA || frame_length < 5) {
+                memmove(emulator->tx, emulator->tx + 1, --emulator->tx_length);
+                continue;
+            }
+            if (emulator->tx_length < frame_length) {
+                break;
+            }
+
+            _execute(emulator, emulator->tx, frame_length);
+            emulator->tx_length -= frame_length;
+            memmove(emulator->tx, emulator->tx + frame_length, emulator->tx_length);
+        }
+    }
+}
+
+static void _nonce_response(asic_emulator * emulator, uint32_t nonce)
+{
+    uint8_t frame[11] = {0xAA, 0x55};
+    uint8_t job_id;
+
+    // the nonce goes out in header byte order, which is what the drivers memcpy back
+    memcpy(frame + 2, emulator->tail + 12, 4);
+
+    switch (emulator->config.chip_id) {
+        case 0x1370:
+            // job id in bits 7-1, small core in the low nibble
+            job_id = (emulator->job_id << 1) | (nonce & 0x0F);
+            break;
+        case 0x1397:
+            // midstate index in the low bits, only the first midstate is hashed
+            job_id = emulator->job_id;
+            break;
+        default:
+            job_id = emulator->job_id | (nonce & 0x07);
+            break;
+    }
+
+    frame[6] = 0;
+    frame[7] = job_id;
+    // version bits stay 0, the 32 bit nonce range of one job is never exhausted in software
+    _send_response(emulator, frame, RESPONSE_JOB);
+}
+
+void asic_emulator_run(asic_emulator * emulator, int64_t now_us)
+{
+    if (!emulator->job_valid || emulator->last_run_us == 0) {
+        emulator->last_run_us = now_us;
+        return;
+    }
+
+    emulator->hash_credit += (double) emulator->config.hashrate * (now_us - emulator->last_run_us) / 1e6;
+    emulator->last_run_us = now_us;
+
+    uint32_t count = (uint32_t) emulator->hash_credit;
+    if (count > ASIC_EMULATOR_MAX_NONCES_PER_RUN) {
+        // a slow caller loses the work, the same as a chip that was never polled
+        count = ASIC_EMULATOR_MAX_NONCES_PER_RUN;
+        emulator->hash_credit = 0;
+    } else {
+        emulator->hash_credit -= count;
+    }
+
+    uint8_t zero_bits = emulator->zero_bits;
+    uint32_t result[8];
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t nonce = emulator->next_nonce++;
+        emulator->tail[12] = nonce;
+        emulator->tail[13] = nonce >> 8;
+        emulator->tail[14] = nonce >> 16;
+        emulator->tail[15] = nonce >> 24;
+
+        _double_sha256_tail(emulator->midstate, emulator->tail, result);
+
+        // the hash is compared as a little endian number, its top 32 bits are the last word byte swapped
+        uint32_t top = __builtin_bswap32(result[7]);
+        if (zero_bits == 0 || (top >> (32 - zero_bits)) == 0) {
+            emulator->stats.nonces++;
+            _nonce_response(emulator, nonce);
+        }
+    }
+
+    emulator->stats.hashes += count;
+}
+
+int asic_emulator_read(asic_emulator * emulator, uint8_t * buffer, int length)
+{
+    int count = 0;
+
+    while (count < length && emulator->rx_length > 0) {
+        buffer[count++] = emulator->rx[emulator->rx_head];
+        emulator->rx_head = (emulator->rx_head + 1) % ASIC_EMULATOR_RX_BUFFER;
+        emulator->rx_length--;
+    }
+
+    return count;
+}
+
+int asic_emulator_available(const asic_emulator * emulator)
+{
+    return emulator->rx_length;
+}
+
+void asic_emulator_clear(asic_emulator * emulator)
+{
+    emulator->rx_head = 0;
+    emulator->rx_length = 0;
+}
@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include "asic_telemetry.h"
+
+static asic_chip_telemetry chips[ASIC_TELEMETRY_MAX_CHIPS];
+static uint16_t chip_count;
+static uint16_t chips_per_chain;
+static uint8_t address_interval;
+
+// Responses are AA 55, the 4 byte register value, the address of the chip that answered,
+// the register address, and on the 11 byte variants two more bytes before the crc
+bool asic_telemetry_decode(const uint8_t * frame, int length, asic_register_response * response)
+{
+    if (length < 9) {
+        return false;
+    }
+
+    response->value = ((uint32_t) frame[2] << 24) | ((uint32_t) frame[3] << 16) | ((uint32_t) frame[4] << 8) | frame[5];
+    response->chip_address = frame[6];
+    response->register_address = frame[7];
+    return true;
+}
+
+void asic_telemetry_init(uint8_t chain_count, uint16_t asic_count)
+{
+    memset(chips, 0, sizeof(chips));
+    chips_per_chain = asic_count;
+    chip_count = chain_count * asic_count > ASIC_TELEMETRY_MAX_CHIPS ? ASIC_TELEMETRY_MAX_CHIPS : chain_count * asic_count;
+    // same interval the drivers use when assigning addresses, a single chip keeps address 0
+    address_interval = asic_count > 0 ? (uint8_t) (256 / asic_count) : 0;
+}
+
+void asic_telemetry_record(uint8_t chain, const uint8_t * frame, int length, int64_t now_us)
+{
+    asic_register_response response;
+    if (!asic_telemetry_decode(frame, length, &response)) {
+        return;
+    }
+
+    // anything between the assigned addresses is a misparse
+    if (address_interval == 0 ? response.chip_address != 0 : response.chip_address % address_interval != 0) {
+        return;
+    }
+
+    uint16_t chip = address_interval == 0 ? 0 : response.chip_address / address_interval;
+    if (chip >= chips_per_chain) {
+        return;
+    }
+
+    // every chain addresses its chips from 0, readings are kept chain after chain
+    chip += chain * chips_per_chain;
+    if (chip >= chip_count) {
+        return;
+    }
+
+    asic_chip_telemetry * telemetry = &chips[chip];
+
+    switch (response.register_address) {
+        case ASIC_REG_PLL0_PARAMETER:
+            telemetry->pll_locked = (response.value & ASIC_PLL_LOCKED) != 0;
+            break;
+        case ASIC_REG_NONCE_ERROR_COUNTER:
+            telemetry->nonce_errors = response.value;
+            break;
+        case ASIC_REG_NONCE_OVERFLOW_COUNTER:
+            telemetry->nonce_overflows = response.value;
+            break;
+        case ASIC_REG_ANALOG_MUX_CONTROL:
+            telemetry->analog_mux = response.value;
+            break;
+        default:
+            // chip id reads from link training and anything else not polled here
+            return;
+    }
+
+    telemetry->seen = true;
+    telemetry->updated_us = now_us;
+}
+
+uint16_t asic_telemetry_chip_count(void)
+{
+    return chip_count;
+}
+
+const asic_chip_telemetry * asic_telemetry_get(uint16_t chip)
+{
+    if (chip >= chip_count) {
+        return NULL;
+    }
+    return &chips[chip];
+}
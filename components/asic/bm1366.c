@@ -9,6 +9,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "frequency_transition_bmXX.h"
+#include "init_burst.h"
+#include "pll.h"
 
 #include <math.h>
 #include <stdint.h>
@@ -20,12 +22,6 @@
 #define BM1366_CHIP_ID 0x1366
 #define BM1366_CHIP_ID_RESPONSE_LENGTH 11
 
-#ifdef CONFIG_GPIO_ASIC_RESET
-#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
-#else
-#define GPIO_ASIC_RESET 1
-#endif
-
 #define TYPE_JOB 0x20
 #define TYPE_CMD 0x40
 
@@ -51,6 +47,7 @@
 #define CORE_REGISTER_CONTROL 0x3C
 #define PLL3_PARAMETER 0x68
 #define FAST_UART_CONFIGURATION 0x28
+#define FAST_UART_BAUD 1000000
 #define TICKET_MASK 0x14
 #define MISC_CONTROL 0x18
 
@@ -64,93 +61,38 @@ typedef struct __attribute__((__packed__))
     uint8_t crc;
 } bm1366_asic_result_t;
 
-static float current_frequency = 56.25;
 
 static const char * TAG = "bm1366Module";
 
-static task_result result;
-
 /// @brief
 /// @param ftdi
 /// @param header
 /// @param data
 /// @param len
-static void _send_BM1366(uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
-{
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    // allocate memory for buffer
-    unsigned char * buf = malloc(total_length);
-
-    // add the preamble
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-
-    // add the header field
-    buf[2] = header;
-
-    // add the length field
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-
-    // add the data
-    memcpy(buf + 4, data, data_len);
-
-    // add the correct crc type
-    if (packet_type == JOB_PACKET) {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    } else {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
-    }
-
-    // send serial data
-    SERIAL_send(buf, total_length, debug);
-
-    free(buf);
-}
-
-static void _send_simple(uint8_t * data, uint8_t total_length)
+static void _send_BM1366(uint8_t chain, uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
 {
-    unsigned char * buf = malloc(total_length);
-    memcpy(buf, data, total_length);
-    SERIAL_send(buf, total_length, BM1366_SERIALTX_DEBUG);
-
-    free(buf);
+    SERIAL_send_packet(chain, header, data, data_len, debug);
 }
 
-static void _send_chain_inactive(void)
+static void _send_simple(uint8_t chain, uint8_t * data, uint8_t total_length)
 {
-
-    unsigned char read_address[2] = {0x00, 0x00};
-    // send serial data
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1366_SERIALTX_DEBUG);
+    SERIAL_send(chain, data, total_length, BM1366_SERIALTX_DEBUG);
 }
 
-static void _set_chip_address(uint8_t chipAddr)
-{
-
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    // send serial data
-    _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1366_SERIALTX_DEBUG);
-}
-
-void BM1366_set_version_mask(uint32_t version_mask) 
+void BM1366_set_version_mask(uint8_t chain, uint32_t version_mask) 
 {
     int versions_to_roll = version_mask >> 13;
     uint8_t version_byte0 = (versions_to_roll >> 8);
     uint8_t version_byte1 = (versions_to_roll & 0xFF); 
     uint8_t version_cmd[] = {0x00, 0xA4, 0x90, 0x00, version_byte0, version_byte1};
-    _send_BM1366(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1366_SERIALTX_DEBUG);
 }
 
-void BM1366_send_hash_frequency(float target_freq)
-{
-    // default 200Mhz if it fails
-    unsigned char freqbuf[9] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41}; // freqbuf - pll0_parameter
-    float newf = 200.0;
+// dividers for every 6.25 MHz step, filled in by BM1366_init
+static pll_table pll_lookup;
 
+static bool _pll_search(float target_freq, pll_setting * pll)
+{
     uint8_t fb_divider = 0;
     uint8_t post_divider1 = 0, post_divider2 = 0;
     uint8_t ref_divider = 0;
@@ -182,131 +124,164 @@ void BM1366_send_hash_frequency(float target_freq)
         }
     }
 
-    if (fb_divider == 0) {
+    pll->fb_divider = fb_divider;
+    pll->ref_divider = ref_divider;
+    pll->post_divider1 = post_divider1;
+    pll->post_divider2 = post_divider2;
+    return fb_divider != 0;
+}
+
+void BM1366_send_hash_frequency(uint8_t chain, int chip_address, float target_freq)
+{
+    // default 200Mhz if it fails
+    unsigned char freqbuf[9] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41}; // freqbuf - pll0_parameter
+    float newf = 200.0;
+
+    pll_setting pll;
+    if (!pll_table_lookup(&pll_lookup, target_freq, &pll)) {
         puts("Finding dividers failed, using default value (200Mhz)");
     } else {
-        newf = 25.0 * (float) (fb_divider) / (float) (ref_divider * post_divider1 * post_divider2);
-        //printf("final refdiv: %d, fbdiv: %d, postdiv1: %d, postdiv2: %d, min diff value: %f\n", ref_divider, fb_divider, post_divider1, post_divider2, min_difference);
+        newf = pll_frequency(&pll);
+        //printf("final refdiv: %d, fbdiv: %d, postdiv1: %d, postdiv2: %d\n", pll.ref_divider, pll.fb_divider, pll.post_divider1, pll.post_divider2);
 
-        freqbuf[3] = fb_divider;
-        freqbuf[4] = ref_divider;
-        freqbuf[5] = (((post_divider1 - 1) & 0xf) << 4) + ((post_divider2 - 1) & 0xf);
+        freqbuf[3] = pll.fb_divider;
+        freqbuf[4] = pll.ref_divider;
+        freqbuf[5] = (((pll.post_divider1 - 1) & 0xf) << 4) + ((pll.post_divider2 - 1) & 0xf);
 
-        if (fb_divider * 25 / (float) ref_divider >= 2400) {
+        if (pll.fb_divider * 25 / (float) pll.ref_divider >= 2400) {
             freqbuf[2] = 0x50;
         }
     }
 
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1366_SERIALTX_DEBUG);
+    if (chip_address != FREQUENCY_ALL_CHIPS) {
+        freqbuf[0] = chip_address;
+    }
+    _send_BM1366(chain, TYPE_CMD | (chip_address == FREQUENCY_ALL_CHIPS ? GROUP_ALL : GROUP_SINGLE) | CMD_WRITE, freqbuf, 6, BM1366_SERIALTX_DEBUG);
 
-    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", target_freq, newf);
+    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f) on chip %d", target_freq, newf, chip_address);
 }
 
-static void do_frequency_ramp_up(float target_frequency) {
-    ESP_LOGI(TAG, "Ramping up frequency from %.2f MHz to %.2f MHz", current_frequency, target_frequency);
-    do_frequency_transition(target_frequency, BM1366_send_hash_frequency, 1366);
+static void do_frequency_ramp_up(uint8_t chain, float target_frequency) {
+    ESP_LOGI(TAG, "Ramping up frequency from %.2f MHz to %.2f MHz", frequency_transition_get(chain, 0), target_frequency);
+    do_frequency_transition(chain, target_frequency, BM1366_send_hash_frequency, 1366);
 }
 
 // Add a public function for external use
-bool BM1366_set_frequency(float target_freq) {
-    return do_frequency_transition(target_freq, BM1366_send_hash_frequency, 1366);
+bool BM1366_set_frequency(uint8_t chain, float target_freq) {
+    return do_frequency_transition(chain, target_freq, BM1366_send_hash_frequency, 1366);
 }
 
 
-static uint8_t _send_init(uint64_t frequency, uint16_t asic_count)
+// the init scripts carry the version mask and ticket mask frames for these values
+_Static_assert(STRATUM_DEFAULT_VERSION_MASK == 0x1fffe000, "update the version mask frames of the init scripts");
+_Static_assert(BM1366_ASIC_DIFFICULTY == 256, "update the ticket mask frame of the init script");
+
+// set the version mask and read register 00 on all chips
+static const init_frame init_script_enumerate[] = {
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {7, {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A}},
+};
+
+// sent before the chips get their addresses
+static const init_frame init_script_chain[] = {
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00, 0x00}},
+    // chain inactive
+    {7, {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03}},
+};
+
+static const init_frame init_script_registers[] = {
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x85, 0x40, 0x0C}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x80, 0x20, 0x19}},
+    // ticket mask
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x14, 0x00, 0x00, 0x00, 0xFF, 0x08}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x03, 0x1D}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x58, 0x02, 0x11, 0x11, 0x11, 0x06}},
+    {11, {0x55, 0xAA, 0x41, 0x09, 0x00, 0x2C, 0x00, 0x7C, 0x00, 0x03, 0x03}},
+    //S19XP Dump sends baudrate change here.. we wait until later.
+    // {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03}},
+};
+
+// only used while a chain is initialized, chains are brought up one at a time
+static init_burst burst;
+
+static uint8_t _send_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
-    // set version mask
-    for (int i = 0; i < 3; i++) {
-        BM1366_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+    init_burst_begin(&burst, chain, BM1366_SERIALTX_DEBUG);
+    if (!init_burst_add_script(&burst, init_script_enumerate, sizeof(init_script_enumerate) / sizeof(init_script_enumerate[0]))) {
+        return 0;
     }
+    init_burst_send(&burst);
 
-    // read register 00 on all chips
-    unsigned char init3[7] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
-    _send_simple(init3, 7);
-
-    int chip_counter = count_asic_chips(asic_count, BM1366_CHIP_ID, BM1366_CHIP_ID_RESPONSE_LENGTH);
+    int chip_counter = count_asic_chips(chain, asic_count, BM1366_CHIP_ID, BM1366_CHIP_ID_RESPONSE_LENGTH);
 
     if (chip_counter == 0) {
         return 0;
     }
 
-    unsigned char init4[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03};
-    _send_simple(init4, 11);
-
-    unsigned char init5[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00, 0x00};
-    _send_simple(init5, 11);
-
-    //{0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03};
-    _send_chain_inactive();
+    if (!init_burst_add_script(&burst, init_script_chain, sizeof(init_script_chain) / sizeof(init_script_chain[0]))) {
+        return 0;
+    }
 
     // split the chip address space evenly
     uint8_t address_interval = (uint8_t) (256 / chip_counter);
     for (uint8_t i = 0; i < chip_counter; i++) {
         //{ 0x55, 0xAA, 0x40, 0x05, 0x00, 0x00, 0x1C };
-        _set_chip_address(i * address_interval);
+        init_burst_add_command(&burst, TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS, (uint8_t[]){i * address_interval, 0x00}, 2);
     }
+    // chips come out of reset at 56.25 MHz
+    frequency_transition_init(chain, chip_counter, address_interval, 56.25);
 
-    unsigned char init135[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x85, 0x40, 0x0C};
-    _send_simple(init135, 11);
-
-    unsigned char init136[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x80, 0x20, 0x19};
-    _send_simple(init136, 11);
-
-    //{0x55, 0xAA, 0x51, 0x09, 0x00, 0x14, 0x00, 0x00, 0x00, 0xFF, 0x08};
-    BM1366_set_job_difficulty_mask(BM1366_ASIC_DIFFICULTY);
-
-    unsigned char init138[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x03, 0x1D};
-    _send_simple(init138, 11);
-
-    unsigned char init139[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x58, 0x02, 0x11, 0x11, 0x11, 0x06};
-    _send_simple(init139, 11);
-
-    unsigned char init171[11] = {0x55, 0xAA, 0x41, 0x09, 0x00, 0x2C, 0x00, 0x7C, 0x00, 0x03, 0x03};
-    _send_simple(init171, 11);
-
-    //S19XP Dump sends baudrate change here.. we wait until later.
-    // unsigned char init173[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
-    // _send_simple(init173, 11);
+    if (!init_burst_add_script(&burst, init_script_registers, sizeof(init_script_registers) / sizeof(init_script_registers[0]))) {
+        return 0;
+    }
 
     for (uint8_t i = 0; i < chip_counter; i++) {
-        unsigned char set_a8_register[6] = {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_a8_register, 6, BM1366_SERIALTX_DEBUG);
-        unsigned char set_18_register[6] = {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_18_register, 6, BM1366_SERIALTX_DEBUG);
-        unsigned char set_3c_register_first[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x85, 0x40};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_first, 6, BM1366_SERIALTX_DEBUG);
-        unsigned char set_3c_register_second[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x20};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_second, 6, BM1366_SERIALTX_DEBUG);
-        unsigned char set_3c_register_third[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA};
-        _send_BM1366((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_third, 6, BM1366_SERIALTX_DEBUG);
+        uint8_t chip_init_cmds[][6] = {
+            {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0},
+            {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00},
+            {i * address_interval, 0x3C, 0x80, 0x00, 0x85, 0x40},
+            {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x20},
+            {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA},
+        };
+
+        for (int j = 0; j < sizeof(chip_init_cmds) / sizeof(chip_init_cmds[0]); j++) {
+            init_burst_add_command(&burst, TYPE_CMD | GROUP_SINGLE | CMD_WRITE, chip_init_cmds[j], 6);
+        }
     }
 
-    do_frequency_ramp_up((float)frequency);
+    init_burst_send(&burst);
+
+    ESP_LOGI(TAG, "Sent %u init frames in %u write(s)", burst.frames, burst.writes);
+
+    do_frequency_ramp_up(chain, (float)frequency);
 
     //register 10 is still a bit of a mystery. discussion: https://github.com/bitaxeorg/ESP-Miner/pull/167
 
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x11, 0x5A}; //S19k Pro Default
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x14, 0x46}; //S19XP-Luxos Default
-    unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x15, 0x1C}; //S19XP-Stock Default
+    unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, BM1366_HASH_COUNTING_NUMBER >> 8, BM1366_HASH_COUNTING_NUMBER & 0xFF}; //S19XP-Stock Default
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x0F, 0x00, 0x00}; //supposedly the "full" 32bit nonce range
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1366_SERIALTX_DEBUG);
 
     unsigned char init795[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C};
-    _send_simple(init795, 11);
+    _send_simple(chain, init795, 11);
 
     return chip_counter;
 }
 
 // reset the BM1366 via the RTS line
-static void _reset(void)
+static void _reset(uint8_t chain)
 {
-    gpio_set_level(GPIO_ASIC_RESET, 0);
+    gpio_set_level(asic_reset_gpio(chain), 0);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     // set the gpio pin high
-    gpio_set_level(GPIO_ASIC_RESET, 1);
+    gpio_set_level(asic_reset_gpio(chain), 1);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
@@ -320,39 +295,69 @@ static void _reset(void)
 //     _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1366_SERIALTX_DEBUG);
 // }
 
-uint8_t BM1366_init(uint64_t frequency, uint16_t asic_count)
+uint8_t BM1366_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     ESP_LOGI(TAG, "Initializing BM1366");
 
-    esp_rom_gpio_pad_select_gpio(GPIO_ASIC_RESET);
-    gpio_set_direction(GPIO_ASIC_RESET, GPIO_MODE_OUTPUT);
+    // the frequency ramp looks its PLL settings up instead of searching on every step
+    if (pll_lookup.search == NULL) {
+        pll_table_init(&pll_lookup, _pll_search);
+    }
+
+    esp_rom_gpio_pad_select_gpio(asic_reset_gpio(chain));
+    gpio_set_direction(asic_reset_gpio(chain), GPIO_MODE_OUTPUT);
 
     // reset the bm1366
-    _reset();
+    _reset(chain);
 
-    return _send_init(frequency, asic_count);
+    return _send_init(chain, frequency, asic_count);
 }
 
 // Baud formula = 25M/((denominator+1)*8)
 // The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1366_set_default_baud(void)
+int BM1366_set_default_baud(uint8_t chain)
 {
     // default divider of 26 (11010) for 115,749
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1366_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1366_set_max_baud(void)
+int BM1366_set_max_baud(uint8_t chain)
 {
-    ESP_LOGI(TAG, "Setting max baud of 1000000");
+    // fast uart configuration for 1,000,000
+    ESP_LOGI(TAG, "Setting max baud of %d", FAST_UART_BAUD);
 
     unsigned char reg28[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
-    _send_simple(reg28, 11);
-    return 1000000;
+    _send_simple(chain, reg28, 11);
+    return FAST_UART_BAUD;
 }
 
-void BM1366_set_job_difficulty_mask(int difficulty)
+// Only the reset default and the fast uart configuration are known for this chip. The chips only
+// go back to step 0 through a reset, the MISC_CONTROL default of the BM1397 would overwrite the value
+// the init script wrote and leaves the fast uart configuration in place
+int BM1366_set_baud_step(uint8_t chain, int step)
+{
+    switch (step) {
+        case 1:
+            return BM1366_set_max_baud(chain);
+        default:
+            return 0;
+    }
+}
+
+int BM1366_read_back_chip_ids(uint8_t chain, uint16_t asic_count)
+{
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, 0x00}, 2, false);
+    return read_back_chip_ids(chain, asic_count, BM1366_CHIP_ID, BM1366_CHIP_ID_RESPONSE_LENGTH);
+}
+
+void BM1366_read_register(uint8_t chain, uint8_t register_address)
+{
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, register_address}, 2, false);
+}
+
+void BM1366_set_job_difficulty_mask(uint8_t chain, int difficulty)
 {
 
     // Default mask of 256 diff
@@ -378,19 +383,17 @@ void BM1366_set_job_difficulty_mask(int difficulty)
 
     ESP_LOGI(TAG, "Setting job ASIC mask to %d", difficulty);
 
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1366_SERIALTX_DEBUG);
+    _send_BM1366(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1366_SERIALTX_DEBUG);
 }
 
-static uint8_t id = 0;
-
 void BM1366_send_work(void * pvParameters, bm_job * next_bm_job)
 {
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    AsicChain * asic_chain = (AsicChain *) pvParameters;
 
     BM1366_job job;
-    id = (id + 8) % 128;
-    job.job_id = id;
+    asic_chain->job_id = (asic_chain->job_id + 8) % 128;
+    job.job_id = asic_chain->job_id;
     job.num_midstates = 0x01;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -399,29 +402,30 @@ void BM1366_send_work(void * pvParameters, bm_job * next_bm_job)
     memcpy(job.prev_block_hash, next_bm_job->prev_block_hash_be, 32);
     memcpy(&job.version, &next_bm_job->version, 4);
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
+    if (asic_chain->active_jobs[job.job_id] != NULL) {
+        free_bm_job(asic_chain->active_jobs[job.job_id]);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
+    asic_chain->active_jobs[job.job_id] = next_bm_job;
 
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+    pthread_mutex_lock(&asic_chain->valid_jobs_lock);
+    asic_chain->valid_jobs[job.job_id] = 1;
+    pthread_mutex_unlock(&asic_chain->valid_jobs_lock);
 
     //debug sent jobs - this can get crazy if the interval is short
     #if BM1366_DEBUG_JOBS
     ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
     #endif
 
-    _send_BM1366((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1366_job), BM1366_DEBUG_WORK);
+    _send_BM1366(asic_chain->index, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1366_job), BM1366_DEBUG_WORK);
 }
 
 task_result * BM1366_process_work(void * pvParameters)
 {
+    AsicChain * asic_chain = (AsicChain *) pvParameters;
     bm1366_asic_result_t asic_result = {0};
 
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result)) == ESP_FAIL) {
+    if (receive_work(asic_chain->index, (uint8_t *)&asic_result, sizeof(asic_result)) == ESP_FAIL) {
         return NULL;
     }
 
@@ -431,18 +435,16 @@ task_result * BM1366_process_work(void * pvParameters)
     uint32_t version_bits = (ntohs(asic_result.version) << 13); // shift the 16 bit value left 13
     ESP_LOGI(TAG, "Job ID: %02X, Core: %d/%d, Ver: %08" PRIX32, job_id, core_id, small_core_id, version_bits);
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
-
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0) {
+    if (asic_chain->valid_jobs[job_id] == 0) {
         ESP_LOGW(TAG, "Invalid job found, 0x%02X", job_id);
         return NULL;
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
+    uint32_t rolled_version = asic_chain->active_jobs[job_id]->version | version_bits;
 
-    result.job_id = job_id;
-    result.nonce = asic_result.nonce;
-    result.rolled_version = rolled_version;
+    asic_chain->result.job_id = job_id;
+    asic_chain->result.nonce = asic_result.nonce;
+    asic_chain->result.rolled_version = rolled_version;
 
-    return &result;
+    return &asic_chain->result;
 }
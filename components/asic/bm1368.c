@@ -9,6 +9,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "frequency_transition_bmXX.h"
+#include "init_burst.h"
+#include "pll.h"
 
 #include <math.h>
 #include <stdint.h>
@@ -20,12 +22,6 @@
 #define BM1368_CHIP_ID 0x1368
 #define BM1368_CHIP_ID_RESPONSE_LENGTH 11
 
-#ifdef CONFIG_GPIO_ASIC_RESET
-#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
-#else
-#define GPIO_ASIC_RESET 1
-#endif
-
 #define TYPE_JOB 0x20
 #define TYPE_CMD 0x40
 
@@ -51,6 +47,7 @@
 #define CORE_REGISTER_CONTROL 0x3C
 #define PLL3_PARAMETER 0x68
 #define FAST_UART_CONFIGURATION 0x28
+#define FAST_UART_BAUD 1000000
 #define TICKET_MASK 0x14
 #define MISC_CONTROL 0x18
 
@@ -66,81 +63,41 @@ typedef struct __attribute__((__packed__))
 
 static const char * TAG = "bm1368Module";
 
-static task_result result;
-
-static float current_frequency = 56.25;
-
-static void _send_BM1368(uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
-{
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    unsigned char * buf = malloc(total_length);
-
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-    buf[2] = header;
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-    memcpy(buf + 4, data, data_len);
-
-    if (packet_type == JOB_PACKET) {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    } else {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
-    }
-
-    SERIAL_send(buf, total_length, debug);
-
-    free(buf);
-}
 
-static void _send_simple(uint8_t * data, uint8_t total_length)
+static void _send_BM1368(uint8_t chain, uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
 {
-    unsigned char * buf = malloc(total_length);
-    memcpy(buf, data, total_length);
-    SERIAL_send(buf, total_length, BM1368_SERIALTX_DEBUG);
-
-    free(buf);
+    SERIAL_send_packet(chain, header, data, data_len, debug);
 }
 
-static void _send_chain_inactive(void)
+static void _send_simple(uint8_t chain, uint8_t * data, uint8_t total_length)
 {
-    unsigned char read_address[2] = {0x00, 0x00};
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1368_SERIALTX_DEBUG);
+    SERIAL_send(chain, data, total_length, BM1368_SERIALTX_DEBUG);
 }
 
-static void _set_chip_address(uint8_t chipAddr)
-{
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    _send_BM1368((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1368_SERIALTX_DEBUG);
-}
-
-void BM1368_set_version_mask(uint32_t version_mask) 
+void BM1368_set_version_mask(uint8_t chain, uint32_t version_mask) 
 {
     int versions_to_roll = version_mask >> 13;
     uint8_t version_byte0 = (versions_to_roll >> 8);
     uint8_t version_byte1 = (versions_to_roll & 0xFF); 
     uint8_t version_cmd[] = {0x00, 0xA4, 0x90, 0x00, version_byte0, version_byte1};
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1368_SERIALTX_DEBUG);
+    _send_BM1368(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1368_SERIALTX_DEBUG);
 }
 
-static void _reset(void)
+static void _reset(uint8_t chain)
 {
-    gpio_set_level(GPIO_ASIC_RESET, 0);
+    gpio_set_level(asic_reset_gpio(chain), 0);
     vTaskDelay(100 / portTICK_PERIOD_MS);
-    gpio_set_level(GPIO_ASIC_RESET, 1);
+    gpio_set_level(asic_reset_gpio(chain), 1);
     vTaskDelay(100 / portTICK_PERIOD_MS);
 }
 
-void BM1368_send_hash_frequency(float target_freq) {
+// dividers for every 6.25 MHz step, filled in by BM1368_init
+static pll_table pll_lookup;
+
+static bool _pll_search(float target_freq, pll_setting * pll) {
     float max_diff = 0.001;
-    uint8_t freqbuf[6] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41};
     uint8_t postdiv_min = 255;
     uint8_t postdiv2_min = 255;
-    float best_freq = 0;
-    uint8_t best_refdiv = 0, best_fbdiv = 0, best_postdiv1 = 0, best_postdiv2 = 0;
     bool found = false;
 
     for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
@@ -157,84 +114,118 @@ void BM1368_send_hash_frequency(float target_freq) {
 
                     postdiv2_min = postdiv2;
                     postdiv_min = postdiv1 * postdiv2;
-                    best_freq = newf;
-                    best_refdiv = refdiv;
-                    best_fbdiv = fb_divider;
-                    best_postdiv1 = postdiv1;
-                    best_postdiv2 = postdiv2;
+                    pll->ref_divider = refdiv;
+                    pll->fb_divider = fb_divider;
+                    pll->post_divider1 = postdiv1;
+                    pll->post_divider2 = postdiv2;
                     found = true;
                 }
             }
         }
     }
 
-    if (!found) {
+    return found;
+}
+
+void BM1368_send_hash_frequency(uint8_t chain, int chip_address, float target_freq) {
+    uint8_t freqbuf[6] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41};
+
+    pll_setting pll;
+    if (!pll_table_lookup(&pll_lookup, target_freq, &pll)) {
         ESP_LOGE(TAG, "Didn't find PLL settings for target frequency %.2f", target_freq);
         return;
     }
 
-    freqbuf[2] = (best_fbdiv * 25 / best_refdiv >= 2400) ? 0x50 : 0x40;
-    freqbuf[3] = best_fbdiv;
-    freqbuf[4] = best_refdiv;
-    freqbuf[5] = (((best_postdiv1 - 1) & 0xf) << 4) | ((best_postdiv2 - 1) & 0xf);
+    freqbuf[2] = (pll.fb_divider * 25 / pll.ref_divider >= 2400) ? 0x50 : 0x40;
+    freqbuf[3] = pll.fb_divider;
+    freqbuf[4] = pll.ref_divider;
+    freqbuf[5] = (((pll.post_divider1 - 1) & 0xf) << 4) | ((pll.post_divider2 - 1) & 0xf);
 
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, freqbuf, sizeof(freqbuf), BM1368_SERIALTX_DEBUG);
+    if (chip_address != FREQUENCY_ALL_CHIPS) {
+        freqbuf[0] = chip_address;
+    }
+    _send_BM1368(chain, TYPE_CMD | (chip_address == FREQUENCY_ALL_CHIPS ? GROUP_ALL : GROUP_SINGLE) | CMD_WRITE, freqbuf, sizeof(freqbuf), BM1368_SERIALTX_DEBUG);
 
-    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", target_freq, best_freq);
-    current_frequency = target_freq;
+    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f) on chip %d", target_freq, pll_frequency(&pll), chip_address);
 }
 
-bool BM1368_set_frequency(float target_freq) {
-    return do_frequency_transition(target_freq, BM1368_send_hash_frequency, 1368);
+bool BM1368_set_frequency(uint8_t chain, float target_freq) {
+    return do_frequency_transition(chain, target_freq, BM1368_send_hash_frequency, 1368);
 }
 
-static void do_frequency_ramp_up(float target_frequency) {
-    ESP_LOGI(TAG, "Ramping up frequency from %.2f MHz to %.2f MHz", current_frequency, target_frequency);
-    do_frequency_transition(target_frequency, BM1368_send_hash_frequency, 1368);
+static void do_frequency_ramp_up(uint8_t chain, float target_frequency) {
+    ESP_LOGI(TAG, "Ramping up frequency from %.2f MHz to %.2f MHz", frequency_transition_get(chain, 0), target_frequency);
+    do_frequency_transition(chain, target_frequency, BM1368_send_hash_frequency, 1368);
 }
 
-uint8_t BM1368_init(uint64_t frequency, uint16_t asic_count)
+// the init scripts carry the version mask and ticket mask frames for these values
+_Static_assert(STRATUM_DEFAULT_VERSION_MASK == 0x1fffe000, "update the version mask frames of the init scripts");
+_Static_assert(BM1368_ASIC_DIFFICULTY == 256, "update the ticket mask frame of the init script");
+
+// set the version mask and read register 00 on all chips
+static const init_frame init_script_enumerate[] = {
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {7, {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A}},
+};
+
+// sent before the chips get their addresses
+static const init_frame init_script_chain[] = {
+    // chain inactive
+    {7, {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00, 0x00}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00, 0x12}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x80, 0x18, 0x1F}},
+    // ticket mask
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x14, 0x00, 0x00, 0x00, 0xFF, 0x08}},
+    // Analog Mux
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x03, 0x1D}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x58, 0x02, 0x11, 0x11, 0x11, 0x06}},
+};
+
+// only used while a chain is initialized, chains are brought up one at a time
+static init_burst burst;
+
+uint8_t BM1368_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     ESP_LOGI(TAG, "Initializing BM1368");
 
-    esp_rom_gpio_pad_select_gpio(GPIO_ASIC_RESET);
-    gpio_set_direction(GPIO_ASIC_RESET, GPIO_MODE_OUTPUT);
+    // the frequency ramp looks its PLL settings up instead of searching on every step
+    if (pll_lookup.search == NULL) {
+        pll_table_init(&pll_lookup, _pll_search);
+    }
 
-    _reset();
+    esp_rom_gpio_pad_select_gpio(asic_reset_gpio(chain));
+    gpio_set_direction(asic_reset_gpio(chain), GPIO_MODE_OUTPUT);
 
-    // set version mask
-    for (int i = 0; i < 4; i++) {
-        BM1368_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
-    }
+    _reset(chain);
 
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_READ, (uint8_t[]){0x00, 0x00}, 2, false);
+    init_burst_begin(&burst, chain, BM1368_SERIALTX_DEBUG);
+    if (!init_burst_add_script(&burst, init_script_enumerate, sizeof(init_script_enumerate) / sizeof(init_script_enumerate[0]))) {
+        return 0;
+    }
+    init_burst_send(&burst);
 
-    int chip_counter = count_asic_chips(asic_count, BM1368_CHIP_ID, BM1368_CHIP_ID_RESPONSE_LENGTH);
+    int chip_counter = count_asic_chips(chain, asic_count, BM1368_CHIP_ID, BM1368_CHIP_ID_RESPONSE_LENGTH);
 
     if (chip_counter == 0) {
         return 0;
     }
 
-    _send_chain_inactive();
-    
-    uint8_t init_cmds[][6] = {
-        {0x00, 0xA8, 0x00, 0x07, 0x00, 0x00},
-        {0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00},
-        {0x00, 0x3C, 0x80, 0x00, 0x8b, 0x00},
-        {0x00, 0x3C, 0x80, 0x00, 0x80, 0x18},
-        {0x00, 0x14, 0x00, 0x00, 0x00, 0xFF},
-        {0x00, 0x54, 0x00, 0x00, 0x00, 0x03}, //Analog Mux
-        {0x00, 0x58, 0x02, 0x11, 0x11, 0x11}
-    };
-
-    for (int i = 0; i < sizeof(init_cmds) / sizeof(init_cmds[0]); i++) {
-        _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, init_cmds[i], 6, false);
+    if (!init_burst_add_script(&burst, init_script_chain, sizeof(init_script_chain) / sizeof(init_script_chain[0]))) {
+        return 0;
     }
 
     uint8_t address_interval = (uint8_t) (256 / chip_counter);
     for (int i = 0; i < chip_counter; i++) {
-        _set_chip_address(i * address_interval);
+        init_burst_add_command(&burst, TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS, (uint8_t[]){i * address_interval, 0x00}, 2);
     }
+    init_burst_send(&burst);
+    // chips come out of reset at 56.25 MHz
+    frequency_transition_init(chain, chip_counter, address_interval, 56.25);
 
     for (int i = 0; i < chip_counter; i++) {
         uint8_t chip_init_cmds[][6] = {
@@ -246,38 +237,67 @@ uint8_t BM1368_init(uint64_t frequency, uint16_t asic_count)
         };
 
         for (int j = 0; j < sizeof(chip_init_cmds) / sizeof(chip_init_cmds[0]); j++) {
-            _send_BM1368(TYPE_CMD | GROUP_SINGLE | CMD_WRITE, chip_init_cmds[j], 6, false);
+            init_burst_add_command(&burst, TYPE_CMD | GROUP_SINGLE | CMD_WRITE, chip_init_cmds[j], 6);
         }
+        // each chip still gets its pause, only the writes in between are batched
+        init_burst_send(&burst);
         vTaskDelay(pdMS_TO_TICKS(500));
     }
 
-    BM1368_set_job_difficulty_mask(BM1368_ASIC_DIFFICULTY);
+    ESP_LOGI(TAG, "Sent %u init frames in %u write(s)", burst.frames, burst.writes);
+
+    BM1368_set_job_difficulty_mask(chain, BM1368_ASIC_DIFFICULTY);
 
-    do_frequency_ramp_up((float)frequency);
+    do_frequency_ramp_up(chain, (float)frequency);
 
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, (uint8_t[]){0x00, 0x10, 0x00, 0x00, 0x15, 0xa4}, 6, false);
-    BM1368_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+    _send_BM1368(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, (uint8_t[]){0x00, 0x10, 0x00, 0x00, BM1368_HASH_COUNTING_NUMBER >> 8, BM1368_HASH_COUNTING_NUMBER & 0xFF}, 6, false);
+    BM1368_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
 
     return chip_counter;
 }
 
-int BM1368_set_default_baud(void)
+int BM1368_set_default_baud(uint8_t chain)
 {
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001};
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1368_SERIALTX_DEBUG);
+    _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1368_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1368_set_max_baud(void)
+int BM1368_set_max_baud(uint8_t chain)
 {
-    ESP_LOGI(TAG, "Setting max baud of 1000000");
+    // fast uart configuration for 1,000,000
+    ESP_LOGI(TAG, "Setting max baud of %d", FAST_UART_BAUD);
 
-    unsigned char init8[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
-    _send_simple(init8, 11);
-    return 1000000;
+    unsigned char reg28[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
+    _send_simple(chain, reg28, 11);
+    return FAST_UART_BAUD;
 }
 
-void BM1368_set_job_difficulty_mask(int difficulty)
+// Only the reset default and the fast uart configuration are known for this chip. The chips only
+// go back to step 0 through a reset, the MISC_CONTROL default of the BM1397 would overwrite the value
+// the init script wrote and leaves the fast uart configuration in place
+int BM1368_set_baud_step(uint8_t chain, int step)
+{
+    switch (step) {
+        case 1:
+            return BM1368_set_max_baud(chain);
+        default:
+            return 0;
+    }
+}
+
+int BM1368_read_back_chip_ids(uint8_t chain, uint16_t asic_count)
+{
+    _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, 0x00}, 2, false);
+    return read_back_chip_ids(chain, asic_count, BM1368_CHIP_ID, BM1368_CHIP_ID_RESPONSE_LENGTH);
+}
+
+void BM1368_read_register(uint8_t chain, uint8_t register_address)
+{
+    _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, register_address}, 2, false);
+}
+
+void BM1368_set_job_difficulty_mask(uint8_t chain, int difficulty)
 {
     unsigned char job_difficulty_mask[9] = {0x00, TICKET_MASK, 0b00000000, 0b00000000, 0b00000000, 0b11111111};
 
@@ -290,18 +310,16 @@ void BM1368_set_job_difficulty_mask(int difficulty)
 
     ESP_LOGI(TAG, "Setting job ASIC mask to %d", difficulty);
 
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1368_SERIALTX_DEBUG);
+    _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1368_SERIALTX_DEBUG);
 }
 
-static uint8_t id = 0;
-
 void BM1368_send_work(void * pvParameters, bm_job * next_bm_job)
 {
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    AsicChain * asic_chain = (AsicChain *) pvParameters;
 
     BM1368_job job;
-    id = (id + 24) % 128;
-    job.job_id = id;
+    asic_chain->job_id = (asic_chain->job_id + 24) % 128;
+    job.job_id = asic_chain->job_id;
     job.num_midstates = 0x01;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -310,28 +328,29 @@ void BM1368_send_work(void * pvParameters, bm_job * next_bm_job)
     memcpy(job.prev_block_hash, next_bm_job->prev_block_hash_be, 32);
     memcpy(&job.version, &next_bm_job->version, 4);
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
+    if (asic_chain->active_jobs[job.job_id] != NULL) {
+        free_bm_job(asic_chain->active_jobs[job.job_id]);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
+    asic_chain->active_jobs[job.job_id] = next_bm_job;
 
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+    pthread_mutex_lock(&asic_chain->valid_jobs_lock);
+    asic_chain->valid_jobs[job.job_id] = 1;
+    pthread_mutex_unlock(&asic_chain->valid_jobs_lock);
 
     #if BM1368_DEBUG_JOBS
     ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
     #endif
 
-    _send_BM1368((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1368_job), BM1368_DEBUG_WORK);
+    _send_BM1368(asic_chain->index, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1368_job), BM1368_DEBUG_WORK);
 }
 
 task_result * BM1368_process_work(void * pvParameters)
 {
+    AsicChain * asic_chain = (AsicChain *) pvParameters;
     bm1368_asic_result_t asic_result = {0};
 
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result)) == ESP_FAIL) {
+    if (receive_work(asic_chain->index, (uint8_t *)&asic_result, sizeof(asic_result)) == ESP_FAIL) {
         return NULL;
     }
 
@@ -341,18 +360,16 @@ task_result * BM1368_process_work(void * pvParameters)
     uint32_t version_bits = (ntohs(asic_result.version) << 13);
     ESP_LOGI(TAG, "Job ID: %02X, Core: %d/%d, Ver: %08" PRIX32, job_id, core_id, small_core_id, version_bits);
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
-
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0) {
+    if (asic_chain->valid_jobs[job_id] == 0) {
         ESP_LOGW(TAG, "Invalid job found, 0x%02X", job_id);
         return NULL;
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
+    uint32_t rolled_version = asic_chain->active_jobs[job_id]->version | version_bits;
 
-    result.job_id = job_id;
-    result.nonce = asic_result.nonce;
-    result.rolled_version = rolled_version;
+    asic_chain->result.job_id = job_id;
+    asic_chain->result.nonce = asic_result.nonce;
+    asic_chain->result.rolled_version = rolled_version;
 
-    return &result;
+    return &asic_chain->result;
 }
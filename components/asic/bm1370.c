@@ -9,6 +9,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "frequency_transition_bmXX.h"
+#include "init_burst.h"
+#include "pll.h"
 
 #include <math.h>
 #include <stdint.h>
@@ -20,12 +22,6 @@
 #define BM1370_CHIP_ID 0x1370
 #define BM1370_CHIP_ID_RESPONSE_LENGTH 11
 
-#ifdef CONFIG_GPIO_ASIC_RESET
-#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
-#else
-#define GPIO_ASIC_RESET 1
-#endif
-
 #define TYPE_JOB 0x20
 #define TYPE_CMD 0x40
 
@@ -51,6 +47,7 @@
 #define CORE_REGISTER_CONTROL 0x3C
 #define PLL3_PARAMETER 0x68
 #define FAST_UART_CONFIGURATION 0x28
+#define FAST_UART_BAUD 1000000
 #define TICKET_MASK 0x14
 #define MISC_CONTROL 0x18
 
@@ -66,90 +63,36 @@ typedef struct __attribute__((__packed__))
 
 static const char * TAG = "bm1370Module";
 
-static task_result result;
-
 /// @brief
 /// @param ftdi
 /// @param header
 /// @param data
 /// @param len
-static void _send_BM1370(uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
+static void _send_BM1370(uint8_t chain, uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
 {
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    // allocate memory for buffer
-    unsigned char * buf = malloc(total_length);
-
-    // add the preamble
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-
-    // add the header field
-    buf[2] = header;
-
-    // add the length field
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-
-    // add the data
-    memcpy(buf + 4, data, data_len);
-
-    // add the correct crc type
-    if (packet_type == JOB_PACKET) {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    } else {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
-    }
-
-    // send serial data
-    if (SERIAL_send(buf, total_length, debug) == 0) {
+    if (SERIAL_send_packet(chain, header, data, data_len, debug) == 0) {
         ESP_LOGE(TAG, "Failed to send data to BM1370");
     }
-
-    free(buf);
-}
-
-static void _send_simple(uint8_t * data, uint8_t total_length)
-{
-    unsigned char * buf = malloc(total_length);
-    memcpy(buf, data, total_length);
-    SERIAL_send(buf, total_length, BM1370_SERIALTX_DEBUG);
-
-    free(buf);
 }
 
-static void _send_chain_inactive(void)
+static void _send_simple(uint8_t chain, uint8_t * data, uint8_t total_length)
 {
-
-    unsigned char read_address[2] = {0x00, 0x00};
-    // send serial data
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1370_SERIALTX_DEBUG);
-}
-
-static void _set_chip_address(uint8_t chipAddr)
-{
-
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    // send serial data
-    _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1370_SERIALTX_DEBUG);
+    SERIAL_send(chain, data, total_length, BM1370_SERIALTX_DEBUG);
 }
 
-void BM1370_set_version_mask(uint32_t version_mask) 
+void BM1370_set_version_mask(uint8_t chain, uint32_t version_mask) 
 {
     int versions_to_roll = version_mask >> 13;
     uint8_t version_byte0 = (versions_to_roll >> 8);
     uint8_t version_byte1 = (versions_to_roll & 0xFF); 
     uint8_t version_cmd[] = {0x00, 0xA4, 0x90, 0x00, version_byte0, version_byte1};
-    _send_BM1370(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1370_SERIALTX_DEBUG);
+    _send_BM1370(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1370_SERIALTX_DEBUG);
 }
 
-void BM1370_send_hash_frequency(float target_freq) {
-    // default 200Mhz if it fails
-    unsigned char freqbuf[6] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41}; // freqbuf - pll0_parameter
-    float newf = 200.0;
+// dividers for every 6.25 MHz step, filled in by BM1370_init
+static pll_table pll_lookup;
 
+static bool _pll_search(float target_freq, pll_setting * pll) {
     uint8_t fb_divider = 0;
     uint8_t post_divider1 = 0, post_divider2 = 0;
     uint8_t ref_divider = 0;
@@ -176,7 +119,6 @@ void BM1370_send_hash_frequency(float target_freq) {
                             post_divider2 = postdiv2_loop;
                             ref_divider = refdiv_loop;
                             min_difference = freq_diff;
-                            newf = temp_freq;
                         }
                     }
                 }
@@ -184,134 +126,156 @@ void BM1370_send_hash_frequency(float target_freq) {
         }
     }
 
-    if (fb_divider == 0) {
+    pll->fb_divider = fb_divider;
+    pll->ref_divider = ref_divider;
+    pll->post_divider1 = post_divider1;
+    pll->post_divider2 = post_divider2;
+    return fb_divider != 0;
+}
+
+void BM1370_send_hash_frequency(uint8_t chain, int chip_address, float target_freq) {
+    // default 200Mhz if it fails
+    unsigned char freqbuf[6] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41}; // freqbuf - pll0_parameter
+
+    pll_setting pll;
+    if (!pll_table_lookup(&pll_lookup, target_freq, &pll)) {
         ESP_LOGE(TAG, "Failed to find PLL settings for target frequency %.2f", target_freq);
         return;
     }
 
-    freqbuf[3] = fb_divider;
-    freqbuf[4] = ref_divider;
-    freqbuf[5] = (((post_divider1 - 1) & 0xf) << 4) + ((post_divider2 - 1) & 0xf);
+    freqbuf[3] = pll.fb_divider;
+    freqbuf[4] = pll.ref_divider;
+    freqbuf[5] = (((pll.post_divider1 - 1) & 0xf) << 4) + ((pll.post_divider2 - 1) & 0xf);
 
-    if (fb_divider * 25 / (float) ref_divider >= 2400) {
+    if (pll.fb_divider * 25 / (float) pll.ref_divider >= 2400) {
         freqbuf[2] = 0x50;
     }
 
-    _send_BM1370(TYPE_CMD | GROUP_ALL | CMD_WRITE, freqbuf, 6, BM1370_SERIALTX_DEBUG);
+    if (chip_address != FREQUENCY_ALL_CHIPS) {
+        freqbuf[0] = chip_address;
+    }
+    _send_BM1370(chain, TYPE_CMD | (chip_address == FREQUENCY_ALL_CHIPS ? GROUP_ALL : GROUP_SINGLE) | CMD_WRITE, freqbuf, 6, BM1370_SERIALTX_DEBUG);
 
-    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", target_freq, newf);
+    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f) on chip %d", target_freq, pll_frequency(&pll), chip_address);
 }
 
-static void do_frequency_ramp_up(float target_frequency) {
+static void do_frequency_ramp_up(uint8_t chain, float target_frequency) {
     if (target_frequency == 0) {
         ESP_LOGI(TAG, "Skipping frequency ramp");
         return;
     }
     
     ESP_LOGI(TAG, "Ramping up frequency from 56.25 MHz to %.2f MHz", target_frequency);
-    do_frequency_transition(target_frequency, BM1370_send_hash_frequency, 1370);
+    do_frequency_transition(chain, target_frequency, BM1370_send_hash_frequency, 1370);
 }
 
 // Add a public function for external use
-bool BM1370_set_frequency(float target_freq) {
-    return do_frequency_transition(target_freq, BM1370_send_hash_frequency, 1370);
+bool BM1370_set_frequency(uint8_t chain, float target_freq) {
+    return do_frequency_transition(chain, target_freq, BM1370_send_hash_frequency, 1370);
 }
 
-static uint8_t _send_init(uint64_t frequency, uint16_t asic_count)
+// the init scripts carry the version mask and ticket mask frames for these values
+_Static_assert(STRATUM_DEFAULT_VERSION_MASK == 0x1fffe000, "update the version mask frames of the init scripts");
+_Static_assert(BM1370_ASIC_DIFFICULTY == 256, "update the ticket mask frame of the init script");
+
+// reset the chips' version rolling and read register 00 on all chips (should respond AA 55 13 70 00 00 00 00 00 00 0F)
+static const init_frame init_script_enumerate[] = {
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    {7, {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A}},
+};
+
+// sent before the chips get their addresses
+static const init_frame init_script_chain[] = {
+    // version mask
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA4, 0x90, 0x00, 0xFF, 0xFF, 0x1C}},
+    // Reg_A8
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03}},
+    // Misc Control, from S21Pro dump (S21 dump has FF 0F C1 00)
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x18, 0xF0, 0x00, 0xC1, 0x00, 0x04}},
+    // chain inactive
+    {7, {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03}},
+};
+
+static const init_frame init_script_registers[] = {
+    // Core Register Control
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00, 0x12}},
+    // Core Register Control, from S21Pro dump (S21 dump has 80 00 80 18)
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x80, 0x0C, 0x11}},
+    // ticket mask
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x14, 0x00, 0x00, 0x00, 0xFF, 0x08}},
+    // IO Driver Strength, from S21Pro dump. Analog Mux Control is not sent here on S21 Pro
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x58, 0x00, 0x01, 0x11, 0x11, 0x0D}},
+};
+
+// sent after every chip got its own Reg_A8, Misc Control and Core Register Control writes
+static const init_frame init_script_misc[] = {
+    // some misc settings?
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xB9, 0x00, 0x00, 0x44, 0x80, 0x0D}},
+    // Analog Mux Control - rumored to control the temp diode
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x02, 0x18}},
+    // duplicate of the first command in the series
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xB9, 0x00, 0x00, 0x44, 0x80, 0x0D}},
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8D, 0xEE, 0x1B}},
+};
+
+// only used while a chain is initialized, chains are brought up one at a time
+static init_burst burst;
+
+static uint8_t _send_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
-    // set version mask
-    for (int i = 0; i < 3; i++) {
-        BM1370_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+    init_burst_begin(&burst, chain, BM1370_SERIALTX_DEBUG);
+    if (!init_burst_add_script(&burst, init_script_enumerate, sizeof(init_script_enumerate) / sizeof(init_script_enumerate[0]))) {
+        return 0;
     }
+    init_burst_send(&burst);
 
-    //read register 00 on all chips (should respond AA 55 13 68 00 00 00 00 00 00 0F)
-    unsigned char init3[7] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
-    _send_simple(init3, 7);
-
-    int chip_counter = count_asic_chips(asic_count, BM1370_CHIP_ID, BM1370_CHIP_ID_RESPONSE_LENGTH);
+    int chip_counter = count_asic_chips(chain, asic_count, BM1370_CHIP_ID, BM1370_CHIP_ID_RESPONSE_LENGTH);
 
     if (chip_counter == 0) {
         return 0;
     }
 
-    // set version mask
-    BM1370_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
-
-    //Reg_A8
-    //unsigned char init5[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03};
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xA8, 0x00, 0x07, 0x00, 0x00}, 6, BM1370_SERIALTX_DEBUG);
-
-    //Misc Control
-    //TX: 55 AA 51 09 [00 18 F0 00 C1 00] 04 //command all chips, write chip address 00, register 18, data F0 00 C1 00 - Misc Control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x18, 0xF0, 0x00, 0xC1, 0x00}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00}, 6, BM1370_SERIALTX_DEBUG); //from S21 dump
-
-    //chain inactive
-    _send_chain_inactive();
-    // unsigned char init7[7] = {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03};
-    // _send_simple(init7, 7);
+    if (!init_burst_add_script(&burst, init_script_chain, sizeof(init_script_chain) / sizeof(init_script_chain[0]))) {
+        return 0;
+    }
 
     // split the chip address space evenly
     uint8_t address_interval = (uint8_t) (256 / chip_counter);
     for (uint8_t i = 0; i < chip_counter; i++) {
-        _set_chip_address(i * address_interval);
-        // unsigned char init8[7] = {0x55, 0xAA, 0x40, 0x05, 0x00, 0x00, 0x1C};
-        // _send_simple(init8, 7);
+        init_burst_add_command(&burst, TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS, (uint8_t[]){i * address_interval, 0x00}, 2);
     }
+    // chips come out of reset at 56.25 MHz
+    frequency_transition_init(chain, chip_counter, address_interval, 56.25);
 
-    //Core Register Control
-    //unsigned char init9[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00, 0x12};
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00}, 6, BM1370_SERIALTX_DEBUG);
-
-    //Core Register Control
-    //TX: 55 AA 51 09 [00 3C 80 00 80 0C] 11  //command all chips, write chip address 00, register 3C, data 80 00 80 0C - Core Register Control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x80, 0x0C}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x80, 0x18}, 6, BM1370_SERIALTX_DEBUG); //from S21 dump
-
-    //set ticket mask
-    // unsigned char init11[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x14, 0x00, 0x00, 0x00, 0xFF, 0x08};
-    BM1370_set_job_difficulty_mask(BM1370_ASIC_DIFFICULTY);
-
-    //Analog Mux Control -- not sent on S21 Pro?
-    // unsigned char init12[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x03, 0x1D};
-    // _send_simple(init12, 11);
-
-    //Set the IO Driver Strength on chip 00
-    //TX: 55 AA 51 09 [00 58 00 01 11 11] 0D  //command all chips, write chip address 00, register 58, data 01 11 11 11 - Set the IO Driver Strength on chip 00
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x58, 0x00, 0x01, 0x11, 0x11}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x58, 0x02, 0x11, 0x11, 0x11}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    
+    if (!init_burst_add_script(&burst, init_script_registers, sizeof(init_script_registers) / sizeof(init_script_registers[0]))) {
+        return 0;
+    }
 
     for (uint8_t i = 0; i < chip_counter; i++) {
-        //TX: 55 AA 41 09 00 [A8 00 07 01 F0] 15    // Reg_A8
-        unsigned char set_a8_register[6] = {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_a8_register, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [18 F0 00 C1 00] 0C    // Misc Control
-        unsigned char set_18_register[6] = {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_18_register, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 8B 00] 1A    // Core Register Control
-        unsigned char set_3c_register_first[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x8B, 0x00};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_first, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 80 0C] 19    // Core Register Control
-        unsigned char set_3c_register_second[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x0C};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_second, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 82 AA] 05    // Core Register Control
-        unsigned char set_3c_register_third[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_third, 6, BM1370_SERIALTX_DEBUG);
+        uint8_t chip_init_cmds[][6] = {
+            {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0}, // Reg_A8
+            {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00}, // Misc Control
+            {i * address_interval, 0x3C, 0x80, 0x00, 0x8B, 0x00}, // Core Register Control
+            {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x0C}, // Core Register Control
+            {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA}, // Core Register Control
+        };
+
+        for (int j = 0; j < sizeof(chip_init_cmds) / sizeof(chip_init_cmds[0]); j++) {
+            init_burst_add_command(&burst, TYPE_CMD | GROUP_SINGLE | CMD_WRITE, chip_init_cmds[j], 6);
+        }
+    }
+
+    if (!init_burst_add_script(&burst, init_script_misc, sizeof(init_script_misc) / sizeof(init_script_misc[0]))) {
+        return 0;
     }
+    init_burst_send(&burst);
 
-    //Some misc settings?
-    // TX: 55 AA 51 09 [00 B9 00 00 44 80] 0D    //command all chips, write chip address 00, register B9, data 00 00 44 80
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xB9, 0x00, 0x00, 0x44, 0x80}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 54 00 00 00 02] 18    //command all chips, write chip address 00, register 54, data 00 00 00 02 - Analog Mux Control - rumored to control the temp diode
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x54, 0x00, 0x00, 0x00, 0x02}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 B9 00 00 44 80] 0D    //command all chips, write chip address 00, register B9, data 00 00 44 80 -- duplicate of first command in series
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xB9, 0x00, 0x00, 0x44, 0x80}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 3C 80 00 8D EE] 1B    //command all chips, write chip address 00, register 3C, data 80 00 8D EE
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x8D, 0xEE}, 6, BM1370_SERIALTX_DEBUG);
+    ESP_LOGI(TAG, "Sent %u init frames in %u write(s)", burst.frames, burst.writes);
 
     //ramp up the hash frequency
-    do_frequency_ramp_up(frequency);
+    do_frequency_ramp_up(chain, frequency);
 
     //register 10 is still a bit of a mystery. discussion: https://github.com/bitaxeorg/ESP-Miner/pull/167
 
@@ -319,23 +283,23 @@ static uint8_t _send_init(uint64_t frequency, uint16_t asic_count)
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x14, 0x46}; //S19XP-Luxos Default
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x15, 0x1C}; //S19XP-Stock Default
     //unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x15, 0xA4}; //S21-Stock Default
-    unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x1E, 0xB5}; //S21 Pro-Stock Default
+    unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, BM1370_HASH_COUNTING_NUMBER >> 8, BM1370_HASH_COUNTING_NUMBER & 0xFF}; //S21 Pro-Stock Default
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x0F, 0x00, 0x00}; //supposedly the "full" 32bit nonce range
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1370_SERIALTX_DEBUG);
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1370_SERIALTX_DEBUG);
 
     return chip_counter;
 }
 
 // reset the BM1370 via the RTS line
-static void _reset(void)
+static void _reset(uint8_t chain)
 {
-    gpio_set_level(GPIO_ASIC_RESET, 0);
+    gpio_set_level(asic_reset_gpio(chain), 0);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     // set the gpio pin high
-    gpio_set_level(GPIO_ASIC_RESET, 1);
+    gpio_set_level(asic_reset_gpio(chain), 1);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
@@ -349,41 +313,70 @@ static void _reset(void)
 //     _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1370_SERIALTX_DEBUG);
 // }
 
-uint8_t BM1370_init(uint64_t frequency, uint16_t asic_count)
+uint8_t BM1370_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     ESP_LOGI(TAG, "Initializing BM1370");
 
-    esp_rom_gpio_pad_select_gpio(GPIO_ASIC_RESET);
-    gpio_set_direction(GPIO_ASIC_RESET, GPIO_MODE_OUTPUT);
+    // the frequency ramp looks its PLL settings up instead of searching on every step
+    if (pll_lookup.search == NULL) {
+        pll_table_init(&pll_lookup, _pll_search);
+    }
+
+    esp_rom_gpio_pad_select_gpio(asic_reset_gpio(chain));
+    gpio_set_direction(asic_reset_gpio(chain), GPIO_MODE_OUTPUT);
 
     // reset the bm1370
-    _reset();
+    _reset(chain);
 
-    return _send_init(frequency, asic_count);
+    return _send_init(chain, frequency, asic_count);
 }
 
 // Baud formula = 25M/((denominator+1)*8)
 // The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1370_set_default_baud(void)
+int BM1370_set_default_baud(uint8_t chain)
 {
     // default divider of 26 (11010) for 115,749
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1370_SERIALTX_DEBUG);
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1370_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1370_set_max_baud(void)
+int BM1370_set_max_baud(uint8_t chain)
 {
-    // divider of 0 for 3,125,000
-    ESP_LOGI(TAG, "Setting max baud of 1000000 ");
+    // fast uart configuration for 1,000,000
+    ESP_LOGI(TAG, "Setting max baud of %d", FAST_UART_BAUD);
 
-    unsigned char init8[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
-    _send_simple(init8, 11);
-    return 1000000;
+    unsigned char reg28[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
+    _send_simple(chain, reg28, 11);
+    return FAST_UART_BAUD;
 }
 
+// Only the reset default and the fast uart configuration are known for this chip. The chips only
+// go back to step 0 through a reset, the MISC_CONTROL default of the BM1397 would overwrite the value
+// the init script wrote and leaves the fast uart configuration in place
+int BM1370_set_baud_step(uint8_t chain, int step)
+{
+    switch (step) {
+        case 1:
+            return BM1370_set_max_baud(chain);
+        default:
+            return 0;
+    }
+}
 
-void BM1370_set_job_difficulty_mask(int difficulty)
+int BM1370_read_back_chip_ids(uint8_t chain, uint16_t asic_count)
+{
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, 0x00}, 2, false);
+    return read_back_chip_ids(chain, asic_count, BM1370_CHIP_ID, BM1370_CHIP_ID_RESPONSE_LENGTH);
+}
+
+void BM1370_read_register(uint8_t chain, uint8_t register_address)
+{
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, register_address}, 2, false);
+}
+
+
+void BM1370_set_job_difficulty_mask(uint8_t chain, int difficulty)
 {
     // Default mask of 256 diff
     unsigned char job_difficulty_mask[9] = {0x00, TICKET_MASK, 0b00000000, 0b00000000, 0b00000000, 0b11111111};
@@ -408,19 +401,17 @@ void BM1370_set_job_difficulty_mask(int difficulty)
 
     ESP_LOGI(TAG, "Setting ASIC difficulty mask to %d", difficulty);
 
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1370_SERIALTX_DEBUG);
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1370_SERIALTX_DEBUG);
 }
 
-static uint8_t id = 0;
-
 void BM1370_send_work(void * pvParameters, bm_job * next_bm_job)
 {
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    AsicChain * asic_chain = (AsicChain *) pvParameters;
 
     BM1370_job job;
-    id = (id + 24) % 128;
-    job.job_id = id;
+    asic_chain->job_id = (asic_chain->job_id + 24) % 128;
+    job.job_id = asic_chain->job_id;
     job.num_midstates = 0x01;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -429,29 +420,30 @@ void BM1370_send_work(void * pvParameters, bm_job * next_bm_job)
     memcpy(job.prev_block_hash, next_bm_job->prev_block_hash_be, 32);
     memcpy(&job.version, &next_bm_job->version, 4);
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
+    if (asic_chain->active_jobs[job.job_id] != NULL) {
+        free_bm_job(asic_chain->active_jobs[job.job_id]);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
+    asic_chain->active_jobs[job.job_id] = next_bm_job;
 
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+    pthread_mutex_lock(&asic_chain->valid_jobs_lock);
+    asic_chain->valid_jobs[job.job_id] = 1;
+    pthread_mutex_unlock(&asic_chain->valid_jobs_lock);
 
     //debug sent jobs - this can get crazy if the interval is short
     #if BM1370_DEBUG_JOBS
     ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
     #endif
 
-    _send_BM1370((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1370_job), BM1370_DEBUG_WORK);
+    _send_BM1370(asic_chain->index, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1370_job), BM1370_DEBUG_WORK);
 }
 
 task_result * BM1370_process_work(void * pvParameters)
 {
+    AsicChain * asic_chain = (AsicChain *) pvParameters;
     bm1370_asic_result_t asic_result = {0};
 
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result)) == ESP_FAIL) {
+    if (receive_work(asic_chain->index, (uint8_t *)&asic_result, sizeof(asic_result)) == ESP_FAIL) {
         return NULL;
     }
 
@@ -468,18 +460,16 @@ task_result * BM1370_process_work(void * pvParameters)
     uint32_t version_bits = (ntohs(asic_result.version) << 13); // shift the 16 bit value left 13
     ESP_LOGI(TAG, "Job ID: %02X, Core: %d/%d, Ver: %08" PRIX32, job_id, core_id, small_core_id, version_bits);
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
-
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0) {
+    if (asic_chain->valid_jobs[job_id] == 0) {
         ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
         return NULL;
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
+    uint32_t rolled_version = asic_chain->active_jobs[job_id]->version | version_bits;
 
-    result.job_id = job_id;
-    result.nonce = asic_result.nonce;
-    result.rolled_version = rolled_version;
+    asic_chain->result.job_id = job_id;
+    asic_chain->result.nonce = asic_result.nonce;
+    asic_chain->result.rolled_version = rolled_version;
 
-    return &result;
+    return &asic_chain->result;
 }
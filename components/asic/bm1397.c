@@ -10,7 +10,9 @@
 #include "esp_log.h"
 
 #include "serial.h"
+#include "frequency_transition_bmXX.h"
 #include "bm1397.h"
+#include "init_burst.h"
 #include "utils.h"
 #include "crc.h"
 #include "mining.h"
@@ -19,12 +21,6 @@
 #define BM1397_CHIP_ID 0x1397
 #define BM1397_CHIP_ID_RESPONSE_LENGTH 9
 
-#ifdef CONFIG_GPIO_ASIC_RESET
-#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
-#else
-#define GPIO_ASIC_RESET 1
-#endif
-
 #define TYPE_JOB 0x20
 #define TYPE_CMD 0x40
 
@@ -64,82 +60,30 @@ typedef struct __attribute__((__packed__))
 
 static const char *TAG = "bm1397Module";
 
-static uint32_t prev_nonce = 0;
-static task_result result;
-
+static uint32_t prev_nonce[SERIAL_MAX_CHAINS];
 /// @brief
 /// @param ftdi
 /// @param header
 /// @param data
 /// @param len
-static void _send_BM1397(uint8_t header, uint8_t *data, uint8_t data_len, bool debug)
+static void _send_BM1397(uint8_t chain, uint8_t header, uint8_t *data, uint8_t data_len, bool debug)
 {
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    // allocate memory for buffer
-    unsigned char *buf = malloc(total_length);
-
-    // add the preamble
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-
-    // add the header field
-    buf[2] = header;
-
-    // add the length field
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-
-    // add the data
-    memcpy(buf + 4, data, data_len);
-
-    // add the correct crc type
-    if (packet_type == JOB_PACKET)
-    {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    }
-    else
-    {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
-    }
-
-    // send serial data
-    SERIAL_send(buf, total_length, debug);
-
-    free(buf);
+    SERIAL_send_packet(chain, header, data, data_len, debug);
 }
 
-static void _send_read_address(void)
+static void _send_read_address(uint8_t chain)
 {
     unsigned char read_address[2] = {0x00, 0x00};
     // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1397_SERIALTX_DEBUG);
-}
-
-static void _send_chain_inactive(void)
-{
-
-    unsigned char read_address[2] = {0x00, 0x00};
-    // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1397_SERIALTX_DEBUG);
 }
 
-static void _set_chip_address(uint8_t chipAddr)
-{
-
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1397_SERIALTX_DEBUG);
-}
-
-void BM1397_set_version_mask(uint32_t version_mask) {
+void BM1397_set_version_mask(uint8_t chain, uint32_t version_mask) {
     // placeholder
 }
 
 // borrowed from cgminer driver-gekko.c calc_gsf_freq()
-void BM1397_send_hash_frequency(float frequency)
+void BM1397_send_hash_frequency(uint8_t chain, int chip_address, float frequency)
 {
     unsigned char prefreq1[9] = {0x00, 0x70, 0x0F, 0x0F, 0x0F, 0x00}; // prefreq - pll0_divider
 
@@ -211,118 +155,168 @@ void BM1397_send_hash_frequency(float frequency)
         newf = basef / ((float)fb * (float)fc1 * (float)fc2);
     }
 
+    uint8_t group = GROUP_ALL;
+    if (chip_address != FREQUENCY_ALL_CHIPS)
+    {
+        group = GROUP_SINGLE;
+        prefreq1[0] = chip_address;
+        freqbuf[0] = chip_address;
+    }
+
     for (i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), prefreq1, 6, BM1397_SERIALTX_DEBUG);
+        _send_BM1397(chain, (TYPE_CMD | group | CMD_WRITE), prefreq1, 6, BM1397_SERIALTX_DEBUG);
     }
     for (i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1397_SERIALTX_DEBUG);
+        _send_BM1397(chain, (TYPE_CMD | group | CMD_WRITE), freqbuf, 6, BM1397_SERIALTX_DEBUG);
     }
 
     vTaskDelay(10 / portTICK_PERIOD_MS);
 
-    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", frequency, newf);
+    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f) on chip %d", frequency, newf, chip_address);
+}
+
+bool BM1397_set_frequency(uint8_t chain, float target_freq)
+{
+    return do_frequency_transition(chain, target_freq, BM1397_send_hash_frequency, 1397);
 }
 
-static uint8_t _send_init(uint64_t frequency, uint16_t asic_count)
+// the ticket mask frame of the init script is for this difficulty
+_Static_assert(BM1397_ASIC_DIFFICULTY == 256, "update the ticket mask frame of the init script");
+
+// sent once the chips have their addresses
+static const init_frame init_script_registers[] = {
+    // clock_order_control0
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, CLOCK_ORDER_CONTROL_0, 0x00, 0x00, 0x00, 0x00, 0x1C}},
+    // clock_order_control1
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, CLOCK_ORDER_CONTROL_1, 0x00, 0x00, 0x00, 0x00, 0x11}},
+    // ordered_clock_enable
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, ORDERED_CLOCK_ENABLE, 0x00, 0x00, 0x00, 0x01, 0x02}},
+    // init_4_?
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, CORE_REGISTER_CONTROL, 0x80, 0x00, 0x80, 0x74, 0x10}},
+    // ticket mask
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, TICKET_MASK, 0x00, 0x00, 0x00, 0xFF, 0x08}},
+    // pll3_parameter
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, PLL3_PARAMETER, 0xC0, 0x70, 0x01, 0x11, 0x00}},
+    // fast_uart_configuration
+    {11, {0x55, 0xAA, 0x51, 0x09, 0x00, FAST_UART_CONFIGURATION, 0x06, 0x00, 0x00, 0x0F, 0x18}},
+};
+
+// only used while a chain is initialized, chains are brought up one at a time
+static init_burst burst;
+
+static uint8_t _send_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     // send the init command
-    _send_read_address();
+    _send_read_address(chain);
 
-    int chip_counter = count_asic_chips(asic_count, BM1397_CHIP_ID, BM1397_CHIP_ID_RESPONSE_LENGTH);
+    int chip_counter = count_asic_chips(chain, asic_count, BM1397_CHIP_ID, BM1397_CHIP_ID_RESPONSE_LENGTH);
 
     if (chip_counter == 0) {
         return 0;
     }
 
-    // send serial data
     vTaskDelay(SLEEP_TIME / portTICK_PERIOD_MS);
-    _send_chain_inactive();
+
+    init_burst_begin(&burst, chain, BM1397_SERIALTX_DEBUG);
+    // chain inactive
+    init_burst_add_command(&burst, TYPE_CMD | GROUP_ALL | CMD_INACTIVE, (uint8_t[]){0x00, 0x00}, 2);
 
     // split the chip address space evenly
     for (uint8_t i = 0; i < asic_count; i++) {
-        _set_chip_address(i * (256 / asic_count));
+        init_burst_add_command(&burst, TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS, (uint8_t[]){i * (256 / asic_count), 0x00}, 2);
     }
 
-    unsigned char init[6] = {0x00, CLOCK_ORDER_CONTROL_0, 0x00, 0x00, 0x00, 0x00}; // init1 - clock_order_control0
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init, 6, BM1397_SERIALTX_DEBUG);
-
-    unsigned char init2[6] = {0x00, CLOCK_ORDER_CONTROL_1, 0x00, 0x00, 0x00, 0x00}; // init2 - clock_order_control1
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init2, 6, BM1397_SERIALTX_DEBUG);
-
-    unsigned char init3[9] = {0x00, ORDERED_CLOCK_ENABLE, 0x00, 0x00, 0x00, 0x01}; // init3 - ordered_clock_enable
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init3, 6, BM1397_SERIALTX_DEBUG);
-
-    unsigned char init4[9] = {0x00, CORE_REGISTER_CONTROL, 0x80, 0x00, 0x80, 0x74}; // init4 - init_4_?
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init4, 6, BM1397_SERIALTX_DEBUG);
-
-    BM1397_set_job_difficulty_mask(BM1397_ASIC_DIFFICULTY);
-
-    unsigned char init5[9] = {0x00, PLL3_PARAMETER, 0xC0, 0x70, 0x01, 0x11}; // init5 - pll3_parameter
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init5, 6, BM1397_SERIALTX_DEBUG);
+    if (!init_burst_add_script(&burst, init_script_registers, sizeof(init_script_registers) / sizeof(init_script_registers[0]))) {
+        return 0;
+    }
+    init_burst_send(&burst);
 
-    unsigned char init6[9] = {0x00, FAST_UART_CONFIGURATION, 0x06, 0x00, 0x00, 0x0F}; // init6 - fast_uart_configuration
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init6, 6, BM1397_SERIALTX_DEBUG);
+    ESP_LOGI(TAG, "Sent %u init frames in %u write(s)", burst.frames, burst.writes);
 
-    BM1397_set_default_baud();
+    BM1397_set_default_baud(chain);
 
-    BM1397_send_hash_frequency(frequency);
+    BM1397_send_hash_frequency(chain, FREQUENCY_ALL_CHIPS, frequency);
+    frequency_transition_init(chain, asic_count, 256 / asic_count, frequency);
 
     return chip_counter;
 }
 
 // reset the BM1397 via the RTS line
-static void _reset(void)
+static void _reset(uint8_t chain)
 {
-    gpio_set_level(GPIO_ASIC_RESET, 0);
+    gpio_set_level(asic_reset_gpio(chain), 0);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     // set the gpio pin high
-    gpio_set_level(GPIO_ASIC_RESET, 1);
+    gpio_set_level(asic_reset_gpio(chain), 1);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
 }
 
-uint8_t BM1397_init(uint64_t frequency, uint16_t asic_count)
+uint8_t BM1397_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     ESP_LOGI(TAG, "Initializing BM1397");
 
-    esp_rom_gpio_pad_select_gpio(GPIO_ASIC_RESET);
-    gpio_set_direction(GPIO_ASIC_RESET, GPIO_MODE_OUTPUT);
+    esp_rom_gpio_pad_select_gpio(asic_reset_gpio(chain));
+    gpio_set_direction(asic_reset_gpio(chain), GPIO_MODE_OUTPUT);
 
     // reset the bm1397
-    _reset();
+    _reset(chain);
 
-    return _send_init(frequency, asic_count);
+    return _send_init(chain, frequency, asic_count);
 }
 
 // Baud formula = 25M/((denominator+1)*8)
 // The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1397_set_default_baud(void)
+// Dividers tried by link training, from the reset default of 26 (115,740) up to 0 (3,125,000)
+static const uint8_t baud_dividers[] = {26, 7, 3, 1, 0};
+
+int BM1397_set_default_baud(uint8_t chain)
 {
     // default divider of 26 (11010) for 115,749
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1397_set_max_baud(void)
+int BM1397_set_max_baud(uint8_t chain)
 {
-    // divider of 0 for 3,125,000
-    ESP_LOGI(TAG, "Setting max baud of 3125000");
-    unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01100000, 0b00110001};
-    ; // baudrate - misc_control
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
-    return 3125000;
+    return BM1397_set_baud_step(chain, sizeof(baud_dividers) - 1);
 }
 
-void BM1397_set_job_difficulty_mask(int difficulty)
+int BM1397_set_baud_step(uint8_t chain, int step)
+{
+    if (step < 0 || step >= (int) sizeof(baud_dividers)) {
+        return 0;
+    }
+
+    int baud = 25000000 / ((baud_dividers[step] + 1) * 8);
+    ESP_LOGI(TAG, "Setting baud of %d (divider %d)", baud, baud_dividers[step]);
+
+    unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01100000 | baud_dividers[step], 0b00110001}; // baudrate - misc_control
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1397_SERIALTX_DEBUG);
+    return baud;
+}
+
+int BM1397_read_back_chip_ids(uint8_t chain, uint16_t asic_count)
+{
+    _send_read_address(chain);
+    return read_back_chip_ids(chain, asic_count, BM1397_CHIP_ID, BM1397_CHIP_ID_RESPONSE_LENGTH);
+}
+
+void BM1397_read_register(uint8_t chain, uint8_t register_address)
+{
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, register_address}, 2, false);
+}
+
+void BM1397_set_job_difficulty_mask(uint8_t chain, int difficulty)
 {
 
     // Default mask of 256 diff
@@ -348,22 +342,20 @@ void BM1397_set_job_difficulty_mask(int difficulty)
 
     ESP_LOGI(TAG, "Setting job ASIC mask to %d", difficulty);
 
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1397_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1397_SERIALTX_DEBUG);
 }
 
-static uint8_t id = 0;
-
 void BM1397_send_work(void *pvParameters, bm_job *next_bm_job)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    AsicChain * asic_chain = (AsicChain *) pvParameters;
 
     job_packet job;
     // max job number is 128
     // there is still some really weird logic with the job id bits for the asic to sort out
     // so we have it limited to 128 and it has to increment by 4
-    id = (id + 4) % 128;
+    asic_chain->job_id = (asic_chain->job_id + 4) % 128;
 
-    job.job_id = id;
+    job.job_id = asic_chain->job_id;
     job.num_midstates = next_bm_job->num_midstates;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -378,29 +370,30 @@ void BM1397_send_work(void *pvParameters, bm_job *next_bm_job)
         memcpy(job.midstate3, next_bm_job->midstate3, 32);
     }
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL)
+    if (asic_chain->active_jobs[job.job_id] != NULL)
     {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
+        free_bm_job(asic_chain->active_jobs[job.job_id]);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
+    asic_chain->active_jobs[job.job_id] = next_bm_job;
 
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+    pthread_mutex_lock(&asic_chain->valid_jobs_lock);
+    asic_chain->valid_jobs[job.job_id] = 1;
+    pthread_mutex_unlock(&asic_chain->valid_jobs_lock);
 
     #if BM1397_DEBUG_JOBS
     ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
     #endif
 
-    _send_BM1397((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet), BM1397_DEBUG_WORK);
+    _send_BM1397(asic_chain->index, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet), BM1397_DEBUG_WORK);
 }
 
 task_result *BM1397_process_work(void *pvParameters)
 {
+    AsicChain * asic_chain = (AsicChain *) pvParameters;
     bm1397_asic_result_t asic_result = {0};
 
-    if (receive_work((uint8_t *)&asic_result, sizeof(asic_result)) == ESP_FAIL) {
+    if (receive_work(asic_chain->index, (uint8_t *)&asic_result, sizeof(asic_result)) == ESP_FAIL) {
         return NULL;
     }
 
@@ -410,17 +403,16 @@ task_result *BM1397_process_work(void *pvParameters)
     uint8_t rx_job_id = asic_result.job_id & 0xfc;
     uint8_t rx_midstate_index = asic_result.job_id & 0x03;
 
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
-    if (GLOBAL_STATE->valid_jobs[rx_job_id] == 0)
+    if (asic_chain->valid_jobs[rx_job_id] == 0)
     {
         ESP_LOGW(TAG, "Invalid job nonce found, id=%d", rx_job_id);
         return NULL;
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version;
+    uint32_t rolled_version = asic_chain->active_jobs[rx_job_id]->version;
     for (int i = 0; i < rx_midstate_index; i++)
     {
-        rolled_version = increment_bitmask(rolled_version, GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version_mask);
+        rolled_version = increment_bitmask(rolled_version, asic_chain->active_jobs[rx_job_id]->version_mask);
     }
 
     // ASIC may return the same nonce multiple times
@@ -437,18 +429,18 @@ task_result *BM1397_process_work(void *pvParameters)
         return NULL;
     }
 
-    if (asic_result.nonce == prev_nonce)
+    if (asic_result.nonce == prev_nonce[asic_chain->index])
     {
         return NULL;
     }
     else
     {
-        prev_nonce = asic_result.nonce;
+        prev_nonce[asic_chain->index] = asic_result.nonce;
     }
 
-    result.job_id = rx_job_id;
-    result.nonce = asic_result.nonce;
-    result.rolled_version = rolled_version;
+    asic_chain->result.job_id = rx_job_id;
+    asic_chain->result.nonce = asic_result.nonce;
+    asic_chain->result.rolled_version = rolled_version;
 
-    return &result;
+    return &asic_chain->result;
 }
@@ -0,0 +1,88 @@
+#include "chain_watchdog.h"
+
+#include <stddef.h>
+
+void chain_watchdog_init(chain_watchdog * watchdog, int64_t now_us)
+{
+    watchdog->last_nonce_us = now_us;
+    watchdog->last_job_us = 0;
+    watchdog->expected_rate = 0;
+    watchdog->attempts = 0;
+    watchdog->holdoff_until_us = 0;
+    watchdog->recoveries = 0;
+}
+
+void chain_watchdog_job_sent(chain_watchdog * watchdog, int64_t now_us)
+{
+    // the first job after an idle spell starts the silence over
+    if (now_us - watchdog->last_job_us > CHAIN_WATCHDOG_IDLE_MS * 1000LL) {
+        watchdog->last_nonce_us = now_us;
+    }
+    watchdog->last_job_us = now_us;
+}
+
+void chain_watchdog_nonce(chain_watchdog * watchdog, int64_t now_us)
+{
+    watchdog->last_nonce_us = now_us;
+    watchdog->attempts = 0;
+    watchdog->holdoff_until_us = 0;
+}
+
+uint32_t chain_watchdog_timeout_ms(const chain_watchdog * watchdog)
+{
+    if (watchdog->expected_rate <= 0) {
+        return 0;
+    }
+
+    double timeout_ms = CHAIN_WATCHDOG_EXPECTED_NONCES / watchdog->expected_rate * 1000;
+    if (timeout_ms < CHAIN_WATCHDOG_MIN_SILENCE_MS) {
+        return CHAIN_WATCHDOG_MIN_SILENCE_MS;
+    }
+    if (timeout_ms > CHAIN_WATCHDOG_MAX_SILENCE_MS) {
+        return CHAIN_WATCHDOG_MAX_SILENCE_MS;
+    }
+    return timeout_ms;
+}
+
+bool chain_watchdog_stalled(const chain_watchdog * watchdog, int64_t now_us)
+{
+    uint32_t timeout_ms = chain_watchdog_timeout_ms(watchdog);
+
+    if (timeout_ms == 0 || now_us < watchdog->holdoff_until_us) {
+        return false;
+    }
+    if (now_us - watchdog->last_job_us > CHAIN_WATCHDOG_IDLE_MS * 1000LL) {
+        return false;
+    }
+    return now_us - watchdog->last_nonce_us > timeout_ms * 1000LL;
+}
+
+void chain_watchdog_recovered(chain_watchdog * watchdog, int64_t now_us)
+{
+    int64_t backoff_ms = CHAIN_WATCHDOG_BACKOFF_MS;
+    for (uint32_t i = 0; i < watchdog->attempts && backoff_ms < CHAIN_WATCHDOG_MAX_BACKOFF_MS; i++) {
+        backoff_ms *= 2;
+    }
+    if (backoff_ms > CHAIN_WATCHDOG_MAX_BACKOFF_MS) {
+        backoff_ms = CHAIN_WATCHDOG_MAX_BACKOFF_MS;
+    }
+
+    watchdog->attempts++;
+    watchdog->recoveries++;
+    watchdog->last_nonce_us = now_us;
+    watchdog->holdoff_until_us = now_us + backoff_ms * 1000;
+}
+
+void chain_recovery_log_add(chain_recovery_log * log, const chain_recovery_event * event)
+{
+    log->events[log->count % CHAIN_RECOVERY_LOG_LENGTH] = *event;
+    log->count++;
+}
+
+const chain_recovery_event * chain_recovery_log_get(const chain_recovery_log * log, uint32_t index)
+{
+    if (index >= log->count || index >= CHAIN_RECOVERY_LOG_LENGTH) {
+        return NULL;
+    }
+    return &log->events[(log->count - 1 - index) % CHAIN_RECOVERY_LOG_LENGTH];
+}
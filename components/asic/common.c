@@ -1,15 +1,43 @@
 #include <string.h>
 #include <stdbool.h>
+#include <inttypes.h>
 
 #include "common.h"
 #include "serial.h"
 #include "esp_log.h"
 #include "crc.h"
+#include "frame_parser.h"
+#include "asic_telemetry.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
 
 #define PREAMBLE 0xAA55
 
+// a chip id response takes about 1 ms at the default baud
+#define READ_BACK_TIMEOUT_MS 50
+
+// time for the first chip to answer a chip id read after reset
+#define CHIP_ID_TIMEOUT_MS 1000
+
 static const char * TAG = "common";
 
+// one parser per chain, each is only ever fed by that chain's result task
+static frame_parser parsers[SERIAL_MAX_CHAINS];
+
+#ifdef CONFIG_GPIO_ASIC_RESET
+#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
+#else
+#define GPIO_ASIC_RESET 1
+#endif
+
+#ifdef CONFIG_GPIO_ASIC_CHAIN1_RESET
+#define GPIO_ASIC_CHAIN1_RESET CONFIG_GPIO_ASIC_CHAIN1_RESET
+#else
+#define GPIO_ASIC_CHAIN1_RESET 2
+#endif
+
+static const gpio_num_t reset_gpios[SERIAL_MAX_CHAINS] = {GPIO_ASIC_RESET, GPIO_ASIC_CHAIN1_RESET};
+
 unsigned char _reverse_bits(unsigned char num)
 {
     unsigned char reversed = 0;
@@ -36,13 +64,20 @@ int _largest_power_of_two(int num)
     return 1 << power;
 }
 
-int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response_length)
+gpio_num_t asic_reset_gpio(uint8_t chain)
+{
+    return reset_gpios[chain];
+}
+
+int count_asic_chips(uint8_t chain, uint16_t asic_count, uint16_t chip_id, int chip_id_response_length)
 {
     uint8_t buffer[11] = {0};
 
     int chip_counter = 0;
-    while (true) {
-        int received = SERIAL_rx(buffer, chip_id_response_length, 1000);
+    // stop as soon as every expected chip answered, the rest of the chain follows the
+    // first answer back to back so a missing chip doesn't cost the full timeout either
+    while (chip_counter < asic_count) {
+        int received = SERIAL_rx(chain, buffer, chip_id_response_length, chip_counter == 0 ? CHIP_ID_TIMEOUT_MS : READ_BACK_TIMEOUT_MS);
         if (received == 0) break;
 
         if (received == -1) {
@@ -82,47 +117,84 @@ int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response
     }    
     
     if (chip_counter != asic_count) {
-        ESP_LOGW(TAG, "%i chip(s) detected on the chain, expected %i", chip_counter, asic_count);
+        ESP_LOGW(TAG, "%i chip(s) detected on chain %u, expected %i", chip_counter, chain, asic_count);
     }
 
     return chip_counter;
 }
 
-esp_err_t receive_work(uint8_t * buffer, int buffer_size)
+int read_back_chip_ids(uint8_t chain, uint16_t asic_count, uint16_t chip_id, int chip_id_response_length)
 {
-    int received = SERIAL_rx(buffer, buffer_size, 10000);
+    uint8_t buffer[11] = {0};
 
-    if (received < 0) {
-        ESP_LOGE(TAG, "UART error in serial RX");
-        return ESP_FAIL;
-    }
+    int chip_counter = 0;
+    while (chip_counter < asic_count) {
+        int received = SERIAL_rx(chain, buffer, chip_id_response_length, READ_BACK_TIMEOUT_MS);
+        if (received != chip_id_response_length) break;
 
-    if (received == 0) {
-        ESP_LOGD(TAG, "UART timeout in serial RX");
-        return ESP_FAIL;
-    }
+        uint16_t received_preamble = (buffer[0] << 8) | buffer[1];
+        uint16_t received_chip_id = (buffer[2] << 8) | buffer[3];
+        if (received_preamble != PREAMBLE || received_chip_id != chip_id || crc5(buffer + 2, received - 2) != 0) {
+            ESP_LOGD(TAG, "Read-back failed after %d chip(s)", chip_counter);
+            ESP_LOG_BUFFER_HEX_LEVEL(TAG, buffer, received, ESP_LOG_DEBUG);
+            break;
+        }
 
-    if (received != buffer_size) {
-        ESP_LOGE(TAG, "Invalid response length %i", received);
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
+        chip_counter++;
     }
 
-    uint16_t received_preamble = (buffer[0] << 8) | buffer[1];
-    if (received_preamble != PREAMBLE) {
-        ESP_LOGE(TAG, "Preamble mismatch: got 0x%04x, expected 0x%04x", received_preamble, PREAMBLE);
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
+    return chip_counter;
+}
+
+esp_err_t receive_work(uint8_t chain, uint8_t * buffer, int buffer_size)
+{
+    frame_parser * parser = &parsers[chain];
+
+    if (parser->frame_length != buffer_size) {
+        frame_parser_init(parser, buffer_size);
+        SERIAL_set_rx_threshold(chain, buffer_size);
     }
 
-    if (crc5(buffer + 2, buffer_size - 2) != 0) {
-        ESP_LOGE(TAG, "Checksum failed on response");        
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
+    uint8_t chunk[FRAME_PARSER_MAX_LENGTH];
+
+    while (true) {
+        // never read past the end of the current frame, so nothing has to be kept between calls
+        int received = SERIAL_rx(chain, chunk, frame_parser_bytes_needed(parser), 10000);
+
+        if (received < 0) {
+            ESP_LOGE(TAG, "UART error in serial RX on chain %u", chain);
+            return ESP_FAIL;
+        }
+
+        if (received == 0) {
+            ESP_LOGD(TAG, "UART timeout in serial RX on chain %u", chain);
+            return ESP_FAIL;
+        }
+
+        uint32_t resyncs = parser->stats.resyncs;
+
+        for (int i = 0; i < received; i++) {
+            frame_type_t frame_type = frame_parser_push(parser, chunk[i]);
+
+            if (frame_type == FRAME_JOB_RESPONSE) {
+                memcpy(buffer, parser->buffer, buffer_size);
+                return ESP_OK;
+            }
+
+            if (frame_type == FRAME_CMD_RESPONSE) {
+                ESP_LOGD(TAG, "Register read response");
+                ESP_LOG_BUFFER_HEX_LEVEL(TAG, parser->buffer, buffer_size, ESP_LOG_DEBUG);
+                asic_telemetry_record(chain, parser->buffer, buffer_size, esp_timer_get_time());
+            }
+        }
+
+        if (parser->stats.resyncs != resyncs) {
+            ESP_LOGW(TAG, "Checksum failed on response, resynchronizing (%" PRIu32 " bytes discarded so far)", parser->stats.bytes_discarded);
+        }
     }
+}
 
-    return ESP_OK;
-}
\ No newline at end of file
+const frame_parser_stats * receive_work_stats(uint8_t chain)
+{
+    return &parsers[chain].stats;
+}
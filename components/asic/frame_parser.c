@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "frame_parser.h"
+#include "crc.h"
+
+#define PREAMBLE_0 0xAA
+#define PREAMBLE_1 0x55
+#define CRC5_INIT 0x1F
+
+void frame_parser_init(frame_parser * parser, uint8_t frame_length)
+{
+    memset(parser, 0, sizeof(frame_parser));
+    parser->frame_length = frame_length > FRAME_PARSER_MAX_LENGTH ? FRAME_PARSER_MAX_LENGTH : frame_length;
+}
+
+uint8_t frame_parser_bytes_needed(const frame_parser * parser)
+{
+    if (parser->position >= parser->frame_length) {
+        return parser->frame_length;
+    }
+    return parser->frame_length - parser->position;
+}
+
+static frame_type_t _feed(frame_parser * parser, uint8_t byte);
+
+// drop the first byte of a bad frame and scan the rest of it for the next preamble
+static void _resync(frame_parser * parser)
+{
+    uint8_t pending[FRAME_PARSER_MAX_LENGTH];
+    uint8_t pending_length = parser->position - 1;
+
+    memcpy(pending, parser->buffer + 1, pending_length);
+
+    parser->stats.resyncs++;
+    parser->stats.bytes_discarded++;
+    parser->position = 0;
+
+    // fewer bytes than a full frame, so this can never complete or fail another frame
+    for (uint8_t i = 0; i < pending_length; i++) {
+        _feed(parser, pending[i]);
+    }
+}
+
+static frame_type_t _feed(frame_parser * parser, uint8_t byte)
+{
+    switch (parser->position) {
+        case 0:
+            if (byte != PREAMBLE_0) {
+                parser->stats.bytes_discarded++;
+                return FRAME_NONE;
+            }
+            parser->buffer[parser->position++] = byte;
+            return FRAME_NONE;
+        case 1:
+            if (byte != PREAMBLE_1) {
+                // the 0xAA was noise, the current byte may still start a preamble
+                parser->stats.bytes_discarded++;
+                parser->position = 0;
+                return _feed(parser, byte);
+            }
+            parser->buffer[parser->position++] = byte;
+            parser->crc = CRC5_INIT;
+            return FRAME_NONE;
+        default:
+            parser->buffer[parser->position++] = byte;
+            parser->crc = crc5_update(parser->crc, byte);
+            break;
+    }
+
+    if (parser->position < parser->frame_length) {
+        return FRAME_NONE;
+    }
+
+    if (parser->crc != 0) {
+        _resync(parser);
+        return FRAME_NONE;
+    }
+
+    parser->stats.frames++;
+    if (byte & FRAME_RESPONSE_JOB) {
+        return FRAME_JOB_RESPONSE;
+    }
+    parser->stats.cmd_responses++;
+    return FRAME_CMD_RESPONSE;
+}
+
+frame_type_t frame_parser_push(frame_parser * parser, uint8_t byte)
+{
+    // the previous frame has been handed out, start on the next one
+    if (parser->position >= parser->frame_length) {
+        parser->position = 0;
+    }
+
+    return _feed(parser, byte);
+}
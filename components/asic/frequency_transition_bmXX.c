@@ -3,54 +3,248 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <math.h>
+#include <string.h>
+
+#include "serial.h"
 
 const char *FREQUENCY_TRANSITION_TAG = "frequency_transition";
 
-static float current_frequency = 56.25;
+#define FREQUENCY_STEP 6.25
+#define FREQUENCY_STEP_DELAY_MS 100
+
+// with a supply monitor the step grows to this while the core voltage holds steady
+#define FREQUENCY_MAX_STEP 50.0
+// the supply is sampled this often after a step, and given at most this long to recover
+#define FREQUENCY_SAMPLE_MS 10
+#define FREQUENCY_MAX_DWELL_MS 200
+// the PLLs get this long to lock on each step, however stiff the supply
+#define FREQUENCY_MIN_DWELL_MS 50
+// core voltage deviation from the level before the step
+#define FREQUENCY_DROOP_LIMIT_MV 25
+#define FREQUENCY_DROOP_SETTLED_MV 10
+#define FREQUENCY_DROOP_QUIET_MV 5
+// largest load step the ramp asks of the regulator at once
+#define FREQUENCY_MAX_CURRENT_STEP_MA 2000
+
+// chips come out of reset at 56.25 MHz
+#define FREQUENCY_RESET 56.25
+
+typedef struct
+{
+    uint16_t chip_count;
+    uint8_t address_interval;
+    // PLL frequency each chip was left at
+    float current[FREQUENCY_TRANSITION_MAX_CHIPS];
+} chain_frequency;
+
+static chain_frequency chains[SERIAL_MAX_CHAINS];
+
+static frequency_ramp_monitor_fn ramp_monitor;
+static void * ramp_monitor_context;
+
+void frequency_transition_set_monitor(frequency_ramp_monitor_fn monitor, void * context) {
+    ramp_monitor_context = context;
+    ramp_monitor = monitor;
+}
+
+void frequency_transition_init(uint8_t chain, uint16_t chip_count, uint8_t address_interval, float frequency) {
+    if (chip_count > FREQUENCY_TRANSITION_MAX_CHIPS) {
+        ESP_LOGW(FREQUENCY_TRANSITION_TAG, "Chain %u has %u chips, only the first %d are tuned individually",
+                 chain, chip_count, FREQUENCY_TRANSITION_MAX_CHIPS);
+        chip_count = FREQUENCY_TRANSITION_MAX_CHIPS;
+    }
+
+    chains[chain].chip_count = chip_count;
+    chains[chain].address_interval = address_interval;
+    for (int chip = 0; chip < FREQUENCY_TRANSITION_MAX_CHIPS; chip++) {
+        chains[chain].current[chip] = frequency;
+    }
+}
+
+static chain_frequency * _chain(uint8_t chain) {
+    // a chain that was never enumerated is driven as one chip through broadcasts
+    if (chains[chain].chip_count == 0) {
+        frequency_transition_init(chain, 1, 0, FREQUENCY_RESET);
+    }
+    return &chains[chain];
+}
+
+uint16_t frequency_transition_chip_count(uint8_t chain) {
+    return _chain(chain)->chip_count;
+}
+
+float frequency_transition_get(uint8_t chain, uint16_t chip) {
+    chain_frequency * state = _chain(chain);
+    if (chip >= state->chip_count) {
+        return 0;
+    }
+    return state->current[chip];
+}
+
+// next frequency on the way from current to target, off-grid frequencies first snap to a multiple of FREQUENCY_STEP
+static float _next_step(float current, float target, float step) {
+    if (current == target) {
+        return target;
+    }
+
+    float next;
+    if (fmod(current, FREQUENCY_STEP) != 0) {
+        next = target > current ? ceil(current / FREQUENCY_STEP) * FREQUENCY_STEP : floor(current / FREQUENCY_STEP) * FREQUENCY_STEP;
+    } else {
+        next = target > current ? current + step : current - step;
+    }
+
+    if ((target > current && next > target) || (target < current && next < target)) {
+        return target;
+    }
+    return next;
+}
+
+// one broadcast when every chip gets the same frequency, otherwise a write to each chip that changes
+static void _send(uint8_t chain, chain_frequency * state, const float * frequencies, bool changed_only, set_hash_frequency_fn set_frequency_fn) {
+    bool same = true;
+    for (int chip = 1; chip < state->chip_count; chip++) {
+        if (frequencies[chip] != frequencies[0]) {
+            same = false;
+            break;
+        }
+    }
+
+    if (same) {
+        set_frequency_fn(chain, FREQUENCY_ALL_CHIPS, frequencies[0]);
+    } else {
+        for (int chip = 0; chip < state->chip_count; chip++) {
+            if (!changed_only || frequencies[chip] != state->current[chip]) {
+                set_frequency_fn(chain, chip * state->address_interval, frequencies[chip]);
+            }
+        }
+    }
+
+    memcpy(state->current, frequencies, state->chip_count * sizeof(float));
+}
 
-bool do_frequency_transition(float target_frequency, set_hash_frequency_fn set_frequency_fn, int asic_type) {
+// waits out the supply response to a step, returns the largest core voltage deviation seen
+static float _dwell(const frequency_ramp_sample * before, frequency_ramp_sample * after) {
+    float peak = 0;
+
+    for (int waited = FREQUENCY_SAMPLE_MS; waited <= FREQUENCY_MAX_DWELL_MS; waited += FREQUENCY_SAMPLE_MS) {
+        vTaskDelay(FREQUENCY_SAMPLE_MS / portTICK_PERIOD_MS);
+
+        if (!ramp_monitor(ramp_monitor_context, after)) {
+            // no reading, fall back to the fixed delay
+            vTaskDelay((FREQUENCY_STEP_DELAY_MS - waited) / portTICK_PERIOD_MS);
+            *after = *before;
+            return FREQUENCY_DROOP_LIMIT_MV;
+        }
+
+        float deviation = fabsf(after->voltage_mv - before->voltage_mv);
+        if (deviation > peak) {
+            peak = deviation;
+        }
+        if (deviation <= FREQUENCY_DROOP_SETTLED_MV && waited >= FREQUENCY_MIN_DWELL_MS) {
+            break;
+        }
+    }
+    return peak;
+}
+
+// step size for the next step from the deviation the last one caused and the load it added
+static float _adapt_step(float step, float peak_mv, float ma_per_mhz) {
+    if (peak_mv > FREQUENCY_DROOP_LIMIT_MV) {
+        step /= 2;
+    } else if (peak_mv < FREQUENCY_DROOP_QUIET_MV) {
+        step *= 2;
+    }
+
+    if (ma_per_mhz > 0 && step * ma_per_mhz > FREQUENCY_MAX_CURRENT_STEP_MA) {
+        step = floorf(FREQUENCY_MAX_CURRENT_STEP_MA / ma_per_mhz / FREQUENCY_STEP) * FREQUENCY_STEP;
+    }
+
+    if (step < FREQUENCY_STEP) {
+        return FREQUENCY_STEP;
+    }
+    if (step > FREQUENCY_MAX_STEP) {
+        return FREQUENCY_MAX_STEP;
+    }
+    return step;
+}
+
+static float _highest(const chain_frequency * state, const float * frequencies) {
+    float highest = 0;
+    for (int chip = 0; chip < state->chip_count; chip++) {
+        if (frequencies[chip] > highest) {
+            highest = frequencies[chip];
+        }
+    }
+    return highest;
+}
+
+bool do_frequency_transition_chips(uint8_t chain, const float * target_frequencies, set_hash_frequency_fn set_frequency_fn, int asic_type) {
     if (set_frequency_fn == NULL) {
         ESP_LOGE(FREQUENCY_TRANSITION_TAG, "Invalid function pointer provided");
         return false;
     }
 
-    float step = 6.25;
-    float current = current_frequency;
-    float target = target_frequency;
+    chain_frequency * state = _chain(chain);
+    float next[FREQUENCY_TRANSITION_MAX_CHIPS];
+    float step = FREQUENCY_STEP;
+    float ma_per_mhz = 0;
+    int steps = 0;
 
-    float direction = (target > current) ? step : -step;
+    frequency_ramp_sample sample;
+    bool monitored = ramp_monitor != NULL && ramp_monitor(ramp_monitor_context, &sample);
 
-    // If current frequency is not a multiple of step, adjust to the nearest multiple
-    if (fmod(current, step) != 0) {
-        float next_dividable;
-        if (direction > 0) {
-            next_dividable = ceil(current / step) * step;
-        } else {
-            next_dividable = floor(current / step) * step;
+    // Gradually adjust every chip in steps until all of them reached their target
+    while (1) {
+        bool moving = false;
+        for (int chip = 0; chip < state->chip_count; chip++) {
+            next[chip] = _next_step(state->current[chip], target_frequencies[chip], step);
+            if (next[chip] != state->current[chip]) {
+                moving = true;
+            }
+        }
+
+        if (!moving) {
+            break;
+        }
+
+        float delta_mhz = _highest(state, next) - _highest(state, state->current);
+        _send(chain, state, next, true, set_frequency_fn);
+        steps++;
+
+        if (!monitored) {
+            vTaskDelay(FREQUENCY_STEP_DELAY_MS / portTICK_PERIOD_MS);
+            continue;
         }
-        current = next_dividable;
-        
-        // Call the provided hash frequency function
-        set_frequency_fn(current);
-        
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-    }
 
-    // Gradually adjust frequency in steps until target is reached
-    while ((direction > 0 && current < target) || (direction < 0 && current > target)) {
-        float next_step = fmin(fabs(direction), fabs(target - current));
-        current += direction > 0 ? next_step : -next_step;
-        
-        // Call the provided hash frequency function
-        set_frequency_fn(current);
-        
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        frequency_ramp_sample settled;
+        float peak_mv = _dwell(&sample, &settled);
+        if (delta_mhz > 0 && settled.current_ma > sample.current_ma) {
+            ma_per_mhz = (settled.current_ma - sample.current_ma) / delta_mhz;
+        }
+        step = _adapt_step(step, peak_mv, ma_per_mhz);
+        // the next step is judged against where the supply settled, the load line moves it
+        sample = settled;
     }
-    
+
     // Set the final target frequency
-    set_frequency_fn(target);
-    current_frequency = target;
-    
-    ESP_LOGI(FREQUENCY_TRANSITION_TAG, "Successfully transitioned ASIC type %d to %.2f MHz", asic_type, target);
+    _send(chain, state, target_frequencies, false, set_frequency_fn);
+
+    float lowest = target_frequencies[0];
+    for (int chip = 1; chip < state->chip_count; chip++) {
+        if (target_frequencies[chip] < lowest) {
+            lowest = target_frequencies[chip];
+        }
+    }
+    ESP_LOGI(FREQUENCY_TRANSITION_TAG, "Successfully transitioned ASIC type %d on chain %u (%u chips) to %.2f-%.2f MHz in %d steps",
+             asic_type, chain, state->chip_count, lowest, _highest(state, target_frequencies), steps);
     return true;
 }
+
+bool do_frequency_transition(uint8_t chain, float target_frequency, set_hash_frequency_fn set_frequency_fn, int asic_type) {
+    float targets[FREQUENCY_TRANSITION_MAX_CHIPS];
+    for (int chip = 0; chip < FREQUENCY_TRANSITION_MAX_CHIPS; chip++) {
+        targets[chip] = target_frequency;
+    }
+    return do_frequency_transition_chips(chain, targets, set_frequency_fn, asic_type);
+}
@@ -11,15 +11,33 @@
 #define BITAXE_GAMMA_ASIC_COUNT 1
 #define BITAXE_GAMMATURBO_ASIC_COUNT 2
 
+// chips across all chains that can get a frequency cap of their own
+#define ASIC_MAX_TUNED_CHIPS 32
+
 uint8_t ASIC_init(GlobalState * GLOBAL_STATE);
 uint8_t ASIC_get_asic_count(GlobalState * GLOBAL_STATE);
 uint16_t ASIC_get_small_core_count(GlobalState * GLOBAL_STATE);
-task_result * ASIC_process_work(GlobalState * GLOBAL_STATE);
-int ASIC_set_max_baud(GlobalState * GLOBAL_STATE);
+task_result * ASIC_process_work(GlobalState * GLOBAL_STATE, AsicChain * chain);
+int ASIC_set_max_baud(GlobalState * GLOBAL_STATE, uint8_t chain);
+void ASIC_check_link(GlobalState * GLOBAL_STATE, uint8_t chain);
+void ASIC_read_register(GlobalState * GLOBAL_STATE, uint8_t register_address);
 void ASIC_set_job_difficulty_mask(GlobalState * GLOBAL_STATE, uint8_t mask);
-void ASIC_send_work(GlobalState * GLOBAL_STATE, void * next_job);
+/// @brief moves the chain's ticket mask towards the target nonce rate, never above the pool difficulty
+void ASIC_update_ticket_mask(GlobalState * GLOBAL_STATE, AsicChain * chain);
+/// @brief resets and re-initializes a chain that gets work but stopped returning the nonces its frequency and mask promise
+void ASIC_check_stall(GlobalState * GLOBAL_STATE, AsicChain * chain);
+void ASIC_send_work(GlobalState * GLOBAL_STATE, AsicChain * chain, void * next_job);
 void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask);
+/// @brief ramps every chip to target_frequency, or to its own cap when that is lower
 bool ASIC_set_frequency(GlobalState * GLOBAL_STATE, float target_frequency);
+/// @brief takes the per chip caps as a comma separated list of MHz, numbered across the chains, 0 or empty for no cap
+void ASIC_set_chip_frequency_caps(GlobalState * GLOBAL_STATE, const char * table);
+/// @brief frequency the chip's PLL was last set to, 0 for an unknown chip
+float ASIC_get_chip_frequency(GlobalState * GLOBAL_STATE, uint16_t chip);
+/// @brief derives asic_job_frequency_ms from the frequency, cores, chips, rolled versions and nonce range
+void ASIC_update_job_interval(GlobalState * GLOBAL_STATE);
+/// @brief shortens the job interval while duplicates or stale shares show jobs outliving their nonce space
+void ASIC_trim_job_interval(GlobalState * GLOBAL_STATE);
 esp_err_t ASIC_set_device_model(GlobalState * GLOBAL_STATE);
 
 #endif // ASIC_H
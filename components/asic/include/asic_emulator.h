@@ -0,0 +1,92 @@
+#ifndef ASIC_EMULATOR_H_
+#define ASIC_EMULATOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ASIC_EMULATOR_MAX_CHIPS 16
+#define ASIC_EMULATOR_RX_BUFFER 1024
+#define ASIC_EMULATOR_TX_BUFFER 320
+
+// upper bound on the nonces hashed by one asic_emulator_run call, keeps a long gap
+// between calls from stalling the caller
+#define ASIC_EMULATOR_MAX_NONCES_PER_RUN 4096
+
+// ticket mask difficulty every driver's init script sets, config.zero_bits applies at this mask
+#define ASIC_EMULATOR_DEFAULT_DIFFICULTY 256
+
+typedef struct
+{
+    uint16_t chip_id;
+    uint16_t asic_count;
+    // a nonce is reported when its hash has at least this many leading zero bits while the chips
+    // are at the default ticket mask, a TICKET_MASK write moves it by the change in difficulty
+    uint8_t zero_bits;
+    // nonces hashed per second across the whole chain
+    uint32_t hashrate;
+} asic_emulator_config;
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t jobs;
+    uint64_t hashes;
+    uint32_t nonces;
+    uint32_t rx_overflows;
+} asic_emulator_stats;
+
+typedef struct
+{
+    asic_emulator_config config;
+    uint8_t response_length;
+
+    uint8_t chip_address[ASIC_EMULATOR_MAX_CHIPS];
+    uint16_t addressed_chips;
+    uint32_t registers[256];
+    // leading zero bits the current ticket mask asks for
+    uint8_t zero_bits;
+
+    // frame being reassembled from SERIAL_send
+    uint8_t tx[ASIC_EMULATOR_TX_BUFFER];
+    uint16_t tx_length;
+
+    // bytes waiting for SERIAL_rx
+    uint8_t rx[ASIC_EMULATOR_RX_BUFFER];
+    uint16_t rx_head;
+    uint16_t rx_length;
+
+    // current job, sha256 state after the first 64 header bytes and the remaining 16 bytes
+    bool job_valid;
+    uint8_t job_id;
+    uint32_t midstate[8];
+    uint8_t tail[16];
+    uint32_t next_nonce;
+
+    int64_t last_run_us;
+    double hash_credit;
+
+    asic_emulator_stats stats;
+} asic_emulator;
+
+/// @brief resets the chain, no chip has an address and no job is loaded
+void asic_emulator_init(asic_emulator * emulator, const asic_emulator_config * config);
+
+/// @brief takes bytes that would have gone out on the UART, complete frames are executed
+void asic_emulator_write(asic_emulator * emulator, const uint8_t * data, int length);
+
+/// @brief hashes the nonces the configured hashrate allows since the previous call
+void asic_emulator_run(asic_emulator * emulator, int64_t now_us);
+
+/// @brief takes bytes the chain has sent back
+/// @return number of bytes copied to buffer
+int asic_emulator_read(asic_emulator * emulator, uint8_t * buffer, int length);
+
+int asic_emulator_available(const asic_emulator * emulator);
+
+void asic_emulator_clear(asic_emulator * emulator);
+
+/// @brief double sha256 of an 80 byte block header, exposed for the tests
+void asic_emulator_hash_header(const uint8_t * header, uint8_t * hash);
+
+#endif /* ASIC_EMULATOR_H_ */
@@ -0,0 +1,47 @@
+#ifndef ASIC_TELEMETRY_H_
+#define ASIC_TELEMETRY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// across all chains
+#define ASIC_TELEMETRY_MAX_CHIPS 32
+
+// registers polled by the telemetry task
+#define ASIC_REG_PLL0_PARAMETER 0x08
+#define ASIC_REG_NONCE_ERROR_COUNTER 0x4C
+#define ASIC_REG_NONCE_OVERFLOW_COUNTER 0x50
+#define ASIC_REG_ANALOG_MUX_CONTROL 0x54
+
+#define ASIC_PLL_LOCKED 0x80000000
+
+typedef struct
+{
+    uint8_t chip_address;
+    uint8_t register_address;
+    uint32_t value;
+} asic_register_response;
+
+typedef struct
+{
+    bool seen;
+    bool pll_locked;
+    uint32_t nonce_errors;
+    uint32_t nonce_overflows;
+    uint32_t analog_mux;
+    int64_t updated_us;
+} asic_chip_telemetry;
+
+/// @brief splits a register read response into value, responding chip and register
+bool asic_telemetry_decode(const uint8_t * frame, int length, asic_register_response * response);
+
+/// @brief forgets all readings, chips are addressed 256 / asic_count apart on each chain
+void asic_telemetry_init(uint8_t chain_count, uint16_t asic_count);
+
+/// @brief stores a register read response, called from the receive path of the chain
+void asic_telemetry_record(uint8_t chain, const uint8_t * frame, int length, int64_t now_us);
+
+uint16_t asic_telemetry_chip_count(void);
+const asic_chip_telemetry * asic_telemetry_get(uint16_t chip);
+
+#endif /* ASIC_TELEMETRY_H_ */
@@ -5,8 +5,6 @@
 #include "driver/gpio.h"
 #include "mining.h"
 
-#define ASIC_BM1368_JOB_FREQUENCY_MS 500
-
 #define BM1368_ASIC_DIFFICULTY 256
 
 #define BM1368_SERIALTX_DEBUG false
@@ -14,6 +12,9 @@
 #define BM1368_DEBUG_WORK false //causes insane amount of debug output
 #define BM1368_DEBUG_JOBS false //causes insane amount of debug output
 
+// nonces each small core searches per version, written to reg 0x10 (S21-Stock Default)
+#define BM1368_HASH_COUNTING_NUMBER 0x15A4
+
 static const uint64_t BM1368_CORE_COUNT = 80;
 static const uint64_t BM1368_SMALL_CORE_COUNT = 1276;
 
@@ -29,14 +30,17 @@ typedef struct __attribute__((__packed__))
     uint8_t version[4];
 } BM1368_job;
 
-uint8_t BM1368_init(uint64_t frequency, uint16_t asic_count);
-void BM1368_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
-void BM1368_set_job_difficulty_mask(int);
-void BM1368_set_version_mask(uint32_t version_mask);
-int BM1368_set_max_baud(void);
-int BM1368_set_default_baud(void);
-void BM1368_send_hash_frequency(float frequency);
-bool BM1368_set_frequency(float target_freq);
-task_result * BM1368_process_work(void * GLOBAL_STATE);
+uint8_t BM1368_init(uint8_t chain, uint64_t frequency, uint16_t asic_count);
+void BM1368_send_work(void * asic_chain, bm_job * next_bm_job);
+void BM1368_set_job_difficulty_mask(uint8_t chain, int);
+void BM1368_set_version_mask(uint8_t chain, uint32_t version_mask);
+int BM1368_set_max_baud(uint8_t chain);
+int BM1368_set_default_baud(uint8_t chain);
+int BM1368_set_baud_step(uint8_t chain, int step);
+int BM1368_read_back_chip_ids(uint8_t chain, uint16_t asic_count);
+void BM1368_read_register(uint8_t chain, uint8_t register_address);
+void BM1368_send_hash_frequency(uint8_t chain, int chip_address, float frequency);
+bool BM1368_set_frequency(uint8_t chain, float target_freq);
+task_result * BM1368_process_work(void * asic_chain);
 
 #endif /* BM1368_H_ */
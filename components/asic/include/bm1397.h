@@ -5,8 +5,6 @@
 #include "driver/gpio.h"
 #include "mining.h"
 
-#define ASIC_BM1397_JOB_FREQUENCY_MS 20 //not currently used
-
 #define BM1397_ASIC_DIFFICULTY 256
 
 #define BM1397_SERIALTX_DEBUG true
@@ -31,13 +29,17 @@ typedef struct __attribute__((__packed__))
     uint8_t midstate3[32];
 } job_packet;
 
-uint8_t BM1397_init(uint64_t frequency, uint16_t asic_count);
-void BM1397_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
-void BM1397_set_job_difficulty_mask(int);
-void BM1397_set_version_mask(uint32_t version_mask);
-int BM1397_set_max_baud(void);
-int BM1397_set_default_baud(void);
-void BM1397_send_hash_frequency(float frequency);
-task_result * BM1397_process_work(void * GLOBAL_STATE);
+uint8_t BM1397_init(uint8_t chain, uint64_t frequency, uint16_t asic_count);
+void BM1397_send_work(void * asic_chain, bm_job * next_bm_job);
+void BM1397_set_job_difficulty_mask(uint8_t chain, int);
+void BM1397_set_version_mask(uint8_t chain, uint32_t version_mask);
+int BM1397_set_max_baud(uint8_t chain);
+int BM1397_set_default_baud(uint8_t chain);
+int BM1397_set_baud_step(uint8_t chain, int step);
+int BM1397_read_back_chip_ids(uint8_t chain, uint16_t asic_count);
+void BM1397_read_register(uint8_t chain, uint8_t register_address);
+void BM1397_send_hash_frequency(uint8_t chain, int chip_address, float frequency);
+bool BM1397_set_frequency(uint8_t chain, float target_freq);
+task_result * BM1397_process_work(void * asic_chain);
 
 #endif /* BM1397_H_ */
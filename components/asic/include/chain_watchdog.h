@@ -0,0 +1,71 @@
+#ifndef CHAIN_WATCHDOG_H_
+#define CHAIN_WATCHDOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// a chain is stalled once it has been silent for the time it should have taken to return this many nonces,
+// the chance of a working chain staying that quiet is e^-20
+#define CHAIN_WATCHDOG_EXPECTED_NONCES 20
+#define CHAIN_WATCHDOG_MIN_SILENCE_MS 60000
+#define CHAIN_WATCHDOG_MAX_SILENCE_MS 600000
+
+// without a job sent for this long the chain is idle, not stalled, and the silence starts over
+#define CHAIN_WATCHDOG_IDLE_MS 30000
+
+// recoveries that are not followed by a nonce back off, doubling up to the maximum
+#define CHAIN_WATCHDOG_BACKOFF_MS 60000
+#define CHAIN_WATCHDOG_MAX_BACKOFF_MS (30 * 60000)
+
+#define CHAIN_RECOVERY_LOG_LENGTH 8
+
+typedef struct
+{
+    int64_t last_nonce_us;
+    int64_t last_job_us;
+    // nonces per second the chain should return at its frequency and ticket mask, 0 while unknown
+    double expected_rate;
+    // recoveries since the last nonce
+    uint32_t attempts;
+    int64_t holdoff_until_us;
+    uint32_t recoveries;
+} chain_watchdog;
+
+typedef struct
+{
+    int64_t time_us;
+    uint8_t chain;
+    uint32_t silence_ms;
+    // chips that answered after the re-init
+    uint8_t asic_count;
+    uint32_t duration_ms;
+    bool recovered;
+} chain_recovery_event;
+
+typedef struct
+{
+    chain_recovery_event events[CHAIN_RECOVERY_LOG_LENGTH];
+    uint32_t count;
+} chain_recovery_log;
+
+void chain_watchdog_init(chain_watchdog * watchdog, int64_t now_us);
+
+void chain_watchdog_job_sent(chain_watchdog * watchdog, int64_t now_us);
+
+void chain_watchdog_nonce(chain_watchdog * watchdog, int64_t now_us);
+
+/// @brief silence in ms after which the chain counts as stalled, 0 while the expected rate is unknown
+uint32_t chain_watchdog_timeout_ms(const chain_watchdog * watchdog);
+
+/// @brief true when the chain is getting work but has been silent for longer than the timeout
+bool chain_watchdog_stalled(const chain_watchdog * watchdog, int64_t now_us);
+
+/// @brief starts the silence over after a recovery and holds the next one off
+void chain_watchdog_recovered(chain_watchdog * watchdog, int64_t now_us);
+
+void chain_recovery_log_add(chain_recovery_log * log, const chain_recovery_event * event);
+
+/// @brief recorded events, 0 is the most recent, NULL past the end
+const chain_recovery_event * chain_recovery_log_get(const chain_recovery_log * log, uint32_t index);
+
+#endif /* CHAIN_WATCHDOG_H_ */
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 #include "esp_err.h"
+#include "driver/gpio.h"
+#include "frame_parser.h"
 
 typedef struct __attribute__((__packed__))
 {
@@ -14,7 +16,12 @@ typedef struct __attribute__((__packed__))
 unsigned char _reverse_bits(unsigned char num);
 int _largest_power_of_two(int num);
 
-int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response_length);
-esp_err_t receive_work(uint8_t * buffer, int buffer_size);
+/// @brief reset line of the chain, chain 0 uses GPIO_ASIC_RESET
+gpio_num_t asic_reset_gpio(uint8_t chain);
+
+int count_asic_chips(uint8_t chain, uint16_t asic_count, uint16_t chip_id, int chip_id_response_length);
+int read_back_chip_ids(uint8_t chain, uint16_t asic_count, uint16_t chip_id, int chip_id_response_length);
+esp_err_t receive_work(uint8_t chain, uint8_t * buffer, int buffer_size);
+const frame_parser_stats * receive_work_stats(uint8_t chain);
 
 #endif /* COMMON_H_ */
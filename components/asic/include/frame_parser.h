@@ -0,0 +1,47 @@
+#ifndef FRAME_PARSER_H_
+#define FRAME_PARSER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_PARSER_MAX_LENGTH 16
+
+// the last byte of every response carries the crc5 in the lower bits
+// and this flag when the response is a nonce rather than a register read
+#define FRAME_RESPONSE_JOB 0x80
+
+typedef enum
+{
+    FRAME_NONE = 0,
+    FRAME_CMD_RESPONSE,
+    FRAME_JOB_RESPONSE,
+} frame_type_t;
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t cmd_responses;
+    uint32_t resyncs;
+    uint32_t bytes_discarded;
+} frame_parser_stats;
+
+typedef struct
+{
+    uint8_t frame_length;
+    uint8_t buffer[FRAME_PARSER_MAX_LENGTH];
+    uint8_t position;
+    uint8_t crc;
+    frame_parser_stats stats;
+} frame_parser;
+
+/// @brief resets the parser for responses of a fixed length, including preamble and crc
+void frame_parser_init(frame_parser * parser, uint8_t frame_length);
+
+/// @brief number of bytes that can be read without running past the end of the current frame
+uint8_t frame_parser_bytes_needed(const frame_parser * parser);
+
+/// @brief feeds one byte from the UART into the parser
+/// @return the type of frame completed by this byte, the frame is in parser->buffer until the next push
+frame_type_t frame_parser_push(frame_parser * parser, uint8_t byte);
+
+#endif /* FRAME_PARSER_H_ */
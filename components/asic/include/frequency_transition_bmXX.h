@@ -2,30 +2,97 @@
 #define FREQUENCY_TRANSITION_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 extern const char *FREQUENCY_TRANSITION_TAG;
 
+// chips per chain whose PLL is tracked and set on its own
+#define FREQUENCY_TRANSITION_MAX_CHIPS 16
+
+// chip address that makes set_hash_frequency_fn write to every chip on the chain
+#define FREQUENCY_ALL_CHIPS -1
+
 /**
  * @brief Function pointer type for ASIC hash frequency setting functions
  * 
  * This type defines the signature for functions that set the hash frequency
  * for different ASIC types.
  * 
+ * @param chain The ASIC chain to program
+ * @param chip_address Address of the chip to program, or FREQUENCY_ALL_CHIPS
  * @param frequency The frequency to set in MHz
  */
-typedef void (*set_hash_frequency_fn)(float frequency);
+typedef void (*set_hash_frequency_fn)(uint8_t chain, int chip_address, float frequency);
+
+typedef struct
+{
+    float voltage_mv;
+    float current_ma;
+} frequency_ramp_sample;
+
+/**
+ * @brief Reads the core supply for the ramp
+ * 
+ * @param context The context given to frequency_transition_set_monitor
+ * @param sample Measured core voltage and current
+ * @return bool False when no reading is available
+ */
+typedef bool (*frequency_ramp_monitor_fn)(void * context, frequency_ramp_sample * sample);
+
+/**
+ * @brief Lets the ramp size its steps from the core supply
+ * 
+ * Without a monitor every step is 6.25 MHz followed by a fixed 100 ms delay.
+ * With one, a step waits only until the core voltage settled again and the step size
+ * grows while the supply holds steady, shrinking again on droop or a large load step.
+ */
+void frequency_transition_set_monitor(frequency_ramp_monitor_fn monitor, void * context);
+
+/**
+ * @brief Start tracking the chips of a chain after enumeration
+ * 
+ * @param chain The ASIC chain
+ * @param chip_count Chips that answered on the chain
+ * @param address_interval Distance between the addresses handed to the chips
+ * @param frequency The frequency every chip runs at right now
+ */
+void frequency_transition_init(uint8_t chain, uint16_t chip_count, uint8_t address_interval, float frequency);
+
+uint16_t frequency_transition_chip_count(uint8_t chain);
+
+/**
+ * @brief Frequency the chip was last set to, 0 for a chip that isn't tracked
+ */
+float frequency_transition_get(uint8_t chain, uint16_t chip);
 
 /**
  * @brief Transition the ASIC frequency to a target value
  * 
  * This function gradually adjusts the ASIC frequency to reach the target value,
  * stepping up or down in increments to ensure stability.
+ * Every chip keeps track of its own current frequency.
+ * The step size and the delay between steps follow the supply monitor, if one is set.
  * 
+ * @param chain The ASIC chain to transition
  * @param target_frequency The target frequency in MHz
  * @param set_frequency_fn Function pointer to the appropriate ASIC's set_hash_frequency function
  * @param asic_type The type of ASIC chip (for logging purposes only)
  * @return bool True if the transition was successful, false otherwise
  */
-bool do_frequency_transition(float target_frequency, set_hash_frequency_fn set_frequency_fn, int asic_type);
+bool do_frequency_transition(uint8_t chain, float target_frequency, set_hash_frequency_fn set_frequency_fn, int asic_type);
+
+/**
+ * @brief Transition every chip of a chain to its own target value
+ * 
+ * All chips step together, steps where every chip gets the same frequency go out
+ * as a single broadcast.
+ * 
+ * @param chain The ASIC chain to transition
+ * @param target_frequencies One target in MHz per chip, in address order
+ * @param set_frequency_fn Function pointer to the appropriate ASIC's set_hash_frequency function
+ * @param asic_type The type of ASIC chip (for logging purposes only)
+ * @return bool True if the transition was successful, false otherwise
+ */
+bool do_frequency_transition_chips(uint8_t chain, const float * target_frequencies, set_hash_frequency_fn set_frequency_fn, int asic_type);
 
 #endif // FREQUENCY_TRANSITION_H
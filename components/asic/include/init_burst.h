@@ -0,0 +1,47 @@
+#ifndef INIT_BURST_H_
+#define INIT_BURST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// preamble, header, length, chip address, register, 4 data bytes and the crc5
+#define INIT_FRAME_MAX_LENGTH 11
+
+// pending bytes are sent early when the next frame doesn't fit
+#define INIT_BURST_LENGTH 512
+
+/// @brief a complete command frame, crc included, so a static init script goes out as is
+typedef struct
+{
+    uint8_t length;
+    uint8_t bytes[INIT_FRAME_MAX_LENGTH];
+} init_frame;
+
+typedef struct
+{
+    uint8_t chain;
+    bool debug;
+    uint8_t buffer[INIT_BURST_LENGTH];
+    uint16_t length;
+    // frames queued since init_burst_begin, across early sends
+    uint16_t frames;
+    uint16_t writes;
+} init_burst;
+
+void init_burst_begin(init_burst * burst, uint8_t chain, bool debug);
+
+/// @brief appends a static script, the frames are copied without touching their crc
+/// @return false and nothing queued when a frame fails init_script_valid
+bool init_burst_add_script(init_burst * burst, const init_frame * script, int count);
+
+/// @brief frames a command the way SERIAL_send_packet does and appends it
+void init_burst_add_command(init_burst * burst, uint8_t header, const uint8_t * data, uint8_t data_len);
+
+/// @brief hands everything queued to the UART in a single write
+/// @return number of bytes sent
+int init_burst_send(init_burst * burst);
+
+/// @brief true when every frame has a preamble, a matching length byte and a valid crc5
+bool init_script_valid(const init_frame * script, int count);
+
+#endif /* INIT_BURST_H_ */
@@ -0,0 +1,60 @@
+#ifndef JOB_INTERVAL_H_
+#define JOB_INTERVAL_H_
+
+#include <stdint.h>
+
+// bounds on the time between two jobs sent to one chain
+#define JOB_INTERVAL_MIN_MS 10.0
+#define JOB_INTERVAL_MAX_MS 5000.0
+
+// a new job goes out when the chain has searched this share of the current one
+#define JOB_INTERVAL_EXHAUSTION_SHARE 0.5
+
+// trim window is only judged once this many nonces came back
+#define JOB_INTERVAL_TRIM_MIN_NONCES 64
+#define JOB_INTERVAL_TRIM_MIN 0.25
+#define JOB_INTERVAL_TRIM_SHRINK 0.8
+#define JOB_INTERVAL_TRIM_RELAX 1.05
+// duplicates per returned nonce and stale rejects per submitted share that shorten the interval
+#define JOB_INTERVAL_DUPLICATE_RATE 0.01
+#define JOB_INTERVAL_STALE_RATE 0.02
+
+typedef struct
+{
+    float frequency_mhz;
+    // per chip
+    uint16_t small_core_count;
+    // chips on the chain the job is sent to
+    uint16_t asic_count;
+    // versions a chip rolls through for every nonce range, 1 without version rolling
+    uint32_t versions;
+    // nonces each small core searches per version (reg 0x10), 0 when the chip splits the full 2^32 range
+    uint32_t hash_counting_number;
+} job_interval_params;
+
+typedef struct
+{
+    double factor;
+    // counter values at the start of the current window
+    uint64_t nonces;
+    uint64_t duplicates;
+    uint64_t shares;
+    uint64_t stale;
+} job_interval_trim;
+
+/// @brief versions covered by a version mask, every set bit doubles them
+uint32_t job_interval_versions(uint32_t version_mask);
+
+/// @brief time in ms the chain needs to search every nonce and version of one job, 0 when the frequency is unknown
+double job_interval_exhaustion_ms(const job_interval_params * params);
+
+/// @brief job interval in ms for the chain, scaled by the trim factor and clamped
+double job_interval_ms(const job_interval_params * params, double trim_factor);
+
+void job_interval_trim_init(job_interval_trim * trim);
+
+/// @brief closes a window once enough nonces came back, all counters are running totals
+/// @return the trim factor, smaller when duplicates or stale shares show the jobs are too old
+double job_interval_trim_update(job_interval_trim * trim, uint64_t nonces, uint64_t duplicates, uint64_t shares, uint64_t stale);
+
+#endif /* JOB_INTERVAL_H_ */
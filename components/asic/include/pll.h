@@ -0,0 +1,42 @@
+#ifndef PLL_H_
+#define PLL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the PLL reference clock
+#define PLL_REFERENCE_MHZ 25.0
+
+// frequencies on this grid up to PLL_TABLE_SIZE steps are looked up instead of searched
+#define PLL_TABLE_STEP 6.25
+#define PLL_TABLE_SIZE 192
+
+typedef struct
+{
+    uint8_t fb_divider;
+    uint8_t ref_divider;
+    uint8_t post_divider1;
+    uint8_t post_divider2;
+} pll_setting;
+
+/// @brief chip specific divider search
+/// @return false when no divider combination reaches the target closely enough
+typedef bool (*pll_search_fn)(float target_frequency, pll_setting * setting);
+
+typedef struct
+{
+    pll_search_fn search;
+    // fb_divider 0 marks a grid frequency the search found nothing for
+    pll_setting entries[PLL_TABLE_SIZE];
+} pll_table;
+
+/// @brief runs the search once for every grid frequency
+void pll_table_init(pll_table * table, pll_search_fn search);
+
+/// @brief dividers for the target, grid frequencies come from the table, anything else is searched
+bool pll_table_lookup(const pll_table * table, float target_frequency, pll_setting * setting);
+
+/// @brief frequency the dividers produce
+float pll_frequency(const pll_setting * setting);
+
+#endif /* PLL_H_ */
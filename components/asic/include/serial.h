@@ -3,17 +3,36 @@
 
 #include "esp_err.h"
 
+// header, length, up to 255 bytes of data and a crc16
+#define SERIAL_MAX_PACKET_LENGTH (255 + 6)
+
+// one UART per ASIC chain
+#define SERIAL_MAX_CHAINS 2
+
 typedef enum
 {
     JOB_PACKET = 0,
     CMD_PACKET = 1,
 } packet_type_t;
 
-int SERIAL_send(uint8_t *, int, bool);
-esp_err_t SERIAL_init(void);
-void SERIAL_debug_rx(void);
-int16_t SERIAL_rx(uint8_t *, uint16_t, uint16_t);
-void SERIAL_clear_buffer(void);
-esp_err_t SERIAL_set_baud(int baud);
+typedef struct
+{
+    uint32_t fifo_overflows;
+    uint32_t buffer_full;
+    uint32_t breaks;
+    uint32_t frame_errors;
+    uint32_t job_tx_time_us;
+} serial_stats;
+
+int SERIAL_send(uint8_t chain, uint8_t *, int, bool);
+int SERIAL_send_packet(uint8_t chain, uint8_t header, uint8_t * data, uint8_t data_len, bool debug);
+esp_err_t SERIAL_wait_tx_done(uint8_t chain, uint32_t timeout_ms);
+esp_err_t SERIAL_init(uint8_t chain);
+void SERIAL_debug_rx(uint8_t chain);
+int16_t SERIAL_rx(uint8_t chain, uint8_t *, uint16_t, uint16_t);
+void SERIAL_clear_buffer(uint8_t chain);
+esp_err_t SERIAL_set_baud(uint8_t chain, int baud);
+esp_err_t SERIAL_set_rx_threshold(uint8_t chain, uint8_t frame_length);
+const serial_stats * SERIAL_get_stats(uint8_t chain);
 
 #endif /* SERIAL_H_ */
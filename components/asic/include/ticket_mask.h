@@ -0,0 +1,50 @@
+#ifndef TICKET_MASK_H_
+#define TICKET_MASK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// bounds on the ticket mask difficulty, always a power of two
+#define TICKET_MASK_MIN_DIFFICULTY 16
+#define TICKET_MASK_MAX_DIFFICULTY 65536
+
+// a window is judged once it is at least WINDOW_MIN_MS long and either WINDOW_NONCES came back
+// or WINDOW_MAX_MS passed, so a slow chain still gets its mask lowered
+#define TICKET_MASK_WINDOW_MIN_MS 10000
+#define TICKET_MASK_WINDOW_MAX_MS 120000
+#define TICKET_MASK_WINDOW_NONCES 64
+
+// the nonce rate has to be off the target by more than this factor before the mask moves
+#define TICKET_MASK_HYSTERESIS 2.0
+
+// nonces arriving this soon after a change may still have been found with the previous mask
+#define TICKET_MASK_SETTLE_MS 500
+
+typedef struct
+{
+    uint32_t difficulty;
+    uint32_t previous_difficulty;
+    int64_t changed_us;
+    // nonces per second
+    double target_rate;
+
+    int64_t window_start_us;
+    uint32_t window_nonces;
+    // nonces per second over the last judged window
+    double rate;
+} ticket_mask;
+
+void ticket_mask_init(ticket_mask * mask, uint32_t difficulty, double target_rate, int64_t now_us);
+
+/// @brief difficulty a nonce arriving now was found with, the lower of the two masks right after a change
+uint32_t ticket_mask_difficulty_at(const ticket_mask * mask, int64_t now_us);
+
+void ticket_mask_record_nonce(ticket_mask * mask);
+
+/// @brief closes a window and moves the mask by whole powers of two towards the target rate
+/// @param max_difficulty the mask is never raised above this, so no share the pool wants is hidden, 0 for no limit
+/// @param max_rate nonces per second the mask is never lowered into and is raised out of, 0 for no limit
+/// @return true when the difficulty changed and has to be sent to the chain
+bool ticket_mask_update(ticket_mask * mask, int64_t now_us, uint32_t max_difficulty, double max_rate);
+
+#endif /* TICKET_MASK_H_ */
@@ -0,0 +1,87 @@
+#include "init_burst.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "crc.h"
+#include "serial.h"
+
+static const char *TAG = "init_burst";
+
+void init_burst_begin(init_burst * burst, uint8_t chain, bool debug)
+{
+    burst->chain = chain;
+    burst->debug = debug;
+    burst->length = 0;
+    burst->frames = 0;
+    burst->writes = 0;
+}
+
+static uint8_t * _reserve(init_burst * burst, int length)
+{
+    if (burst->length + length > INIT_BURST_LENGTH) {
+        init_burst_send(burst);
+    }
+
+    uint8_t * frame = burst->buffer + burst->length;
+    burst->length += length;
+    burst->frames++;
+    return frame;
+}
+
+bool init_burst_add_script(init_burst * burst, const init_frame * script, int count)
+{
+    // the scripts are typed in by hand, a frame the chips would drop fails the whole init
+    if (!init_script_valid(script, count)) {
+        ESP_LOGE(TAG, "Init script with a bad frame, not sent");
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        memcpy(_reserve(burst, script[i].length), script[i].bytes, script[i].length);
+    }
+    return true;
+}
+
+void init_burst_add_command(init_burst * burst, uint8_t header, const uint8_t * data, uint8_t data_len)
+{
+    uint8_t * frame = _reserve(burst, data_len + 5);
+
+    frame[0] = 0x55;
+    frame[1] = 0xAA;
+    frame[2] = header;
+    frame[3] = data_len + 3;
+    memcpy(frame + 4, data, data_len);
+    frame[4 + data_len] = crc5(frame + 2, data_len + 2);
+}
+
+int init_burst_send(init_burst * burst)
+{
+    if (burst->length == 0) {
+        return 0;
+    }
+
+    int sent = SERIAL_send(burst->chain, burst->buffer, burst->length, burst->debug);
+    burst->length = 0;
+    burst->writes++;
+    return sent;
+}
+
+bool init_script_valid(const init_frame * script, int count)
+{
+    for (int i = 0; i < count; i++) {
+        const init_frame * frame = &script[i];
+
+        if (frame->length < 5 || frame->length > INIT_FRAME_MAX_LENGTH) {
+            return false;
+        }
+        if (frame->bytes[0] != 0x55 || frame->bytes[1] != 0xAA || frame->bytes[3] != frame->length - 2) {
+            return false;
+        }
+        if (crc5((uint8_t *) frame->bytes + 2, frame->length - 3) != frame->bytes[frame->length - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+#include "job_interval.h"
+
+static const double NONCE_SPACE = 4294967296.0; //  2^32
+
+uint32_t job_interval_versions(uint32_t version_mask)
+{
+    uint32_t versions = 1;
+    for (; version_mask != 0; version_mask &= version_mask - 1) {
+        // more than 31 bits can't be rolled in a 32 bit version field anyway
+        if (versions == 0x80000000) {
+            break;
+        }
+        versions <<= 1;
+    }
+    return versions;
+}
+
+double job_interval_exhaustion_ms(const job_interval_params * params)
+{
+    double cores = (double) params->small_core_count * params->asic_count;
+    if (params->frequency_mhz <= 0 || cores <= 0) {
+        return 0;
+    }
+
+    // every small core searches its own slice of the nonce range, the chain as a whole
+    // never covers more than 2^32 nonces per version
+    double range = NONCE_SPACE;
+    if (params->hash_counting_number != 0 && params->hash_counting_number * cores < NONCE_SPACE) {
+        range = params->hash_counting_number * cores;
+    }
+
+    // each small core checks one nonce per clock
+    double versions = params->versions == 0 ? 1 : params->versions;
+    return versions * range / (params->frequency_mhz * 1000.0 * cores);
+}
+
+double job_interval_ms(const job_interval_params * params, double trim_factor)
+{
+    double exhaustion_ms = job_interval_exhaustion_ms(params);
+    if (exhaustion_ms <= 0) {
+        return JOB_INTERVAL_MAX_MS;
+    }
+
+    double interval = exhaustion_ms * JOB_INTERVAL_EXHAUSTION_SHARE * trim_factor;
+    if (interval < JOB_INTERVAL_MIN_MS) {
+        return JOB_INTERVAL_MIN_MS;
+    }
+    if (interval > JOB_INTERVAL_MAX_MS) {
+        return JOB_INTERVAL_MAX_MS;
+    }
+    return interval;
+}
+
+void job_interval_trim_init(job_interval_trim * trim)
+{
+    trim->factor = 1.0;
+    trim->nonces = 0;
+    trim->duplicates = 0;
+    trim->shares = 0;
+    trim->stale = 0;
+}
+
+double job_interval_trim_update(job_interval_trim * trim, uint64_t nonces, uint64_t duplicates, uint64_t shares, uint64_t stale)
+{
+    // share counters are reset on a pool failover, start a new window
+    if (nonces < trim->nonces || duplicates < trim->duplicates || shares < trim->shares || stale < trim->stale) {
+        trim->nonces = nonces;
+        trim->duplicates = duplicates;
+        trim->shares = shares;
+        trim->stale = stale;
+        return trim->factor;
+    }
+
+    uint64_t window_nonces = nonces - trim->nonces;
+    if (window_nonces < JOB_INTERVAL_TRIM_MIN_NONCES) {
+        return trim->factor;
+    }
+
+    double duplicate_rate = (double) (duplicates - trim->duplicates) / window_nonces;
+    uint64_t window_shares = shares - trim->shares;
+    double stale_rate = window_shares == 0 ? 0 : (double) (stale - trim->stale) / window_shares;
+
+    if (duplicate_rate > JOB_INTERVAL_DUPLICATE_RATE || stale_rate > JOB_INTERVAL_STALE_RATE) {
+        trim->factor *= JOB_INTERVAL_TRIM_SHRINK;
+        if (trim->factor < JOB_INTERVAL_TRIM_MIN) {
+            trim->factor = JOB_INTERVAL_TRIM_MIN;
+        }
+    } else {
+        trim->factor *= JOB_INTERVAL_TRIM_RELAX;
+        if (trim->factor > 1.0) {
+            trim->factor = 1.0;
+        }
+    }
+
+    trim->nonces = nonces;
+    trim->duplicates = duplicates;
+    trim->shares = shares;
+    trim->stale = stale;
+
+    return trim->factor;
+}
@@ -0,0 +1,38 @@
+#include "pll.h"
+
+#include <math.h>
+#include <string.h>
+
+void pll_table_init(pll_table * table, pll_search_fn search)
+{
+    table->search = search;
+
+    for (int i = 0; i < PLL_TABLE_SIZE; i++) {
+        if (!search((i + 1) * PLL_TABLE_STEP, &table->entries[i])) {
+            memset(&table->entries[i], 0, sizeof(pll_setting));
+        }
+    }
+}
+
+bool pll_table_lookup(const pll_table * table, float target_frequency, pll_setting * setting)
+{
+    float index = target_frequency / PLL_TABLE_STEP - 1;
+
+    if (index >= 0 && index < PLL_TABLE_SIZE && index == floorf(index)) {
+        *setting = table->entries[(int) index];
+        return setting->fb_divider != 0;
+    }
+
+    if (table->search == NULL) {
+        return false;
+    }
+    return table->search(target_frequency, setting);
+}
+
+float pll_frequency(const pll_setting * setting)
+{
+    if (setting->ref_divider == 0 || setting->post_divider1 == 0 || setting->post_divider2 == 0) {
+        return 0;
+    }
+    return PLL_REFERENCE_MHZ * setting->fb_divider / (float) (setting->ref_divider * setting->post_divider1 * setting->post_divider2);
+}
@@ -1,27 +1,120 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 #include "driver/uart.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "soc/uart_struct.h"
 
 #include "serial.h"
+#include "crc.h"
 #include "utils.h"
 
+#if CONFIG_ASIC_EMULATOR
+#include "asic_emulator.h"
+#endif
+
 #define ECHO_TEST_TXD (17)
 #define ECHO_TEST_RXD (18)
 #define BUF_SIZE (1024)
+#define UART_QUEUE_SIZE (32)
+
+#ifdef CONFIG_GPIO_ASIC_CHAIN1_TX
+#define CHAIN1_TXD CONFIG_GPIO_ASIC_CHAIN1_TX
+#define CHAIN1_RXD CONFIG_GPIO_ASIC_CHAIN1_RX
+#else
+#define CHAIN1_TXD (15)
+#define CHAIN1_RXD (16)
+#endif
+
+#define TYPE_JOB 0x20
+
+// rx timeout in symbol times, raise the interrupt shortly after the line goes idle
+// instead of the driver default of 10 so partial frames are delivered quickly
+#define RX_TIMEOUT_SYMBOLS (2)
 
 static const char *TAG = "serial";
 
-esp_err_t SERIAL_init(void)
+typedef struct
+{
+    uart_port_t uart;
+    int tx_pin;
+    int rx_pin;
+    QueueHandle_t uart_queue;
+    serial_stats stats;
+
+    // start of the job frame that is still being shifted out, 0 when idle
+    int64_t job_tx_start_us;
+
+#if CONFIG_ASIC_EMULATOR
+    // the UART is replaced by a software chain, jobs are sent and results read from different tasks
+    asic_emulator emulator;
+    SemaphoreHandle_t emulator_lock;
+#endif
+} serial_port;
+
+static serial_port ports[SERIAL_MAX_CHAINS] = {
+    {.uart = UART_NUM_1, .tx_pin = ECHO_TEST_TXD, .rx_pin = ECHO_TEST_RXD},
+    {.uart = UART_NUM_2, .tx_pin = CHAIN1_TXD, .rx_pin = CHAIN1_RXD},
+};
+
+#if CONFIG_ASIC_EMULATOR
+static esp_err_t _emulator_init(serial_port * port)
 {
-    ESP_LOGI(TAG, "Initializing serial");
-    // Configure UART1 parameters
+    asic_emulator_config config = {
+        .chip_id = CONFIG_ASIC_EMULATOR_CHIP_ID,
+        .asic_count = CONFIG_ASIC_EMULATOR_CHIP_COUNT,
+        .zero_bits = CONFIG_ASIC_EMULATOR_ZERO_BITS,
+        .hashrate = CONFIG_ASIC_EMULATOR_HASHRATE,
+    };
+
+    ESP_LOGW(TAG, "Using an emulated BM%04X chain of %d chip(s) instead of UART%d", config.chip_id, config.asic_count, port->uart);
+
+    port->emulator_lock = xSemaphoreCreateMutex();
+    if (port->emulator_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    asic_emulator_init(&port->emulator, &config);
+    return ESP_OK;
+}
+
+static int _emulator_rx(serial_port * port, uint8_t * buf, uint16_t size, uint16_t timeout_ms)
+{
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    int bytes_read = 0;
+
+    while (true) {
+        xSemaphoreTake(port->emulator_lock, portMAX_DELAY);
+        asic_emulator_run(&port->emulator, esp_timer_get_time());
+        bytes_read += asic_emulator_read(&port->emulator, buf + bytes_read, size - bytes_read);
+        xSemaphoreGive(port->emulator_lock);
+
+        if (bytes_read == size || (int32_t)(deadline - xTaskGetTickCount()) <= 0) {
+            return bytes_read;
+        }
+        vTaskDelay(1);
+    }
+}
+#endif
+
+esp_err_t SERIAL_init(uint8_t chain)
+{
+    serial_port * port = &ports[chain];
+
+    ESP_LOGI(TAG, "Initializing serial for chain %u", chain);
+
+    #if CONFIG_ASIC_EMULATOR
+    return _emulator_init(port);
+    #else
+
     uart_config_t uart_config = {
         .baud_rate = 115200,
         .data_bits = UART_DATA_8_BITS,
@@ -30,68 +123,224 @@ esp_err_t SERIAL_init(void)
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
         .rx_flow_ctrl_thresh = 122,
     };
-    // Configure UART1 parameters
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_param_config(UART_NUM_1, &uart_config));
-    // Set UART1 pins(TX: IO17, RX: I018)
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(UART_NUM_1, ECHO_TEST_TXD, ECHO_TEST_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
-
-    // Install UART driver (we don't need an event queue here)
-    // tx buffer 0 so the tx time doesn't overlap with the job wait time
-    //  by returning before the job is written
-    return uart_driver_install(UART_NUM_1, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_param_config(port->uart, &uart_config));
+    // chain 0 is TX: IO17, RX: IO18, the second chain's pins come from the GPIO configuration
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(port->uart, port->tx_pin, port->rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+    // Install UART driver with an event queue so overflows and breaks are visible to the reader
+    // the tx ring buffer lets SERIAL_send return while the frame is still being shifted out,
+    // SERIAL_wait_tx_done tells the caller when the line is idle again
+    esp_err_t err = uart_driver_install(port->uart, BUF_SIZE * 2, BUF_SIZE * 2, UART_QUEUE_SIZE, &port->uart_queue, 0);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_rx_timeout(port->uart, RX_TIMEOUT_SYMBOLS));
+
+    return ESP_OK;
+    #endif
+}
+
+/// @brief raise the rx interrupt as soon as a full response is in the FIFO
+/// @param frame_length length of a single response from the ASIC
+esp_err_t SERIAL_set_rx_threshold(uint8_t chain, uint8_t frame_length)
+{
+    #if CONFIG_ASIC_EMULATOR
+    return ESP_OK;
+    #else
+    return uart_set_rx_full_threshold(ports[chain].uart, frame_length);
+    #endif
 }
 
-esp_err_t SERIAL_set_baud(int baud)
+esp_err_t SERIAL_set_baud(uint8_t chain, int baud)
 {
-    ESP_LOGI(TAG, "Changing UART baud to %i", baud);
+    ESP_LOGI(TAG, "Changing chain %u UART baud to %i", chain, baud);
 
+    #if !CONFIG_ASIC_EMULATOR
     // Make sure that we are done writing before setting a new baudrate.
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(UART_NUM_1, 1000 / portTICK_PERIOD_MS));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(ports[chain].uart, 1000 / portTICK_PERIOD_MS));
 
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(UART_NUM_1, baud));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(ports[chain].uart, baud));
+    #endif
 
     return ESP_OK;
 }
 
-int SERIAL_send(uint8_t *data, int len, bool debug)
+int SERIAL_send(uint8_t chain, uint8_t *data, int len, bool debug)
 {
     if (debug)
     {
-        printf("tx: ");
+        printf("tx%u: ", chain);
         prettyHex((unsigned char *)data, len);
         printf("\n");
     }
 
-    return uart_write_bytes(UART_NUM_1, (const char *)data, len);
+    #if CONFIG_ASIC_EMULATOR
+    serial_port * port = &ports[chain];
+    xSemaphoreTake(port->emulator_lock, portMAX_DELAY);
+    asic_emulator_write(&port->emulator, data, len);
+    xSemaphoreGive(port->emulator_lock);
+    return len;
+    #else
+    return uart_write_bytes(ports[chain].uart, (const char *)data, len);
+    #endif
+}
+
+#if !CONFIG_ASIC_EMULATOR
+static void _handle_event(serial_port * port, const uart_event_t * event)
+{
+    serial_stats * stats = &port->stats;
+
+    switch (event->type) {
+        case UART_DATA:
+            break;
+        case UART_FIFO_OVF:
+            // the driver resets the FIFO, the frame parser resynchronizes on what follows
+            stats->fifo_overflows++;
+            ESP_LOGW(TAG, "UART%d FIFO overflow (%" PRIu32 ")", port->uart, stats->fifo_overflows);
+            break;
+        case UART_BUFFER_FULL:
+            stats->buffer_full++;
+            ESP_LOGW(TAG, "UART%d ring buffer full (%" PRIu32 ")", port->uart, stats->buffer_full);
+            break;
+        case UART_BREAK:
+            stats->breaks++;
+            ESP_LOGD(TAG, "UART%d break (%" PRIu32 ")", port->uart, stats->breaks);
+            break;
+        case UART_FRAME_ERR:
+        case UART_PARITY_ERR:
+            stats->frame_errors++;
+            ESP_LOGD(TAG, "UART%d frame error (%" PRIu32 ")", port->uart, stats->frame_errors);
+            break;
+        default:
+            ESP_LOGD(TAG, "UART%d event type: %d", port->uart, event->type);
+            break;
+    }
+}
+#endif
+
+/// @brief frames a command or job, adds the crc for its type and queues it for transmission
+/// @return number of bytes queued, or -1 on error
+int SERIAL_send_packet(uint8_t chain, uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
+{
+    // built on the caller's stack, jobs and register writes are sent from different tasks
+    // and the driver copies the frame into its tx ring buffer before this returns
+    uint8_t buf[SERIAL_MAX_PACKET_LENGTH];
+
+    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
+    int total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
+
+    buf[0] = 0x55;
+    buf[1] = 0xAA;
+    buf[2] = header;
+    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
+    memcpy(buf + 4, data, data_len);
+
+    if (packet_type == JOB_PACKET) {
+        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
+        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
+        buf[5 + data_len] = crc16_total & 0xFF;
+        ports[chain].job_tx_start_us = esp_timer_get_time();
+    } else {
+        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    }
+
+    return SERIAL_send(chain, buf, total_length, debug);
+}
+
+/// @brief waits until everything queued by SERIAL_send has been shifted out
+/// @param timeout_ms number of ms to wait before timing out
+esp_err_t SERIAL_wait_tx_done(uint8_t chain, uint32_t timeout_ms)
+{
+    serial_port * port = &ports[chain];
+
+    #if CONFIG_ASIC_EMULATOR
+    esp_err_t err = ESP_OK;
+    #else
+    esp_err_t err = uart_wait_tx_done(port->uart, pdMS_TO_TICKS(timeout_ms));
+    #endif
+
+    if (err == ESP_OK && port->job_tx_start_us != 0) {
+        port->stats.job_tx_time_us = esp_timer_get_time() - port->job_tx_start_us;
+        port->job_tx_start_us = 0;
+    }
+
+    return err;
 }
 
 /// @brief waits for a serial response from the device
 /// @param buf buffer to read data into
-/// @param buf number of ms to wait before timing out
+/// @param size number of bytes to read
+/// @param timeout_ms number of ms to wait before timing out
 /// @return number of bytes read, or -1 on error
-int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+int16_t SERIAL_rx(uint8_t chain, uint8_t *buf, uint16_t size, uint16_t timeout_ms)
 {
-    int16_t bytes_read = uart_read_bytes(UART_NUM_1, buf, size, timeout_ms / portTICK_PERIOD_MS);
+    serial_port * port = &ports[chain];
+
+    #if CONFIG_ASIC_EMULATOR
+    return _emulator_rx(port, buf, size, timeout_ms);
+    #else
+
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout_ms);
+    int16_t bytes_read = 0;
+
+    while (bytes_read < size) {
+        // take every pending event off the queue on each pass, under steady traffic the buffer is rarely empty
+        // and a full queue would make the driver drop the overflow and break events counted here
+        uart_event_t event;
+        while (xQueueReceive(port->uart_queue, &event, 0) == pdTRUE) {
+            _handle_event(port, &event);
+        }
+
+        size_t available = 0;
+        uart_get_buffered_data_len(port->uart, &available);
+
+        if (available > 0) {
+            int len = uart_read_bytes(port->uart, buf + bytes_read, MIN(available, size - bytes_read), 0);
+            if (len < 0) {
+                return -1;
+            }
+            bytes_read += len;
+            continue;
+        }
+
+        // sleep until the driver reports new data or an error
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(deadline - now) <= 0) {
+            break;
+        }
+
+        if (xQueueReceive(port->uart_queue, &event, deadline - now) != pdTRUE) {
+            break;
+        }
+        _handle_event(port, &event);
+    }
 
     #if BM1397_SERIALRX_DEBUG || BM1366_SERIALRX_DEBUG || BM1368_SERIALRX_DEBUG
     size_t buff_len = 0;
     if (bytes_read > 0) {
-        uart_get_buffered_data_len(UART_NUM_1, &buff_len);
-        printf("rx: ");
+        uart_get_buffered_data_len(port->uart, &buff_len);
+        printf("rx%u: ", chain);
         prettyHex((unsigned char*) buf, bytes_read);
         printf(" [%d]\n", buff_len);
     }
     #endif
 
     return bytes_read;
+    #endif
 }
 
-void SERIAL_debug_rx(void)
+const serial_stats * SERIAL_get_stats(uint8_t chain)
+{
+    return &ports[chain].stats;
+}
+
+void SERIAL_debug_rx(uint8_t chain)
 {
     int ret;
     uint8_t buf[100];
 
-    ret = SERIAL_rx(buf, 100, 20);
+    ret = SERIAL_rx(chain, buf, 100, 20);
     if (ret < 0)
     {
         fprintf(stderr, "unable to read data\n");
@@ -101,7 +350,16 @@ void SERIAL_debug_rx(void)
     memset(buf, 0, 100);
 }
 
-void SERIAL_clear_buffer(void)
+void SERIAL_clear_buffer(uint8_t chain)
 {
-    uart_flush(UART_NUM_1);
+    serial_port * port = &ports[chain];
+
+    #if CONFIG_ASIC_EMULATOR
+    xSemaphoreTake(port->emulator_lock, portMAX_DELAY);
+    asic_emulator_clear(&port->emulator);
+    xSemaphoreGive(port->emulator_lock);
+    #else
+    uart_flush(port->uart);
+    xQueueReset(port->uart_queue);
+    #endif
 }
@@ -0,0 +1,186 @@
+#include "unity.h"
+
+#include <string.h>
+
+#include "asic_emulator.h"
+#include "bm1370.h"
+#include "bm1397.h"
+#include "crc.h"
+#include "mining.h"
+#include "serial.h"
+
+static asic_emulator emulator;
+
+static void send_command(uint8_t header, const uint8_t * data, uint8_t data_len)
+{
+    uint8_t frame[16] = {0x55, 0xAA, header, data_len + 3};
+    memcpy(frame + 4, data, data_len);
+    frame[4 + data_len] = crc5(frame + 2, data_len + 2);
+    asic_emulator_write(&emulator, frame, data_len + 5);
+}
+
+static void send_job(const uint8_t * data, uint8_t data_len)
+{
+    uint8_t frame[SERIAL_MAX_PACKET_LENGTH] = {0x55, 0xAA, 0x21, data_len + 4};
+    memcpy(frame + 4, data, data_len);
+    uint16_t crc = crc16_false(frame + 2, data_len + 2);
+    frame[4 + data_len] = crc >> 8;
+    frame[5 + data_len] = crc;
+    // split the frame the way a partially drained tx buffer would
+    asic_emulator_write(&emulator, frame, 7);
+    asic_emulator_write(&emulator, frame + 7, data_len - 1);
+}
+
+static bm_job make_job(void)
+{
+    mining_notify notify_message;
+    notify_message.prev_block_hash = "bf44fd3513dc7b837d60e5c628b572b448d204a8000007490000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705dd01;
+    notify_message.ntime = 0x64658bd8;
+    notify_message.difficulty = 1;
+    return construct_bm_job(&notify_message, "cd1be82132ef0d12053dcece1fa0247fcfdb61d4dbd3eb32ea9ef9b4c604a846", 0);
+}
+
+TEST_CASE("Emulated chain answers chip id reads and takes addresses", "[asic_emulator]")
+{
+    asic_emulator_config config = {.chip_id = 0x1370, .asic_count = 2, .zero_bits = 8, .hashrate = 1000};
+    asic_emulator_init(&emulator, &config);
+
+    uint8_t read_chip_id[7] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
+    asic_emulator_write(&emulator, read_chip_id, sizeof(read_chip_id));
+
+    uint8_t response[22];
+    TEST_ASSERT_EQUAL_INT(22, asic_emulator_read(&emulator, response, sizeof(response)));
+    for (int chip = 0; chip < 2; chip++) {
+        uint8_t * frame = response + chip * 11;
+        TEST_ASSERT_EQUAL_HEX8(0xAA, frame[0]);
+        TEST_ASSERT_EQUAL_HEX8(0x55, frame[1]);
+        TEST_ASSERT_EQUAL_HEX8(0x13, frame[2]);
+        TEST_ASSERT_EQUAL_HEX8(0x70, frame[3]);
+        TEST_ASSERT_EQUAL_HEX8(0x00, frame[5]);
+        TEST_ASSERT_EQUAL_HEX8(0x00, crc5(frame + 2, 9));
+        TEST_ASSERT_EQUAL_HEX8(0x00, frame[10] & 0x80);
+    }
+
+    uint8_t address0[2] = {0x00, 0x00};
+    uint8_t address1[2] = {0x80, 0x00};
+    send_command(0x40, address0, 2);
+    send_command(0x40, address1, 2);
+
+    asic_emulator_write(&emulator, read_chip_id, sizeof(read_chip_id));
+    TEST_ASSERT_EQUAL_INT(22, asic_emulator_read(&emulator, response, sizeof(response)));
+    TEST_ASSERT_EQUAL_HEX8(0x00, response[5]);
+    TEST_ASSERT_EQUAL_HEX8(0x80, response[11 + 5]);
+
+    // a single chip read only gets an answer from that chip
+    uint8_t read_pll[2] = {0x80, 0x08};
+    send_command(0x42, read_pll, 2);
+    TEST_ASSERT_EQUAL_INT(11, asic_emulator_read(&emulator, response, sizeof(response)));
+    TEST_ASSERT_EQUAL_HEX8(0x80, response[6]);
+    TEST_ASSERT_EQUAL_HEX8(0x08, response[7]);
+    TEST_ASSERT_EQUAL_HEX8(0x80, response[2] & 0x80);
+
+    // a corrupted command is dropped
+    uint8_t corrupted[7] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0B};
+    asic_emulator_write(&emulator, corrupted, sizeof(corrupted));
+    TEST_ASSERT_EQUAL_INT(0, asic_emulator_available(&emulator));
+    TEST_ASSERT_EQUAL_UINT32(1, emulator.stats.crc_errors);
+}
+
+TEST_CASE("Emulated BM1370 returns nonces that meet the ticket mask", "[asic_emulator]")
+{
+    asic_emulator_config config = {.chip_id = 0x1370, .asic_count = 1, .zero_bits = 8, .hashrate = 4096};
+    asic_emulator_init(&emulator, &config);
+
+    bm_job job = make_job();
+    BM1370_job packet;
+    packet.job_id = 24;
+    packet.num_midstates = 1;
+    memcpy(&packet.starting_nonce, &job.starting_nonce, 4);
+    memcpy(&packet.nbits, &job.target, 4);
+    memcpy(&packet.ntime, &job.ntime, 4);
+    memcpy(packet.merkle_root, job.merkle_root_be, 32);
+    memcpy(packet.prev_block_hash, job.prev_block_hash_be, 32);
+    memcpy(&packet.version, &job.version, 4);
+    send_job((uint8_t *) &packet, sizeof(packet));
+    TEST_ASSERT_EQUAL_UINT32(1, emulator.stats.jobs);
+
+    asic_emulator_run(&emulator, 1);
+    asic_emulator_run(&emulator, 1000001);
+    TEST_ASSERT_EQUAL_UINT64(4096, emulator.stats.hashes);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, emulator.stats.nonces);
+
+    uint8_t frame[11];
+    for (uint32_t i = 0; i < emulator.stats.nonces; i++) {
+        TEST_ASSERT_EQUAL_INT(11, asic_emulator_read(&emulator, frame, sizeof(frame)));
+        TEST_ASSERT_EQUAL_HEX8(0x00, crc5(frame + 2, 9));
+        TEST_ASSERT_EQUAL_HEX8(0x80, frame[10] & 0x80);
+        TEST_ASSERT_EQUAL_HEX8(24, (frame[7] & 0xf0) >> 1);
+
+        uint32_t nonce;
+        memcpy(&nonce, frame + 2, 4);
+        // 8 zero bits is a difficulty of 1/2^24
+        TEST_ASSERT_TRUE(test_nonce_value(&job, nonce, job.version) * (1 << 24) >= 0.99);
+    }
+    TEST_ASSERT_EQUAL_INT(0, asic_emulator_available(&emulator));
+}
+
+TEST_CASE("Emulated BM1397 hashes from the job midstate", "[asic_emulator]")
+{
+    asic_emulator_config config = {.chip_id = 0x1397, .asic_count = 1, .zero_bits = 8, .hashrate = 4096};
+    asic_emulator_init(&emulator, &config);
+
+    bm_job job = make_job();
+    job_packet packet;
+    packet.job_id = 8;
+    packet.num_midstates = 1;
+    memcpy(&packet.starting_nonce, &job.starting_nonce, 4);
+    memcpy(&packet.nbits, &job.target, 4);
+    memcpy(&packet.ntime, &job.ntime, 4);
+    memcpy(&packet.merkle4, job.merkle_root + 28, 4);
+    memcpy(packet.midstate, job.midstate, 32);
+    send_job((uint8_t *) &packet, 18 + 32);
+
+    asic_emulator_run(&emulator, 1);
+    asic_emulator_run(&emulator, 1000001);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, emulator.stats.nonces);
+
+    uint8_t frame[9];
+    for (uint32_t i = 0; i < emulator.stats.nonces; i++) {
+        TEST_ASSERT_EQUAL_INT(9, asic_emulator_read(&emulator, frame, sizeof(frame)));
+        TEST_ASSERT_EQUAL_HEX8(0x00, crc5(frame + 2, 7));
+        TEST_ASSERT_EQUAL_HEX8(8, frame[7] & 0xfc);
+
+        uint32_t nonce;
+        memcpy(&nonce, frame + 2, 4);
+        TEST_ASSERT_TRUE(test_nonce_value(&job, nonce, job.version) * (1 << 24) >= 0.99);
+    }
+}
+
+TEST_CASE("Emulated chain follows ticket mask writes", "[asic_emulator]")
+{
+    asic_emulator_config config = {.chip_id = 0x1366, .asic_count = 1, .zero_bits = 8, .hashrate = 1000};
+    asic_emulator_init(&emulator, &config);
+    TEST_ASSERT_EQUAL_UINT8(8, emulator.zero_bits);
+
+    // the default mask of 256 as the init scripts write it
+    uint8_t mask_256[6] = {0x00, 0x14, 0x00, 0x00, 0x00, 0xFF};
+    send_command(0x51, mask_256, 6);
+    TEST_ASSERT_EQUAL_UINT8(8, emulator.zero_bits);
+
+    // 1024 - 1 is 0x3FF, its second byte goes out bit reversed
+    uint8_t mask_1024[6] = {0x00, 0x14, 0x00, 0x00, 0xC0, 0xFF};
+    send_command(0x51, mask_1024, 6);
+    TEST_ASSERT_EQUAL_UINT8(10, emulator.zero_bits);
+
+    // 16 - 1 is 0x0F
+    uint8_t mask_16[6] = {0x00, 0x14, 0x00, 0x00, 0x00, 0xF0};
+    send_command(0x51, mask_16, 6);
+    TEST_ASSERT_EQUAL_UINT8(4, emulator.zero_bits);
+
+    // difficulty 1 cannot go below 0 zero bits
+    uint8_t mask_1[6] = {0x00, 0x14, 0x00, 0x00, 0x00, 0x00};
+    send_command(0x51, mask_1, 6);
+    TEST_ASSERT_EQUAL_UINT8(0, emulator.zero_bits);
+}
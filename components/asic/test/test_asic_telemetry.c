@@ -0,0 +1,63 @@
+#include "unity.h"
+
+#include "asic_telemetry.h"
+
+TEST_CASE("Telemetry decodes a register read response", "[asic_telemetry]")
+{
+    // BM1370 reply from chip 0x80 to a read of the nonce error counter
+    uint8_t frame[11] = {0xAA, 0x55, 0x00, 0x00, 0x01, 0x2C, 0x80, 0x4C, 0x00, 0x00, 0x00};
+    asic_register_response response;
+
+    TEST_ASSERT_TRUE(asic_telemetry_decode(frame, sizeof(frame), &response));
+    TEST_ASSERT_EQUAL_HEX32(0x0000012C, response.value);
+    TEST_ASSERT_EQUAL_HEX8(0x80, response.chip_address);
+    TEST_ASSERT_EQUAL_HEX8(ASIC_REG_NONCE_ERROR_COUNTER, response.register_address);
+}
+
+TEST_CASE("Telemetry files readings under the responding chip", "[asic_telemetry]")
+{
+    asic_telemetry_init(1, 2);
+
+    uint8_t pll_chip1[9] = {0xAA, 0x55, 0xC0, 0xA8, 0x02, 0x63, 0x80, ASIC_REG_PLL0_PARAMETER, 0x00};
+    uint8_t errors_chip0[9] = {0xAA, 0x55, 0x00, 0x00, 0x00, 0x07, 0x00, ASIC_REG_NONCE_ERROR_COUNTER, 0x00};
+
+    asic_telemetry_record(0, pll_chip1, sizeof(pll_chip1), 1000);
+    asic_telemetry_record(0, errors_chip0, sizeof(errors_chip0), 2000);
+
+    TEST_ASSERT_EQUAL_UINT16(2, asic_telemetry_chip_count());
+    TEST_ASSERT_TRUE(asic_telemetry_get(1)->seen);
+    TEST_ASSERT_TRUE(asic_telemetry_get(1)->pll_locked);
+    TEST_ASSERT_EQUAL_UINT32(0, asic_telemetry_get(1)->nonce_errors);
+    TEST_ASSERT_EQUAL_UINT32(7, asic_telemetry_get(0)->nonce_errors);
+    TEST_ASSERT_FALSE(asic_telemetry_get(0)->pll_locked);
+    TEST_ASSERT_NULL(asic_telemetry_get(2));
+}
+
+TEST_CASE("Telemetry ignores chip id reads and unknown chips", "[asic_telemetry]")
+{
+    asic_telemetry_init(1, 1);
+
+    uint8_t chip_id[11] = {0xAA, 0x55, 0x13, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    uint8_t stray[11] = {0xAA, 0x55, 0x00, 0x00, 0x00, 0x01, 0x80, ASIC_REG_NONCE_ERROR_COUNTER, 0x00, 0x00, 0x00};
+
+    asic_telemetry_record(0, chip_id, sizeof(chip_id), 1000);
+    TEST_ASSERT_FALSE(asic_telemetry_get(0)->seen);
+
+    // a single chip keeps address 0, everything else is a misparse
+    asic_telemetry_record(0, stray, sizeof(stray), 1000);
+    TEST_ASSERT_EQUAL_UINT32(0, asic_telemetry_get(0)->nonce_errors);
+}
+
+TEST_CASE("Telemetry keeps the chains apart", "[asic_telemetry]")
+{
+    asic_telemetry_init(2, 2);
+
+    uint8_t errors_chip1[9] = {0xAA, 0x55, 0x00, 0x00, 0x00, 0x03, 0x80, ASIC_REG_NONCE_ERROR_COUNTER, 0x00};
+
+    asic_telemetry_record(1, errors_chip1, sizeof(errors_chip1), 1000);
+
+    TEST_ASSERT_EQUAL_UINT16(4, asic_telemetry_chip_count());
+    TEST_ASSERT_FALSE(asic_telemetry_get(1)->seen);
+    TEST_ASSERT_TRUE(asic_telemetry_get(3)->seen);
+    TEST_ASSERT_EQUAL_UINT32(3, asic_telemetry_get(3)->nonce_errors);
+}
@@ -0,0 +1,91 @@
+#include "unity.h"
+
+#include "chain_watchdog.h"
+
+#define SECONDS(s) ((int64_t) (s) * 1000000)
+
+static chain_watchdog watchdog;
+
+// a job every 5 s, as the ASIC task would send them
+static void send_jobs(int64_t from_us, int64_t to_us)
+{
+    for (int64_t t = from_us; t <= to_us; t += SECONDS(5)) {
+        chain_watchdog_job_sent(&watchdog, t);
+    }
+}
+
+TEST_CASE("Chain watchdog timeout follows the expected nonce rate", "[chain_watchdog]")
+{
+    chain_watchdog_init(&watchdog, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, chain_watchdog_timeout_ms(&watchdog));
+
+    // 0.1 nonces per second should return 20 nonces in 200 s
+    watchdog.expected_rate = 0.1;
+    TEST_ASSERT_EQUAL_UINT32(200000, chain_watchdog_timeout_ms(&watchdog));
+
+    watchdog.expected_rate = 10;
+    TEST_ASSERT_EQUAL_UINT32(CHAIN_WATCHDOG_MIN_SILENCE_MS, chain_watchdog_timeout_ms(&watchdog));
+
+    watchdog.expected_rate = 0.001;
+    TEST_ASSERT_EQUAL_UINT32(CHAIN_WATCHDOG_MAX_SILENCE_MS, chain_watchdog_timeout_ms(&watchdog));
+}
+
+TEST_CASE("Chain watchdog only fires on a chain that gets work", "[chain_watchdog]")
+{
+    chain_watchdog_init(&watchdog, 0);
+    watchdog.expected_rate = 1;
+
+    // no work for a long time is not a stall
+    TEST_ASSERT_FALSE(chain_watchdog_stalled(&watchdog, SECONDS(300)));
+
+    // the silence starts with the first job after the idle spell
+    send_jobs(SECONDS(300), SECONDS(355));
+    TEST_ASSERT_FALSE(chain_watchdog_stalled(&watchdog, SECONDS(355)));
+
+    chain_watchdog_nonce(&watchdog, SECONDS(350));
+    send_jobs(SECONDS(360), SECONDS(410));
+    TEST_ASSERT_FALSE(chain_watchdog_stalled(&watchdog, SECONDS(410)));
+    TEST_ASSERT_TRUE(chain_watchdog_stalled(&watchdog, SECONDS(411)));
+
+    // work stopped, so did the nonces
+    TEST_ASSERT_FALSE(chain_watchdog_stalled(&watchdog, SECONDS(450)));
+}
+
+TEST_CASE("Chain watchdog backs off recoveries that don't bring nonces back", "[chain_watchdog]")
+{
+    chain_watchdog_init(&watchdog, 0);
+    watchdog.expected_rate = 1;
+
+    int64_t now = 0;
+    int64_t expected_backoff[] = {60, 120, 240};
+    for (int i = 0; i < 3; i++) {
+        chain_watchdog_recovered(&watchdog, now);
+        int64_t until = now + SECONDS(expected_backoff[i]);
+        send_jobs(now, until - SECONDS(1));
+        TEST_ASSERT_FALSE(chain_watchdog_stalled(&watchdog, until - SECONDS(1)));
+        send_jobs(until - SECONDS(1), until + SECONDS(1));
+        TEST_ASSERT_TRUE(chain_watchdog_stalled(&watchdog, until + SECONDS(1)));
+        now = until + SECONDS(1);
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, watchdog.recoveries);
+
+    // a nonce clears the backoff
+    chain_watchdog_nonce(&watchdog, now);
+    chain_watchdog_recovered(&watchdog, now);
+    TEST_ASSERT_EQUAL_INT64(now + SECONDS(60), watchdog.holdoff_until_us);
+}
+
+TEST_CASE("Chain recovery log keeps the most recent events", "[chain_watchdog]")
+{
+    chain_recovery_log log = {0};
+    TEST_ASSERT_NULL(chain_recovery_log_get(&log, 0));
+
+    for (int i = 0; i < CHAIN_RECOVERY_LOG_LENGTH + 3; i++) {
+        chain_recovery_event event = {.time_us = i, .chain = i % 2};
+        chain_recovery_log_add(&log, &event);
+    }
+
+    TEST_ASSERT_EQUAL_INT64(CHAIN_RECOVERY_LOG_LENGTH + 2, chain_recovery_log_get(&log, 0)->time_us);
+    TEST_ASSERT_EQUAL_INT64(3, chain_recovery_log_get(&log, CHAIN_RECOVERY_LOG_LENGTH - 1)->time_us);
+    TEST_ASSERT_NULL(chain_recovery_log_get(&log, CHAIN_RECOVERY_LOG_LENGTH));
+}
@@ -0,0 +1,77 @@
+#include "unity.h"
+
+#include <string.h>
+
+#include "esp_random.h"
+
+#include "crc.h"
+
+// bit serial shift register the table driven crc5 replaced
+static uint8_t reference_crc5(const uint8_t * data, uint8_t len)
+{
+    uint8_t crcin[5] = {1, 1, 1, 1, 1};
+    uint8_t crcout[5];
+
+    for (int i = 0; i < len * 8; i++) {
+        uint8_t din = (data[i / 8] & (0x80 >> (i % 8))) != 0;
+        crcout[0] = crcin[4] ^ din;
+        crcout[1] = crcin[0];
+        crcout[2] = crcin[1] ^ crcin[4] ^ din;
+        crcout[3] = crcin[2];
+        crcout[4] = crcin[3];
+        memcpy(crcin, crcout, 5);
+    }
+
+    return (crcin[4] << 4) | (crcin[3] << 3) | (crcin[2] << 2) | (crcin[1] << 1) | crcin[0];
+}
+
+// byte at a time crc16 the slice-by-4 version replaced
+static uint16_t reference_crc16(uint16_t crc, const uint8_t * data, uint16_t len)
+{
+    while (len-- > 0) {
+        crc ^= *data++ << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+TEST_CASE("crc5 matches known command frames", "[crc]")
+{
+    uint8_t read_chip_id[7] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
+    uint8_t write_a8[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03};
+    uint8_t write_3c[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x80, 0x20, 0x19};
+
+    TEST_ASSERT_EQUAL_HEX8(0x0A, crc5(read_chip_id + 2, 4));
+    TEST_ASSERT_EQUAL_HEX8(0x03, crc5(write_a8 + 2, 8));
+    TEST_ASSERT_EQUAL_HEX8(0x19, crc5(write_3c + 2, 8));
+}
+
+TEST_CASE("crc16 matches the CCITT check values", "[crc]")
+{
+    uint8_t check[] = "123456789";
+
+    TEST_ASSERT_EQUAL_HEX16(0x31C3, crc16(check, 9));
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16_false(check, 9));
+}
+
+TEST_CASE("crc kernels match the reference implementations", "[crc]")
+{
+    uint8_t data[160];
+
+    for (int round = 0; round < 200; round++) {
+        esp_fill_random(data, sizeof(data));
+        uint8_t len = esp_random() % sizeof(data);
+
+        TEST_ASSERT_EQUAL_HEX8(reference_crc5(data, len), crc5(data, len));
+        TEST_ASSERT_EQUAL_HEX16(reference_crc16(0, data, len), crc16(data, len));
+        TEST_ASSERT_EQUAL_HEX16(reference_crc16(0xFFFF, data, len), crc16_false(data, len));
+
+        uint8_t crc = 0x1F;
+        for (int i = 0; i < len; i++) {
+            crc = crc5_update(crc, data[i]);
+        }
+        TEST_ASSERT_EQUAL_HEX8(reference_crc5(data, len), crc);
+    }
+}
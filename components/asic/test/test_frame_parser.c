@@ -0,0 +1,146 @@
+#include "unity.h"
+
+#include <string.h>
+
+#include "crc.h"
+#include "frame_parser.h"
+
+#define BM1370_RESPONSE_LENGTH 11
+
+static frame_parser parser;
+
+// fills in the crc5 in the lower bits of the last byte, keeping the response type flag
+static void make_frame(uint8_t * frame, uint8_t len, uint8_t flags)
+{
+    for (uint8_t crc = 0; crc <= 0x1F; crc++) {
+        frame[len - 1] = flags | crc;
+        if (crc5(frame + 2, len - 2) == 0) {
+            return;
+        }
+    }
+    TEST_FAIL_MESSAGE("no valid crc5 found");
+}
+
+static void make_job_response(uint8_t * frame, uint32_t nonce)
+{
+    uint8_t response[BM1370_RESPONSE_LENGTH] = {0xAA, 0x55, nonce >> 24, nonce >> 16, nonce >> 8, nonce, 0x01, 0x18, 0x00, 0x04, 0};
+    memcpy(frame, response, sizeof(response));
+    make_frame(frame, BM1370_RESPONSE_LENGTH, FRAME_RESPONSE_JOB);
+}
+
+static void make_cmd_response(uint8_t * frame)
+{
+    uint8_t response[BM1370_RESPONSE_LENGTH] = {0xAA, 0x55, 0x13, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0};
+    memcpy(frame, response, sizeof(response));
+    make_frame(frame, BM1370_RESPONSE_LENGTH, 0x00);
+}
+
+// pushes a stream and returns the number of job responses, the last one is copied to last_job
+static int push_stream(const uint8_t * stream, int len, uint8_t * last_job)
+{
+    int jobs = 0;
+    for (int i = 0; i < len; i++) {
+        if (frame_parser_push(&parser, stream[i]) == FRAME_JOB_RESPONSE) {
+            memcpy(last_job, parser.buffer, BM1370_RESPONSE_LENGTH);
+            jobs++;
+        }
+    }
+    return jobs;
+}
+
+TEST_CASE("Frame parser accepts a clean job response", "[frame_parser]")
+{
+    frame_parser_init(&parser, BM1370_RESPONSE_LENGTH);
+    uint8_t frame[BM1370_RESPONSE_LENGTH];
+    uint8_t job[BM1370_RESPONSE_LENGTH];
+    make_job_response(frame, 0x12345678);
+
+    TEST_ASSERT_EQUAL_INT(1, push_stream(frame, sizeof(frame), job));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(frame, job, sizeof(frame));
+    TEST_ASSERT_EQUAL_UINT32(0, parser.stats.resyncs);
+    TEST_ASSERT_EQUAL_UINT32(0, parser.stats.bytes_discarded);
+}
+
+TEST_CASE("Frame parser skips garbage and a broken preamble", "[frame_parser]")
+{
+    frame_parser_init(&parser, BM1370_RESPONSE_LENGTH);
+    uint8_t stream[5 + BM1370_RESPONSE_LENGTH] = {0x00, 0x55, 0xAA, 0xAA, 0x12};
+    uint8_t job[BM1370_RESPONSE_LENGTH];
+    make_job_response(stream + 5, 0xdeadbeef);
+
+    TEST_ASSERT_EQUAL_INT(1, push_stream(stream, sizeof(stream), job));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(stream + 5, job, BM1370_RESPONSE_LENGTH);
+    TEST_ASSERT_EQUAL_UINT32(5, parser.stats.bytes_discarded);
+}
+
+TEST_CASE("Frame parser resyncs after a corrupted frame", "[frame_parser]")
+{
+    frame_parser_init(&parser, BM1370_RESPONSE_LENGTH);
+    uint8_t stream[2 * BM1370_RESPONSE_LENGTH];
+    uint8_t job[BM1370_RESPONSE_LENGTH];
+    make_job_response(stream, 0x11111111);
+    make_job_response(stream + BM1370_RESPONSE_LENGTH, 0x22222222);
+    stream[4] ^= 0x40;
+
+    TEST_ASSERT_EQUAL_INT(1, push_stream(stream, sizeof(stream), job));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(stream + BM1370_RESPONSE_LENGTH, job, BM1370_RESPONSE_LENGTH);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, parser.stats.resyncs);
+    TEST_ASSERT_EQUAL_UINT32(BM1370_RESPONSE_LENGTH, parser.stats.bytes_discarded);
+}
+
+TEST_CASE("Frame parser finds a frame inside a truncated one", "[frame_parser]")
+{
+    frame_parser_init(&parser, BM1370_RESPONSE_LENGTH);
+    // a response cut short by a glitch, directly followed by a complete one
+    uint8_t stream[4 + BM1370_RESPONSE_LENGTH];
+    uint8_t job[BM1370_RESPONSE_LENGTH];
+    make_job_response(stream + 4, 0xcafebabe);
+    stream[0] = 0xAA;
+    stream[1] = 0x55;
+    stream[2] = 0xca;
+    stream[3] = 0xfe;
+
+    TEST_ASSERT_EQUAL_INT(1, push_stream(stream, sizeof(stream), job));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(stream + 4, job, BM1370_RESPONSE_LENGTH);
+    TEST_ASSERT_EQUAL_UINT32(1, parser.stats.resyncs);
+    TEST_ASSERT_EQUAL_UINT32(4, parser.stats.bytes_discarded);
+}
+
+TEST_CASE("Frame parser separates command and job responses", "[frame_parser]")
+{
+    frame_parser_init(&parser, BM1370_RESPONSE_LENGTH);
+    uint8_t cmd[BM1370_RESPONSE_LENGTH];
+    uint8_t frame[BM1370_RESPONSE_LENGTH];
+    make_cmd_response(cmd);
+    make_job_response(frame, 0x0a4c049b);
+
+    frame_type_t last = FRAME_NONE;
+    for (int i = 0; i < BM1370_RESPONSE_LENGTH; i++) {
+        last = frame_parser_push(&parser, cmd[i]);
+    }
+    TEST_ASSERT_EQUAL(FRAME_CMD_RESPONSE, last);
+
+    for (int i = 0; i < BM1370_RESPONSE_LENGTH; i++) {
+        last = frame_parser_push(&parser, frame[i]);
+    }
+    TEST_ASSERT_EQUAL(FRAME_JOB_RESPONSE, last);
+    TEST_ASSERT_EQUAL_UINT32(2, parser.stats.frames);
+    TEST_ASSERT_EQUAL_UINT32(1, parser.stats.cmd_responses);
+}
+
+TEST_CASE("Frame parser never asks for bytes past the current frame", "[frame_parser]")
+{
+    frame_parser_init(&parser, BM1370_RESPONSE_LENGTH);
+    uint8_t frame[BM1370_RESPONSE_LENGTH];
+    make_job_response(frame, 0x01020304);
+
+    TEST_ASSERT_EQUAL_UINT8(BM1370_RESPONSE_LENGTH, frame_parser_bytes_needed(&parser));
+    for (int i = 0; i < 3; i++) {
+        frame_parser_push(&parser, frame[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT8(BM1370_RESPONSE_LENGTH - 3, frame_parser_bytes_needed(&parser));
+    for (int i = 3; i < BM1370_RESPONSE_LENGTH; i++) {
+        frame_parser_push(&parser, frame[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT8(BM1370_RESPONSE_LENGTH, frame_parser_bytes_needed(&parser));
+}
@@ -0,0 +1,134 @@
+#include "unity.h"
+
+#include "frequency_transition_bmXX.h"
+
+#define MAX_WRITES 256
+
+typedef struct
+{
+    int chip_address;
+    float frequency;
+} pll_write;
+
+static pll_write writes[MAX_WRITES];
+static int write_count;
+
+static void record_frequency(uint8_t chain, int chip_address, float frequency)
+{
+    if (write_count < MAX_WRITES) {
+        writes[write_count].chip_address = chip_address;
+        writes[write_count].frequency = frequency;
+    }
+    write_count++;
+}
+
+TEST_CASE("Frequency transition broadcasts while every chip follows the same ramp", "[frequency_transition]")
+{
+    frequency_transition_init(0, 2, 128, 56.25);
+    write_count = 0;
+
+    TEST_ASSERT_TRUE(do_frequency_transition(0, 75, record_frequency, 1370));
+
+    // 62.5, 68.75, 75 and the final write
+    TEST_ASSERT_EQUAL_INT(4, write_count);
+    for (int i = 0; i < write_count; i++) {
+        TEST_ASSERT_EQUAL_INT(FREQUENCY_ALL_CHIPS, writes[i].chip_address);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(62.5, writes[0].frequency);
+    TEST_ASSERT_EQUAL_FLOAT(75, writes[3].frequency);
+    TEST_ASSERT_EQUAL_FLOAT(75, frequency_transition_get(0, 0));
+    TEST_ASSERT_EQUAL_FLOAT(75, frequency_transition_get(0, 1));
+    TEST_ASSERT_EQUAL_FLOAT(0, frequency_transition_get(0, 2));
+}
+
+TEST_CASE("Frequency transition steps each chip to its own target", "[frequency_transition]")
+{
+    frequency_transition_init(1, 2, 128, 56.25);
+    write_count = 0;
+
+    float targets[FREQUENCY_TRANSITION_MAX_CHIPS] = {75, 62.5};
+    TEST_ASSERT_TRUE(do_frequency_transition_chips(1, targets, record_frequency, 1370));
+
+    // both chips step to 62.5 together, then only chip 0 moves on, the final writes address each chip
+    TEST_ASSERT_EQUAL_INT(FREQUENCY_ALL_CHIPS, writes[0].chip_address);
+    TEST_ASSERT_EQUAL_FLOAT(62.5, writes[0].frequency);
+    TEST_ASSERT_EQUAL_INT(0, writes[1].chip_address);
+    TEST_ASSERT_EQUAL_FLOAT(68.75, writes[1].frequency);
+    TEST_ASSERT_EQUAL_INT(0, writes[2].chip_address);
+    TEST_ASSERT_EQUAL_FLOAT(75, writes[2].frequency);
+    TEST_ASSERT_EQUAL_INT(0, writes[3].chip_address);
+    TEST_ASSERT_EQUAL_INT(128, writes[4].chip_address);
+    TEST_ASSERT_EQUAL_FLOAT(62.5, writes[4].frequency);
+    TEST_ASSERT_EQUAL_INT(5, write_count);
+
+    // an off-grid target is reached without overshooting it
+    write_count = 0;
+    targets[0] = 60;
+    targets[1] = 60;
+    TEST_ASSERT_TRUE(do_frequency_transition_chips(1, targets, record_frequency, 1370));
+    for (int i = 0; i < write_count; i++) {
+        TEST_ASSERT_TRUE(writes[i].frequency >= 60);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(60, frequency_transition_get(1, 0));
+    TEST_ASSERT_EQUAL_FLOAT(60, frequency_transition_get(1, 1));
+}
+
+static float monitor_droop_mv;
+static float monitor_ma_per_mhz;
+static int monitor_samples;
+
+// a supply that drops monitor_droop_mv below 1200 mV on every sample after a step up
+static bool fake_monitor(void * context, frequency_ramp_sample * sample)
+{
+    monitor_samples++;
+    float frequency = write_count > 0 ? writes[(write_count - 1) % MAX_WRITES].frequency : 56.25;
+    sample->voltage_mv = 1200 - monitor_droop_mv * (write_count % 2);
+    sample->current_ma = frequency * monitor_ma_per_mhz;
+    return true;
+}
+
+TEST_CASE("Frequency ramp grows its steps while the supply holds", "[frequency_transition]")
+{
+    frequency_transition_init(0, 1, 0, 56.25);
+    frequency_transition_set_monitor(fake_monitor, NULL);
+    monitor_droop_mv = 0;
+    monitor_ma_per_mhz = 10;
+    monitor_samples = 0;
+    write_count = 0;
+
+    TEST_ASSERT_TRUE(do_frequency_transition(0, 600, record_frequency, 1370));
+    TEST_ASSERT_EQUAL_FLOAT(600, frequency_transition_get(0, 0));
+    // 87 steps of 6.25 MHz without a monitor
+    TEST_ASSERT_LESS_THAN(20, write_count);
+    for (int i = 1; i < write_count; i++) {
+        TEST_ASSERT_TRUE(writes[i].frequency - writes[i - 1].frequency <= 50);
+    }
+    // a settled supply still waits 50 ms, five samples, on every step for the PLL to lock
+    TEST_ASSERT_GREATER_OR_EQUAL(1 + (write_count - 1) * 5, monitor_samples);
+
+    // a heavy load per MHz keeps the steps small
+    frequency_transition_init(0, 1, 0, 56.25);
+    monitor_ma_per_mhz = 400;
+    write_count = 0;
+    TEST_ASSERT_TRUE(do_frequency_transition(0, 300, record_frequency, 1370));
+    for (int i = 2; i < write_count; i++) {
+        TEST_ASSERT_TRUE(writes[i].frequency - writes[i - 1].frequency <= 6.25);
+    }
+
+    frequency_transition_set_monitor(NULL, NULL);
+}
+
+TEST_CASE("Frequency ramp keeps small steps while the supply droops", "[frequency_transition]")
+{
+    frequency_transition_init(0, 1, 0, 56.25);
+    frequency_transition_set_monitor(fake_monitor, NULL);
+    monitor_droop_mv = 40;
+    monitor_ma_per_mhz = 0;
+    write_count = 0;
+
+    TEST_ASSERT_TRUE(do_frequency_transition(0, 100, record_frequency, 1370));
+    // 62.5 .. 100 one grid step at a time and the final write
+    TEST_ASSERT_EQUAL_INT(8, write_count);
+
+    frequency_transition_set_monitor(NULL, NULL);
+}
@@ -0,0 +1,75 @@
+#include "unity.h"
+
+#include <string.h>
+
+#include "init_burst.h"
+
+static init_burst burst;
+
+TEST_CASE("Init burst frames commands like SERIAL_send_packet", "[init_burst]")
+{
+    init_burst_begin(&burst, 0, false);
+
+    init_burst_add_command(&burst, 0x52, (uint8_t[]){0x00, 0x00}, 2);
+    init_burst_add_command(&burst, 0x51, (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x80, 0x20}, 6);
+    init_burst_add_command(&burst, 0x40, (uint8_t[]){0x00, 0x00}, 2);
+
+    uint8_t expected[] = {
+        0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A,
+        0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x80, 0x20, 0x19,
+        0x55, 0xAA, 0x40, 0x05, 0x00, 0x00, 0x1C,
+    };
+    TEST_ASSERT_EQUAL_UINT16(sizeof(expected), burst.length);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, burst.buffer, sizeof(expected));
+    TEST_ASSERT_EQUAL_UINT16(3, burst.frames);
+    TEST_ASSERT_EQUAL_UINT16(0, burst.writes);
+}
+
+TEST_CASE("Init burst appends static scripts as is", "[init_burst]")
+{
+    static const init_frame script[] = {
+        {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03}},
+        {7, {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03}},
+    };
+    TEST_ASSERT_TRUE(init_script_valid(script, 2));
+
+    init_burst_begin(&burst, 0, false);
+    init_burst_add_script(&burst, script, 2);
+    init_burst_add_command(&burst, 0x51, (uint8_t[]){0x00, 0xA8, 0x00, 0x07, 0x00, 0x00}, 6);
+
+    TEST_ASSERT_EQUAL_UINT16(29, burst.length);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(script[0].bytes, burst.buffer, 11);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(script[1].bytes, burst.buffer + 11, 7);
+    // the precomputed frame and the one framed at runtime are the same bytes
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(script[0].bytes, burst.buffer + 18, 11);
+}
+
+TEST_CASE("Init script check catches a bad crc or length", "[init_burst]")
+{
+    init_frame frame = {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00, 0x12}};
+    TEST_ASSERT_TRUE(init_script_valid(&frame, 1));
+
+    frame.bytes[10] = 0x13;
+    TEST_ASSERT_FALSE(init_script_valid(&frame, 1));
+
+    frame.bytes[10] = 0x12;
+    frame.length = 7;
+    TEST_ASSERT_FALSE(init_script_valid(&frame, 1));
+}
+
+TEST_CASE("Init burst refuses a script with a bad frame", "[init_burst]")
+{
+    init_frame script[] = {
+        {7, {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03}},
+        {11, {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00, 0x13}},
+    };
+
+    init_burst_begin(&burst, 0, false);
+    TEST_ASSERT_FALSE(init_burst_add_script(&burst, script, 2));
+    TEST_ASSERT_EQUAL_UINT16(0, burst.length);
+    TEST_ASSERT_EQUAL_UINT16(0, burst.frames);
+
+    script[1].bytes[10] = 0x12;
+    TEST_ASSERT_TRUE(init_burst_add_script(&burst, script, 2));
+    TEST_ASSERT_EQUAL_UINT16(18, burst.length);
+}
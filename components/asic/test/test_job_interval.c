@@ -0,0 +1,84 @@
+#include "unity.h"
+
+#include "bm1366.h"
+#include "bm1370.h"
+#include "bm1397.h"
+#include "job_interval.h"
+
+TEST_CASE("Job interval counts versions from the mask", "[job_interval]")
+{
+    TEST_ASSERT_EQUAL_UINT32(1, job_interval_versions(0));
+    TEST_ASSERT_EQUAL_UINT32(2, job_interval_versions(0x00002000));
+    TEST_ASSERT_EQUAL_UINT32(65536, job_interval_versions(0x1fffe000));
+}
+
+TEST_CASE("Job interval without a nonce range setting splits 2^32 between the cores", "[job_interval]")
+{
+    job_interval_params params = {.frequency_mhz = 425, .small_core_count = BM1397_SMALL_CORE_COUNT, .asic_count = 1, .versions = 1};
+
+    // the formula the BM1397 used before the interval was derived
+    double expected = 4294967296.0 / (425.0 * BM1397_SMALL_CORE_COUNT * 1000);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, expected, job_interval_exhaustion_ms(&params));
+
+    params.versions = 4;
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, expected * 4 * JOB_INTERVAL_EXHAUSTION_SHARE, job_interval_ms(&params, 1.0));
+}
+
+TEST_CASE("Job interval follows frequency and the reg 0x10 nonce range", "[job_interval]")
+{
+    job_interval_params params = {
+        .frequency_mhz = 525,
+        .small_core_count = BM1370_SMALL_CORE_COUNT,
+        .asic_count = 1,
+        .versions = job_interval_versions(0x1fffe000),
+        .hash_counting_number = BM1370_HASH_COUNTING_NUMBER,
+    };
+
+    // every version takes hash_counting_number clocks
+    double expected = 65536.0 * BM1370_HASH_COUNTING_NUMBER / (525 * 1000.0);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, expected, job_interval_exhaustion_ms(&params));
+
+    // the nonce range per version and core stays the same with more chips on the chain
+    params.asic_count = 2;
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, expected, job_interval_exhaustion_ms(&params));
+
+    // twice the clock empties the job twice as fast
+    params.frequency_mhz = 1050;
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, expected / 2, job_interval_exhaustion_ms(&params));
+
+    // a nonce range past 2^32 is capped
+    params.hash_counting_number = 0xFFFFFFFF;
+    params.small_core_count = BM1366_SMALL_CORE_COUNT;
+    params.versions = 1;
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 4294967296.0 / (1050 * 1000.0 * BM1366_SMALL_CORE_COUNT * 2), job_interval_exhaustion_ms(&params));
+
+    TEST_ASSERT_EQUAL_DOUBLE(JOB_INTERVAL_MIN_MS, job_interval_ms(&params, 1.0));
+    params.frequency_mhz = 0;
+    TEST_ASSERT_EQUAL_DOUBLE(JOB_INTERVAL_MAX_MS, job_interval_ms(&params, 1.0));
+}
+
+TEST_CASE("Job interval trim shrinks on duplicates and stale shares and recovers", "[job_interval]")
+{
+    job_interval_trim trim;
+    job_interval_trim_init(&trim);
+
+    // too few nonces to judge, the window stays open
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, job_interval_trim_update(&trim, 10, 5, 10, 0));
+
+    TEST_ASSERT_EQUAL_DOUBLE(JOB_INTERVAL_TRIM_SHRINK, job_interval_trim_update(&trim, 1000, 50, 100, 0));
+    TEST_ASSERT_EQUAL_DOUBLE(JOB_INTERVAL_TRIM_SHRINK * JOB_INTERVAL_TRIM_SHRINK, job_interval_trim_update(&trim, 2000, 50, 200, 10));
+
+    for (int i = 0; i < 20; i++) {
+        job_interval_trim_update(&trim, 3000 + i * 1000, 100 + i * 100, 300 + i * 100, 10);
+    }
+    TEST_ASSERT_EQUAL_DOUBLE(JOB_INTERVAL_TRIM_MIN, trim.factor);
+
+    for (int i = 0; i < 100; i++) {
+        job_interval_trim_update(&trim, 30000 + i * 1000, 2000, 3000 + i * 100, 10);
+    }
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, trim.factor);
+
+    // counters reset on a pool failover only restart the window
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, job_interval_trim_update(&trim, 200000, 2000, 0, 0));
+    TEST_ASSERT_EQUAL_DOUBLE(1.0, job_interval_trim_update(&trim, 201000, 2000, 100, 0));
+}
@@ -0,0 +1,50 @@
+#include "unity.h"
+
+#include <math.h>
+
+#include "pll.h"
+
+static int searches;
+
+// fb / refdiv 1 / postdiv 1 * 1 with fb in 144..235, like the BM1366 range without the post dividers
+static bool fake_search(float target_frequency, pll_setting * setting)
+{
+    searches++;
+    int fb_divider = roundf(target_frequency / PLL_REFERENCE_MHZ * 4);
+    if (fb_divider < 144 || fb_divider > 235) {
+        return false;
+    }
+    setting->fb_divider = fb_divider;
+    setting->ref_divider = 1;
+    setting->post_divider1 = 2;
+    setting->post_divider2 = 2;
+    return true;
+}
+
+TEST_CASE("PLL table answers grid frequencies without searching", "[pll]")
+{
+    pll_table table;
+    searches = 0;
+    pll_table_init(&table, fake_search);
+    TEST_ASSERT_EQUAL_INT(PLL_TABLE_SIZE, searches);
+
+    searches = 0;
+    pll_setting setting;
+    TEST_ASSERT_TRUE(pll_table_lookup(&table, 1000, &setting));
+    TEST_ASSERT_EQUAL_UINT8(160, setting.fb_divider);
+    TEST_ASSERT_EQUAL_FLOAT(1000, pll_frequency(&setting));
+    TEST_ASSERT_EQUAL_INT(0, searches);
+
+    // below the divider range the table has no entry either
+    TEST_ASSERT_FALSE(pll_table_lookup(&table, 500, &setting));
+    TEST_ASSERT_EQUAL_INT(0, searches);
+
+    // off the grid falls back to the search
+    TEST_ASSERT_TRUE(pll_table_lookup(&table, 1003, &setting));
+    TEST_ASSERT_EQUAL_INT(1, searches);
+    TEST_ASSERT_EQUAL_FLOAT(1000, pll_frequency(&setting));
+
+    // above the table as well
+    TEST_ASSERT_TRUE(pll_table_lookup(&table, 1450, &setting));
+    TEST_ASSERT_EQUAL_INT(2, searches);
+}
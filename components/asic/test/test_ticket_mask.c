@@ -0,0 +1,97 @@
+#include "unity.h"
+
+#include "ticket_mask.h"
+
+static ticket_mask mask;
+
+static bool run_window(int64_t * now_us, uint32_t nonces, int64_t length_ms, uint32_t max_difficulty)
+{
+    for (uint32_t i = 0; i < nonces; i++) {
+        ticket_mask_record_nonce(&mask);
+    }
+    *now_us += length_ms * 1000;
+    return ticket_mask_update(&mask, *now_us, max_difficulty, 0);
+}
+
+TEST_CASE("Ticket mask moves by powers of two towards the target rate", "[ticket_mask]")
+{
+    int64_t now_us = 0;
+    ticket_mask_init(&mask, 256, 2.0, now_us);
+
+    // a window is only judged after the minimum time
+    TEST_ASSERT_FALSE(run_window(&now_us, 0, 1000, 0));
+
+    // 20 nonces per second is 10x the target, three doublings bring it to 2.5
+    TEST_ASSERT_TRUE(run_window(&now_us, 200, 9000, 0));
+    TEST_ASSERT_EQUAL_UINT32(2048, mask.difficulty);
+    TEST_ASSERT_EQUAL_DOUBLE(20.0, mask.rate);
+
+    // within a factor of two of the target nothing changes
+    TEST_ASSERT_FALSE(run_window(&now_us, 30, 10000, 0));
+    TEST_ASSERT_FALSE(run_window(&now_us, 12, 10000, 0));
+    TEST_ASSERT_EQUAL_UINT32(2048, mask.difficulty);
+
+    // a slow chain is judged after the maximum window even with few nonces
+    TEST_ASSERT_FALSE(run_window(&now_us, 20, 60000, 0));
+    TEST_ASSERT_TRUE(run_window(&now_us, 40, 60000, 0));
+    TEST_ASSERT_EQUAL_UINT32(1024, mask.difficulty);
+
+    // no nonces at all drops to the minimum
+    TEST_ASSERT_TRUE(run_window(&now_us, 0, TICKET_MASK_WINDOW_MAX_MS, 0));
+    TEST_ASSERT_EQUAL_UINT32(TICKET_MASK_MIN_DIFFICULTY, mask.difficulty);
+}
+
+TEST_CASE("Ticket mask stays at or below the pool difficulty", "[ticket_mask]")
+{
+    int64_t now_us = 0;
+    ticket_mask_init(&mask, 256, 2.0, now_us);
+
+    TEST_ASSERT_TRUE(run_window(&now_us, 2000, 10000, 1000));
+    TEST_ASSERT_EQUAL_UINT32(512, mask.difficulty);
+
+    // the pool lowering its difficulty pulls the mask down right away
+    TEST_ASSERT_TRUE(ticket_mask_update(&mask, now_us, 300, 0));
+    TEST_ASSERT_EQUAL_UINT32(256, mask.difficulty);
+
+    // below the minimum the pool difficulty still wins
+    TEST_ASSERT_TRUE(ticket_mask_update(&mask, now_us, 4, 0));
+    TEST_ASSERT_EQUAL_UINT32(4, mask.difficulty);
+    TEST_ASSERT_FALSE(run_window(&now_us, 0, TICKET_MASK_WINDOW_MAX_MS, 4));
+}
+
+TEST_CASE("Ticket mask credits nonces in flight with the lower mask", "[ticket_mask]")
+{
+    int64_t now_us = 0;
+    ticket_mask_init(&mask, 256, 2.0, now_us);
+
+    TEST_ASSERT_TRUE(run_window(&now_us, 100, 10000, 0));
+    TEST_ASSERT_EQUAL_UINT32(1024, mask.difficulty);
+    TEST_ASSERT_EQUAL_UINT32(256, ticket_mask_difficulty_at(&mask, now_us + 100000));
+    TEST_ASSERT_EQUAL_UINT32(1024, ticket_mask_difficulty_at(&mask, now_us + TICKET_MASK_SETTLE_MS * 1000));
+
+    // lowering the mask takes effect at once, every nonce found before it meets the new one anyway
+    TEST_ASSERT_TRUE(run_window(&now_us, 0, TICKET_MASK_WINDOW_MAX_MS, 0));
+    TEST_ASSERT_EQUAL_UINT32(TICKET_MASK_MIN_DIFFICULTY, ticket_mask_difficulty_at(&mask, now_us));
+}
+
+TEST_CASE("Ticket mask keeps the nonce rate under the limit", "[ticket_mask]")
+{
+    int64_t now_us = 0;
+    ticket_mask_init(&mask, 256, 20.0, now_us);
+
+    // 6.4 nonces per second is well under the target, but halving the mask would pass the limit of 10
+    for (int i = 0; i < 64; i++) {
+        ticket_mask_record_nonce(&mask);
+    }
+    now_us += 10000000;
+    TEST_ASSERT_FALSE(ticket_mask_update(&mask, now_us, 0, 10));
+    TEST_ASSERT_EQUAL_UINT32(256, mask.difficulty);
+
+    // 25 nonces per second is within the band around the target, but over the limit
+    for (int i = 0; i < 250; i++) {
+        ticket_mask_record_nonce(&mask);
+    }
+    now_us += 10000000;
+    TEST_ASSERT_TRUE(ticket_mask_update(&mask, now_us, 0, 10));
+    TEST_ASSERT_EQUAL_UINT32(1024, mask.difficulty);
+}
@@ -0,0 +1,95 @@
+#include "ticket_mask.h"
+
+#include <math.h>
+
+static uint32_t _power_of_two_at_most(uint32_t value)
+{
+    uint32_t power = 1;
+    while (power <= value / 2) {
+        power <<= 1;
+    }
+    return power;
+}
+
+static void _restart_window(ticket_mask * mask, int64_t now_us)
+{
+    mask->window_start_us = now_us;
+    mask->window_nonces = 0;
+}
+
+static void _change(ticket_mask * mask, uint32_t difficulty, int64_t now_us)
+{
+    mask->previous_difficulty = mask->difficulty;
+    mask->difficulty = difficulty;
+    mask->changed_us = now_us;
+    _restart_window(mask, now_us);
+}
+
+void ticket_mask_init(ticket_mask * mask, uint32_t difficulty, double target_rate, int64_t now_us)
+{
+    mask->difficulty = difficulty;
+    mask->previous_difficulty = difficulty;
+    mask->changed_us = now_us;
+    mask->target_rate = target_rate;
+    mask->rate = 0;
+    _restart_window(mask, now_us);
+}
+
+uint32_t ticket_mask_difficulty_at(const ticket_mask * mask, int64_t now_us)
+{
+    if (now_us - mask->changed_us < TICKET_MASK_SETTLE_MS * 1000LL && mask->previous_difficulty < mask->difficulty) {
+        return mask->previous_difficulty;
+    }
+    return mask->difficulty;
+}
+
+void ticket_mask_record_nonce(ticket_mask * mask)
+{
+    mask->window_nonces++;
+}
+
+bool ticket_mask_update(ticket_mask * mask, int64_t now_us, uint32_t max_difficulty, double max_rate)
+{
+    uint32_t ceiling = TICKET_MASK_MAX_DIFFICULTY;
+    if (max_difficulty != 0 && max_difficulty < ceiling) {
+        ceiling = _power_of_two_at_most(max_difficulty);
+    }
+    // a pool difficulty below the minimum still wins, shares must never be masked out
+    uint32_t floor = ceiling < TICKET_MASK_MIN_DIFFICULTY ? ceiling : TICKET_MASK_MIN_DIFFICULTY;
+
+    if (mask->difficulty > ceiling) {
+        _change(mask, ceiling, now_us);
+        return true;
+    }
+
+    int64_t elapsed_us = now_us - mask->window_start_us;
+    if (mask->target_rate <= 0 || elapsed_us < TICKET_MASK_WINDOW_MIN_MS * 1000LL) {
+        return false;
+    }
+    if (mask->window_nonces < TICKET_MASK_WINDOW_NONCES && elapsed_us < TICKET_MASK_WINDOW_MAX_MS * 1000LL) {
+        return false;
+    }
+
+    mask->rate = mask->window_nonces / (elapsed_us / 1e6);
+    _restart_window(mask, now_us);
+
+    // the band is wider than one step, so a change never overshoots into the opposite correction
+    double ratio = mask->rate / mask->target_rate;
+    // ratio at which the rate would pass max_rate
+    double limit = max_rate > 0 ? max_rate / mask->target_rate : INFINITY;
+    uint32_t difficulty = mask->difficulty;
+    while ((ratio > TICKET_MASK_HYSTERESIS || ratio > limit) && difficulty < ceiling) {
+        difficulty <<= 1;
+        ratio /= 2;
+    }
+    while (ratio < 1 / TICKET_MASK_HYSTERESIS && ratio * 2 <= limit && difficulty > floor) {
+        difficulty >>= 1;
+        ratio *= 2;
+    }
+
+    if (difficulty == mask->difficulty) {
+        return false;
+    }
+    _change(mask, difficulty, now_us);
+    return true;
+}
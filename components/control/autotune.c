@@ -0,0 +1,278 @@
+#include "autotune.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static bool _settle(autotune * tuner, int64_t now_ms)
+{
+    tuner->state = AUTOTUNE_SETTLING;
+    tuner->start_ms = now_ms;
+    return true;
+}
+
+static bool _done(autotune * tuner)
+{
+    tuner->state = AUTOTUNE_DONE;
+    return true;
+}
+
+static bool _next_voltage(autotune * tuner, int64_t now_ms, bool over_power)
+{
+    // nothing held within the power limit, a higher voltage only draws more
+    if (over_power && tuner->stable_frequency == 0) {
+        return _done(tuner);
+    }
+
+    // lower clocks at a higher voltage cost power for hashrate already found, pick up above the best one so far
+    uint16_t frequency = tuner->stable_frequency == 0 ? tuner->frequency : tuner->stable_frequency + tuner->limits.frequency_step;
+
+    tuner->voltage += tuner->limits.voltage_step;
+    if (tuner->voltage > tuner->limits.max_voltage || frequency > tuner->limits.max_frequency) {
+        return _done(tuner);
+    }
+
+    tuner->frequency = frequency;
+    tuner->stable_frequency = 0;
+    return _settle(tuner, now_ms);
+}
+
+void autotune_start(autotune * tuner, const autotune_limits * limits, int64_t now_ms)
+{
+    tuner->limits = *limits;
+    tuner->frequency = limits->min_frequency;
+    tuner->voltage = limits->min_voltage;
+    tuner->stable_frequency = 0;
+    tuner->count = 0;
+    tuner->derated = false;
+    _settle(tuner, now_ms);
+}
+
+bool autotune_derated(autotune * tuner, int64_t now_ms)
+{
+    if (tuner->state == AUTOTUNE_DONE) {
+        return false;
+    }
+
+    if (!tuner->derated) {
+        tuner->derated = true;
+        tuner->derated_ms = now_ms;
+    }
+    if (now_ms - tuner->derated_ms >= AUTOTUNE_MAX_DWELL_MS) {
+        tuner->derated = false;
+        return _next_voltage(tuner, now_ms, true);
+    }
+
+    // nothing measured at a lower frequency says anything about the setpoint
+    _settle(tuner, now_ms);
+    return false;
+}
+
+bool autotune_sample(autotune * tuner, int64_t now_ms, const autotune_counters * counters, float power)
+{
+    switch (tuner->state) {
+        case AUTOTUNE_SETTLING:
+            if (now_ms - tuner->start_ms < AUTOTUNE_SETTLE_MS) {
+                return false;
+            }
+            // a derate restarts the settling, a point that gets this far is no longer held down
+            tuner->derated = false;
+            tuner->state = AUTOTUNE_MEASURING;
+            tuner->start_ms = now_ms;
+            tuner->start = *counters;
+            tuner->power_sum = 0;
+            tuner->power_samples = 0;
+            return false;
+        case AUTOTUNE_MEASURING:
+            break;
+        default:
+            return false;
+    }
+
+    tuner->power_sum += power;
+    tuner->power_samples++;
+    double power_avg = tuner->power_sum / tuner->power_samples;
+    if (tuner->power_samples >= AUTOTUNE_POWER_SAMPLES && power_avg > tuner->limits.max_power) {
+        return _next_voltage(tuner, now_ms, true);
+    }
+
+    int64_t elapsed_ms = now_ms - tuner->start_ms;
+    uint64_t nonces = counters->nonces - tuner->start.nonces;
+
+    // without a single nonce there is no telling the chips from a pool that sends no work, measure again
+    if (nonces == 0 && elapsed_ms >= AUTOTUNE_MAX_DWELL_MS) {
+        tuner->state = AUTOTUNE_SETTLING;
+        tuner->start_ms = now_ms - AUTOTUNE_SETTLE_MS;
+        return false;
+    }
+    if (elapsed_ms < AUTOTUNE_MIN_DWELL_MS || (nonces < AUTOTUNE_NONCES && elapsed_ms < AUTOTUNE_MAX_DWELL_MS)) {
+        return false;
+    }
+
+    double difficulty = counters->difficulty_sum - tuner->start.difficulty_sum;
+    double hw_error_difficulty = counters->hw_error_difficulty_sum - tuner->start.hw_error_difficulty_sum;
+    double hw_error_rate = difficulty + hw_error_difficulty > 0 ? hw_error_difficulty / (difficulty + hw_error_difficulty) : 0;
+    // a chain reset clears the chip counters, that measurement has nothing to say about them
+    uint64_t chip_errors = counters->chip_errors >= tuner->start.chip_errors ? counters->chip_errors - tuner->start.chip_errors : 0;
+    double chip_error_rate = (double) chip_errors / (nonces + chip_errors);
+
+    autotune_point point = {
+        .frequency = tuner->frequency,
+        .voltage = tuner->voltage,
+        .hashrate = difficulty * 4294967296.0 / (elapsed_ms / 1000.0) / 1e9,
+        .power = power_avg,
+    };
+
+    // errors or missing hashrate mean the chips can't keep up at this voltage
+    if (hw_error_rate > AUTOTUNE_MAX_HW_ERROR_RATE || chip_error_rate > AUTOTUNE_MAX_HW_ERROR_RATE || counters->unlocked_chips > 0 ||
+        point.hashrate < tuner->frequency * tuner->limits.hashrate_per_mhz * AUTOTUNE_MIN_HASHRATE_RATIO) {
+        return _next_voltage(tuner, now_ms, false);
+    }
+
+    if (tuner->count < AUTOTUNE_MAX_POINTS) {
+        tuner->points[tuner->count++] = point;
+    }
+    tuner->stable_frequency = tuner->frequency;
+
+    if (tuner->frequency + tuner->limits.frequency_step > tuner->limits.max_frequency) {
+        return _next_voltage(tuner, now_ms, false);
+    }
+    tuner->frequency += tuner->limits.frequency_step;
+    return _settle(tuner, now_ms);
+}
+
+float autotune_efficiency(const autotune_point * point)
+{
+    if (point->hashrate <= 0) {
+        return INFINITY;
+    }
+    return point->power / (point->hashrate / 1000.0);
+}
+
+uint8_t autotune_pareto(const autotune_point * points, uint8_t count, autotune_point * curve)
+{
+    autotune_point sorted[AUTOTUNE_MAX_POINTS];
+    if (count > AUTOTUNE_MAX_POINTS) {
+        count = AUTOTUNE_MAX_POINTS;
+    }
+
+    // by rising hashrate
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1].hashrate > points[i].hashrate) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = points[i];
+    }
+
+    // from the top down a point stays when it is more efficient than everything faster
+    uint8_t kept = 0;
+    float best = INFINITY;
+    for (int i = count - 1; i >= 0; i--) {
+        float efficiency = autotune_efficiency(&sorted[i]);
+        if (efficiency < best) {
+            best = efficiency;
+            kept++;
+            curve[count - kept] = sorted[i];
+        }
+    }
+
+    for (uint8_t i = 0; i < kept; i++) {
+        curve[i] = curve[count - kept + i];
+    }
+    return kept;
+}
+
+const autotune_point * autotune_select(const autotune_point * curve, uint8_t count, autotune_objective objective, float power_cap)
+{
+    const autotune_point * selected = NULL;
+
+    for (uint8_t i = 0; i < count; i++) {
+        const autotune_point * point = &curve[i];
+        switch (objective) {
+            case AUTOTUNE_MAX_HASHRATE:
+                if (selected == NULL || point->hashrate > selected->hashrate) {
+                    selected = point;
+                }
+                break;
+            case AUTOTUNE_BEST_EFFICIENCY:
+                if (selected == NULL || autotune_efficiency(point) < autotune_efficiency(selected)) {
+                    selected = point;
+                }
+                break;
+            case AUTOTUNE_POWER_CAP:
+                // the fastest point under the cap, the most frugal one when none fits
+                if (selected == NULL ||
+                    (point->power <= power_cap && (selected->power > power_cap || point->hashrate > selected->hashrate)) ||
+                    (point->power > power_cap && selected->power > power_cap && point->power < selected->power)) {
+                    selected = point;
+                }
+                break;
+            default:
+                return NULL;
+        }
+    }
+    return selected;
+}
+
+uint16_t autotune_voltage_for(const autotune_point * curve, uint8_t count, uint16_t frequency)
+{
+    const autotune_point * found = NULL;
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (curve[i].frequency >= frequency && (found == NULL || curve[i].frequency < found->frequency)) {
+            found = &curve[i];
+        }
+    }
+    return found == NULL ? 0 : found->voltage;
+}
+
+void autotune_curve_format(const autotune_point * curve, uint8_t count, char * buffer, size_t size)
+{
+    size_t length = 0;
+    buffer[0] = '\0';
+
+    for (uint8_t i = 0; i < count; i++) {
+        int written = snprintf(buffer + length, size - length, "%s%u:%u:%.1f:%.2f", i == 0 ? "" : ",",
+                               curve[i].frequency, curve[i].voltage, curve[i].hashrate, curve[i].power);
+        // a point that doesn't fit is left out whole
+        if (written < 0 || (size_t) written >= size - length) {
+            buffer[length] = '\0';
+            return;
+        }
+        length += written;
+    }
+}
+
+uint8_t autotune_curve_parse(const char * text, autotune_point * curve, uint8_t max_count)
+{
+    uint8_t count = 0;
+    const char * p = text;
+
+    while (p != NULL && *p != '\0' && count < max_count) {
+        char * end;
+        autotune_point point;
+
+        point.frequency = strtoul(p, &end, 10);
+        if (*end != ':') {
+            break;
+        }
+        point.voltage = strtoul(end + 1, &end, 10);
+        if (*end != ':') {
+            break;
+        }
+        point.hashrate = strtof(end + 1, &end);
+        if (*end != ':') {
+            break;
+        }
+        point.power = strtof(end + 1, &end);
+        if (*end != ',' && *end != '\0') {
+            break;
+        }
+
+        curve[count++] = point;
+        p = *end == ',' ? end + 1 : NULL;
+    }
+    return count;
+}
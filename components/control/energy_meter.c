@@ -0,0 +1,132 @@
+#include "energy_meter.h"
+
+#include <string.h>
+
+static const uint32_t periods_s[ENERGY_WINDOWS] = {60, 15 * 60, 60 * 60};
+
+// moves the ring up to the bucket of now, clearing the ones it passes, and returns that bucket
+static energy_bucket * _ring_at(energy_ring * ring, int64_t now_ms)
+{
+    int64_t bucket = now_ms / ring->bucket_ms;
+
+    if (ring->bucket < 0) {
+        memset(ring->buckets, 0, sizeof(ring->buckets));
+        ring->bucket = bucket;
+    }
+    // a reading from before the newest bucket still counts, in the newest bucket
+    for (int cleared = 0; ring->bucket < bucket; cleared++) {
+        ring->bucket++;
+        if (cleared < ENERGY_WINDOW_BUCKETS) {
+            memset(&ring->buckets[ring->bucket % ENERGY_WINDOW_BUCKETS], 0, sizeof(energy_bucket));
+        } else {
+            ring->bucket = bucket;
+        }
+    }
+    return &ring->buckets[ring->bucket % ENERGY_WINDOW_BUCKETS];
+}
+
+void energy_meter_init(energy_meter * meter, double total_wh, int64_t now_ms)
+{
+    memset(meter, 0, sizeof(*meter));
+    meter->total_wh = total_wh;
+    meter->checkpoint_wh = total_wh;
+    meter->checkpoint_ms = now_ms;
+    meter->first_ms = now_ms;
+
+    for (int length = 0; length < ENERGY_WINDOWS; length++) {
+        meter->rings[length].bucket_ms = periods_s[length] * 1000 / ENERGY_WINDOW_BUCKETS;
+        meter->rings[length].bucket = -1;
+    }
+}
+
+void energy_meter_add_power(energy_meter * meter, int64_t now_ms, float power)
+{
+    int64_t dt_ms = now_ms - meter->last_ms;
+
+    if (meter->powered && dt_ms > 0 && dt_ms <= ENERGY_MAX_SAMPLE_GAP_MS) {
+        // trapezoid between the two readings
+        double joules = (meter->last_power + power) / 2.0 * dt_ms / 1000.0;
+        meter->total_wh += joules / 3600.0;
+        meter->session_wh += joules / 3600.0;
+        for (int length = 0; length < ENERGY_WINDOWS; length++) {
+            _ring_at(&meter->rings[length], now_ms)->joules += joules;
+        }
+    }
+
+    meter->last_ms = now_ms;
+    meter->last_power = power;
+    meter->powered = true;
+}
+
+void energy_meter_add_work(energy_meter * meter, int64_t now_ms, double difficulty, uint64_t shares)
+{
+    if (meter->counted) {
+        double difficulty_added = difficulty >= meter->last_difficulty ? difficulty - meter->last_difficulty : difficulty;
+        uint64_t shares_added = shares >= meter->last_shares ? shares - meter->last_shares : shares;
+        for (int length = 0; length < ENERGY_WINDOWS; length++) {
+            energy_bucket * bucket = _ring_at(&meter->rings[length], now_ms);
+            bucket->difficulty += difficulty_added;
+            bucket->shares += shares_added;
+        }
+    }
+
+    meter->last_difficulty = difficulty;
+    meter->last_shares = shares;
+    meter->counted = true;
+}
+
+void energy_meter_window(const energy_meter * meter, energy_window_length length, int64_t now_ms, energy_window * window)
+{
+    const energy_ring * ring = &meter->rings[length];
+    int64_t now_bucket = now_ms / ring->bucket_ms;
+    // the oldest bucket still in the window, the current one is partly filled
+    int64_t oldest = now_bucket - ENERGY_WINDOW_BUCKETS + 1;
+    double joules = 0;
+    double difficulty = 0;
+    uint32_t shares = 0;
+
+    memset(window, 0, sizeof(*window));
+    window->period_s = periods_s[length];
+
+    if (ring->bucket >= 0) {
+        for (int i = 0; i < ENERGY_WINDOW_BUCKETS; i++) {
+            int64_t bucket = ring->bucket - i;
+            if (bucket < oldest || bucket > now_bucket) {
+                continue;
+            }
+            const energy_bucket * data = &ring->buckets[bucket % ENERGY_WINDOW_BUCKETS];
+            joules += data->joules;
+            difficulty += data->difficulty;
+            shares += data->shares;
+        }
+    }
+
+    int64_t start_ms = oldest * ring->bucket_ms;
+    if (start_ms < meter->first_ms) {
+        start_ms = meter->first_ms;
+    }
+    window->covered_s = (now_ms - start_ms) / 1000.0;
+    if (window->covered_s <= 0) {
+        return;
+    }
+
+    double terahashes = difficulty * 4294967296.0 / 1e12;
+    window->energy_wh = joules / 3600.0;
+    window->power = joules / window->covered_s;
+    window->hashrate = terahashes * 1000.0 / window->covered_s;
+    window->shares = shares;
+    window->joules_per_th = terahashes > 0 ? joules / terahashes : 0;
+    window->joules_per_share = shares > 0 ? joules / shares : 0;
+}
+
+bool energy_meter_checkpoint_due(const energy_meter * meter, int64_t now_ms)
+{
+    return meter->total_wh - meter->checkpoint_wh >= ENERGY_CHECKPOINT_MIN_WH &&
+           now_ms - meter->checkpoint_ms >= ENERGY_CHECKPOINT_INTERVAL_MS;
+}
+
+void energy_meter_checkpointed(energy_meter * meter, int64_t now_ms)
+{
+    meter->checkpoint_wh = meter->total_wh;
+    meter->checkpoint_ms = now_ms;
+}
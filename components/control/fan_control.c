@@ -0,0 +1,177 @@
+#include "fan_control.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static float _clamp(float value, float min, float max)
+{
+    if (value < min) {
+        return min;
+    }
+    if (value > max) {
+        return max;
+    }
+    return value;
+}
+
+void fan_controller_init(fan_controller * controller, const fan_gains * gains, float min_output, float max_output, float output)
+{
+    controller->gains = *gains;
+    controller->min_output = min_output;
+    controller->max_output = max_output;
+    controller->output = _clamp(output, min_output, max_output);
+    controller->integral = controller->output;
+    controller->derivative = 0;
+    controller->primed = false;
+}
+
+float fan_controller_update(fan_controller * controller, float temperature, float setpoint, float power, float dt_s)
+{
+    const fan_gains * gains = &controller->gains;
+
+    if (!controller->primed) {
+        controller->temperature = temperature;
+        controller->power_average = power;
+        controller->primed = true;
+    } else if (dt_s > 0) {
+        float previous = controller->temperature;
+        controller->temperature += (temperature - controller->temperature) * FAN_CONTROL_DERIVATIVE_FILTER;
+        controller->derivative = (controller->temperature - previous) / dt_s;
+
+        float period_s = gains->period_s > dt_s ? gains->period_s : dt_s;
+        controller->power_average += (power - controller->power_average) * dt_s / period_s;
+    } else {
+        return controller->output;
+    }
+
+    // a power step shows up on the fan right away and fades as the temperature catches up with it
+    float error = temperature - setpoint;
+    float feed_forward = gains->kff * (power - controller->power_average);
+    float proportional = gains->kp * error + gains->kd * controller->derivative + feed_forward;
+
+    float integral = _clamp(controller->integral + gains->ki * error * dt_s, controller->min_output, controller->max_output);
+    float output = proportional + integral;
+    // the integral doesn't wind up against a limit the output already sits on
+    if ((output > controller->max_output && error > 0) || (output < controller->min_output && error < 0)) {
+        integral = controller->integral;
+        output = proportional + integral;
+    }
+
+    controller->integral = integral;
+    controller->output = _clamp(output, controller->min_output, controller->max_output);
+    return controller->output;
+}
+
+void fan_autotune_start(fan_autotune * tuner, float setpoint, float output, float min_output, float max_output, int64_t now_ms)
+{
+    float center = _clamp(output, min_output + FAN_AUTOTUNE_AMPLITUDE, max_output - FAN_AUTOTUNE_AMPLITUDE);
+
+    tuner->state = FAN_AUTOTUNE_RUNNING;
+    tuner->setpoint = setpoint;
+    tuner->low = _clamp(center - FAN_AUTOTUNE_AMPLITUDE, min_output, max_output);
+    tuner->high = _clamp(center + FAN_AUTOTUNE_AMPLITUDE, min_output, max_output);
+    tuner->output_high = false;
+    tuner->start_ms = now_ms;
+    tuner->cycle_start_ms = now_ms;
+    tuner->temperature_max = -INFINITY;
+    tuner->temperature_min = INFINITY;
+    tuner->cycles = 0;
+    tuner->period_sum_s = 0;
+    tuner->amplitude_sum = 0;
+}
+
+float fan_autotune_update(fan_autotune * tuner, float temperature, int64_t now_ms)
+{
+    if (tuner->state != FAN_AUTOTUNE_RUNNING) {
+        return tuner->output_high ? tuner->high : tuner->low;
+    }
+
+    // a board that never crosses the setpoint both ways can't be tuned at it
+    if (now_ms - tuner->start_ms > FAN_AUTOTUNE_TIMEOUT_MS) {
+        tuner->state = FAN_AUTOTUNE_FAILED;
+        return tuner->high;
+    }
+
+    if (temperature > tuner->temperature_max) {
+        tuner->temperature_max = temperature;
+    }
+    if (temperature < tuner->temperature_min) {
+        tuner->temperature_min = temperature;
+    }
+
+    if (!tuner->output_high && temperature > tuner->setpoint + FAN_AUTOTUNE_HYSTERESIS) {
+        tuner->output_high = true;
+
+        // every switch to high after the first closes a cycle, the first cycle is left out
+        if (tuner->cycles >= 2) {
+            tuner->period_sum_s += (now_ms - tuner->cycle_start_ms) / 1000.0;
+            tuner->amplitude_sum += (tuner->temperature_max - tuner->temperature_min) / 2;
+        }
+        tuner->cycles++;
+        tuner->cycle_start_ms = now_ms;
+        tuner->temperature_max = temperature;
+        tuner->temperature_min = temperature;
+
+        if (tuner->cycles >= FAN_AUTOTUNE_CYCLES + 2) {
+            tuner->state = FAN_AUTOTUNE_DONE;
+        }
+    } else if (tuner->output_high && temperature < tuner->setpoint - FAN_AUTOTUNE_HYSTERESIS) {
+        tuner->output_high = false;
+    }
+
+    return tuner->output_high ? tuner->high : tuner->low;
+}
+
+bool fan_autotune_gains(const fan_autotune * tuner, fan_gains * gains)
+{
+    if (tuner->state != FAN_AUTOTUNE_DONE) {
+        return false;
+    }
+
+    float amplitude = tuner->amplitude_sum / FAN_AUTOTUNE_CYCLES;
+    float period_s = tuner->period_sum_s / FAN_AUTOTUNE_CYCLES;
+    if (amplitude <= FAN_AUTOTUNE_HYSTERESIS || period_s <= 0) {
+        return false;
+    }
+
+    // describing function of a relay with hysteresis gives the ultimate gain, Tyreus-Luyben turns it and
+    // the period into gains that overshoot less than Ziegler-Nichols, the fan is loud when it does
+    float relay = (tuner->high - tuner->low) / 2;
+    float ultimate_gain = 4 * relay / (M_PI * sqrtf(amplitude * amplitude - FAN_AUTOTUNE_HYSTERESIS * FAN_AUTOTUNE_HYSTERESIS));
+    float integral_time = 2.2 * period_s;
+    float derivative_time = period_s / 6.3;
+
+    gains->kp = ultimate_gain / 3.2;
+    gains->ki = gains->kp / integral_time;
+    gains->kd = gains->kp * derivative_time;
+    gains->period_s = period_s;
+    return true;
+}
+
+void fan_gains_format(const fan_gains * gains, char * buffer, size_t size)
+{
+    snprintf(buffer, size, "%.3f:%.4f:%.3f:%.3f:%.1f", gains->kp, gains->ki, gains->kd, gains->kff, gains->period_s);
+}
+
+bool fan_gains_parse(const char * text, fan_gains * gains)
+{
+    float values[5];
+    const char * p = text;
+
+    for (int i = 0; i < 5; i++) {
+        char * end;
+        values[i] = strtof(p, &end);
+        if (end == p || *end != (i < 4 ? ':' : '\0')) {
+            return false;
+        }
+        p = end + 1;
+    }
+
+    gains->kp = values[0];
+    gains->ki = values[1];
+    gains->kd = values[2];
+    gains->kff = values[3];
+    gains->period_s = values[4];
+    return true;
+}
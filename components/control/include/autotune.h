@@ -0,0 +1,130 @@
+#ifndef AUTOTUNE_H_
+#define AUTOTUNE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// a new setpoint runs this long before it is measured, the PLL ramp and the temperature settle first
+#define AUTOTUNE_SETTLE_MS 30000
+
+// the hashrate estimate from n nonces is off by 1/sqrt(n), 400 nonces measure a point to 5%,
+// a slow setup stops at the maximum dwell with what it has
+#define AUTOTUNE_NONCES 400
+#define AUTOTUNE_MIN_DWELL_MS 60000
+#define AUTOTUNE_MAX_DWELL_MS 600000
+
+// a point holds when no more than this share of the work is hardware errors, on the host or counted
+// by the chips, every PLL stays locked and the hashrate reaches this share of what the frequency promises
+#define AUTOTUNE_MAX_HW_ERROR_RATE 0.01
+#define AUTOTUNE_MIN_HASHRATE_RATIO 0.85
+
+// readings averaged before a setpoint is dropped for drawing too much power
+#define AUTOTUNE_POWER_SAMPLES 3
+
+#define AUTOTUNE_MAX_POINTS 64
+
+typedef enum
+{
+    AUTOTUNE_OFF = 0,
+    AUTOTUNE_MAX_HASHRATE,
+    AUTOTUNE_BEST_EFFICIENCY,
+    AUTOTUNE_POWER_CAP,
+} autotune_objective;
+
+typedef enum
+{
+    AUTOTUNE_SETTLING,
+    AUTOTUNE_MEASURING,
+    AUTOTUNE_DONE,
+} autotune_state;
+
+typedef struct
+{
+    uint16_t frequency;
+    uint16_t voltage;
+    // GH/s
+    float hashrate;
+    // W
+    float power;
+} autotune_point;
+
+typedef struct
+{
+    uint16_t min_frequency;
+    uint16_t max_frequency;
+    uint16_t frequency_step;
+    uint16_t min_voltage;
+    uint16_t max_voltage;
+    uint16_t voltage_step;
+    float max_power;
+    // GH/s one MHz is worth on all chips together
+    double hashrate_per_mhz;
+} autotune_limits;
+
+// running totals as kept by SYSTEM_notify_found_nonce, and what the register telemetry of the chips reports
+typedef struct
+{
+    uint64_t nonces;
+    double difficulty_sum;
+    double hw_error_difficulty_sum;
+    // nonce error counters of all chips added up, they count errors the host never sees
+    uint64_t chip_errors;
+    // chips that read their PLL unlocked
+    uint16_t unlocked_chips;
+} autotune_counters;
+
+typedef struct
+{
+    autotune_limits limits;
+    autotune_state state;
+
+    // setpoint being measured
+    uint16_t frequency;
+    uint16_t voltage;
+    // highest frequency that held at the current voltage, 0 for none yet
+    uint16_t stable_frequency;
+
+    int64_t start_ms;
+    autotune_counters start;
+    // a derate has held the chips below the setpoint since derated_ms
+    bool derated;
+    int64_t derated_ms;
+    double power_sum;
+    uint32_t power_samples;
+
+    autotune_point points[AUTOTUNE_MAX_POINTS];
+    uint8_t count;
+} autotune;
+
+/// @brief starts a sweep at the lowest voltage and frequency
+void autotune_start(autotune * tuner, const autotune_limits * limits, int64_t now_ms);
+
+/// @brief feeds one reading, true when the tuner moved to a new setpoint or finished
+bool autotune_sample(autotune * tuner, int64_t now_ms, const autotune_counters * counters, float power);
+
+/// @brief in place of autotune_sample while a derate keeps the chips off the setpoint, the point is measured
+/// again once it lifts, a point it holds down for the maximum dwell counts as one the board can't run
+/// @return true when the tuner moved to a new setpoint or finished
+bool autotune_derated(autotune * tuner, int64_t now_ms);
+
+/// @brief J/TH of a point
+float autotune_efficiency(const autotune_point * point);
+
+/// @brief the points no other point beats on both hashrate and J/TH, by rising hashrate, returns how many
+/// curve needs room for count points
+uint8_t autotune_pareto(const autotune_point * points, uint8_t count, autotune_point * curve);
+
+/// @brief the curve point that meets the objective, NULL for an empty curve
+const autotune_point * autotune_select(const autotune_point * curve, uint8_t count, autotune_objective objective, float power_cap);
+
+/// @brief voltage of the slowest curve point at or above frequency, it held more than that, 0 when none does
+uint16_t autotune_voltage_for(const autotune_point * curve, uint8_t count, uint16_t frequency);
+
+/// @brief writes the curve as comma separated frequency:voltage:hashrate:power entries
+void autotune_curve_format(const autotune_point * curve, uint8_t count, char * buffer, size_t size);
+
+/// @brief reads a curve written by autotune_curve_format, returns how many points it holds
+uint8_t autotune_curve_parse(const char * text, autotune_point * curve, uint8_t max_count);
+
+#endif /* AUTOTUNE_H_ */
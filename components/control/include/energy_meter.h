@@ -0,0 +1,96 @@
+#ifndef ENERGY_METER_H_
+#define ENERGY_METER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// rolling windows of one minute, fifteen minutes and an hour, each made of this many buckets
+#define ENERGY_WINDOW_BUCKETS 12
+
+// the counter goes to flash once this much energy came in and this long has passed, at most 96 writes a day
+#define ENERGY_CHECKPOINT_MIN_WH 1.0
+#define ENERGY_CHECKPOINT_INTERVAL_MS (15 * 60 * 1000)
+
+// a gap between power samples longer than this is not integrated, the task was held off or the clock jumped
+#define ENERGY_MAX_SAMPLE_GAP_MS 10000
+
+typedef enum
+{
+    ENERGY_WINDOW_MINUTE,
+    ENERGY_WINDOW_QUARTER,
+    ENERGY_WINDOW_HOUR,
+    ENERGY_WINDOWS,
+} energy_window_length;
+
+typedef struct
+{
+    double joules;
+    // ticket mask difficulty of the valid nonces, 2^32 hashes each
+    double difficulty;
+    uint32_t shares;
+} energy_bucket;
+
+typedef struct
+{
+    uint32_t bucket_ms;
+    // bucket number of the newest bucket, -1 before the first sample
+    int64_t bucket;
+    energy_bucket buckets[ENERGY_WINDOW_BUCKETS];
+} energy_ring;
+
+typedef struct
+{
+    // lifetime counter, the checkpoint it was restored from plus everything since
+    double total_wh;
+    double session_wh;
+    double checkpoint_wh;
+    int64_t checkpoint_ms;
+
+    int64_t first_ms;
+    int64_t last_ms;
+    float last_power;
+    bool powered;
+
+    // the work counters are cumulative, the meter keeps the last value it saw
+    double last_difficulty;
+    uint64_t last_shares;
+    bool counted;
+
+    energy_ring rings[ENERGY_WINDOWS];
+} energy_meter;
+
+typedef struct
+{
+    uint32_t period_s;
+    // part of the window with data, shorter than the period right after boot
+    float covered_s;
+    double energy_wh;
+    // W
+    float power;
+    // GH/s
+    float hashrate;
+    uint32_t shares;
+    // 0 without work or shares in the window
+    float joules_per_th;
+    float joules_per_share;
+} energy_window;
+
+/// @brief starts the meter from the lifetime total of the last checkpoint
+void energy_meter_init(energy_meter * meter, double total_wh, int64_t now_ms);
+
+/// @brief integrates a power reading in W since the previous one
+void energy_meter_add_power(energy_meter * meter, int64_t now_ms, float power);
+
+/// @brief takes the cumulative nonce difficulty and accepted share counters, a counter that went down was reset
+void energy_meter_add_work(energy_meter * meter, int64_t now_ms, double difficulty, uint64_t shares);
+
+/// @brief energy, hashrate and efficiency over one of the rolling windows
+void energy_meter_window(const energy_meter * meter, energy_window_length length, int64_t now_ms, energy_window * window);
+
+/// @brief true when the lifetime counter should be written to flash
+bool energy_meter_checkpoint_due(const energy_meter * meter, int64_t now_ms);
+
+/// @brief records that total_wh was written
+void energy_meter_checkpointed(energy_meter * meter, int64_t now_ms);
+
+#endif /* ENERGY_METER_H_ */
@@ -0,0 +1,100 @@
+#ifndef FAN_CONTROL_H_
+#define FAN_CONTROL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// the gains the fan ran on before the relay test, per °C, per °C·s and °C/s
+#define FAN_CONTROL_DEFAULT_KP 4.0
+#define FAN_CONTROL_DEFAULT_KI 0.2
+#define FAN_CONTROL_DEFAULT_KD 3.0
+// fan percent per W the power moved off its recent average
+#define FAN_CONTROL_DEFAULT_KFF 1.0
+#define FAN_CONTROL_DEFAULT_PERIOD_S 120.0
+
+// the derivative is taken from a smoothed temperature, the sensor steps in 0.125 °C
+#define FAN_CONTROL_DERIVATIVE_FILTER 0.2
+
+// the relay swings the fan this far either side of where it was, the hysteresis keeps sensor noise
+// from flipping it
+#define FAN_AUTOTUNE_AMPLITUDE 20.0
+#define FAN_AUTOTUNE_HYSTERESIS 0.5
+// the first cycle is still the approach to the setpoint, the ones after it are averaged
+#define FAN_AUTOTUNE_CYCLES 4
+#define FAN_AUTOTUNE_TIMEOUT_MS (30 * 60000)
+
+typedef struct
+{
+    float kp;
+    float ki;
+    float kd;
+    float kff;
+    // oscillation period the relay test found, the feed-forward fades out over it
+    float period_s;
+} fan_gains;
+
+typedef struct
+{
+    fan_gains gains;
+    float min_output;
+    float max_output;
+
+    float integral;
+    float temperature;
+    float derivative;
+    // slow average of the power, the feed-forward acts on the difference to it
+    float power_average;
+    bool primed;
+    float output;
+} fan_controller;
+
+typedef enum
+{
+    FAN_AUTOTUNE_RUNNING,
+    FAN_AUTOTUNE_DONE,
+    FAN_AUTOTUNE_FAILED,
+} fan_autotune_state;
+
+typedef struct
+{
+    fan_autotune_state state;
+    float setpoint;
+    float low;
+    float high;
+    bool output_high;
+
+    int64_t start_ms;
+    // when the fan last went high, a cycle runs from one of those to the next
+    int64_t cycle_start_ms;
+    float temperature_max;
+    float temperature_min;
+
+    // cycles seen, the first one isn't measured
+    uint8_t cycles;
+    float period_sum_s;
+    float amplitude_sum;
+} fan_autotune;
+
+/// @brief starts the controller at output so the handover from a fixed speed doesn't bump the fan
+void fan_controller_init(fan_controller * controller, const fan_gains * gains, float min_output, float max_output, float output);
+
+/// @brief fan percent for the temperature and power, dt_s is the time since the last update
+float fan_controller_update(fan_controller * controller, float temperature, float setpoint, float power, float dt_s);
+
+/// @brief starts a relay test around setpoint that swings the fan around output
+void fan_autotune_start(fan_autotune * tuner, float setpoint, float output, float min_output, float max_output, int64_t now_ms);
+
+/// @brief feeds one reading, returns the fan percent to run
+float fan_autotune_update(fan_autotune * tuner, float temperature, int64_t now_ms);
+
+/// @brief gains from a finished test, the feed-forward gain is kept from gains, false unless the test is done
+bool fan_autotune_gains(const fan_autotune * tuner, fan_gains * gains);
+
+/// @brief writes the gains as kp:ki:kd:kff:period
+void fan_gains_format(const fan_gains * gains, char * buffer, size_t size);
+
+/// @brief reads gains written by fan_gains_format, false and gains untouched when text isn't that
+bool fan_gains_parse(const char * text, fan_gains * gains);
+
+#endif /* FAN_CONTROL_H_ */
@@ -0,0 +1,47 @@
+#ifndef POWER_CAP_H_
+#define POWER_CAP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// frequency moves per step period, down fast enough to get under a breaker's limit within a few seconds,
+// up slowly, the ramp in between still goes through the PLL in small steps
+#define POWER_CAP_MAX_STEP_DOWN 50.0
+#define POWER_CAP_MAX_STEP_UP 12.5
+
+// the power loop's poll, updates coming in faster share the steps, a longer wait doesn't add to them
+#define POWER_CAP_STEP_PERIOD_MS 1800
+
+// below the target by less than this the frequency holds, every change costs a ramp
+#define POWER_CAP_DEADBAND 1.0
+
+// fraction of the estimated correction applied per update, power follows frequency with a lag
+#define POWER_CAP_GAIN_DOWN 0.8
+#define POWER_CAP_GAIN_UP 0.5
+
+// weight of a new reading in the filtered power, an overshoot is acted on unfiltered
+#define POWER_CAP_FILTER 0.3
+
+// the controller never takes the chips below this share of the configured frequency
+#define POWER_CAP_MIN_FREQUENCY_RATIO 0.5
+
+typedef struct
+{
+    // W, 0 while the cap is off
+    float target;
+    // MHz the controller currently allows
+    float frequency;
+    // filtered W
+    float power;
+    // the time from here to now is the step left to take
+    int64_t step_ms;
+} power_cap;
+
+void power_cap_init(power_cap * cap, float target, float frequency);
+
+/// @brief moves the allowed frequency towards the power target, never above max_frequency,
+/// true when it changed
+/// @param power W measured with the chips at applied_frequency, below the allowed one while derated
+bool power_cap_update(power_cap * cap, float power, float applied_frequency, float max_frequency, int64_t now_ms);
+
+#endif /* POWER_CAP_H_ */
@@ -0,0 +1,65 @@
+#ifndef POWER_PROFILE_H_
+#define POWER_PROFILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// letters, digits, '-' and '_', the stored text uses ':' and ','
+#define POWER_PROFILE_NAME_LENGTH 16
+#define POWER_PROFILE_MAX_COUNT 8
+#define POWER_SCHEDULE_MAX_ENTRIES 16
+
+#define POWER_SCHEDULE_MINUTES_PER_DAY (24 * 60)
+#define POWER_SCHEDULE_MINUTES_PER_WEEK (7 * POWER_SCHEDULE_MINUTES_PER_DAY)
+
+// a setting the profile leaves as it is, an empty field in the stored text
+#define POWER_PROFILE_UNSET UINT16_MAX
+
+// a named operating point, a power cap of 0 turns the cap off, a frequency, voltage or temperature of 0
+// is no setting and is left alone like an unset one
+typedef struct
+{
+    char name[POWER_PROFILE_NAME_LENGTH];
+    // MHz
+    uint16_t frequency;
+    // mV
+    uint16_t voltage;
+    // chip temperature the fan holds, C
+    uint16_t temp_target;
+    // W
+    uint16_t power_cap;
+} power_profile;
+
+// the profile starts at the minute of the day on every day in the mask and holds until the next entry
+typedef struct
+{
+    // bit 0 is Sunday, as tm_wday
+    uint8_t days;
+    uint16_t minute;
+    char profile[POWER_PROFILE_NAME_LENGTH];
+} power_schedule_entry;
+
+bool power_profile_name_valid(const char * name);
+
+/// @brief profiles as "name:frequency:voltage:temp_target:power_cap,...", unset settings empty, a profile that
+/// doesn't fit is left out
+void power_profiles_format(const power_profile * profiles, uint8_t count, char * buffer, size_t size);
+
+/// @brief reads what power_profiles_format wrote, stops at the first malformed profile, returns the count
+uint8_t power_profiles_parse(const char * text, power_profile * profiles, uint8_t max_count);
+
+/// @brief entries as "days:minute:profile,...", an entry that doesn't fit is left out
+void power_schedule_format(const power_schedule_entry * entries, uint8_t count, char * buffer, size_t size);
+
+/// @brief reads what power_schedule_format wrote, stops at the first malformed entry, returns the count
+uint8_t power_schedule_parse(const char * text, power_schedule_entry * entries, uint8_t max_count);
+
+/// @brief the entry in force at a minute of the week, 0 is Sunday 00:00, the last start before it
+/// wrapping around the week, -1 without entries
+int power_schedule_active(const power_schedule_entry * entries, uint8_t count, uint16_t week_minute);
+
+/// @brief the profile with the name, NULL when there is none
+const power_profile * power_profile_find(const power_profile * profiles, uint8_t count, const char * name);
+
+#endif /* POWER_PROFILE_H_ */
@@ -0,0 +1,86 @@
+#ifndef SAMPLE_HISTORY_H_
+#define SAMPLE_HISTORY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// slots kept at each resolution, two minutes of seconds, two hours of minutes and three days of hours
+#define SAMPLE_HISTORY_SECONDS 120
+#define SAMPLE_HISTORY_MINUTES 120
+#define SAMPLE_HISTORY_HOURS 72
+
+typedef enum
+{
+    SAMPLE_VOLTAGE,
+    SAMPLE_CURRENT,
+    SAMPLE_POWER,
+    SAMPLE_VR_TEMP,
+    SAMPLE_CHIP_TEMP,
+    SAMPLE_FAN_RPM,
+    SAMPLE_CHANNELS,
+} sample_channel;
+
+typedef enum
+{
+    SAMPLE_RESOLUTION_SECOND,
+    SAMPLE_RESOLUTION_MINUTE,
+    SAMPLE_RESOLUTION_HOUR,
+    SAMPLE_RESOLUTIONS,
+} sample_resolution;
+
+typedef struct
+{
+    float min;
+    float max;
+    float mean;
+} sample_stat;
+
+typedef struct
+{
+    // uptime at the start of the slot
+    uint32_t start_s;
+    // samples that went into it
+    uint32_t count;
+    sample_stat channels[SAMPLE_CHANNELS];
+} sample_slot;
+
+typedef struct
+{
+    uint32_t period_s;
+    uint16_t length;
+    sample_slot * slots;
+    // next slot to write and how many hold data
+    uint16_t head;
+    uint16_t count;
+
+    // the slot being filled, not in slots until its period is over
+    bool open;
+    uint32_t bucket;
+    sample_slot current;
+    double sums[SAMPLE_CHANNELS];
+} sample_ring;
+
+// about 25 KB, meant for PSRAM
+typedef struct
+{
+    sample_ring rings[SAMPLE_RESOLUTIONS];
+    sample_slot seconds[SAMPLE_HISTORY_SECONDS];
+    sample_slot minutes[SAMPLE_HISTORY_MINUTES];
+    sample_slot hours[SAMPLE_HISTORY_HOURS];
+} sample_history;
+
+void sample_history_init(sample_history * history);
+
+/// @brief adds one reading of every channel, a finished second goes on into the minute and the hour
+void sample_history_add(sample_history * history, int64_t now_ms, const float values[SAMPLE_CHANNELS]);
+
+/// @brief slots held at a resolution
+uint16_t sample_history_count(const sample_history * history, sample_resolution resolution);
+
+/// @brief slot at a resolution, 0 is the oldest, NULL past the end
+const sample_slot * sample_history_get(const sample_history * history, sample_resolution resolution, uint16_t index);
+
+/// @brief seconds a slot at the resolution covers
+uint32_t sample_history_period_s(sample_resolution resolution);
+
+#endif /* SAMPLE_HISTORY_H_ */
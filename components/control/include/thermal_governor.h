@@ -0,0 +1,57 @@
+#ifndef THERMAL_GOVERNOR_H_
+#define THERMAL_GOVERNOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// every step takes this share off the frequency, down to at most half
+#define THERMAL_DERATE_STEP 0.1
+#define THERMAL_MAX_DERATE_STEPS 5
+
+// a step has this long to show in the temperature before the next one
+#define THERMAL_STEP_INTERVAL_MS 15000
+
+// a step is given back once both temperatures stayed this far under their throttle point for the recovery time
+#define THERMAL_HYSTERESIS 5.0
+#define THERMAL_RECOVER_MS 60000
+
+typedef enum
+{
+    THERMAL_NORMAL,
+    THERMAL_DERATING,
+    THERMAL_HOLDING,
+    THERMAL_RECOVERING,
+    // past the absolute limit, only cutting the core voltage helps
+    THERMAL_RUNAWAY,
+} thermal_stage;
+
+typedef struct
+{
+    float chip_throttle;
+    float chip_max;
+    float vr_throttle;
+    float vr_max;
+} thermal_limits;
+
+typedef struct
+{
+    thermal_limits limits;
+    thermal_stage stage;
+    uint8_t steps;
+    int64_t changed_ms;
+    // -1 while not cool enough to recover
+    int64_t cool_since_ms;
+} thermal_governor;
+
+void thermal_governor_init(thermal_governor * governor, const thermal_limits * limits);
+
+/// @brief moves the derate by a step on a new reading, a chip temperature below 0 is an invalid reading,
+/// true when the derate changed or the governor just hit runaway
+bool thermal_governor_update(thermal_governor * governor, float chip_temp, float vr_temp, int64_t now_ms);
+
+/// @brief the frequency the current derate allows
+float thermal_governor_frequency(const thermal_governor * governor, float frequency);
+
+const char * thermal_governor_stage_name(thermal_stage stage);
+
+#endif /* THERMAL_GOVERNOR_H_ */
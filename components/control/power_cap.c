@@ -0,0 +1,78 @@
+#include "power_cap.h"
+
+#include <math.h>
+
+void power_cap_init(power_cap * cap, float target, float frequency)
+{
+    cap->target = target;
+    cap->frequency = frequency;
+    cap->power = 0;
+    cap->step_ms = 0;
+}
+
+bool power_cap_update(power_cap * cap, float power, float applied_frequency, float max_frequency, int64_t now_ms)
+{
+    float min_frequency = max_frequency * POWER_CAP_MIN_FREQUENCY_RATIO;
+    float frequency = cap->frequency;
+
+    if (cap->target <= 0 || frequency > max_frequency) {
+        frequency = max_frequency;
+    }
+    if (frequency < min_frequency) {
+        frequency = min_frequency;
+    }
+
+    cap->power = cap->power <= 0 ? power : cap->power + POWER_CAP_FILTER * (power - cap->power);
+
+    if (cap->target > 0 && power > 0) {
+        float measured = power > cap->target ? power : cap->power;
+        float error = cap->target - measured;
+        // the power was drawn at the applied frequency, a derate on top of the cap holds it lower
+        float running = applied_frequency > 0 && applied_frequency < frequency ? applied_frequency : frequency;
+
+        // room left under a derate isn't room at the allowed frequency, it holds until the derate lifts
+        if (error < 0 || (error > POWER_CAP_DEADBAND && running == frequency)) {
+            // the steps are per step period however often the loop is woken, time not spent on a move
+            // carries over, up to one period
+            if (now_ms - cap->step_ms > POWER_CAP_STEP_PERIOD_MS) {
+                cap->step_ms = now_ms - POWER_CAP_STEP_PERIOD_MS;
+            }
+            float period = now_ms > cap->step_ms ? (float) (now_ms - cap->step_ms) / POWER_CAP_STEP_PERIOD_MS : 0;
+            // whole MHz, the rounding below can't take a step past them
+            float max_step_down = floorf(POWER_CAP_MAX_STEP_DOWN * period);
+            float max_step_up = floorf(POWER_CAP_MAX_STEP_UP * period);
+
+            // taking all the power as proportional to the clock overestimates the W per MHz, the steps err short
+            float w_per_mhz = measured / running;
+            float step = error / w_per_mhz * (error < 0 ? POWER_CAP_GAIN_DOWN : POWER_CAP_GAIN_UP);
+
+            if (step < -max_step_down) {
+                step = -max_step_down;
+            }
+            if (step > max_step_up) {
+                step = max_step_up;
+            }
+            // down to the next whole MHz when over, so a small overshoot is still acted on
+            float next = error < 0 ? floorf(running + step) : roundf(running + step);
+            // short of a whole MHz the time keeps adding up until the next update
+            if (running - next <= max_step_down && next - running <= max_step_up) {
+                float share = next < running ? (running - next) / POWER_CAP_MAX_STEP_DOWN : (next - running) / POWER_CAP_MAX_STEP_UP;
+                cap->step_ms += share * POWER_CAP_STEP_PERIOD_MS;
+                frequency = next;
+            }
+        }
+
+        if (frequency > max_frequency) {
+            frequency = max_frequency;
+        }
+        if (frequency < min_frequency) {
+            frequency = min_frequency;
+        }
+    }
+
+    if (frequency == cap->frequency) {
+        return false;
+    }
+    cap->frequency = frequency;
+    return true;
+}
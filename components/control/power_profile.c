@@ -0,0 +1,181 @@
+#include "power_profile.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool power_profile_name_valid(const char * name)
+{
+    size_t length = strlen(name);
+
+    if (length == 0 || length >= POWER_PROFILE_NAME_LENGTH) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (!isalnum((unsigned char) name[i]) && name[i] != '-' && name[i] != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// copies a name up to the next separator, returns the separator or NULL when the name isn't valid
+static const char * _parse_name(const char * p, char name[POWER_PROFILE_NAME_LENGTH], char separator)
+{
+    const char * end = strchr(p, separator);
+    size_t length = end != NULL ? (size_t) (end - p) : strlen(p);
+
+    if (length == 0 || length >= POWER_PROFILE_NAME_LENGTH) {
+        return NULL;
+    }
+    memcpy(name, p, length);
+    name[length] = '\0';
+    if (!power_profile_name_valid(name)) {
+        return NULL;
+    }
+    return p + length;
+}
+
+static const char * _format_setting(uint16_t value, char buffer[6])
+{
+    if (value == POWER_PROFILE_UNSET) {
+        return "";
+    }
+    snprintf(buffer, 6, "%u", value);
+    return buffer;
+}
+
+void power_profiles_format(const power_profile * profiles, uint8_t count, char * buffer, size_t size)
+{
+    size_t length = 0;
+    buffer[0] = '\0';
+
+    for (uint8_t i = 0; i < count; i++) {
+        char settings[4][6];
+        int written = snprintf(buffer + length, size - length, "%s%s:%s:%s:%s:%s", i == 0 ? "" : ",", profiles[i].name,
+                               _format_setting(profiles[i].frequency, settings[0]), _format_setting(profiles[i].voltage, settings[1]),
+                               _format_setting(profiles[i].temp_target, settings[2]), _format_setting(profiles[i].power_cap, settings[3]));
+        if (written < 0 || (size_t) written >= size - length) {
+            buffer[length] = '\0';
+            return;
+        }
+        length += written;
+    }
+}
+
+uint8_t power_profiles_parse(const char * text, power_profile * profiles, uint8_t max_count)
+{
+    uint8_t count = 0;
+    const char * p = text;
+
+    while (p != NULL && *p != '\0' && count < max_count) {
+        power_profile profile = {0};
+        unsigned long values[4];
+        char * end;
+
+        p = _parse_name(p, profile.name, ':');
+        if (p == NULL || *p != ':') {
+            break;
+        }
+        for (int i = 0; i < 4; i++) {
+            values[i] = strtoul(p + 1, &end, 10);
+            // an empty setting is unset, anything else but a separator fails below
+            if (end == p + 1) {
+                values[i] = POWER_PROFILE_UNSET;
+            } else if (values[i] >= POWER_PROFILE_UNSET) {
+                return count;
+            }
+            if (i < 3 ? *end != ':' : *end != ',' && *end != '\0') {
+                return count;
+            }
+            p = end;
+        }
+        profile.frequency = values[0];
+        profile.voltage = values[1];
+        profile.temp_target = values[2];
+        profile.power_cap = values[3];
+
+        profiles[count++] = profile;
+        p = *end == ',' ? end + 1 : NULL;
+    }
+    return count;
+}
+
+void power_schedule_format(const power_schedule_entry * entries, uint8_t count, char * buffer, size_t size)
+{
+    size_t length = 0;
+    buffer[0] = '\0';
+
+    for (uint8_t i = 0; i < count; i++) {
+        int written = snprintf(buffer + length, size - length, "%s%u:%u:%s", i == 0 ? "" : ",",
+                               entries[i].days, entries[i].minute, entries[i].profile);
+        if (written < 0 || (size_t) written >= size - length) {
+            buffer[length] = '\0';
+            return;
+        }
+        length += written;
+    }
+}
+
+uint8_t power_schedule_parse(const char * text, power_schedule_entry * entries, uint8_t max_count)
+{
+    uint8_t count = 0;
+    const char * p = text;
+
+    while (p != NULL && *p != '\0' && count < max_count) {
+        power_schedule_entry entry;
+        char * end;
+
+        unsigned long days = strtoul(p, &end, 10);
+        if (end == p || *end != ':' || days == 0 || days > 0x7F) {
+            break;
+        }
+        unsigned long minute = strtoul(end + 1, &end, 10);
+        if (*end != ':' || minute >= POWER_SCHEDULE_MINUTES_PER_DAY) {
+            break;
+        }
+        p = _parse_name(end + 1, entry.profile, ',');
+        if (p == NULL) {
+            break;
+        }
+        entry.days = days;
+        entry.minute = minute;
+
+        entries[count++] = entry;
+        p = *p == ',' ? p + 1 : NULL;
+    }
+    return count;
+}
+
+int power_schedule_active(const power_schedule_entry * entries, uint8_t count, uint16_t week_minute)
+{
+    int active = -1;
+    uint16_t closest = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        for (int day = 0; day < 7; day++) {
+            if (!(entries[i].days & (1 << day))) {
+                continue;
+            }
+            uint16_t start = day * POWER_SCHEDULE_MINUTES_PER_DAY + entries[i].minute;
+            // minutes since this start, going back over the end of the week
+            uint16_t since = (week_minute + POWER_SCHEDULE_MINUTES_PER_WEEK - start) % POWER_SCHEDULE_MINUTES_PER_WEEK;
+            if (active < 0 || since < closest) {
+                active = i;
+                closest = since;
+            }
+        }
+    }
+    return active;
+}
+
+const power_profile * power_profile_find(const power_profile * profiles, uint8_t count, const char * name)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        if (strcmp(profiles[i].name, name) == 0) {
+            return &profiles[i];
+        }
+    }
+    return NULL;
+}
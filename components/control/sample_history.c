@@ -0,0 +1,113 @@
+#include "sample_history.h"
+
+#include <stddef.h>
+
+static const uint32_t periods_s[SAMPLE_RESOLUTIONS] = {1, 60, 3600};
+
+static void _ring_init(sample_ring * ring, uint32_t period_s, sample_slot * slots, uint16_t length)
+{
+    ring->period_s = period_s;
+    ring->slots = slots;
+    ring->length = length;
+    ring->head = 0;
+    ring->count = 0;
+    ring->open = false;
+}
+
+// returns the slot that was closed, NULL when the ring had none open
+static const sample_slot * _ring_close(sample_ring * ring)
+{
+    if (!ring->open) {
+        return NULL;
+    }
+
+    for (int channel = 0; channel < SAMPLE_CHANNELS; channel++) {
+        ring->current.channels[channel].mean = ring->sums[channel] / ring->current.count;
+    }
+
+    sample_slot * slot = &ring->slots[ring->head];
+    *slot = ring->current;
+    ring->head = (ring->head + 1) % ring->length;
+    if (ring->count < ring->length) {
+        ring->count++;
+    }
+    ring->open = false;
+    return slot;
+}
+
+// merges a slot of a finer resolution, or a single sample as a slot of one, returns the slot it closed
+static const sample_slot * _ring_add(sample_ring * ring, uint32_t start_s, const sample_slot * slot)
+{
+    const sample_slot * closed = NULL;
+    uint32_t bucket = start_s / ring->period_s;
+
+    if (ring->open && bucket != ring->bucket) {
+        closed = _ring_close(ring);
+    }
+
+    if (!ring->open) {
+        ring->open = true;
+        ring->bucket = bucket;
+        ring->current = *slot;
+        ring->current.start_s = bucket * ring->period_s;
+        for (int channel = 0; channel < SAMPLE_CHANNELS; channel++) {
+            ring->sums[channel] = (double) slot->channels[channel].mean * slot->count;
+        }
+        return closed;
+    }
+
+    for (int channel = 0; channel < SAMPLE_CHANNELS; channel++) {
+        sample_stat * stat = &ring->current.channels[channel];
+        const sample_stat * add = &slot->channels[channel];
+        if (add->min < stat->min) {
+            stat->min = add->min;
+        }
+        if (add->max > stat->max) {
+            stat->max = add->max;
+        }
+        ring->sums[channel] += (double) add->mean * slot->count;
+    }
+    ring->current.count += slot->count;
+    return closed;
+}
+
+void sample_history_init(sample_history * history)
+{
+    _ring_init(&history->rings[SAMPLE_RESOLUTION_SECOND], periods_s[SAMPLE_RESOLUTION_SECOND], history->seconds, SAMPLE_HISTORY_SECONDS);
+    _ring_init(&history->rings[SAMPLE_RESOLUTION_MINUTE], periods_s[SAMPLE_RESOLUTION_MINUTE], history->minutes, SAMPLE_HISTORY_MINUTES);
+    _ring_init(&history->rings[SAMPLE_RESOLUTION_HOUR], periods_s[SAMPLE_RESOLUTION_HOUR], history->hours, SAMPLE_HISTORY_HOURS);
+}
+
+void sample_history_add(sample_history * history, int64_t now_ms, const float values[SAMPLE_CHANNELS])
+{
+    sample_slot sample = {.start_s = now_ms / 1000, .count = 1};
+    for (int channel = 0; channel < SAMPLE_CHANNELS; channel++) {
+        sample.channels[channel] = (sample_stat) {values[channel], values[channel], values[channel]};
+    }
+
+    // a closed slot is carried on to the next coarser resolution
+    const sample_slot * closed = _ring_add(&history->rings[0], sample.start_s, &sample);
+    for (int resolution = 1; resolution < SAMPLE_RESOLUTIONS && closed != NULL; resolution++) {
+        closed = _ring_add(&history->rings[resolution], closed->start_s, closed);
+    }
+}
+
+uint16_t sample_history_count(const sample_history * history, sample_resolution resolution)
+{
+    return history->rings[resolution].count;
+}
+
+const sample_slot * sample_history_get(const sample_history * history, sample_resolution resolution, uint16_t index)
+{
+    const sample_ring * ring = &history->rings[resolution];
+
+    if (index >= ring->count) {
+        return NULL;
+    }
+    return &ring->slots[(ring->head + ring->length - ring->count + index) % ring->length];
+}
+
+uint32_t sample_history_period_s(sample_resolution resolution)
+{
+    return periods_s[resolution];
+}
@@ -0,0 +1,244 @@
+#include <string.h>
+
+#include "unity.h"
+
+#include "autotune.h"
+
+static autotune tuner;
+
+static const autotune_limits limits = {
+    .min_frequency = 400,
+    .max_frequency = 600,
+    .frequency_step = 50,
+    .min_voltage = 1000,
+    .max_voltage = 1200,
+    .voltage_step = 100,
+    .max_power = 50,
+    .hashrate_per_mhz = 2,
+};
+
+// a chip that holds up to 500 MHz at 1000 mV and 100 MHz more per 100 mV, and draws power with f * V^2
+static bool chip_stable(uint16_t frequency, uint16_t voltage)
+{
+    return frequency <= 500 + (voltage - 1000);
+}
+
+static float chip_power(uint16_t frequency, uint16_t voltage)
+{
+    return 5 + frequency * (voltage / 1000.0) * (voltage / 1000.0) / 20;
+}
+
+// runs the sweep against the model chip, one sample every 2 s, returns the setpoints it went through
+static int run_sweep(void)
+{
+    autotune_counters counters = {0};
+    int64_t now_ms = 0;
+    int setpoints = 1;
+
+    autotune_start(&tuner, &limits, now_ms);
+    while (tuner.state != AUTOTUNE_DONE && now_ms < 24 * 3600 * 1000LL) {
+        now_ms += 2000;
+        double hashrate = tuner.frequency * limits.hashrate_per_mhz;
+        // nonces at difficulty 256, a failing chip returns a fifth of its work as errors
+        double difficulty = hashrate * 1e9 * 2 / 4294967296.0;
+        if (chip_stable(tuner.frequency, tuner.voltage)) {
+            counters.difficulty_sum += difficulty;
+        } else {
+            counters.difficulty_sum += difficulty * 0.8;
+            counters.hw_error_difficulty_sum += difficulty * 0.2;
+        }
+        counters.nonces += 8;
+        if (autotune_sample(&tuner, now_ms, &counters, chip_power(tuner.frequency, tuner.voltage))) {
+            setpoints++;
+        }
+    }
+    return setpoints;
+}
+
+TEST_CASE("Autotune sweeps up each voltage until the chips fail", "[autotune]")
+{
+    int setpoints = run_sweep();
+    TEST_ASSERT_EQUAL(AUTOTUNE_DONE, tuner.state);
+
+    // 1000 mV holds 400..500, 1100 mV picks up at 550 and holds to the top, 1200 mV has nothing left to find
+    TEST_ASSERT_EQUAL_UINT8(5, tuner.count);
+    TEST_ASSERT_EQUAL_UINT16(400, tuner.points[0].frequency);
+    TEST_ASSERT_EQUAL_UINT16(500, tuner.points[2].frequency);
+    TEST_ASSERT_EQUAL_UINT16(550, tuner.points[3].frequency);
+    TEST_ASSERT_EQUAL_UINT16(1100, tuner.points[3].voltage);
+    TEST_ASSERT_EQUAL_UINT16(600, tuner.points[4].frequency);
+    TEST_ASSERT_EQUAL(7, setpoints);
+
+    TEST_ASSERT_FLOAT_WITHIN(10, 800, tuner.points[0].hashrate);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, chip_power(400, 1000), tuner.points[0].power);
+}
+
+TEST_CASE("Autotune stops at the power limit", "[autotune]")
+{
+    autotune_limits low_power = limits;
+    low_power.max_power = 30;
+
+    autotune_counters counters = {0};
+    autotune_start(&tuner, &low_power, 0);
+    int64_t now_ms = 0;
+    while (tuner.state != AUTOTUNE_DONE && now_ms < 24 * 3600 * 1000LL) {
+        now_ms += 2000;
+        counters.difficulty_sum += tuner.frequency * 2e9 * 2 / 4294967296.0;
+        counters.nonces += 8;
+        autotune_sample(&tuner, now_ms, &counters, chip_power(tuner.frequency, tuner.voltage));
+    }
+
+    TEST_ASSERT_EQUAL(AUTOTUNE_DONE, tuner.state);
+    for (uint8_t i = 0; i < tuner.count; i++) {
+        TEST_ASSERT_TRUE(tuner.points[i].power <= low_power.max_power);
+    }
+    TEST_ASSERT_EQUAL_UINT16(500, tuner.points[tuner.count - 1].frequency);
+}
+
+TEST_CASE("Autotune waits out a spell without nonces", "[autotune]")
+{
+    autotune_counters counters = {0};
+    autotune_start(&tuner, &limits, 0);
+
+    int64_t now_ms = 0;
+    while (now_ms < AUTOTUNE_SETTLE_MS + 2 * AUTOTUNE_MAX_DWELL_MS) {
+        now_ms += 2000;
+        TEST_ASSERT_FALSE(autotune_sample(&tuner, now_ms, &counters, 20));
+    }
+    TEST_ASSERT_EQUAL_UINT16(400, tuner.frequency);
+    TEST_ASSERT_EQUAL_UINT8(0, tuner.count);
+}
+
+TEST_CASE("Autotune keeps the Pareto front and picks by objective", "[autotune]")
+{
+    autotune_point points[] = {
+        {.frequency = 400, .voltage = 1000, .hashrate = 800, .power = 11},
+        {.frequency = 500, .voltage = 1000, .hashrate = 1000, .power = 15},
+        // slower and hungrier than 500 MHz at 1000 mV
+        {.frequency = 450, .voltage = 1100, .hashrate = 900, .power = 16},
+        {.frequency = 600, .voltage = 1100, .hashrate = 1200, .power = 22},
+    };
+    autotune_point curve[AUTOTUNE_MAX_POINTS];
+
+    uint8_t count = autotune_pareto(points, 4, curve);
+    TEST_ASSERT_EQUAL_UINT8(3, count);
+    TEST_ASSERT_EQUAL_UINT16(400, curve[0].frequency);
+    TEST_ASSERT_EQUAL_UINT16(500, curve[1].frequency);
+    TEST_ASSERT_EQUAL_UINT16(600, curve[2].frequency);
+
+    TEST_ASSERT_EQUAL_UINT16(600, autotune_select(curve, count, AUTOTUNE_MAX_HASHRATE, 0)->frequency);
+    TEST_ASSERT_EQUAL_UINT16(400, autotune_select(curve, count, AUTOTUNE_BEST_EFFICIENCY, 0)->frequency);
+    TEST_ASSERT_EQUAL_UINT16(500, autotune_select(curve, count, AUTOTUNE_POWER_CAP, 20)->frequency);
+    TEST_ASSERT_EQUAL_UINT16(400, autotune_select(curve, count, AUTOTUNE_POWER_CAP, 10)->frequency);
+    TEST_ASSERT_NULL(autotune_select(curve, count, AUTOTUNE_OFF, 0));
+
+    TEST_ASSERT_EQUAL_UINT16(1000, autotune_voltage_for(curve, count, 450));
+    TEST_ASSERT_EQUAL_UINT16(1100, autotune_voltage_for(curve, count, 550));
+    TEST_ASSERT_EQUAL_UINT16(0, autotune_voltage_for(curve, count, 650));
+    TEST_ASSERT_NULL(autotune_select(curve, 0, AUTOTUNE_MAX_HASHRATE, 0));
+}
+
+TEST_CASE("Autotune curve survives a round trip through text", "[autotune]")
+{
+    autotune_point curve[] = {
+        {.frequency = 400, .voltage = 1000, .hashrate = 812.5, .power = 13.25},
+        {.frequency = 600, .voltage = 1100, .hashrate = 1203.1, .power = 22.5},
+    };
+    char buffer[64];
+    autotune_curve_format(curve, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_STRING("400:1000:812.5:13.25,600:1100:1203.1:22.50", buffer);
+
+    autotune_point parsed[AUTOTUNE_MAX_POINTS];
+    TEST_ASSERT_EQUAL_UINT8(2, autotune_curve_parse(buffer, parsed, AUTOTUNE_MAX_POINTS));
+    TEST_ASSERT_EQUAL_UINT16(600, parsed[1].frequency);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 22.5, parsed[1].power);
+
+    // a point that doesn't fit is dropped whole
+    autotune_curve_format(curve, 2, buffer, 30);
+    TEST_ASSERT_EQUAL_STRING("400:1000:812.5:13.25", buffer);
+
+    TEST_ASSERT_EQUAL_UINT8(0, autotune_curve_parse("", parsed, AUTOTUNE_MAX_POINTS));
+    TEST_ASSERT_EQUAL_UINT8(1, autotune_curve_parse("400:1000:800:13,garbage", parsed, AUTOTUNE_MAX_POINTS));
+}
+
+TEST_CASE("Autotune fails a point on errors the chips count and on an unlocked PLL", "[autotune]")
+{
+    autotune_counters counters = {0};
+    int64_t now_ms = 0;
+
+    autotune_start(&tuner, &limits, now_ms);
+    // the host sees clean nonces, the chips count 2% errors
+    while (tuner.voltage == limits.min_voltage && now_ms < 24 * 3600 * 1000LL) {
+        now_ms += 2000;
+        counters.difficulty_sum += tuner.frequency * 2e9 * 2 / 4294967296.0;
+        counters.nonces += 50;
+        counters.chip_errors += 1;
+        autotune_sample(&tuner, now_ms, &counters, 20);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, tuner.count);
+
+    // clean counters, but a chip lost its PLL lock
+    counters.unlocked_chips = 1;
+    while (tuner.voltage == limits.min_voltage + limits.voltage_step && now_ms < 48 * 3600 * 1000LL) {
+        now_ms += 2000;
+        counters.difficulty_sum += tuner.frequency * 2e9 * 2 / 4294967296.0;
+        counters.nonces += 50;
+        autotune_sample(&tuner, now_ms, &counters, 20);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, tuner.count);
+
+    // a chain reset in the middle of a measurement clears the chip counters, that is no error
+    counters.unlocked_chips = 0;
+    while (tuner.count == 0 && tuner.state != AUTOTUNE_DONE && now_ms < 72 * 3600 * 1000LL) {
+        now_ms += 2000;
+        if (tuner.state == AUTOTUNE_MEASURING && now_ms - tuner.start_ms > AUTOTUNE_MIN_DWELL_MS / 2) {
+            counters.chip_errors = 0;
+        }
+        counters.difficulty_sum += tuner.frequency * 2e9 * 2 / 4294967296.0;
+        counters.nonces += 50;
+        autotune_sample(&tuner, now_ms, &counters, 20);
+    }
+    TEST_ASSERT_EQUAL_UINT8(1, tuner.count);
+}
+
+TEST_CASE("Autotune measures a point again after a derate", "[autotune]")
+{
+    autotune_counters counters = {0};
+    int64_t now_ms = 0;
+
+    autotune_start(&tuner, &limits, now_ms);
+    // a derate halfway through the first measurement throws it away
+    while (now_ms < AUTOTUNE_SETTLE_MS + AUTOTUNE_MIN_DWELL_MS / 2) {
+        now_ms += 2000;
+        counters.difficulty_sum += tuner.frequency * 2e9 * 2 / 4294967296.0;
+        counters.nonces += 50;
+        autotune_sample(&tuner, now_ms, &counters, 20);
+    }
+    TEST_ASSERT_EQUAL(AUTOTUNE_MEASURING, tuner.state);
+    TEST_ASSERT_FALSE(autotune_derated(&tuner, now_ms));
+    TEST_ASSERT_EQUAL(AUTOTUNE_SETTLING, tuner.state);
+
+    // once it lifts the point settles and is measured in full
+    int64_t lifted_ms = now_ms;
+    while (tuner.count == 0 && now_ms < 3600 * 1000LL) {
+        now_ms += 2000;
+        counters.difficulty_sum += tuner.frequency * 2e9 * 2 / 4294967296.0;
+        counters.nonces += 50;
+        autotune_sample(&tuner, now_ms, &counters, 20);
+    }
+    TEST_ASSERT_EQUAL_UINT8(1, tuner.count);
+    TEST_ASSERT_TRUE(now_ms - lifted_ms >= AUTOTUNE_SETTLE_MS + AUTOTUNE_MIN_DWELL_MS);
+    TEST_ASSERT_EQUAL_UINT16(450, tuner.frequency);
+
+    // a derate that never lifts ends the voltage, the power task keeps sampling in between
+    bool moved = false;
+    while (!moved && now_ms < 7200 * 1000LL) {
+        now_ms += 2000;
+        autotune_sample(&tuner, now_ms, &counters, 20);
+        moved = autotune_derated(&tuner, now_ms);
+    }
+    TEST_ASSERT_TRUE(moved);
+    TEST_ASSERT_EQUAL_UINT16(limits.min_voltage + limits.voltage_step, tuner.voltage);
+    TEST_ASSERT_EQUAL_UINT16(450, tuner.frequency);
+    TEST_ASSERT_EQUAL_UINT8(1, tuner.count);
+}
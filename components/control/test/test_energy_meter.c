@@ -0,0 +1,82 @@
+#include "unity.h"
+
+#include "energy_meter.h"
+
+TEST_CASE("Energy meter integrates power into Wh", "[energy_meter]")
+{
+    energy_meter meter;
+    energy_meter_init(&meter, 100, 0);
+
+    // 36 W for 100 s at 20 Hz is one Wh
+    for (int64_t now_ms = 0; now_ms <= 100000; now_ms += 50) {
+        energy_meter_add_power(&meter, now_ms, 36);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 1, meter.session_wh);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 101, meter.total_wh);
+
+    // a stalled sampler doesn't make up the gap
+    energy_meter_add_power(&meter, 100000 + ENERGY_MAX_SAMPLE_GAP_MS + 1, 36);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 1, meter.session_wh);
+}
+
+TEST_CASE("Energy meter gives J/TH and J per share over a window", "[energy_meter]")
+{
+    energy_meter meter;
+    energy_meter_init(&meter, 0, 0);
+    energy_meter_add_work(&meter, 0, 1000, 10);
+
+    // 20 W and 1 TH/s, 1e12 / 2^32 difficulty a second, and a share every 6 s for two minutes
+    double difficulty = 1000;
+    uint64_t shares = 10;
+    for (int64_t now_ms = 0; now_ms <= 120000; now_ms += 100) {
+        energy_meter_add_power(&meter, now_ms, 20);
+        difficulty += 1e12 / 4294967296.0 / 10;
+        if (now_ms > 0 && now_ms % 6000 == 0) {
+            shares++;
+        }
+        energy_meter_add_work(&meter, now_ms, difficulty, shares);
+    }
+
+    energy_window window;
+    energy_meter_window(&meter, ENERGY_WINDOW_MINUTE, 120000, &window);
+    TEST_ASSERT_EQUAL(60, window.period_s);
+    TEST_ASSERT_FLOAT_WITHIN(5.1, 60, window.covered_s);
+    TEST_ASSERT_FLOAT_WITHIN(0.1, 20, window.power);
+    TEST_ASSERT_FLOAT_WITHIN(10, 1000, window.hashrate);
+    TEST_ASSERT_FLOAT_WITHIN(0.2, 20, window.joules_per_th);
+    TEST_ASSERT_FLOAT_WITHIN(15, 120, window.joules_per_share);
+
+    // the hour covers everything since boot
+    energy_meter_window(&meter, ENERGY_WINDOW_HOUR, 120000, &window);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 120, window.covered_s);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3, 20 * 120 / 3600.0, window.energy_wh);
+    TEST_ASSERT_EQUAL(20, window.shares);
+    TEST_ASSERT_FLOAT_WITHIN(0.2, 20, window.joules_per_th);
+
+    // a reset share counter starts over instead of counting backwards
+    energy_meter_add_work(&meter, 120100, difficulty, 2);
+    energy_meter_window(&meter, ENERGY_WINDOW_HOUR, 120100, &window);
+    TEST_ASSERT_EQUAL(22, window.shares);
+
+    // nothing came in for longer than the minute
+    energy_meter_window(&meter, ENERGY_WINDOW_MINUTE, 200000, &window);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0, window.power);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 0, window.joules_per_th);
+}
+
+TEST_CASE("Energy meter checkpoints after enough energy and time", "[energy_meter]")
+{
+    energy_meter meter;
+    energy_meter_init(&meter, 5, 0);
+
+    energy_meter_add_power(&meter, 0, 3600);
+    energy_meter_add_power(&meter, 2000, 3600);
+    // two Wh in, but too soon
+    TEST_ASSERT_FALSE(energy_meter_checkpoint_due(&meter, 2000));
+    TEST_ASSERT_TRUE(energy_meter_checkpoint_due(&meter, ENERGY_CHECKPOINT_INTERVAL_MS));
+
+    energy_meter_checkpointed(&meter, ENERGY_CHECKPOINT_INTERVAL_MS);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 7, meter.checkpoint_wh);
+    // long enough, but not enough energy
+    TEST_ASSERT_FALSE(energy_meter_checkpoint_due(&meter, 3 * ENERGY_CHECKPOINT_INTERVAL_MS));
+}
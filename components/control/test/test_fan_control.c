@@ -0,0 +1,150 @@
+#include "unity.h"
+
+#include "fan_control.h"
+
+static const fan_gains default_gains = {
+    .kp = FAN_CONTROL_DEFAULT_KP,
+    .ki = FAN_CONTROL_DEFAULT_KI,
+    .kd = FAN_CONTROL_DEFAULT_KD,
+    .kff = FAN_CONTROL_DEFAULT_KFF,
+    .period_s = FAN_CONTROL_DEFAULT_PERIOD_S,
+};
+
+// a chip that heats with the power and is cooled by the fan, first order with a 40 s time constant
+// and a 2 s sensor delay
+typedef struct
+{
+    float temperature;
+    float history[4];
+} board;
+
+static float board_step(board * b, float power, float fan, float dt_s)
+{
+    float steady = 25 + power * 1.5 - fan * 0.4;
+    b->temperature += (steady - b->temperature) * dt_s / 40;
+    for (int i = 3; i > 0; i--) {
+        b->history[i] = b->history[i - 1];
+    }
+    b->history[0] = b->temperature;
+    return b->history[3];
+}
+
+TEST_CASE("Fan controller holds the setpoint", "[fan_control]")
+{
+    fan_controller controller;
+    board b = {.temperature = 50, .history = {50, 50, 50, 50}};
+    fan_controller_init(&controller, &default_gains, 15, 100, 50);
+
+    float temperature = 50;
+    for (int i = 0; i < 2400; i++) {
+        float fan = fan_controller_update(&controller, temperature, 60, 40, 0.5);
+        temperature = board_step(&b, 40, fan, 0.5);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 60, temperature);
+}
+
+TEST_CASE("Fan controller spins up on a power step before the temperature moves", "[fan_control]")
+{
+    fan_controller with, without;
+    fan_gains no_feed_forward = default_gains;
+    no_feed_forward.kff = 0;
+    fan_controller_init(&with, &default_gains, 15, 100, 50);
+    fan_controller_init(&without, &no_feed_forward, 15, 100, 50);
+
+    for (int i = 0; i < 20; i++) {
+        fan_controller_update(&with, 60, 60, 20, 0.5);
+        fan_controller_update(&without, 60, 60, 20, 0.5);
+    }
+    float before = with.output;
+    float after = fan_controller_update(&with, 60, 60, 30, 0.5);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, before + 10 * FAN_CONTROL_DEFAULT_KFF, after);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, before, fan_controller_update(&without, 60, 60, 30, 0.5));
+
+    // the push fades once the power holds, the temperature takes over
+    for (int i = 0; i < 4 * FAN_CONTROL_DEFAULT_PERIOD_S / 0.5; i++) {
+        fan_controller_update(&with, 60, 60, 30, 0.5);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.5, before, with.output);
+}
+
+TEST_CASE("Fan controller doesn't wind up at full speed", "[fan_control]")
+{
+    fan_controller controller;
+    fan_controller_init(&controller, &default_gains, 15, 100, 50);
+
+    for (int i = 0; i < 1000; i++) {
+        TEST_ASSERT_TRUE(fan_controller_update(&controller, 80, 60, 20, 0.5) <= 100);
+    }
+    TEST_ASSERT_TRUE(controller.integral <= 100);
+
+    // back under the setpoint the fan comes down within a few samples
+    float output = 100;
+    for (int i = 0; i < 10; i++) {
+        output = fan_controller_update(&controller, 55, 60, 20, 0.5);
+    }
+    TEST_ASSERT_TRUE(output < 100);
+}
+
+TEST_CASE("Fan autotune finds gains that hold the setpoint", "[fan_control]")
+{
+    fan_autotune tuner;
+    board b = {.temperature = 60, .history = {60, 60, 60, 60}};
+    fan_autotune_start(&tuner, 60, 55, 15, 100, 0);
+
+    float temperature = 60;
+    int64_t now_ms = 0;
+    while (tuner.state == FAN_AUTOTUNE_RUNNING) {
+        float fan = fan_autotune_update(&tuner, temperature, now_ms);
+        temperature = board_step(&b, 40, fan, 0.5);
+        now_ms += 500;
+    }
+    TEST_ASSERT_EQUAL(FAN_AUTOTUNE_DONE, tuner.state);
+
+    fan_gains gains = default_gains;
+    TEST_ASSERT_TRUE(fan_autotune_gains(&tuner, &gains));
+    TEST_ASSERT_TRUE(gains.kp > 0 && gains.ki > 0 && gains.kd > 0);
+    TEST_ASSERT_TRUE(gains.period_s > 2 && gains.period_s < 120);
+    TEST_ASSERT_EQUAL_FLOAT(FAN_CONTROL_DEFAULT_KFF, gains.kff);
+
+    fan_controller controller;
+    fan_controller_init(&controller, &gains, 15, 100, 55);
+    for (int i = 0; i < 2400; i++) {
+        float fan = fan_controller_update(&controller, temperature, 62, 40, 0.5);
+        temperature = board_step(&b, 40, fan, 0.5);
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 62, temperature);
+}
+
+TEST_CASE("Fan autotune gives up on a board that doesn't cross the setpoint", "[fan_control]")
+{
+    fan_autotune tuner;
+    fan_autotune_start(&tuner, 60, 50, 15, 100, 0);
+
+    TEST_ASSERT_EQUAL_FLOAT(30, fan_autotune_update(&tuner, 40, 0));
+    TEST_ASSERT_EQUAL(FAN_AUTOTUNE_RUNNING, tuner.state);
+    fan_autotune_update(&tuner, 40, FAN_AUTOTUNE_TIMEOUT_MS + 1);
+    TEST_ASSERT_EQUAL(FAN_AUTOTUNE_FAILED, tuner.state);
+
+    fan_gains gains = default_gains;
+    TEST_ASSERT_FALSE(fan_autotune_gains(&tuner, &gains));
+    TEST_ASSERT_EQUAL_FLOAT(FAN_CONTROL_DEFAULT_KP, gains.kp);
+}
+
+TEST_CASE("Fan gains survive formatting", "[fan_control]")
+{
+    char text[64];
+    fan_gains gains = {.kp = 6.5, .ki = 0.0625, .kd = 12.25, .kff = 1.5, .period_s = 48};
+    fan_gains_format(&gains, text, sizeof(text));
+
+    fan_gains parsed;
+    TEST_ASSERT_TRUE(fan_gains_parse(text, &parsed));
+    TEST_ASSERT_EQUAL_FLOAT(gains.kp, parsed.kp);
+    TEST_ASSERT_EQUAL_FLOAT(gains.ki, parsed.ki);
+    TEST_ASSERT_EQUAL_FLOAT(gains.kd, parsed.kd);
+    TEST_ASSERT_EQUAL_FLOAT(gains.kff, parsed.kff);
+    TEST_ASSERT_EQUAL_FLOAT(gains.period_s, parsed.period_s);
+
+    TEST_ASSERT_FALSE(fan_gains_parse("", &parsed));
+    TEST_ASSERT_FALSE(fan_gains_parse("1:2:3", &parsed));
+    TEST_ASSERT_FALSE(fan_gains_parse("1:2:3:4:5x", &parsed));
+}
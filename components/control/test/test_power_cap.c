@@ -0,0 +1,122 @@
+#include "unity.h"
+
+#include "power_cap.h"
+
+static power_cap cap;
+static int64_t now_ms;
+
+// one poll later, the chips running at the allowed frequency
+static bool update(float power, float max_frequency)
+{
+    now_ms += POWER_CAP_STEP_PERIOD_MS;
+    return power_cap_update(&cap, power, cap.frequency, max_frequency, now_ms);
+}
+
+// 5 W for the board and 30 mW per MHz
+static float board_power(float frequency)
+{
+    return 5 + 0.03 * frequency;
+}
+
+TEST_CASE("Power cap settles under the target without overshooting", "[power_cap]")
+{
+    power_cap_init(&cap, 15, 500);
+
+    float previous = cap.frequency;
+    for (int i = 0; i < 60; i++) {
+        update(board_power(cap.frequency), 500);
+        // every move is within the slew limits
+        TEST_ASSERT_TRUE(cap.frequency - previous <= POWER_CAP_MAX_STEP_UP);
+        TEST_ASSERT_TRUE(previous - cap.frequency <= POWER_CAP_MAX_STEP_DOWN);
+        previous = cap.frequency;
+    }
+
+    TEST_ASSERT_TRUE(board_power(cap.frequency) <= 15);
+    TEST_ASSERT_TRUE(board_power(cap.frequency) >= 15 - POWER_CAP_DEADBAND);
+
+    // settled, nothing moves
+    TEST_ASSERT_FALSE(update(board_power(cap.frequency), 500));
+}
+
+TEST_CASE("Power cap climbs back when the load drops", "[power_cap]")
+{
+    power_cap_init(&cap, 15, 300);
+    for (int i = 0; i < 60; i++) {
+        update(board_power(cap.frequency) - 3, 500);
+    }
+    // 3 W less for the rest of the board leaves room for 100 MHz more
+    TEST_ASSERT_FLOAT_WITHIN(35, 433, cap.frequency);
+    TEST_ASSERT_TRUE(board_power(cap.frequency) - 3 <= 15);
+}
+
+TEST_CASE("Power cap stays within the configured frequency", "[power_cap]")
+{
+    power_cap_init(&cap, 100, 400);
+    for (int i = 0; i < 20; i++) {
+        update(board_power(cap.frequency), 450);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(450, cap.frequency);
+
+    // a lower setting pulls it down at once
+    TEST_ASSERT_TRUE(update(board_power(cap.frequency), 420));
+    TEST_ASSERT_EQUAL_FLOAT(420, cap.frequency);
+
+    // and an impossible target bottoms out at the floor
+    cap.target = 1;
+    for (int i = 0; i < 20; i++) {
+        update(board_power(cap.frequency), 420);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(420 * POWER_CAP_MIN_FREQUENCY_RATIO, cap.frequency);
+}
+
+TEST_CASE("Power cap follows the configured frequency while off", "[power_cap]")
+{
+    power_cap_init(&cap, 0, 400);
+    TEST_ASSERT_TRUE(update(50, 500));
+    TEST_ASSERT_EQUAL_FLOAT(500, cap.frequency);
+    TEST_ASSERT_FALSE(update(50, 500));
+}
+
+TEST_CASE("Power cap holds while a derate keeps the chips below it", "[power_cap]")
+{
+    power_cap_init(&cap, 15, 250);
+    // a fifth off for the thermal derate, the board draws well under the target
+    for (int i = 0; i < 60; i++) {
+        now_ms += POWER_CAP_STEP_PERIOD_MS;
+        power_cap_update(&cap, board_power(cap.frequency * 0.8), cap.frequency * 0.8, 300, now_ms);
+    }
+    TEST_ASSERT_EQUAL_FLOAT(250, cap.frequency);
+
+    // over the target while derated, down from the applied frequency
+    TEST_ASSERT_TRUE(power_cap_update(&cap, 18, 200, 300, now_ms + POWER_CAP_STEP_PERIOD_MS));
+    TEST_ASSERT_TRUE(cap.frequency < 200);
+    TEST_ASSERT_TRUE(200 - cap.frequency <= POWER_CAP_MAX_STEP_DOWN);
+}
+
+TEST_CASE("Power cap steps are bounded per unit of time", "[power_cap]")
+{
+    power_cap_init(&cap, 20, 700);
+    for (int i = 0; i < 60; i++) {
+        update(board_power(cap.frequency), 700);
+    }
+    // a step period's worth is banked while settled, the first overshoot spends it at once
+    TEST_ASSERT_TRUE(power_cap_update(&cap, 25, cap.frequency, 700, now_ms));
+    float start = cap.frequency;
+
+    // woken every 100 ms for a step period, far over the target the whole time
+    for (int i = 0; i < POWER_CAP_STEP_PERIOD_MS / 100; i++) {
+        now_ms += 100;
+        power_cap_update(&cap, 25, cap.frequency, 700, now_ms);
+    }
+    TEST_ASSERT_TRUE(start - cap.frequency <= POWER_CAP_MAX_STEP_DOWN);
+    TEST_ASSERT_TRUE(start - cap.frequency >= POWER_CAP_MAX_STEP_DOWN - 2);
+
+    // and back up no faster
+    float low = cap.frequency;
+    for (int i = 0; i < POWER_CAP_STEP_PERIOD_MS / 100; i++) {
+        now_ms += 100;
+        power_cap_update(&cap, 5, cap.frequency, 700, now_ms);
+    }
+    TEST_ASSERT_TRUE(cap.frequency > low);
+    TEST_ASSERT_TRUE(cap.frequency - low <= POWER_CAP_MAX_STEP_UP);
+}
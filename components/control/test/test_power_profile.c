@@ -0,0 +1,104 @@
+#include "unity.h"
+
+#include "power_profile.h"
+
+#define WEEKDAYS 0x3E
+#define WEEKEND 0x41
+
+TEST_CASE("Power profiles survive formatting", "[power_profile]")
+{
+    power_profile profiles[] = {
+        {.name = "peak", .frequency = 400, .voltage = 1100, .temp_target = 55, .power_cap = 12},
+        {.name = "off-peak_2", .frequency = 575, .voltage = 1250, .temp_target = 65, .power_cap = 0},
+    };
+    char text[128];
+    power_profiles_format(profiles, 2, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("peak:400:1100:55:12,off-peak_2:575:1250:65:0", text);
+
+    power_profile parsed[POWER_PROFILE_MAX_COUNT];
+    TEST_ASSERT_EQUAL(2, power_profiles_parse(text, parsed, POWER_PROFILE_MAX_COUNT));
+    TEST_ASSERT_EQUAL_STRING("off-peak_2", parsed[1].name);
+    TEST_ASSERT_EQUAL(575, parsed[1].frequency);
+    TEST_ASSERT_EQUAL(1250, parsed[1].voltage);
+    TEST_ASSERT_EQUAL(65, parsed[1].temp_target);
+    TEST_ASSERT_EQUAL(0, parsed[1].power_cap);
+    TEST_ASSERT_EQUAL(12, power_profile_find(parsed, 2, "peak")->power_cap);
+    TEST_ASSERT_NULL(power_profile_find(parsed, 2, "night"));
+
+    // a malformed profile ends the list
+    TEST_ASSERT_EQUAL(1, power_profiles_parse("peak:400:1100:55:12,bad name:1:2:3:4", parsed, POWER_PROFILE_MAX_COUNT));
+    TEST_ASSERT_EQUAL(0, power_profiles_parse("peak:400:1100:55", parsed, POWER_PROFILE_MAX_COUNT));
+    TEST_ASSERT_EQUAL(0, power_profiles_parse("peak:400:1100:55:70000", parsed, POWER_PROFILE_MAX_COUNT));
+    TEST_ASSERT_EQUAL(0, power_profiles_parse("peak:400:1100:55:65535", parsed, POWER_PROFILE_MAX_COUNT));
+    TEST_ASSERT_FALSE(power_profile_name_valid("a-name-that-is-too-long"));
+    TEST_ASSERT_FALSE(power_profile_name_valid(""));
+}
+
+TEST_CASE("Power profile settings can be left unset", "[power_profile]")
+{
+    power_profile profiles[] = {
+        {.name = "eco", .frequency = POWER_PROFILE_UNSET, .voltage = POWER_PROFILE_UNSET, .temp_target = 60, .power_cap = 0},
+        {.name = "keep", .frequency = 500, .voltage = 1150, .temp_target = POWER_PROFILE_UNSET, .power_cap = POWER_PROFILE_UNSET},
+    };
+    char text[128];
+    power_profiles_format(profiles, 2, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("eco:::60:0,keep:500:1150::", text);
+
+    power_profile parsed[POWER_PROFILE_MAX_COUNT];
+    TEST_ASSERT_EQUAL(2, power_profiles_parse(text, parsed, POWER_PROFILE_MAX_COUNT));
+    TEST_ASSERT_EQUAL(POWER_PROFILE_UNSET, parsed[0].frequency);
+    TEST_ASSERT_EQUAL(POWER_PROFILE_UNSET, parsed[0].voltage);
+    TEST_ASSERT_EQUAL(60, parsed[0].temp_target);
+    // a cap of 0 turns the cap off, it is not the same as leaving it
+    TEST_ASSERT_EQUAL(0, parsed[0].power_cap);
+    TEST_ASSERT_EQUAL(POWER_PROFILE_UNSET, parsed[1].temp_target);
+    TEST_ASSERT_EQUAL(POWER_PROFILE_UNSET, parsed[1].power_cap);
+
+    TEST_ASSERT_EQUAL(0, power_profiles_parse("eco:x::60:", parsed, POWER_PROFILE_MAX_COUNT));
+}
+
+TEST_CASE("Power schedule survives formatting", "[power_profile]")
+{
+    power_schedule_entry entries[] = {
+        {.days = WEEKDAYS, .minute = 7 * 60, .profile = "peak"},
+        {.days = 0x7F, .minute = 22 * 60 + 30, .profile = "night"},
+    };
+    char text[128];
+    power_schedule_format(entries, 2, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("62:420:peak,127:1350:night", text);
+
+    power_schedule_entry parsed[POWER_SCHEDULE_MAX_ENTRIES];
+    TEST_ASSERT_EQUAL(2, power_schedule_parse(text, parsed, POWER_SCHEDULE_MAX_ENTRIES));
+    TEST_ASSERT_EQUAL(WEEKDAYS, parsed[0].days);
+    TEST_ASSERT_EQUAL(1350, parsed[1].minute);
+    TEST_ASSERT_EQUAL_STRING("night", parsed[1].profile);
+
+    TEST_ASSERT_EQUAL(0, power_schedule_parse("0:420:peak", parsed, POWER_SCHEDULE_MAX_ENTRIES));
+    TEST_ASSERT_EQUAL(0, power_schedule_parse("62:1440:peak", parsed, POWER_SCHEDULE_MAX_ENTRIES));
+    TEST_ASSERT_EQUAL(1, power_schedule_parse("62:420:peak,62:600:", parsed, POWER_SCHEDULE_MAX_ENTRIES));
+}
+
+TEST_CASE("Power schedule picks the last start before now across the week", "[power_profile]")
+{
+    power_schedule_entry entries[] = {
+        {.days = WEEKDAYS, .minute = 7 * 60, .profile = "peak"},
+        {.days = WEEKDAYS, .minute = 21 * 60, .profile = "night"},
+        {.days = WEEKEND, .minute = 10 * 60, .profile = "weekend"},
+    };
+    uint16_t monday = 1 * POWER_SCHEDULE_MINUTES_PER_DAY;
+    uint16_t saturday = 6 * POWER_SCHEDULE_MINUTES_PER_DAY;
+
+    TEST_ASSERT_EQUAL(-1, power_schedule_active(entries, 0, monday));
+    TEST_ASSERT_EQUAL(0, power_schedule_active(entries, 3, monday + 7 * 60));
+    TEST_ASSERT_EQUAL(0, power_schedule_active(entries, 3, monday + 20 * 60 + 59));
+    TEST_ASSERT_EQUAL(1, power_schedule_active(entries, 3, monday + 21 * 60));
+    // Saturday morning is still Friday night
+    TEST_ASSERT_EQUAL(1, power_schedule_active(entries, 3, saturday + 9 * 60));
+    TEST_ASSERT_EQUAL(2, power_schedule_active(entries, 3, saturday + 10 * 60));
+    // Monday before seven runs on from Sunday, over the start of the week
+    TEST_ASSERT_EQUAL(2, power_schedule_active(entries, 3, monday + 6 * 60));
+    // Sunday at midnight runs on from Saturday
+    TEST_ASSERT_EQUAL(2, power_schedule_active(entries, 3, 0));
+    // a schedule with only weekday entries wraps from Friday night to Monday morning
+    TEST_ASSERT_EQUAL(1, power_schedule_active(entries, 2, 0));
+}
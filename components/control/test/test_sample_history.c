@@ -0,0 +1,78 @@
+#include "unity.h"
+
+#include <stdlib.h>
+
+#include "sample_history.h"
+
+static sample_history * history;
+
+static void add(int64_t now_ms, float power)
+{
+    float values[SAMPLE_CHANNELS] = {5000, 2000, power, 50, 60, 4000};
+    sample_history_add(history, now_ms, values);
+}
+
+TEST_CASE("Sample history keeps min, max and mean per second", "[sample_history]")
+{
+    history = malloc(sizeof(sample_history));
+    sample_history_init(history);
+
+    // 20 Hz with a droop in the second second
+    for (int i = 0; i < 20; i++) {
+        add(i * 50, 10);
+    }
+    for (int i = 20; i < 40; i++) {
+        add(i * 50, i == 30 ? 2 : 12);
+    }
+    TEST_ASSERT_EQUAL_UINT16(1, sample_history_count(history, SAMPLE_RESOLUTION_SECOND));
+
+    add(2000, 10);
+    TEST_ASSERT_EQUAL_UINT16(2, sample_history_count(history, SAMPLE_RESOLUTION_SECOND));
+
+    const sample_slot * first = sample_history_get(history, SAMPLE_RESOLUTION_SECOND, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, first->start_s);
+    TEST_ASSERT_EQUAL_UINT32(20, first->count);
+    TEST_ASSERT_EQUAL_FLOAT(10, first->channels[SAMPLE_POWER].mean);
+
+    const sample_slot * second = sample_history_get(history, SAMPLE_RESOLUTION_SECOND, 1);
+    TEST_ASSERT_EQUAL_UINT32(1, second->start_s);
+    TEST_ASSERT_EQUAL_FLOAT(2, second->channels[SAMPLE_POWER].min);
+    TEST_ASSERT_EQUAL_FLOAT(12, second->channels[SAMPLE_POWER].max);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, (19 * 12 + 2) / 20.0, second->channels[SAMPLE_POWER].mean);
+    TEST_ASSERT_EQUAL_FLOAT(5000, second->channels[SAMPLE_VOLTAGE].mean);
+
+    TEST_ASSERT_NULL(sample_history_get(history, SAMPLE_RESOLUTION_SECOND, 2));
+    free(history);
+}
+
+TEST_CASE("Sample history carries finished seconds into minutes and hours", "[sample_history]")
+{
+    history = malloc(sizeof(sample_history));
+    sample_history_init(history);
+
+    // 10 Hz for two hours and two minutes, one bad sample in the first minute,
+    // a slot only moves on once the next one starts so the last minute and hour are still open
+    for (int64_t t = 0; t <= 2 * 3600 * 1000 + 120000; t += 100) {
+        add(t, t == 30000 ? 40 : 10);
+    }
+
+    TEST_ASSERT_EQUAL_UINT16(SAMPLE_HISTORY_SECONDS, sample_history_count(history, SAMPLE_RESOLUTION_SECOND));
+    TEST_ASSERT_EQUAL_UINT16(SAMPLE_HISTORY_MINUTES, sample_history_count(history, SAMPLE_RESOLUTION_MINUTE));
+    TEST_ASSERT_EQUAL_UINT16(2, sample_history_count(history, SAMPLE_RESOLUTION_HOUR));
+
+    // the oldest second still held is two minutes back
+    const sample_slot * oldest = sample_history_get(history, SAMPLE_RESOLUTION_SECOND, 0);
+    TEST_ASSERT_EQUAL_UINT32(2 * 3600 + 120 - SAMPLE_HISTORY_SECONDS, oldest->start_s);
+
+    const sample_slot * hour = sample_history_get(history, SAMPLE_RESOLUTION_HOUR, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, hour->start_s);
+    TEST_ASSERT_EQUAL_UINT32(36000, hour->count);
+    TEST_ASSERT_EQUAL_FLOAT(40, hour->channels[SAMPLE_POWER].max);
+    TEST_ASSERT_EQUAL_FLOAT(10, hour->channels[SAMPLE_POWER].min);
+    TEST_ASSERT_FLOAT_WITHIN(0.001, 10 + 30 / 36000.0, hour->channels[SAMPLE_POWER].mean);
+
+    const sample_slot * minute = sample_history_get(history, SAMPLE_RESOLUTION_MINUTE, SAMPLE_HISTORY_MINUTES - 1);
+    TEST_ASSERT_EQUAL_UINT32(2 * 3600, minute->start_s);
+    TEST_ASSERT_EQUAL_UINT32(600, minute->count);
+    free(history);
+}
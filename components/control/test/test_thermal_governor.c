@@ -0,0 +1,90 @@
+#include "unity.h"
+
+#include "thermal_governor.h"
+
+static thermal_governor governor;
+
+static const thermal_limits limits = {
+    .chip_throttle = 75,
+    .chip_max = 90,
+    .vr_throttle = 105,
+    .vr_max = 145,
+};
+
+// feeds the same reading every 2 s for the given time
+static void run(int64_t * now_ms, int64_t duration_ms, float chip_temp, float vr_temp)
+{
+    for (int64_t end = *now_ms + duration_ms; *now_ms < end;) {
+        *now_ms += 2000;
+        thermal_governor_update(&governor, chip_temp, vr_temp, *now_ms);
+    }
+}
+
+TEST_CASE("Thermal governor derates in steps and holds", "[thermal_governor]")
+{
+    int64_t now_ms = 0;
+    thermal_governor_init(&governor, &limits);
+
+    // the first hot reading takes a step at once
+    TEST_ASSERT_TRUE(thermal_governor_update(&governor, 76, 60, now_ms += 2000));
+    TEST_ASSERT_EQUAL(THERMAL_DERATING, governor.stage);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 450, thermal_governor_frequency(&governor, 500));
+
+    // the next one waits for the step to show
+    TEST_ASSERT_FALSE(thermal_governor_update(&governor, 76, 60, now_ms += 2000));
+    run(&now_ms, THERMAL_STEP_INTERVAL_MS, 76, 60);
+    TEST_ASSERT_EQUAL_UINT8(2, governor.steps);
+
+    // between the throttle point and the hysteresis the derate holds
+    run(&now_ms, 10 * THERMAL_RECOVER_MS, 72, 60);
+    TEST_ASSERT_EQUAL(THERMAL_HOLDING, governor.stage);
+    TEST_ASSERT_EQUAL_UINT8(2, governor.steps);
+
+    // a hot regulator derates as well
+    run(&now_ms, 2000, 60, 110);
+    TEST_ASSERT_EQUAL_UINT8(3, governor.steps);
+
+    // never more than the maximum
+    run(&now_ms, 20 * THERMAL_STEP_INTERVAL_MS, 80, 60);
+    TEST_ASSERT_EQUAL_UINT8(THERMAL_MAX_DERATE_STEPS, governor.steps);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 250, thermal_governor_frequency(&governor, 500));
+}
+
+TEST_CASE("Thermal governor recovers a step per recovery time", "[thermal_governor]")
+{
+    int64_t now_ms = 0;
+    thermal_governor_init(&governor, &limits);
+    run(&now_ms, THERMAL_STEP_INTERVAL_MS + 2000, 80, 60);
+    TEST_ASSERT_EQUAL_UINT8(2, governor.steps);
+
+    // the recovery time counts from the first cool reading
+    run(&now_ms, THERMAL_RECOVER_MS, 65, 60);
+    TEST_ASSERT_EQUAL(THERMAL_RECOVERING, governor.stage);
+    TEST_ASSERT_EQUAL_UINT8(2, governor.steps);
+    run(&now_ms, 2000, 65, 60);
+    TEST_ASSERT_EQUAL_UINT8(1, governor.steps);
+
+    // an invalid reading doesn't count as cool
+    run(&now_ms, 2 * THERMAL_RECOVER_MS, -1, 60);
+    TEST_ASSERT_EQUAL_UINT8(1, governor.steps);
+
+    run(&now_ms, THERMAL_RECOVER_MS + 2000, 65, 60);
+    TEST_ASSERT_EQUAL_UINT8(0, governor.steps);
+    TEST_ASSERT_EQUAL(THERMAL_NORMAL, governor.stage);
+}
+
+TEST_CASE("Thermal governor only gives up past the absolute limit", "[thermal_governor]")
+{
+    int64_t now_ms = 0;
+    thermal_governor_init(&governor, &limits);
+
+    run(&now_ms, 60 * THERMAL_STEP_INTERVAL_MS, 89, 144);
+    TEST_ASSERT_EQUAL(THERMAL_DERATING, governor.stage);
+
+    TEST_ASSERT_TRUE(thermal_governor_update(&governor, 60, 145, now_ms += 2000));
+    TEST_ASSERT_EQUAL(THERMAL_RUNAWAY, governor.stage);
+
+    // runaway sticks, the governor doesn't undo a shutdown
+    TEST_ASSERT_FALSE(thermal_governor_update(&governor, 40, 40, now_ms += 2000));
+    TEST_ASSERT_EQUAL(THERMAL_RUNAWAY, governor.stage);
+}
@@ -0,0 +1,84 @@
+#include "thermal_governor.h"
+
+void thermal_governor_init(thermal_governor * governor, const thermal_limits * limits)
+{
+    governor->limits = *limits;
+    governor->stage = THERMAL_NORMAL;
+    governor->steps = 0;
+    governor->changed_ms = 0;
+    governor->cool_since_ms = -1;
+}
+
+bool thermal_governor_update(thermal_governor * governor, float chip_temp, float vr_temp, int64_t now_ms)
+{
+    const thermal_limits * limits = &governor->limits;
+    bool chip_valid = chip_temp >= 0;
+    uint8_t steps = governor->steps;
+
+    if (governor->stage == THERMAL_RUNAWAY) {
+        return false;
+    }
+    if ((chip_valid && chip_temp >= limits->chip_max) || vr_temp >= limits->vr_max) {
+        governor->stage = THERMAL_RUNAWAY;
+        return true;
+    }
+
+    bool hot = (chip_valid && chip_temp >= limits->chip_throttle) || vr_temp >= limits->vr_throttle;
+    // an invalid chip reading never counts as cool
+    bool cool = chip_valid && chip_temp < limits->chip_throttle - THERMAL_HYSTERESIS && vr_temp < limits->vr_throttle - THERMAL_HYSTERESIS;
+
+    if (hot) {
+        governor->cool_since_ms = -1;
+        governor->stage = THERMAL_DERATING;
+        if (governor->steps < THERMAL_MAX_DERATE_STEPS && (governor->steps == 0 || now_ms - governor->changed_ms >= THERMAL_STEP_INTERVAL_MS)) {
+            governor->steps++;
+        }
+    } else if (governor->steps == 0) {
+        governor->stage = THERMAL_NORMAL;
+    } else if (cool) {
+        governor->stage = THERMAL_RECOVERING;
+        if (governor->cool_since_ms < 0) {
+            governor->cool_since_ms = now_ms;
+        }
+        // each step back needs a full recovery time of its own
+        if (now_ms - governor->cool_since_ms >= THERMAL_RECOVER_MS) {
+            governor->steps--;
+            governor->cool_since_ms = now_ms;
+            if (governor->steps == 0) {
+                governor->stage = THERMAL_NORMAL;
+            }
+        }
+    } else {
+        governor->cool_since_ms = -1;
+        governor->stage = THERMAL_HOLDING;
+    }
+
+    if (governor->steps == steps) {
+        return false;
+    }
+    governor->changed_ms = now_ms;
+    return true;
+}
+
+float thermal_governor_frequency(const thermal_governor * governor, float frequency)
+{
+    return frequency * (1 - governor->steps * THERMAL_DERATE_STEP);
+}
+
+const char * thermal_governor_stage_name(thermal_stage stage)
+{
+    switch (stage) {
+        case THERMAL_NORMAL:
+            return "normal";
+        case THERMAL_DERATING:
+            return "derating";
+        case THERMAL_HOLDING:
+            return "holding";
+        case THERMAL_RECOVERING:
+            return "recovering";
+        case THERMAL_RUNAWAY:
+            return "runaway";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef SHARE_FILTER_H_
+#define SHARE_FILTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "mining.h"
+
+// Number of shares remembered per generation. The filter keeps the current and
+// the previous generation, so at least this many recent shares are always covered.
+// 128 job ids at ~500ms each is roughly a minute of live work, which is well under
+// 256 nonces even on a GammaTurbo at the default ticket mask.
+#define SHARE_FILTER_CAPACITY 256
+#define SHARE_FILTER_WINDOW_S 64
+
+// nonces per second across all chains the filter covers a full window of live work at,
+// the adaptive ticket mask is never lowered past it
+#define SHARE_FILTER_MAX_RATE ((double) SHARE_FILTER_CAPACITY / SHARE_FILTER_WINDOW_S)
+
+// Open addressing table size per generation, kept at 50% load
+#define SHARE_FILTER_SLOTS (SHARE_FILTER_CAPACITY * 2)
+
+typedef struct
+{
+    uint64_t keys[2][SHARE_FILTER_SLOTS];
+    int current;
+    int count;
+    uint64_t duplicates;
+    pthread_mutex_t lock;
+} share_filter;
+
+void share_filter_init(share_filter * filter);
+void share_filter_clear(share_filter * filter);
+
+uint64_t share_filter_key(const bm_job * job, uint32_t nonce, uint32_t rolled_version);
+
+/// @brief checks if a share was already seen and remembers it otherwise
+/// @return true if the share is a duplicate and must not be submitted
+bool share_filter_check(share_filter * filter, const bm_job * job, uint32_t nonce, uint32_t rolled_version);
+
+#endif /* SHARE_FILTER_H_ */
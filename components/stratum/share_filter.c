@@ -0,0 +1,123 @@
+#include <string.h>
+
+#include "share_filter.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t _fnv1a(uint64_t hash, const void * data, size_t len)
+{
+    const uint8_t * bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer, spreads the bits so the low bits can be used as the slot index
+static uint64_t _mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static bool _contains(const uint64_t * keys, uint64_t key)
+{
+    for (int i = 0; i < SHARE_FILTER_SLOTS; i++) {
+        uint64_t slot = keys[(key + i) & (SHARE_FILTER_SLOTS - 1)];
+        if (slot == 0) {
+            return false;
+        }
+        if (slot == key) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void _insert(uint64_t * keys, uint64_t key)
+{
+    for (int i = 0; i < SHARE_FILTER_SLOTS; i++) {
+        uint64_t * slot = &keys[(key + i) & (SHARE_FILTER_SLOTS - 1)];
+        if (*slot == 0) {
+            *slot = key;
+            return;
+        }
+    }
+}
+
+void share_filter_init(share_filter * filter)
+{
+    memset(filter->keys, 0, sizeof(filter->keys));
+    filter->current = 0;
+    filter->count = 0;
+    filter->duplicates = 0;
+    pthread_mutex_init(&filter->lock, NULL);
+}
+
+void share_filter_clear(share_filter * filter)
+{
+    pthread_mutex_lock(&filter->lock);
+    memset(filter->keys, 0, sizeof(filter->keys));
+    filter->current = 0;
+    filter->count = 0;
+    pthread_mutex_unlock(&filter->lock);
+}
+
+// The job generation is identified by the stratum job id, the extranonce2 and the ntime
+// that were rolled into the work. These are unique per job handed to the ASIC, even when
+// the 7 bit ASIC job id slot is reused.
+uint64_t share_filter_key(const bm_job * job, uint32_t nonce, uint32_t rolled_version)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    if (job->jobid != NULL) {
+        hash = _fnv1a(hash, job->jobid, strlen(job->jobid) + 1);
+    }
+    if (job->extranonce2 != NULL) {
+        hash = _fnv1a(hash, job->extranonce2, strlen(job->extranonce2) + 1);
+    }
+    hash = _fnv1a(hash, &job->ntime, sizeof(job->ntime));
+    hash = _fnv1a(hash, &nonce, sizeof(nonce));
+    hash = _fnv1a(hash, &rolled_version, sizeof(rolled_version));
+
+    uint64_t key = _mix(hash);
+
+    // 0 marks an empty slot
+    return key == 0 ? 1 : key;
+}
+
+bool share_filter_check(share_filter * filter, const bm_job * job, uint32_t nonce, uint32_t rolled_version)
+{
+    uint64_t key = share_filter_key(job, nonce, rolled_version);
+
+    pthread_mutex_lock(&filter->lock);
+
+    uint64_t * current = filter->keys[filter->current];
+    uint64_t * previous = filter->keys[filter->current ^ 1];
+
+    if (_contains(current, key) || _contains(previous, key)) {
+        filter->duplicates++;
+        pthread_mutex_unlock(&filter->lock);
+        return true;
+    }
+
+    // current generation is full, retire the previous one and start over
+    if (filter->count >= SHARE_FILTER_CAPACITY) {
+        filter->current ^= 1;
+        current = filter->keys[filter->current];
+        memset(current, 0, sizeof(filter->keys[0]));
+        filter->count = 0;
+    }
+
+    _insert(current, key);
+    filter->count++;
+
+    pthread_mutex_unlock(&filter->lock);
+    return false;
+}
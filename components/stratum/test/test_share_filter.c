@@ -0,0 +1,66 @@
+#include "unity.h"
+#include "share_filter.h"
+
+static share_filter filter;
+
+static bm_job make_job(char * jobid, char * extranonce2, uint32_t ntime)
+{
+    bm_job job = {0};
+    job.jobid = jobid;
+    job.extranonce2 = extranonce2;
+    job.ntime = ntime;
+    return job;
+}
+
+TEST_CASE("Share filter drops repeated shares", "[share_filter]")
+{
+    share_filter_init(&filter);
+    bm_job job = make_job("1a2b", "00000001", 0x64658bd8);
+
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &job, 0x0a4c049b, 0x20000004));
+    TEST_ASSERT_TRUE(share_filter_check(&filter, &job, 0x0a4c049b, 0x20000004));
+    TEST_ASSERT_EQUAL_UINT64(1, filter.duplicates);
+}
+
+TEST_CASE("Share filter keeps distinct shares", "[share_filter]")
+{
+    share_filter_init(&filter);
+    bm_job job = make_job("1a2b", "00000001", 0x64658bd8);
+    bm_job next_extranonce = make_job("1a2b", "00000002", 0x64658bd8);
+    bm_job next_job = make_job("1a2c", "00000001", 0x64658bd8);
+
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &job, 0x0a4c049b, 0x20000004));
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &job, 0x0a4c049c, 0x20000004));
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &job, 0x0a4c049b, 0x20002004));
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &next_extranonce, 0x0a4c049b, 0x20000004));
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &next_job, 0x0a4c049b, 0x20000004));
+    TEST_ASSERT_EQUAL_UINT64(0, filter.duplicates);
+}
+
+TEST_CASE("Share filter forgets shares after clean jobs", "[share_filter]")
+{
+    share_filter_init(&filter);
+    bm_job job = make_job("1a2b", "00000001", 0x64658bd8);
+
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &job, 0x0a4c049b, 0x20000004));
+    share_filter_clear(&filter);
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &job, 0x0a4c049b, 0x20000004));
+}
+
+TEST_CASE("Share filter remembers at least one full generation", "[share_filter]")
+{
+    share_filter_init(&filter);
+    bm_job job = make_job("1a2b", "00000001", 0x64658bd8);
+
+    for (uint32_t nonce = 0; nonce < SHARE_FILTER_CAPACITY * 3; nonce++) {
+        TEST_ASSERT_FALSE(share_filter_check(&filter, &job, nonce, 0x20000004));
+    }
+
+    // the most recent SHARE_FILTER_CAPACITY shares are always covered
+    for (uint32_t nonce = SHARE_FILTER_CAPACITY * 2; nonce < SHARE_FILTER_CAPACITY * 3; nonce++) {
+        TEST_ASSERT_TRUE(share_filter_check(&filter, &job, nonce, 0x20000004));
+    }
+
+    // the oldest generation has been retired
+    TEST_ASSERT_FALSE(share_filter_check(&filter, &job, 0, 0x20000004));
+}
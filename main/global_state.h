@@ -7,6 +7,7 @@
 #include "common.h"
 #include "power_management_task.h"
 #include "serial.h"
+#include "share_filter.h"
 #include "stratum_api.h"
 #include "work_queue.h"
 
@@ -61,6 +62,15 @@ typedef struct
     int64_t start_time;
     uint64_t shares_accepted;
     uint64_t shares_rejected;
+    // rejects that said the job was already gone, trims the ASIC job interval
+    uint64_t shares_stale;
+    // nonces that passed the duplicate filter
+    uint64_t nonces_found;
+    // nonces below the ticket mask they were found with
+    uint64_t hw_errors;
+    // ticket mask difficulty summed over valid nonces and hardware errors, the work each of them stands for
+    double nonce_difficulty_sum;
+    double hw_error_difficulty_sum;
     RejectedReasonStat rejected_reason_stats[10];
     int rejected_reason_stats_count;
     int screen_page;
@@ -84,6 +94,13 @@ typedef struct
     char * pool_pass;
     char * fallback_pool_pass;
     bool is_using_fallback;
+    // false from a dropped pool connection until the next mining.notify, and when that last changed
+    bool has_work;
+    int64_t work_changed_us;
+    // when the last mining.notify came in, a pool that stops sending them runs out of valid jobs too
+    int64_t last_notify_us;
+    // when the pool answered the last subscribe, 0 once it sent work or the connection dropped
+    int64_t handshake_us;
     uint16_t overheat_mode;
     uint16_t power_fault;
     uint32_t lastClockSync;
@@ -110,10 +127,10 @@ typedef struct
     AsicModel asic_model;
     char * asic_model_str;
     double asic_job_frequency_ms;
+    // ticket mask difficulty every chain starts from, see AsicChain.ticket_mask for the current one
     uint32_t ASIC_difficulty;
 
     work_queue stratum_queue;
-    work_queue ASIC_jobs_queue;
 
     SystemModule SYSTEM_MODULE;
     AsicTaskModule ASIC_TASK_MODULE;
@@ -124,8 +141,7 @@ typedef struct
     int extranonce_2_len;
     int abandon_work;
 
-    uint8_t * valid_jobs;
-    pthread_mutex_t valid_jobs_lock;
+    share_filter duplicate_share_filter;
 
     uint32_t stratum_difficulty;
     uint32_t version_mask;
@@ -137,6 +153,10 @@ typedef struct
     // For requests not expecting a response (called notifications), this is null.
     int send_uid;
 
+    // taken by the result task of each chain around a submit and the share accounting after it,
+    // and by the stratum task while it hands out the handshake ids
+    pthread_mutex_t share_lock;
+
     bool ASIC_initalized;
     bool psram_is_available;
 } GlobalState;
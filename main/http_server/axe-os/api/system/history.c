@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "power_sampler_task.h"
+#include "history.h"
+
+// Function declarations from http_server.c
+extern esp_err_t is_network_allowed(httpd_req_t *req);
+extern esp_err_t set_cors_headers(httpd_req_t *req);
+
+static const char * resolution_names[SAMPLE_RESOLUTIONS] = {"second", "minute", "hour"};
+static const char * channel_names[SAMPLE_CHANNELS] = {"voltage", "current", "power", "vrTemp", "chipTemp", "fanRpm"};
+
+/* Handler for system history endpoint */
+esp_err_t GET_system_history(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    sample_resolution resolution = SAMPLE_RESOLUTION_SECOND;
+    char query[32];
+    char value[16];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "resolution", value, sizeof(value)) == ESP_OK) {
+        for (resolution = 0; resolution < SAMPLE_RESOLUTIONS; resolution++) {
+            if (strcmp(value, resolution_names[resolution]) == 0) {
+                break;
+            }
+        }
+        if (resolution == SAMPLE_RESOLUTIONS) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown resolution");
+        }
+    }
+
+    // copied out so the sampler isn't held up while the response goes out
+    const sample_history * history = power_sampler_acquire();
+    if (history == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No sample history");
+    }
+    uint16_t count = sample_history_count(history, resolution);
+    sample_slot * slots = malloc(count * sizeof(sample_slot) + 1);
+    if (slots == NULL) {
+        power_sampler_release();
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No memory for the history");
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        slots[i] = *sample_history_get(history, resolution, i);
+    }
+    power_sampler_release();
+
+    // a few hundred slots as cJSON objects would need more heap than the copy, they are written one by one
+    char buffer[512];
+    snprintf(buffer, sizeof(buffer), "{\"resolution\":\"%s\",\"period\":%lu,\"sampleRate\":%u,\"uptimeSeconds\":%lu,\"slots\":[",
+             resolution_names[resolution], (unsigned long) sample_history_period_s(resolution), power_sampler_rate(),
+             (unsigned long) (esp_timer_get_time() / 1000000));
+    httpd_resp_sendstr_chunk(req, buffer);
+
+    for (uint16_t i = 0; i < count; i++) {
+        int length = snprintf(buffer, sizeof(buffer), "%s{\"time\":%lu,\"count\":%lu", i == 0 ? "" : ",",
+                              (unsigned long) slots[i].start_s, (unsigned long) slots[i].count);
+        for (int channel = 0; channel < SAMPLE_CHANNELS; channel++) {
+            const sample_stat * stat = &slots[i].channels[channel];
+            length += snprintf(buffer + length, sizeof(buffer) - length, ",\"%s\":[%.2f,%.2f,%.2f]",
+                               channel_names[channel], stat->min, stat->max, stat->mean);
+        }
+        snprintf(buffer + length, sizeof(buffer) - length, "}");
+        if (httpd_resp_sendstr_chunk(req, buffer) != ESP_OK) {
+            free(slots);
+            return ESP_FAIL;
+        }
+    }
+    free(slots);
+
+    httpd_resp_sendstr_chunk(req, "]}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
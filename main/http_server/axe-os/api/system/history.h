@@ -0,0 +1,9 @@
+#ifndef HISTORY_API_H_
+#define HISTORY_API_H_
+
+#include <esp_http_server.h>
+
+// Function to handle the /api/system/history endpoint
+esp_err_t GET_system_history(httpd_req_t *req);
+
+#endif // HISTORY_API_H_
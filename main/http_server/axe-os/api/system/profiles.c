@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_http_server.h"
+#include "cJSON.h"
+#include "global_state.h"
+#include "nvs_config.h"
+#include "power_profile.h"
+#include "profiles.h"
+
+#define PROFILES_MAX_BODY 4096
+#define PROFILES_TEXT_LENGTH 512
+#define SCHEDULE_TZ_DEFAULT "UTC0"
+#define SCHEDULE_TZ_LENGTH 64
+
+static GlobalState *GLOBAL_STATE = NULL;
+
+// Function declarations from http_server.c
+extern esp_err_t is_network_allowed(httpd_req_t *req);
+extern esp_err_t set_cors_headers(httpd_req_t *req);
+
+// Initialize the profiles API with the global state
+void profiles_api_init(GlobalState *global_state) {
+    GLOBAL_STATE = global_state;
+}
+
+// a missing or null field leaves the setting as it is, so does 0 unless it means off like for the power cap
+static bool _get_u16(cJSON *object, const char *name, bool zero_is_off, uint16_t *value)
+{
+    cJSON *item = cJSON_GetObjectItem(object, name);
+
+    if (item == NULL || cJSON_IsNull(item)) {
+        *value = POWER_PROFILE_UNSET;
+        return true;
+    }
+    if (!cJSON_IsNumber(item) || item->valuedouble < 0 || item->valuedouble >= POWER_PROFILE_UNSET) {
+        return false;
+    }
+    *value = item->valueint == 0 && !zero_is_off ? POWER_PROFILE_UNSET : item->valueint;
+    return true;
+}
+
+static void _add_u16(cJSON *object, const char *name, uint16_t value)
+{
+    if (value != POWER_PROFILE_UNSET) {
+        cJSON_AddNumberToObject(object, name, value);
+    }
+}
+
+static const char *_parse_profiles(cJSON *array, power_profile *profiles, uint8_t *count)
+{
+    if (!cJSON_IsArray(array) || cJSON_GetArraySize(array) > POWER_PROFILE_MAX_COUNT) {
+        return "profiles must be an array of at most 8";
+    }
+
+    *count = 0;
+    cJSON *item;
+    cJSON_ArrayForEach(item, array) {
+        power_profile *profile = &profiles[*count];
+        cJSON *name = cJSON_GetObjectItem(item, "name");
+
+        memset(profile, 0, sizeof(*profile));
+        if (!cJSON_IsString(name) || !power_profile_name_valid(name->valuestring)) {
+            return "profile names are 1 to 15 letters, digits, '-' or '_'";
+        }
+        if (power_profile_find(profiles, *count, name->valuestring) != NULL) {
+            return "profile names must be unique";
+        }
+        strcpy(profile->name, name->valuestring);
+        if (!_get_u16(item, "frequency", false, &profile->frequency) || !_get_u16(item, "coreVoltage", false, &profile->voltage) ||
+            !_get_u16(item, "temptarget", false, &profile->temp_target) || !_get_u16(item, "powerCap", true, &profile->power_cap)) {
+            return "profile settings must be numbers from 0 to 65534 or null";
+        }
+        (*count)++;
+    }
+    return NULL;
+}
+
+static const char *_parse_schedule(cJSON *array, const power_profile *profiles, uint8_t profile_count,
+                                   power_schedule_entry *entries, uint8_t *count)
+{
+    if (!cJSON_IsArray(array) || cJSON_GetArraySize(array) > POWER_SCHEDULE_MAX_ENTRIES) {
+        return "schedule must be an array of at most 16";
+    }
+
+    *count = 0;
+    cJSON *item;
+    cJSON_ArrayForEach(item, array) {
+        power_schedule_entry *entry = &entries[*count];
+        cJSON *days = cJSON_GetObjectItem(item, "days");
+        cJSON *start = cJSON_GetObjectItem(item, "start");
+        cJSON *profile = cJSON_GetObjectItem(item, "profile");
+        unsigned hour, minute;
+        char end;
+
+        memset(entry, 0, sizeof(*entry));
+        if (!cJSON_IsArray(days)) {
+            return "schedule days must be an array of 0 (Sunday) to 6";
+        }
+        cJSON *day;
+        cJSON_ArrayForEach(day, days) {
+            if (!cJSON_IsNumber(day) || day->valueint < 0 || day->valueint > 6) {
+                return "schedule days must be an array of 0 (Sunday) to 6";
+            }
+            entry->days |= 1 << day->valueint;
+        }
+        if (entry->days == 0) {
+            return "schedule days must be an array of 0 (Sunday) to 6";
+        }
+        if (!cJSON_IsString(start) || sscanf(start->valuestring, "%u:%u%c", &hour, &minute, &end) != 2 ||
+            hour > 23 || minute > 59) {
+            return "schedule start must be HH:MM";
+        }
+        entry->minute = hour * 60 + minute;
+        if (!cJSON_IsString(profile) || power_profile_find(profiles, profile_count, profile->valuestring) == NULL) {
+            return "schedule entries must name a profile";
+        }
+        strcpy(entry->profile, profile->valuestring);
+        (*count)++;
+    }
+    return NULL;
+}
+
+/* Handler for fetching the power profiles and their schedule */
+esp_err_t GET_system_profiles(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    char *text = nvs_config_get_string(NVS_CONFIG_PROFILES, "");
+    power_profile profiles[POWER_PROFILE_MAX_COUNT];
+    uint8_t profile_count = power_profiles_parse(text, profiles, POWER_PROFILE_MAX_COUNT);
+    free(text);
+
+    text = nvs_config_get_string(NVS_CONFIG_SCHEDULE, "");
+    power_schedule_entry entries[POWER_SCHEDULE_MAX_ENTRIES];
+    uint8_t entry_count = power_schedule_parse(text, entries, POWER_SCHEDULE_MAX_ENTRIES);
+    free(text);
+
+    cJSON *root = cJSON_CreateObject();
+
+    cJSON *profile_array = cJSON_CreateArray();
+    for (uint8_t i = 0; i < profile_count; i++) {
+        cJSON *profile_obj = cJSON_CreateObject();
+        cJSON_AddStringToObject(profile_obj, "name", profiles[i].name);
+        _add_u16(profile_obj, "frequency", profiles[i].frequency);
+        _add_u16(profile_obj, "coreVoltage", profiles[i].voltage);
+        _add_u16(profile_obj, "temptarget", profiles[i].temp_target);
+        _add_u16(profile_obj, "powerCap", profiles[i].power_cap);
+        cJSON_AddItemToArray(profile_array, profile_obj);
+    }
+    cJSON_AddItemToObject(root, "profiles", profile_array);
+
+    cJSON *schedule_array = cJSON_CreateArray();
+    for (uint8_t i = 0; i < entry_count; i++) {
+        cJSON *entry_obj = cJSON_CreateObject();
+        cJSON *days = cJSON_CreateArray();
+        for (int day = 0; day < 7; day++) {
+            if (entries[i].days & (1 << day)) {
+                cJSON_AddItemToArray(days, cJSON_CreateNumber(day));
+            }
+        }
+        cJSON_AddItemToObject(entry_obj, "days", days);
+        char start[6];
+        snprintf(start, sizeof(start), "%02u:%02u", entries[i].minute / 60, entries[i].minute % 60);
+        cJSON_AddStringToObject(entry_obj, "start", start);
+        cJSON_AddStringToObject(entry_obj, "profile", entries[i].profile);
+        cJSON_AddItemToArray(schedule_array, entry_obj);
+    }
+    cJSON_AddItemToObject(root, "schedule", schedule_array);
+
+    text = nvs_config_get_string(NVS_CONFIG_SCHEDULE_TZ, SCHEDULE_TZ_DEFAULT);
+    cJSON_AddStringToObject(root, "timezone", text);
+    free(text);
+
+    // the schedule waits for the first job to set the clock
+    cJSON_AddBoolToObject(root, "clockSet", GLOBAL_STATE->SYSTEM_MODULE.lastClockSync != 0);
+    if (GLOBAL_STATE->POWER_MANAGEMENT_MODULE.active_profile != NULL) {
+        cJSON_AddStringToObject(root, "activeProfile", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.active_profile);
+    } else {
+        cJSON_AddNullToObject(root, "activeProfile");
+    }
+
+    const char *response = cJSON_Print(root);
+    httpd_resp_sendstr(req, response);
+
+    free((void *)response);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+/* Handler for replacing the power profiles, the schedule or the timezone, a field left out stays as it is */
+esp_err_t PUT_system_profiles(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    int total_len = req->content_len;
+    int cur_len = 0;
+    if (total_len >= PROFILES_MAX_BODY) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "content too long");
+        return ESP_OK;
+    }
+    char *buf = malloc(total_len + 1);
+    if (buf == NULL) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+    while (cur_len < total_len) {
+        int received = httpd_req_recv(req, buf + cur_len, total_len - cur_len);
+        if (received <= 0) {
+            free(buf);
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive profiles");
+            return ESP_OK;
+        }
+        cur_len += received;
+    }
+    buf[total_len] = '\0';
+
+    cJSON *root = cJSON_Parse(buf);
+    free(buf);
+    if (root == NULL) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_OK;
+    }
+
+    // everything is checked before anything is stored, a schedule has to name profiles that exist
+    power_profile profiles[POWER_PROFILE_MAX_COUNT];
+    uint8_t profile_count = 0;
+    power_schedule_entry entries[POWER_SCHEDULE_MAX_ENTRIES];
+    uint8_t entry_count = 0;
+    const char *error = NULL;
+
+    cJSON *profiles_item = cJSON_GetObjectItem(root, "profiles");
+    if (profiles_item != NULL) {
+        error = _parse_profiles(profiles_item, profiles, &profile_count);
+    } else {
+        char *text = nvs_config_get_string(NVS_CONFIG_PROFILES, "");
+        profile_count = power_profiles_parse(text, profiles, POWER_PROFILE_MAX_COUNT);
+        free(text);
+    }
+
+    cJSON *schedule_item = cJSON_GetObjectItem(root, "schedule");
+    bool store_schedule = schedule_item != NULL || profiles_item != NULL;
+    if (error == NULL && schedule_item != NULL) {
+        error = _parse_schedule(schedule_item, profiles, profile_count, entries, &entry_count);
+    } else if (error == NULL && profiles_item != NULL) {
+        // the stored schedule loses the entries of profiles that went away
+        char *text = nvs_config_get_string(NVS_CONFIG_SCHEDULE, "");
+        power_schedule_entry stored[POWER_SCHEDULE_MAX_ENTRIES];
+        uint8_t stored_count = power_schedule_parse(text, stored, POWER_SCHEDULE_MAX_ENTRIES);
+        free(text);
+
+        entry_count = 0;
+        for (uint8_t i = 0; i < stored_count; i++) {
+            if (power_profile_find(profiles, profile_count, stored[i].profile) != NULL) {
+                entries[entry_count++] = stored[i];
+            }
+        }
+    }
+
+    cJSON *timezone = cJSON_GetObjectItem(root, "timezone");
+    if (error == NULL && timezone != NULL &&
+        (!cJSON_IsString(timezone) || timezone->valuestring[0] == '\0' || strlen(timezone->valuestring) >= SCHEDULE_TZ_LENGTH)) {
+        error = "timezone must be a POSIX TZ string such as CET-1CEST,M3.5.0,M10.5.0/3";
+    }
+
+    if (error != NULL) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, error);
+        cJSON_Delete(root);
+        return ESP_OK;
+    }
+
+    char text[PROFILES_TEXT_LENGTH];
+    if (profiles_item != NULL) {
+        power_profiles_format(profiles, profile_count, text, sizeof(text));
+        nvs_config_set_string(NVS_CONFIG_PROFILES, text);
+    }
+    if (store_schedule) {
+        power_schedule_format(entries, entry_count, text, sizeof(text));
+        nvs_config_set_string(NVS_CONFIG_SCHEDULE, text);
+    }
+    if (timezone != NULL) {
+        nvs_config_set_string(NVS_CONFIG_SCHEDULE_TZ, timezone->valuestring);
+    }
+
+    cJSON_Delete(root);
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
@@ -0,0 +1,14 @@
+#ifndef PROFILES_API_H_
+#define PROFILES_API_H_
+
+#include <esp_http_server.h>
+#include "global_state.h"
+
+// Functions to handle the /api/system/profiles endpoint
+esp_err_t GET_system_profiles(httpd_req_t *req);
+esp_err_t PUT_system_profiles(httpd_req_t *req);
+
+// Initialize the profiles API with the global state
+void profiles_api_init(GlobalState *global_state);
+
+#endif // PROFILES_API_H_
@@ -1,5 +1,6 @@
 #include <pthread.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/param.h>
 
@@ -34,9 +35,16 @@
 #include "power.h"
 #include "connect.h"
 #include "asic.h"
+#include "serial.h"
+#include "asic_telemetry.h"
+#include "autotune.h"
+#include "fan_control.h"
+#include "power_sampler_task.h"
 #include "TPS546.h"
 #include "theme_api.h"  // Add theme API include
 #include "axe-os/api/system/asic_settings.h"
+#include "axe-os/api/system/history.h"
+#include "axe-os/api/system/profiles.h"
 #include "http_server.h"
 
 static const char * TAG = "http_server";
@@ -419,6 +427,16 @@ static esp_err_t PATCH_update_settings(httpd_req_t * req)
         return ESP_OK;
     }
 
+    // checked before anything is stored, a rejected request changes nothing
+    if (((item = cJSON_GetObjectItem(root, "autotune")) != NULL &&
+         (item->valueint < AUTOTUNE_OFF || item->valueint > AUTOTUNE_POWER_CAP)) ||
+        ((item = cJSON_GetObjectItem(root, "powerCap")) != NULL && item->valueint > UINT16_MAX) ||
+        ((item = cJSON_GetObjectItem(root, "autotunePowerCap")) != NULL && item->valueint > UINT16_MAX)) {
+        cJSON_Delete(root);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Setting out of range");
+        return ESP_OK;
+    }
+
     if (cJSON_IsString(item = cJSON_GetObjectItem(root, "stratumURL"))) {
         nvs_config_set_string(NVS_CONFIG_STRATUM_URL, item->valuestring);
     }
@@ -458,6 +476,10 @@ static esp_err_t PATCH_update_settings(httpd_req_t * req)
     if ((item = cJSON_GetObjectItem(root, "frequency")) != NULL && item->valueint > 0) {
         nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, item->valueint);
     }
+    // comma separated MHz caps, one per chip, empty or 0 follows "frequency"
+    if (cJSON_IsString(item = cJSON_GetObjectItem(root, "chipFrequencies"))) {
+        nvs_config_set_string(NVS_CONFIG_ASIC_CHIP_FREQ, item->valuestring);
+    }
     if ((item = cJSON_GetObjectItem(root, "flipscreen")) != NULL) {
         nvs_config_set_u16(NVS_CONFIG_FLIP_SCREEN, item->valueint);
     }
@@ -479,9 +501,32 @@ static esp_err_t PATCH_update_settings(httpd_req_t * req)
     if ((item = cJSON_GetObjectItem(root, "temptarget")) != NULL) {
         nvs_config_set_u16(NVS_CONFIG_TEMP_TARGET, item->valueint);
     }
+    // picked up by the fan controller, which clears it once the relay test starts
+    if ((item = cJSON_GetObjectItem(root, "fanAutotune")) != NULL && item->valueint == 1) {
+        nvs_config_set_u16(NVS_CONFIG_FAN_AUTOTUNE, 1);
+    }
+    if ((item = cJSON_GetObjectItem(root, "sampleRate")) != NULL && item->valueint > 0) {
+        nvs_config_set_u16(NVS_CONFIG_SAMPLE_RATE, item->valueint);
+    }
+    if ((item = cJSON_GetObjectItem(root, "idleTimeout")) != NULL && item->valueint >= 0) {
+        nvs_config_set_u16(NVS_CONFIG_IDLE_TIMEOUT, item->valueint);
+    }
     if ((item = cJSON_GetObjectItem(root, "overclockEnabled")) != NULL) {
         nvs_config_set_u16(NVS_CONFIG_OVERCLOCK_ENABLED, item->valueint);
     }
+    if ((item = cJSON_GetObjectItem(root, "powerCap")) != NULL && item->valueint >= 0) {
+        nvs_config_set_u16(NVS_CONFIG_POWER_CAP, item->valueint);
+    }
+    if ((item = cJSON_GetObjectItem(root, "autotune")) != NULL) {
+        nvs_config_set_u16(NVS_CONFIG_AUTOTUNE, item->valueint);
+    }
+    if ((item = cJSON_GetObjectItem(root, "autotunePowerCap")) != NULL && item->valueint > 0) {
+        nvs_config_set_u16(NVS_CONFIG_AUTOTUNE_POWER, item->valueint);
+    }
+    // picked up by the power management task, which clears it once the sweep starts
+    if ((item = cJSON_GetObjectItem(root, "autotuneSweep")) != NULL && item->valueint == 1) {
+        nvs_config_set_u16(NVS_CONFIG_AUTOTUNE_SWEEP, 1);
+    }
 
     cJSON_Delete(root);
     httpd_resp_send_chunk(req, NULL, 0);
@@ -542,6 +587,7 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     char * stratumUser = nvs_config_get_string(NVS_CONFIG_STRATUM_USER, CONFIG_STRATUM_USER);
     char * fallbackStratumUser = nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER, CONFIG_FALLBACK_STRATUM_USER);
     char * board_version = nvs_config_get_string(NVS_CONFIG_BOARD_VERSION, "unknown");
+    char * chip_frequencies = nvs_config_get_string(NVS_CONFIG_ASIC_CHIP_FREQ, "");
 
     esp_wifi_get_mac(WIFI_IF_STA, mac);
     snprintf(formattedMac, 18, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
@@ -556,6 +602,20 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     cJSON_AddNumberToObject(root, "temp", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.chip_temp_avg);
     cJSON_AddNumberToObject(root, "vrTemp", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.vr_temp);
     cJSON_AddNumberToObject(root, "maxPower", Power_get_max_settings(GLOBAL_STATE));
+    cJSON_AddNumberToObject(root, "powerCap", nvs_config_get_u16(NVS_CONFIG_POWER_CAP, 0));
+    cJSON_AddBoolToObject(root, "powerLimited", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power_limited);
+    if (GLOBAL_STATE->POWER_MANAGEMENT_MODULE.thermal_stage != NULL) {
+        cJSON_AddStringToObject(root, "thermalStage", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.thermal_stage);
+    }
+    cJSON_AddNumberToObject(root, "thermalDerate", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.thermal_derate);
+    cJSON_AddNumberToObject(root, "faultDerate", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fault_derate);
+    cJSON_AddNumberToObject(root, "faultRecoveries", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fault_recoveries);
+    cJSON_AddNumberToObject(root, "sampleRate", power_sampler_rate());
+    cJSON_AddBoolToObject(root, "idle", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.idle);
+    cJSON_AddNumberToObject(root, "idleTimeout", nvs_config_get_u16(NVS_CONFIG_IDLE_TIMEOUT, 60));
+    if (GLOBAL_STATE->POWER_MANAGEMENT_MODULE.active_profile != NULL) {
+        cJSON_AddStringToObject(root, "activeProfile", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.active_profile);
+    }
     cJSON_AddNumberToObject(root, "nominalVoltage", Power_get_nominal_voltage(GLOBAL_STATE));
     cJSON_AddNumberToObject(root, "hashRate", GLOBAL_STATE->SYSTEM_MODULE.current_hashrate);
     cJSON_AddStringToObject(root, "bestDiff", GLOBAL_STATE->SYSTEM_MODULE.best_diff_string);
@@ -570,6 +630,7 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     cJSON_AddNumberToObject(root, "coreVoltage", nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE, CONFIG_ASIC_VOLTAGE));
     cJSON_AddNumberToObject(root, "coreVoltageActual", VCORE_get_voltage_mv(GLOBAL_STATE));
     cJSON_AddNumberToObject(root, "frequency", nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY));
+    cJSON_AddStringToObject(root, "chipFrequencies", chip_frequencies);
     cJSON_AddStringToObject(root, "ssid", ssid);
     cJSON_AddStringToObject(root, "macAddr", formattedMac);
     cJSON_AddStringToObject(root, "hostname", hostname);
@@ -578,6 +639,33 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     cJSON_AddNumberToObject(root, "apEnabled", GLOBAL_STATE->SYSTEM_MODULE.ap_enabled);
     cJSON_AddNumberToObject(root, "sharesAccepted", GLOBAL_STATE->SYSTEM_MODULE.shares_accepted);
     cJSON_AddNumberToObject(root, "sharesRejected", GLOBAL_STATE->SYSTEM_MODULE.shares_rejected);
+    cJSON_AddNumberToObject(root, "duplicateShares", GLOBAL_STATE->duplicate_share_filter.duplicates);
+    cJSON_AddNumberToObject(root, "hwErrors", GLOBAL_STATE->SYSTEM_MODULE.hw_errors);
+    // share of the work the nonces stand for, so errors at a high ticket mask aren't undercounted
+    double hw_error_work = GLOBAL_STATE->SYSTEM_MODULE.hw_error_difficulty_sum;
+    double nonce_work = hw_error_work + GLOBAL_STATE->SYSTEM_MODULE.nonce_difficulty_sum;
+    cJSON_AddNumberToObject(root, "hwErrorRate", nonce_work > 0 ? hw_error_work / nonce_work * 100 : 0);
+    // link counters summed over all chains, the job transmit time is the slowest chain's
+    uint32_t uart_resyncs = 0;
+    uint32_t uart_bytes_discarded = 0;
+    uint32_t uart_overflows = 0;
+    uint32_t uart_breaks = 0;
+    uint32_t uart_job_tx_time_us = 0;
+    for (uint8_t chain = 0; chain < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; chain++) {
+        const serial_stats * uart_stats = SERIAL_get_stats(chain);
+        uart_resyncs += receive_work_stats(chain)->resyncs;
+        uart_bytes_discarded += receive_work_stats(chain)->bytes_discarded;
+        uart_overflows += uart_stats->fifo_overflows + uart_stats->buffer_full;
+        uart_breaks += uart_stats->breaks;
+        if (uart_stats->job_tx_time_us > uart_job_tx_time_us) {
+            uart_job_tx_time_us = uart_stats->job_tx_time_us;
+        }
+    }
+    cJSON_AddNumberToObject(root, "uartResyncs", uart_resyncs);
+    cJSON_AddNumberToObject(root, "uartBytesDiscarded", uart_bytes_discarded);
+    cJSON_AddNumberToObject(root, "uartOverflows", uart_overflows);
+    cJSON_AddNumberToObject(root, "uartBreaks", uart_breaks);
+    cJSON_AddNumberToObject(root, "uartJobTxTimeUs", uart_job_tx_time_us);
 
     cJSON *error_array = cJSON_CreateArray();
     cJSON_AddItemToObject(root, "sharesRejectedReasons", error_array);
@@ -589,8 +677,57 @@ static esp_err_t GET_system_info(httpd_req_t * req)
         cJSON_AddItemToArray(error_array, error_obj);
     }
 
+    cJSON *telemetry_array = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "asicTelemetry", telemetry_array);
+
+    for (int chip = 0; chip < asic_telemetry_chip_count(); chip++) {
+        const asic_chip_telemetry * telemetry = asic_telemetry_get(chip);
+        if (!telemetry->seen) {
+            continue;
+        }
+        cJSON *chip_obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(chip_obj, "chip", chip);
+        cJSON_AddBoolToObject(chip_obj, "pllLocked", telemetry->pll_locked);
+        cJSON_AddNumberToObject(chip_obj, "frequency", ASIC_get_chip_frequency(GLOBAL_STATE, chip));
+        cJSON_AddNumberToObject(chip_obj, "nonceErrors", telemetry->nonce_errors);
+        cJSON_AddNumberToObject(chip_obj, "nonceOverflows", telemetry->nonce_overflows);
+        cJSON_AddNumberToObject(chip_obj, "analogMux", telemetry->analog_mux);
+        cJSON_AddNumberToObject(chip_obj, "ageMs", (esp_timer_get_time() - telemetry->updated_us) / 1000);
+        cJSON_AddItemToArray(telemetry_array, chip_obj);
+    }
+
     cJSON_AddNumberToObject(root, "uptimeSeconds", (esp_timer_get_time() - GLOBAL_STATE->SYSTEM_MODULE.start_time) / 1000000);
-    cJSON_AddNumberToObject(root, "asicCount", ASIC_get_asic_count(GLOBAL_STATE));
+    cJSON_AddNumberToObject(root, "asicCount", ASIC_get_asic_count(GLOBAL_STATE) * GLOBAL_STATE->ASIC_TASK_MODULE.chain_count);
+    cJSON_AddNumberToObject(root, "asicChainCount", GLOBAL_STATE->ASIC_TASK_MODULE.chain_count);
+
+    cJSON *chain_array = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "asicChains", chain_array);
+
+    for (uint8_t chain = 0; chain < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; chain++) {
+        const AsicChain * asic_chain = &GLOBAL_STATE->ASIC_TASK_MODULE.chains[chain];
+        cJSON *chain_obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(chain_obj, "chain", chain);
+        cJSON_AddNumberToObject(chain_obj, "asicCount", asic_chain->asic_count);
+        cJSON_AddNumberToObject(chain_obj, "asicDifficulty", asic_chain->ticket_mask.difficulty);
+        cJSON_AddNumberToObject(chain_obj, "nonceRate", asic_chain->ticket_mask.rate);
+        cJSON_AddNumberToObject(chain_obj, "recoveries", asic_chain->watchdog.recoveries);
+        cJSON_AddItemToArray(chain_array, chain_obj);
+    }
+
+    cJSON *recovery_array = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "chainRecoveries", recovery_array);
+
+    const chain_recovery_event * event;
+    for (uint32_t i = 0; (event = chain_recovery_log_get(&GLOBAL_STATE->ASIC_TASK_MODULE.recovery_log, i)) != NULL; i++) {
+        cJSON *event_obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(event_obj, "chain", event->chain);
+        cJSON_AddNumberToObject(event_obj, "uptimeSeconds", event->time_us / 1000000);
+        cJSON_AddNumberToObject(event_obj, "silenceMs", event->silence_ms);
+        cJSON_AddNumberToObject(event_obj, "asicCount", event->asic_count);
+        cJSON_AddNumberToObject(event_obj, "durationMs", event->duration_ms);
+        cJSON_AddBoolToObject(event_obj, "recovered", event->recovered);
+        cJSON_AddItemToArray(recovery_array, event_obj);
+    }
     cJSON_AddNumberToObject(root, "smallCoreCount", ASIC_get_small_core_count(GLOBAL_STATE));
     cJSON_AddStringToObject(root, "ASICModel", GLOBAL_STATE->asic_model_str);
     cJSON_AddStringToObject(root, "stratumURL", stratumURL);
@@ -616,7 +753,70 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     cJSON_AddNumberToObject(root, "fanspeed", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_perc);
     cJSON_AddNumberToObject(root, "temptarget", nvs_config_get_u16(NVS_CONFIG_TEMP_TARGET, 60));
     cJSON_AddNumberToObject(root, "fanrpm", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_rpm);
-    
+    cJSON_AddBoolToObject(root, "fanAutotuneRunning", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_autotuning);
+
+    fan_gains gains = {
+        .kp = FAN_CONTROL_DEFAULT_KP,
+        .ki = FAN_CONTROL_DEFAULT_KI,
+        .kd = FAN_CONTROL_DEFAULT_KD,
+        .kff = FAN_CONTROL_DEFAULT_KFF,
+        .period_s = FAN_CONTROL_DEFAULT_PERIOD_S,
+    };
+    char * fan_gains_text = nvs_config_get_string(NVS_CONFIG_FAN_GAINS, "");
+    fan_gains_parse(fan_gains_text, &gains);
+    free(fan_gains_text);
+
+    cJSON * gains_obj = cJSON_CreateObject();
+    cJSON_AddNumberToObject(gains_obj, "kp", gains.kp);
+    cJSON_AddNumberToObject(gains_obj, "ki", gains.ki);
+    cJSON_AddNumberToObject(gains_obj, "kd", gains.kd);
+    cJSON_AddNumberToObject(gains_obj, "feedForward", gains.kff);
+    cJSON_AddNumberToObject(gains_obj, "period", gains.period_s);
+    cJSON_AddItemToObject(root, "fanGains", gains_obj);
+
+    cJSON_AddNumberToObject(root, "autotune", nvs_config_get_u16(NVS_CONFIG_AUTOTUNE, AUTOTUNE_OFF));
+    cJSON_AddNumberToObject(root, "autotunePowerCap", nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_POWER, Power_get_max_settings(GLOBAL_STATE)));
+    cJSON_AddBoolToObject(root, "autotuneRunning", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.autotuning);
+
+    cJSON *curve_array = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "autotuneCurve", curve_array);
+
+    char * autotune_curve = nvs_config_get_string(NVS_CONFIG_AUTOTUNE_CURVE, "");
+    autotune_point curve[AUTOTUNE_MAX_POINTS];
+    uint8_t curve_count = autotune_curve_parse(autotune_curve, curve, AUTOTUNE_MAX_POINTS);
+    free(autotune_curve);
+    for (uint8_t i = 0; i < curve_count; i++) {
+        cJSON *point_obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(point_obj, "frequency", curve[i].frequency);
+        cJSON_AddNumberToObject(point_obj, "coreVoltage", curve[i].voltage);
+        cJSON_AddNumberToObject(point_obj, "hashRate", curve[i].hashrate);
+        cJSON_AddNumberToObject(point_obj, "power", curve[i].power);
+        cJSON_AddNumberToObject(point_obj, "efficiency", autotune_efficiency(&curve[i]));
+        cJSON_AddItemToArray(curve_array, point_obj);
+    }
+
+    double energy_total, energy_session;
+    energy_window windows[ENERGY_WINDOWS];
+    if (power_sampler_energy(&energy_total, &energy_session, windows)) {
+        cJSON_AddNumberToObject(root, "energyTotal", energy_total);
+        cJSON_AddNumberToObject(root, "energySession", energy_session);
+
+        cJSON *efficiency_array = cJSON_CreateArray();
+        cJSON_AddItemToObject(root, "efficiency", efficiency_array);
+        for (int length = 0; length < ENERGY_WINDOWS; length++) {
+            cJSON *window_obj = cJSON_CreateObject();
+            cJSON_AddNumberToObject(window_obj, "period", windows[length].period_s);
+            cJSON_AddNumberToObject(window_obj, "covered", windows[length].covered_s);
+            cJSON_AddNumberToObject(window_obj, "energy", windows[length].energy_wh);
+            cJSON_AddNumberToObject(window_obj, "power", windows[length].power);
+            cJSON_AddNumberToObject(window_obj, "hashRate", windows[length].hashrate);
+            cJSON_AddNumberToObject(window_obj, "shares", windows[length].shares);
+            cJSON_AddNumberToObject(window_obj, "joulesPerTH", windows[length].joules_per_th);
+            cJSON_AddNumberToObject(window_obj, "joulesPerShare", windows[length].joules_per_share);
+            cJSON_AddItemToArray(efficiency_array, window_obj);
+        }
+    }
+
     if (GLOBAL_STATE->SYSTEM_MODULE.power_fault > 0) {
         cJSON_AddStringToObject(root, "power_fault", VCORE_get_fault_string(GLOBAL_STATE));
     }
@@ -628,6 +828,7 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     free(stratumUser);
     free(fallbackStratumUser);
     free(board_version);
+    free(chip_frequencies);
 
     const char * sys_info = cJSON_Print(root);
     httpd_resp_sendstr(req, sys_info);
@@ -903,6 +1104,7 @@ esp_err_t start_rest_server(void * pvParameters)
     
     // Initialize the ASIC API with the global state
     asic_api_init(GLOBAL_STATE);
+    profiles_api_init(GLOBAL_STATE);
     const char * base_path = "";
 
     bool enter_recovery = false;
@@ -923,7 +1125,7 @@ esp_err_t start_rest_server(void * pvParameters)
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.stack_size = 8192;
     config.max_open_sockets = 10;
-    config.max_uri_handlers = 20;
+    config.max_uri_handlers = 24;
 
     ESP_LOGI(TAG, "Starting HTTP Server");
     REST_CHECK(httpd_start(&server, &config) == ESP_OK, "Start server failed", err_start);
@@ -957,6 +1159,40 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &system_asic_get_uri);
 
+    /* URI handler for fetching the sampled power and thermal history */
+    httpd_uri_t system_history_get_uri = {
+        .uri = "/api/system/history",
+        .method = HTTP_GET,
+        .handler = GET_system_history,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_history_get_uri);
+
+    /* URI handlers for the power profiles and their weekly schedule */
+    httpd_uri_t system_profiles_get_uri = {
+        .uri = "/api/system/profiles",
+        .method = HTTP_GET,
+        .handler = GET_system_profiles,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_profiles_get_uri);
+
+    httpd_uri_t system_profiles_put_uri = {
+        .uri = "/api/system/profiles",
+        .method = HTTP_PUT,
+        .handler = PUT_system_profiles,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_profiles_put_uri);
+
+    httpd_uri_t system_profiles_options_uri = {
+        .uri = "/api/system/profiles",
+        .method = HTTP_OPTIONS,
+        .handler = handle_options_request,
+        .user_ctx = NULL,
+    };
+    httpd_register_uri_handler(server, &system_profiles_options_uri);
+
     /* URI handler for WiFi scan */
     httpd_uri_t wifi_scan_get_uri = {
         .uri = "/api/system/wifi/scan",
@@ -1,3 +1,5 @@
+#include <stdio.h>
+
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_psram.h"
@@ -6,8 +8,11 @@
 #include "main.h"
 
 #include "asic_result_task.h"
+#include "asic_telemetry_task.h"
 #include "asic_task.h"
 #include "create_jobs_task.h"
+#include "fan_controller_task.h"
+#include "power_sampler_task.h"
 #include "system.h"
 #include "http_server.h"
 #include "nvs_config.h"
@@ -18,6 +23,7 @@
 #include "nvs_device.h"
 #include "self_test.h"
 #include "asic.h"
+#include "power.h"
 #include "driver/gpio.h"
 
 static GlobalState GLOBAL_STATE = {
@@ -89,7 +95,12 @@ void app_main(void)
 
     SYSTEM_init_peripherals(&GLOBAL_STATE);
 
+    // the frequency ramp sizes its steps from the core supply
+    frequency_transition_set_monitor(Power_get_ramp_sample, &GLOBAL_STATE);
+
     xTaskCreate(POWER_MANAGEMENT_task, "power management", 8192, (void *) &GLOBAL_STATE, 10, NULL);
+    xTaskCreate(FAN_CONTROLLER_task, "fan controller", 4096, (void *) &GLOBAL_STATE, 10, NULL);
+    xTaskCreate(POWER_SAMPLER_task, "power sampler", 4096, (void *) &GLOBAL_STATE, 5, NULL);
 
     //start the API for AxeOS
     start_rest_server((void *) &GLOBAL_STATE);
@@ -109,9 +120,15 @@ void app_main(void)
     wifi_softap_off();
 
     queue_init(&GLOBAL_STATE.stratum_queue);
-    queue_init(&GLOBAL_STATE.ASIC_jobs_queue);
-
-    SERIAL_init();
+    share_filter_init(&GLOBAL_STATE.duplicate_share_filter);
+    pthread_mutex_init(&GLOBAL_STATE.share_lock, NULL);
+
+    AsicTaskModule * asic_module = &GLOBAL_STATE.ASIC_TASK_MODULE;
+    asic_module->chain_count = CONFIG_ASIC_CHAIN_COUNT;
+    for (uint8_t chain = 0; chain < asic_module->chain_count; chain++) {
+        ASIC_chain_init(&asic_module->chains[chain], chain, &GLOBAL_STATE);
+        SERIAL_init(chain);
+    }
 
     if (ASIC_init(&GLOBAL_STATE) == 0) {
         GLOBAL_STATE.SYSTEM_MODULE.asic_status = "Chip count 0";
@@ -119,13 +136,22 @@ void app_main(void)
         return;
     }
 
-    SERIAL_set_baud(ASIC_set_max_baud(&GLOBAL_STATE));
-    SERIAL_clear_buffer();
+    for (uint8_t chain = 0; chain < asic_module->chain_count; chain++) {
+        ASIC_set_max_baud(&GLOBAL_STATE, chain);
+        SERIAL_clear_buffer(chain);
+    }
 
     GLOBAL_STATE.ASIC_initalized = true;
 
     xTaskCreate(stratum_task, "stratum admin", 8192, (void *) &GLOBAL_STATE, 5, NULL);
     xTaskCreate(create_jobs_task, "stratum miner", 8192, (void *) &GLOBAL_STATE, 10, NULL);
-    xTaskCreate(ASIC_task, "asic", 8192, (void *) &GLOBAL_STATE, 10, NULL);
-    xTaskCreate(ASIC_result_task, "asic result", 8192, (void *) &GLOBAL_STATE, 15, NULL);
+    // every chain sends and receives on its own pair of tasks
+    for (uint8_t chain = 0; chain < asic_module->chain_count; chain++) {
+        char name[16];
+        snprintf(name, sizeof(name), "asic %u", chain);
+        xTaskCreate(ASIC_task, name, 8192, (void *) &asic_module->chains[chain], 10, NULL);
+        snprintf(name, sizeof(name), "asic result %u", chain);
+        xTaskCreate(ASIC_result_task, name, 8192, (void *) &asic_module->chains[chain], 15, NULL);
+    }
+    xTaskCreate(ASIC_telemetry_task, "asic telemetry", 4096, (void *) &GLOBAL_STATE, 3, NULL);
 }
@@ -1,171 +1,369 @@
 #include "nvs_config.h"
 #include "esp_log.h"
 #include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define NVS_CONFIG_NAMESPACE "main"
 
+// every key in the namespace is held in RAM, there are about 40 of them
+#define NVS_CONFIG_MAX_ENTRIES 64
+#define NVS_CONFIG_MAX_SUBSCRIBERS 24
+
+typedef struct
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    union
+    {
+        uint16_t u16;
+        int32_t i32;
+        uint64_t u64;
+        char * str;
+    } value;
+} nvs_config_entry;
+
+typedef struct
+{
+    const char * key;
+    nvs_config_callback callback;
+    void * context;
+} nvs_config_subscriber;
+
 static const char * TAG = "nvs_config";
 
-char * nvs_config_get_string(const char * key, const char * default_value)
+static nvs_config_entry entries[NVS_CONFIG_MAX_ENTRIES];
+static uint8_t entry_count;
+static nvs_config_subscriber subscribers[NVS_CONFIG_MAX_SUBSCRIBERS];
+static uint8_t subscriber_count;
+static SemaphoreHandle_t lock;
+
+// call with the lock held
+static nvs_config_entry * _find(const char * key, nvs_type_t type)
 {
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return strdup(default_value);
+    for (uint8_t i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].key, key) == 0) {
+            // read as another type the key doesn't exist, as with NVS
+            return type == NVS_TYPE_ANY || entries[i].type == type ? &entries[i] : NULL;
+        }
     }
+    return NULL;
+}
 
-    size_t size = 0;
-    err = nvs_get_str(handle, key, NULL, &size);
+// call with the lock held
+static void _store(const char * key, nvs_type_t type, const void * value)
+{
+    nvs_config_entry * entry = _find(key, NVS_TYPE_ANY);
+
+    if (entry == NULL) {
+        if (entry_count == NVS_CONFIG_MAX_ENTRIES) {
+            ESP_LOGE(TAG, "No room to cache nvs key: %s", key);
+            return;
+        }
+        entry = &entries[entry_count++];
+        strncpy(entry->key, key, sizeof(entry->key) - 1);
+        entry->key[sizeof(entry->key) - 1] = '\0';
+    } else if (entry->type == NVS_TYPE_STR) {
+        free(entry->value.str);
+    }
 
-    if (err != ESP_OK) {
-        nvs_close(handle);
-        return strdup(default_value);
+    entry->type = type;
+    switch (type) {
+        case NVS_TYPE_U16:
+            entry->value.u16 = *(const uint16_t *) value;
+            break;
+        case NVS_TYPE_I32:
+            entry->value.i32 = *(const int32_t *) value;
+            break;
+        case NVS_TYPE_U64:
+            entry->value.u64 = *(const uint64_t *) value;
+            break;
+        case NVS_TYPE_STR:
+            entry->value.str = strdup((const char *) value);
+            break;
+        default:
+            break;
     }
+}
 
-    char * out = malloc(size);
-    err = nvs_get_str(handle, key, out, &size);
+// call with the lock held
+static bool _unchanged(const char * key, nvs_type_t type, const void * value)
+{
+    nvs_config_entry * entry = _find(key, type);
 
-    if (err != ESP_OK) {
-        free(out);
-        nvs_close(handle);
-        return strdup(default_value);
+    if (entry == NULL) {
+        return false;
     }
+    switch (type) {
+        case NVS_TYPE_U16:
+            return entry->value.u16 == *(const uint16_t *) value;
+        case NVS_TYPE_I32:
+            return entry->value.i32 == *(const int32_t *) value;
+        case NVS_TYPE_U64:
+            return entry->value.u64 == *(const uint64_t *) value;
+        case NVS_TYPE_STR:
+            return entry->value.str != NULL && strcmp(entry->value.str, (const char *) value) == 0;
+        default:
+            return false;
+    }
+}
 
-    nvs_close(handle);
-    return out;
+static void _load(nvs_handle handle, const nvs_entry_info_t * info)
+{
+    esp_err_t err;
+
+    switch (info->type) {
+        case NVS_TYPE_U16: {
+            uint16_t value;
+            if ((err = nvs_get_u16(handle, info->key, &value)) == ESP_OK) {
+                _store(info->key, info->type, &value);
+            }
+            break;
+        }
+        case NVS_TYPE_I32: {
+            int32_t value;
+            if ((err = nvs_get_i32(handle, info->key, &value)) == ESP_OK) {
+                _store(info->key, info->type, &value);
+            }
+            break;
+        }
+        case NVS_TYPE_U64: {
+            uint64_t value;
+            if ((err = nvs_get_u64(handle, info->key, &value)) == ESP_OK) {
+                _store(info->key, info->type, &value);
+            }
+            break;
+        }
+        case NVS_TYPE_STR: {
+            size_t size = 0;
+            if ((err = nvs_get_str(handle, info->key, NULL, &size)) != ESP_OK) {
+                break;
+            }
+            char * value = malloc(size);
+            if ((err = nvs_get_str(handle, info->key, value, &size)) == ESP_OK) {
+                _store(info->key, info->type, value);
+            }
+            free(value);
+            break;
+        }
+        default:
+            // the config only uses the types above
+            ESP_LOGW(TAG, "Not caching nvs key: %s, type %d", info->key, info->type);
+            return;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Could not read nvs key: %s", info->key);
+    }
 }
 
-void nvs_config_set_string(const char * key, const char * value)
+// writes through to flash and caches the value once it is stored, true when it changed
+static bool _set(const char * key, nvs_type_t type, const void * value)
 {
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    // unchanged values don't cost a flash write or wake anyone
+    if (_unchanged(key, type, value)) {
+        xSemaphoreGive(lock);
+        return false;
+    }
 
     nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    esp_err_t err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
     if (err != ESP_OK) {
+        xSemaphoreGive(lock);
         ESP_LOGW(TAG, "Could not open nvs");
-        return;
+        return false;
+    }
+
+    switch (type) {
+        case NVS_TYPE_U16:
+            err = nvs_set_u16(handle, key, *(const uint16_t *) value);
+            break;
+        case NVS_TYPE_I32:
+            err = nvs_set_i32(handle, key, *(const int32_t *) value);
+            break;
+        case NVS_TYPE_U64:
+            err = nvs_set_u64(handle, key, *(const uint64_t *) value);
+            break;
+        case NVS_TYPE_STR:
+            err = nvs_set_str(handle, key, (const char *) value);
+            break;
+        default:
+            err = ESP_ERR_INVALID_ARG;
+    }
+    nvs_close(handle);
+
+    if (err == ESP_OK) {
+        _store(key, type, value);
     }
+    xSemaphoreGive(lock);
 
-    err = nvs_set_str(handle, key, value);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %s", key, value);
+        ESP_LOGW(TAG, "Could not write nvs key: %s", key);
     }
+    return err == ESP_OK;
+}
 
-    nvs_close(handle);
+static void _notify(const char * key)
+{
+    nvs_config_subscriber matching[NVS_CONFIG_MAX_SUBSCRIBERS];
+    uint8_t count = 0;
+
+    // the callbacks run without the lock so they can read the new value
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (uint8_t i = 0; i < subscriber_count; i++) {
+        if (subscribers[i].key == NULL || strcmp(subscribers[i].key, key) == 0) {
+            matching[count++] = subscribers[i];
+        }
+    }
+    xSemaphoreGive(lock);
+
+    for (uint8_t i = 0; i < count; i++) {
+        matching[i].callback(key, matching[i].context);
+    }
 }
 
-uint16_t nvs_config_get_u16(const char * key, const uint16_t default_value)
+esp_err_t nvs_config_init(void)
 {
+    lock = xSemaphoreCreateMutex();
+    if (lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
     nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return default_value;
+    if (nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        // nothing was ever written, every setting reads as its default
+        ESP_LOGI(TAG, "No settings stored yet");
+        return ESP_OK;
     }
 
-    uint16_t out;
-    err = nvs_get_u16(handle, key, &out);
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_CONFIG_NAMESPACE, NVS_TYPE_ANY, &it);
+    xSemaphoreTake(lock, portMAX_DELAY);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        _load(handle, &info);
+        err = nvs_entry_next(&it);
+    }
+    xSemaphoreGive(lock);
+    nvs_release_iterator(it);
     nvs_close(handle);
 
-    if (err != ESP_OK) {
-        return default_value;
+    ESP_LOGI(TAG, "Loaded %u settings", entry_count);
+    return ESP_OK;
+}
+
+void nvs_config_subscribe(const char * key, nvs_config_callback callback, void * context)
+{
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (subscriber_count < NVS_CONFIG_MAX_SUBSCRIBERS) {
+        subscribers[subscriber_count++] = (nvs_config_subscriber) {
+            .key = key,
+            .callback = callback,
+            .context = context,
+        };
+    } else {
+        ESP_LOGE(TAG, "No room to subscribe to %s", key == NULL ? "all keys" : key);
     }
-    return out;
+    xSemaphoreGive(lock);
 }
 
-void nvs_config_set_u16(const char * key, const uint16_t value)
+void nvs_config_notify_task(const char * key, void * context)
 {
+    TaskHandle_t task = (TaskHandle_t) context;
 
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open nvs");
-        return;
+    // a task changing its own settings already knows
+    if (task != xTaskGetCurrentTaskHandle()) {
+        xTaskNotifyGive(task);
     }
+}
 
-    err = nvs_set_u16(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %u", key, value);
+char * nvs_config_get_string(const char * key, const char * default_value)
+{
+    char * out = NULL;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    nvs_config_entry * entry = _find(key, NVS_TYPE_STR);
+    if (entry != NULL && entry->value.str != NULL) {
+        out = strdup(entry->value.str);
     }
+    xSemaphoreGive(lock);
 
-    nvs_close(handle);
+    return out != NULL ? out : strdup(default_value);
 }
 
-int32_t nvs_config_get_i32(const char * key, const int32_t default_value)
+void nvs_config_set_string(const char * key, const char * value)
 {
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return default_value;
+    if (_set(key, NVS_TYPE_STR, value)) {
+        _notify(key);
     }
+}
 
-    int32_t out;
-    err = nvs_get_i32(handle, key, &out);
-    nvs_close(handle);
+uint16_t nvs_config_get_u16(const char * key, const uint16_t default_value)
+{
+    uint16_t out = default_value;
 
-    if (err != ESP_OK) {
-        return default_value;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    nvs_config_entry * entry = _find(key, NVS_TYPE_U16);
+    if (entry != NULL) {
+        out = entry->value.u16;
     }
+    xSemaphoreGive(lock);
+
     return out;
 }
 
-void nvs_config_set_i32(const char * key, const int32_t value)
+void nvs_config_set_u16(const char * key, const uint16_t value)
 {
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open nvs");
-        return;
+    if (_set(key, NVS_TYPE_U16, &value)) {
+        _notify(key);
     }
+}
 
-    err = nvs_set_i32(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %li", key, value);
+int32_t nvs_config_get_i32(const char * key, const int32_t default_value)
+{
+    int32_t out = default_value;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    nvs_config_entry * entry = _find(key, NVS_TYPE_I32);
+    if (entry != NULL) {
+        out = entry->value.i32;
     }
+    xSemaphoreGive(lock);
 
-    nvs_close(handle);
+    return out;
 }
 
-uint64_t nvs_config_get_u64(const char * key, const uint64_t default_value)
+void nvs_config_set_i32(const char * key, const int32_t value)
 {
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return default_value;
+    if (_set(key, NVS_TYPE_I32, &value)) {
+        _notify(key);
     }
+}
 
-    uint64_t out;
-    err = nvs_get_u64(handle, key, &out);
+uint64_t nvs_config_get_u64(const char * key, const uint64_t default_value)
+{
+    uint64_t out = default_value;
 
-    if (err != ESP_OK) {
-        nvs_close(handle);
-        return default_value;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    nvs_config_entry * entry = _find(key, NVS_TYPE_U64);
+    if (entry != NULL) {
+        out = entry->value.u64;
     }
+    xSemaphoreGive(lock);
 
-    nvs_close(handle);
     return out;
 }
 
 void nvs_config_set_u64(const char * key, const uint64_t value)
 {
-
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open nvs");
-        return;
-    }
-
-    err = nvs_set_u64(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %llu", key, value);
+    if (_set(key, NVS_TYPE_U64, &value)) {
+        _notify(key);
     }
-    nvs_close(handle);
 }
@@ -2,6 +2,7 @@
 #define MAIN_NVS_CONFIG_H
 
 #include <stdint.h>
+#include "esp_err.h"
 
 // Max length 15
 
@@ -17,6 +18,7 @@
 #define NVS_CONFIG_FALLBACK_STRATUM_USER "fbstratumuser"
 #define NVS_CONFIG_FALLBACK_STRATUM_PASS "fbstratumpass"
 #define NVS_CONFIG_ASIC_FREQ "asicfrequency"
+#define NVS_CONFIG_ASIC_CHIP_FREQ "asicchipfreq"
 #define NVS_CONFIG_ASIC_VOLTAGE "asicvoltage"
 #define NVS_CONFIG_ASIC_MODEL "asicmodel"
 #define NVS_CONFIG_DEVICE_MODEL "devicemodel"
@@ -32,11 +34,34 @@
 #define NVS_CONFIG_OVERHEAT_MODE "overheat_mode"
 #define NVS_CONFIG_OVERCLOCK_ENABLED "oc_enabled"
 #define NVS_CONFIG_SWARM "swarmconfig"
+#define NVS_CONFIG_POWER_CAP "powercap"
+#define NVS_CONFIG_AUTOTUNE "autotune"
+#define NVS_CONFIG_AUTOTUNE_POWER "autotunepower"
+#define NVS_CONFIG_AUTOTUNE_SWEEP "autotunesweep"
+#define NVS_CONFIG_AUTOTUNE_CURVE "autotunecurve"
+#define NVS_CONFIG_FAN_GAINS "fangains"
+#define NVS_CONFIG_FAN_AUTOTUNE "fanautotune"
+#define NVS_CONFIG_SAMPLE_RATE "samplerate"
+#define NVS_CONFIG_ENERGY_TOTAL "energymwh"
+#define NVS_CONFIG_IDLE_TIMEOUT "idletimeout"
+#define NVS_CONFIG_PROFILES "profiles"
+#define NVS_CONFIG_SCHEDULE "schedule"
+#define NVS_CONFIG_SCHEDULE_TZ "scheduletz"
 
 // Theme configuration
 #define NVS_CONFIG_THEME_SCHEME "themescheme"
 #define NVS_CONFIG_THEME_COLORS "themecolors"
 
+// called on the task that wrote the setting, after the new value can be read
+typedef void (*nvs_config_callback)(const char * key, void * context);
+
+// loads every setting into RAM, the getters read from there and the setters write through to flash
+esp_err_t nvs_config_init(void);
+// key NULL subscribes to every setting
+void nvs_config_subscribe(const char * key, nvs_config_callback callback, void * context);
+// callback that wakes the task handle passed as context out of ulTaskNotifyTake
+void nvs_config_notify_task(const char * key, void * context);
+
 char * nvs_config_get_string(const char * key, const char * default_value);
 void nvs_config_set_string(const char * key, const char * default_value);
 uint16_t nvs_config_get_u16(const char * key, const uint16_t default_value);
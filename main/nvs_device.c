@@ -7,6 +7,7 @@
 #include "nvs_config.h"
 #include "nvs_device.h"
 
+#include "asic.h"
 #include "connect.h"
 #include "global_state.h"
 
@@ -18,7 +19,10 @@ esp_err_t NVSDevice_init(void) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         err = nvs_flash_init();
     }
-    return err;
+    if (err != ESP_OK) {
+        return err;
+    }
+    return nvs_config_init();
 }
 
 esp_err_t NVSDevice_get_wifi_creds(GlobalState * GLOBAL_STATE, char ** wifi_ssid, char ** wifi_pass, char ** hostname) {
@@ -39,6 +43,10 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
     GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value = nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY);
     ESP_LOGI(TAG, "NVS_CONFIG_ASIC_FREQ %f", (float)GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value);
 
+    char * chip_frequencies = nvs_config_get_string(NVS_CONFIG_ASIC_CHIP_FREQ, "");
+    ASIC_set_chip_frequency_caps(GLOBAL_STATE, chip_frequencies);
+    free(chip_frequencies);
+
     GLOBAL_STATE->asic_model_str = nvs_config_get_string(NVS_CONFIG_ASIC_MODEL, "");
     GLOBAL_STATE->device_model_str = nvs_config_get_string(NVS_CONFIG_DEVICE_MODEL, "invalid");
     char * board_version = nvs_config_get_string(NVS_CONFIG_BOARD_VERSION, "000");
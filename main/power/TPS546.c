@@ -5,6 +5,9 @@
 #include "esp_log.h"
 #include "esp_err.h"
 #include "esp_check.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "pmbus_commands.h"
 
@@ -36,6 +39,10 @@ static i2c_master_dev_handle_t tps546_i2c_handle;
 
 static TPS546_CONFIG tps546_config;
 
+// the power, fan and sampler tasks all read the regulator, PHASE must not change under another task's read
+static SemaphoreHandle_t tps546_lock;
+static TPS546_TELEMETRY telemetry_snapshot;
+
 static esp_err_t TPS546_parse_status(uint16_t);
 
 /**
@@ -342,6 +349,10 @@ esp_err_t TPS546_init(TPS546_CONFIG config)
 
     tps546_config = config;
 
+    if (tps546_lock == NULL && (tps546_lock = xSemaphoreCreateMutex()) == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
     ESP_LOGI(TAG, "Initializing the core voltage regulator");
 
     ESP_RETURN_ON_ERROR(i2c_bitaxe_add_device(TPS546_I2CADDR, &tps546_i2c_handle, TAG), TAG, "Failed to add TPS546 I2C");
@@ -459,7 +470,12 @@ esp_err_t TPS546_init(TPS546_CONFIG config)
 
 esp_err_t TPS546_clear_faults(void) {
 
-    ESP_RETURN_ON_ERROR(smb_write_addr(PMBUS_CLEAR_FAULTS), TAG, "Failed to write address");
+    xSemaphoreTake(tps546_lock, portMAX_DELAY);
+    esp_err_t err = smb_write_addr(PMBUS_CLEAR_FAULTS);
+    // the next snapshot has to show the cleared status
+    telemetry_snapshot.time_us = 0;
+    xSemaphoreGive(tps546_lock);
+    ESP_RETURN_ON_ERROR(err, TAG, "Failed to write address");
 
     // acknowledge the SMBus fault to reset the SMBALERT pin
     //ESP_RETURN_ON_ERROR(smb_clear_alert(), TAG, "Failed to clear alert"); //this doesn't seem to work?
@@ -657,93 +673,122 @@ void TPS546_set_frequency(int newfreq)
     //ESP_LOGI(TAG, "Converted value: %d", freq);
 }
 
+/**
+ * @brief Read every measurement and the status in one locked session
+ * @param telemetry Filled with the readings, a snapshot younger than TPS546_TELEMETRY_MAX_AGE_MS is shared
+ */
+esp_err_t TPS546_get_telemetry(TPS546_TELEMETRY *telemetry)
+{
+    uint16_t vin, vout, iout, temperature, status;
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(tps546_lock, portMAX_DELAY);
+
+    int64_t now_us = esp_timer_get_time();
+    if (telemetry_snapshot.time_us == 0 || now_us - telemetry_snapshot.time_us > TPS546_TELEMETRY_MAX_AGE_MS * 1000) {
+        // PMBus has no block read of the measurements, they go back to back with PHASE switched once for the current
+        if (smb_read_word(PMBUS_STATUS_WORD, &status) != ESP_OK ||
+            smb_read_word(PMBUS_READ_VIN, &vin) != ESP_OK ||
+            smb_read_word(PMBUS_READ_VOUT, &vout) != ESP_OK ||
+            smb_read_word(PMBUS_READ_TEMPERATURE_1, &temperature) != ESP_OK) {
+            err = ESP_FAIL;
+        } else {
+            //set the phase register to 0xFF to read all phases
+            smb_write_byte(PMBUS_PHASE, 0xFF);
+            err = smb_read_word(PMBUS_READ_IOUT, &iout);
+            //set the phase register back to the default
+            smb_write_byte(PMBUS_PHASE, TPS546_INIT_PHASE);
+        }
+
+        if (err == ESP_OK) {
+            telemetry_snapshot = (TPS546_TELEMETRY) {
+                .vin = slinear11_2_float(vin),
+                .vout = ulinear16_2_float(vout),
+                .iout = slinear11_2_float(iout),
+                .temperature = slinear11_2_int(temperature),
+                .status = status,
+                .time_us = now_us,
+            };
+        #ifdef DEBUG_TPS546_MEAS
+            ESP_LOGI(TAG, "Got Vin: %2.3f V, Vout: %2.3f V, Iout: %2.3f A, Temp: %d C, Status: %04X",
+                     telemetry_snapshot.vin, telemetry_snapshot.vout, telemetry_snapshot.iout,
+                     telemetry_snapshot.temperature, telemetry_snapshot.status);
+        #endif
+        }
+    }
+    *telemetry = telemetry_snapshot;
+
+    xSemaphoreGive(tps546_lock);
+
+    ESP_RETURN_ON_ERROR(err, TAG, "Could not read telemetry");
+    return ESP_OK;
+}
+
 int TPS546_get_temperature(void)
 {
-    uint16_t value;
-    int temp;
+    TPS546_TELEMETRY telemetry;
 
-    smb_read_word(PMBUS_READ_TEMPERATURE_1, &value);
-    temp = slinear11_2_int(value);
-    return temp;
+    if (TPS546_get_telemetry(&telemetry) != ESP_OK) {
+        return 0;
+    }
+    return telemetry.temperature;
 }
 
 float TPS546_get_vin(void)
 {
-    uint16_t u16_value;
-    float vin;
+    TPS546_TELEMETRY telemetry;
 
-    /* Get voltage input (ULINEAR16) */
-    if (smb_read_word(PMBUS_READ_VIN, &u16_value) != ESP_OK) {
-        ESP_LOGE(TAG, "Could not read VIN");
+    if (TPS546_get_telemetry(&telemetry) != ESP_OK) {
         return 0;
-    } else {
-        vin = slinear11_2_float(u16_value);
-        #ifdef DEBUG_TPS546_MEAS
-        ESP_LOGI(TAG, "Got Vin: %2.3f V", vin);
-        #endif
-        return vin;
-    }    
+    }
+    return telemetry.vin;
 }
 
 float TPS546_get_iout(void)
 {
-    uint16_t u16_value;
-    float iout;
+    TPS546_TELEMETRY telemetry;
 
-    //set the phase register to 0xFF to read all phases
-    smb_write_byte(PMBUS_PHASE, 0xFF);
-
-    /* Get current output (SLINEAR11) */
-    if (smb_read_word(PMBUS_READ_IOUT, &u16_value) != ESP_OK) {
-        ESP_LOGE(TAG, "Could not read Iout");
+    if (TPS546_get_telemetry(&telemetry) != ESP_OK) {
         return 0;
-    } else {
-        iout = slinear11_2_float(u16_value);
-
-    #ifdef DEBUG_TPS546_MEAS
-        ESP_LOGI(TAG, "Got Iout: %2.3f A", iout);
-    #endif
-
-    //set the phase register back to the default
-    smb_write_byte(PMBUS_PHASE, TPS546_INIT_PHASE);
-
-        return iout;
     }
+    return telemetry.iout;
 }
 
 float TPS546_get_vout(void)
 {
-    uint16_t u16_value;
-    float vout;
+    TPS546_TELEMETRY telemetry;
 
-    /* Get voltage output (ULINEAR16) */
-    if (smb_read_word(PMBUS_READ_VOUT, &u16_value) != ESP_OK) {
-        ESP_LOGE(TAG, "Could not read Vout");
+    if (TPS546_get_telemetry(&telemetry) != ESP_OK) {
         return 0;
-    } else {
-        vout = ulinear16_2_float(u16_value);
-    #ifdef DEBUG_TPS546_MEAS
-        ESP_LOGI(TAG, "Got Vout: %2.3f V", vout);
-    #endif
-        return vout;
     }
+    return telemetry.vout;
 }
 
 esp_err_t TPS546_check_status(GlobalState * global_state) {
 
     uint16_t status;
+    esp_err_t err = ESP_OK;
     SystemModule * sys_module = &global_state->SYSTEM_MODULE;
 
-    ESP_RETURN_ON_ERROR(smb_read_word(PMBUS_STATUS_WORD, &status), TAG, "Failed to read STATUS_WORD");
+    xSemaphoreTake(tps546_lock, portMAX_DELAY);
+    if (smb_read_word(PMBUS_STATUS_WORD, &status) != ESP_OK) {
+        xSemaphoreGive(tps546_lock);
+        ESP_LOGE(TAG, "Failed to read STATUS_WORD");
+        return ESP_FAIL;
+    }
     //determine if this is a fault we care about
     if (status & (TPS546_STATUS_OFF | TPS546_STATUS_VOUT_OV | TPS546_STATUS_IOUT_OC | TPS546_STATUS_VIN_UV | TPS546_STATUS_TEMP)) {
         if (sys_module->power_fault == 0) {
-            ESP_RETURN_ON_ERROR(TPS546_parse_status(status), TAG, "Failed to parse STATUS_WORD");
-            sys_module->power_fault = 1;
+            if ((err = TPS546_parse_status(status)) == ESP_OK) {
+                sys_module->power_fault = 1;
+            }
         }
     } else {
         sys_module->power_fault = 0;
     }
+    xSemaphoreGive(tps546_lock);
+
+    ESP_RETURN_ON_ERROR(err, TAG, "Failed to parse STATUS_WORD");
     return ESP_OK;
 }
 
@@ -961,7 +1006,7 @@ static esp_err_t TPS546_parse_status(uint16_t status) {
  * send a 0 to turn off the output
  * @param volts The desired output voltage
 **/
-esp_err_t TPS546_set_vout(float volts) {
+static esp_err_t set_vout(float volts) {
     uint16_t value;
     uint8_t value8;
 
@@ -1007,6 +1052,13 @@ esp_err_t TPS546_set_vout(float volts) {
     return ESP_OK;
 }
 
+esp_err_t TPS546_set_vout(float volts) {
+    xSemaphoreTake(tps546_lock, portMAX_DELAY);
+    esp_err_t err = set_vout(volts);
+    xSemaphoreGive(tps546_lock);
+    return err;
+}
+
 void TPS546_show_voltage_settings(void)
 {
     uint16_t u16_value;
@@ -25,6 +25,9 @@
 
 #define TPS546_INIT_FREQUENCY 650  /* KHz */
 
+// a snapshot this recent is handed out again instead of going back to the bus
+#define TPS546_TELEMETRY_MAX_AGE_MS 10
+
 typedef struct
 {
   /* vin voltage */
@@ -42,6 +45,16 @@ typedef struct
   float TPS546_INIT_IOUT_OC_FAULT_LIMIT; /* A */
 } TPS546_CONFIG;
 
+typedef struct
+{
+  float vin;  /* V */
+  float vout; /* V */
+  float iout; /* A, all phases */
+  int temperature; /* degrees C */
+  uint16_t status; /* STATUS_WORD */
+  int64_t time_us; /* when it was read */
+} TPS546_TELEMETRY;
+
 /* vin voltage */
 // #define TPS546_INIT_VIN_ON  11.0  /* V */
 // #define TPS546_INIT_VIN_OFF 10.5  /* V */
@@ -179,6 +192,7 @@ int TPS546_get_temperature(void);
 float TPS546_get_vin(void);
 float TPS546_get_iout(void);
 float TPS546_get_vout(void);
+esp_err_t TPS546_get_telemetry(TPS546_TELEMETRY *telemetry);
 esp_err_t TPS546_set_vout(float volts);
 void TPS546_show_voltage_settings(void);
 void TPS546_print_status(void);
@@ -196,3 +196,17 @@ float Power_get_vreg_temp(GlobalState * GLOBAL_STATE) {
 
     return 0.0;
 }
+
+// supply monitor for the frequency ramp, context is the GlobalState
+bool Power_get_ramp_sample(void * context, frequency_ramp_sample * sample) {
+    GlobalState * GLOBAL_STATE = (GlobalState *) context;
+
+    int16_t voltage_mv = VCORE_get_voltage_mv(GLOBAL_STATE);
+    if (voltage_mv <= 0) {
+        return false;
+    }
+
+    sample->voltage_mv = voltage_mv;
+    sample->current_ma = Power_get_current(GLOBAL_STATE);
+    return true;
+}
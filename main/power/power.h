@@ -3,6 +3,7 @@
 
 #include <esp_err.h>
 #include "global_state.h"
+#include "frequency_transition_bmXX.h"
 
 
 esp_err_t Power_disable(GlobalState * GLOBAL_STATE);
@@ -13,5 +14,6 @@ float Power_get_input_voltage(GlobalState * GLOBAL_STATE);
 float Power_get_vreg_temp(GlobalState * GLOBAL_STATE);
 float Power_get_max_settings(GlobalState * GLOBAL_STATE);
 int Power_get_nominal_voltage(GlobalState * GLOBAL_STATE);
+bool Power_get_ramp_sample(void * context, frequency_ramp_sample * sample);
 
 #endif // POWER_H
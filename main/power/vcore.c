@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <math.h>
 #include "esp_log.h"
+#include "esp_check.h"
 
 #include "vcore.h"
 #include "adc.h"
@@ -12,6 +13,7 @@
 #define GPIO_ASIC_ENABLE CONFIG_GPIO_ASIC_ENABLE
 #define GPIO_ASIC_RESET  CONFIG_GPIO_ASIC_RESET
 #define GPIO_PLUG_SENSE  CONFIG_GPIO_PLUG_SENSE
+#define GPIO_TPS546_ALERT CONFIG_GPIO_TPS546_ALERT
 
 static TPS546_CONFIG TPS546_CONFIG_GAMMATURBO = {
     /* vin voltage */
@@ -47,6 +49,36 @@ static TPS546_CONFIG TPS546_CONFIG_GAMMA = {
 
 static const char *TAG = "vcore.c";
 
+static TaskHandle_t alert_task;
+static volatile bool alert_pending;
+
+static bool is_tps546(GlobalState * global_state)
+{
+    switch (global_state->device_model) {
+        case DEVICE_MAX:
+        case DEVICE_ULTRA:
+        case DEVICE_SUPRA:
+            return global_state->board_version >= 402 && global_state->board_version <= 499;
+        case DEVICE_GAMMA:
+        case DEVICE_GAMMATURBO:
+            return true;
+        // case DEVICE_HEX:
+        default:
+    }
+    return false;
+}
+
+#if GPIO_TPS546_ALERT >= 0
+static void IRAM_ATTR alert_isr_handler(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+
+    alert_pending = true;
+    vTaskNotifyGiveFromISR(alert_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+#endif
+
 esp_err_t VCORE_init(GlobalState * GLOBAL_STATE) {
     switch (GLOBAL_STATE->device_model) {
         case DEVICE_MAX:
@@ -182,3 +214,68 @@ const char* VCORE_get_fault_string(GlobalState * global_state) {
     return NULL;
 }
 
+
+esp_err_t VCORE_enable_alert(GlobalState * global_state, TaskHandle_t task)
+{
+#if GPIO_TPS546_ALERT < 0
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    if (!is_tps546(global_state)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    alert_task = task;
+
+    // SMBALERT is open drain and held low until the faults are cleared
+    gpio_config_t alert_conf = {
+        .pin_bit_mask = (1ULL << GPIO_TPS546_ALERT),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_RETURN_ON_ERROR(gpio_config(&alert_conf), TAG, "Error configuring SMBALERT pin");
+    ESP_RETURN_ON_ERROR(gpio_isr_handler_add(GPIO_TPS546_ALERT, alert_isr_handler, NULL), TAG, "Error adding SMBALERT handler");
+
+    // an alert raised before the handler was in place has no edge left to catch
+    if (gpio_get_level(GPIO_TPS546_ALERT) == 0) {
+        alert_pending = true;
+        xTaskNotifyGive(task);
+    }
+
+    ESP_LOGI(TAG, "SMBALERT on GPIO %d", GPIO_TPS546_ALERT);
+    return ESP_OK;
+#endif
+}
+
+bool VCORE_take_alert(void)
+{
+    bool pending = alert_pending;
+
+    alert_pending = false;
+    return pending;
+}
+
+esp_err_t VCORE_get_status(GlobalState * global_state, uint16_t * status)
+{
+    TPS546_TELEMETRY telemetry;
+
+    if (!is_tps546(global_state)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    ESP_RETURN_ON_ERROR(TPS546_get_telemetry(&telemetry), TAG, "TPS546 read status failed!");
+    *status = telemetry.status;
+    return ESP_OK;
+}
+
+esp_err_t VCORE_clear_faults(GlobalState * global_state)
+{
+    if (!is_tps546(global_state)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    ESP_RETURN_ON_ERROR(TPS546_clear_faults(), TAG, "TPS546 clear faults failed!");
+    // the flags are clear, PMBus power_fault has to be looked at again
+    global_state->SYSTEM_MODULE.power_fault = 0;
+    return ESP_OK;
+}
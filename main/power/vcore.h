@@ -1,6 +1,9 @@
 #ifndef VCORE_H_
 #define VCORE_H_
 
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "global_state.h"
 
 esp_err_t VCORE_init(GlobalState * global_state);
@@ -9,4 +12,12 @@ int16_t VCORE_get_voltage_mv(GlobalState * global_state);
 esp_err_t VCORE_check_fault(GlobalState * global_state);
 const char* VCORE_get_fault_string(GlobalState * global_state);
 
+// SMBALERT wakes the task with a notification, ESP_ERR_NOT_SUPPORTED without a TPS546 or an alert pin
+esp_err_t VCORE_enable_alert(GlobalState * global_state, TaskHandle_t task);
+// true once after the regulator raised SMBALERT
+bool VCORE_take_alert(void);
+// regulator STATUS_WORD, ESP_ERR_NOT_SUPPORTED without a TPS546
+esp_err_t VCORE_get_status(GlobalState * global_state, uint16_t * status);
+esp_err_t VCORE_clear_faults(GlobalState * global_state);
+
 #endif /* VCORE_H_ */
@@ -64,6 +64,9 @@ static uint64_t current_difficulty;
 static float current_chip_temp;
 static bool found_block;
 
+// kept up to date by the config cache rather than read twice a second
+static int32_t display_timeout_config;
+
 static lv_obj_t * create_scr_self_test() {
     lv_obj_t * scr = lv_obj_create(NULL);
 
@@ -257,10 +260,13 @@ static void screen_show(screen_t screen)
     }
 }
 
-static void screen_update_cb(lv_timer_t * timer)
+static void display_timeout_changed(const char * key, void * context)
 {
-    int32_t display_timeout_config = nvs_config_get_i32(NVS_CONFIG_DISPLAY_TIMEOUT, -1);
+    display_timeout_config = nvs_config_get_i32(NVS_CONFIG_DISPLAY_TIMEOUT, -1);
+}
 
+static void screen_update_cb(lv_timer_t * timer)
+{
     if (0 > display_timeout_config) {
         // display always on
         display_on(true);
@@ -420,6 +426,9 @@ esp_err_t screen_start(void * pvParameters)
         screens[SCR_URLS] = create_scr_urls(module);
         screens[SCR_STATS] = create_scr_stats();
 
+        display_timeout_config = nvs_config_get_i32(NVS_CONFIG_DISPLAY_TIMEOUT, -1);
+        nvs_config_subscribe(NVS_CONFIG_DISPLAY_TIMEOUT, display_timeout_changed, NULL);
+
         lv_timer_create(screen_update_cb, SCREEN_UPDATE_MS, NULL);
     }
 
@@ -373,12 +373,18 @@ void self_test(void * pvParameters)
         tests_done(GLOBAL_STATE, TESTS_FAILED);
     }
 
+    // the self test only runs on the first chain
+    AsicChain * chain = &GLOBAL_STATE->ASIC_TASK_MODULE.chains[0];
+    GLOBAL_STATE->ASIC_TASK_MODULE.chain_count = 1;
+    ASIC_chain_init(chain, 0, GLOBAL_STATE);
+
     //test for number of ASICs
-    if (SERIAL_init() != ESP_OK) {
+    if (SERIAL_init(chain->index) != ESP_OK) {
         ESP_LOGE(TAG, "SERIAL init failed!");
         tests_done(GLOBAL_STATE, TESTS_FAILED);
     }
 
+    frequency_transition_set_monitor(Power_get_ramp_sample, GLOBAL_STATE);
     uint8_t chips_detected = ASIC_init(GLOBAL_STATE);
     uint8_t chips_expected = ASIC_get_asic_count(GLOBAL_STATE);
     ESP_LOGI(TAG, "%u chips detected, %u expected", chips_detected, chips_expected);
@@ -401,22 +407,14 @@ void self_test(void * pvParameters)
     }
 
     //setup and test hashrate
-    int baud = ASIC_set_max_baud(GLOBAL_STATE);
+    int baud = ASIC_set_max_baud(GLOBAL_STATE, chain->index);
     vTaskDelay(10 / portTICK_PERIOD_MS);
 
-    if (SERIAL_set_baud(baud) != ESP_OK) {
+    if (SERIAL_set_baud(chain->index, baud) != ESP_OK) {
         ESP_LOGE(TAG, "SERIAL set baud failed!");
         tests_done(GLOBAL_STATE, TESTS_FAILED);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs = malloc(sizeof(bm_job *) * 128);
-    GLOBAL_STATE->valid_jobs = malloc(sizeof(uint8_t) * 128);
-
-    for (int i = 0; i < 128; i++) {
-        GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[i] = NULL;
-        GLOBAL_STATE->valid_jobs[i] = 0;
-    }
-
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 
     mining_notify notify_message;
@@ -466,7 +464,7 @@ void self_test(void * pvParameters)
     ESP_LOGI(TAG, "Sending work");
 
     //(*GLOBAL_STATE->ASIC_functions.send_work_fn)(GLOBAL_STATE, &job);
-    ASIC_send_work(GLOBAL_STATE, &job);
+    ASIC_send_work(GLOBAL_STATE, chain, &job);
     
     double start = esp_timer_get_time();
     double sum = 0;
@@ -475,7 +473,7 @@ void self_test(void * pvParameters)
     double hashtest_timeout = 5;
 
     while (duration < hashtest_timeout) {
-        task_result * asic_result = ASIC_process_work(GLOBAL_STATE);
+        task_result * asic_result = ASIC_process_work(GLOBAL_STATE, chain);
         if (asic_result != NULL) {
             // check the nonce difficulty
             double nonce_diff = test_nonce_value(&job, asic_result->nonce, asic_result->rolled_version);
@@ -517,8 +515,11 @@ void self_test(void * pvParameters)
         tests_done(GLOBAL_STATE, TESTS_FAILED);
     }
 
-    free(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs);
-    free(GLOBAL_STATE->valid_jobs);
+    // the test job lives on this stack, the chain must not hold on to it
+    for (int i = 0; i < ASIC_JOB_ID_COUNT; i++) {
+        chain->active_jobs[i] = NULL;
+        chain->valid_jobs[i] = 0;
+    }
 
     if (test_core_voltage(GLOBAL_STATE) != ESP_OK) {
         tests_done(GLOBAL_STATE, TESTS_FAILED);
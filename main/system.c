@@ -1,3 +1,4 @@
+#include <ctype.h>
 #include <inttypes.h>
 #include <math.h>
 #include <stdint.h>
@@ -37,7 +38,7 @@ static void _suffix_string(uint64_t, char *, size_t, int);
 //local function prototypes
 static esp_err_t ensure_overheat_mode_config();
 
-static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id);
+static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, bm_job * job);
 static void _suffix_string(uint64_t val, char * buf, size_t bufsiz, int sigdigits);
 
 void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
@@ -51,6 +52,11 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     module->screen_page = 0;
     module->shares_accepted = 0;
     module->shares_rejected = 0;
+    module->shares_stale = 0;
+    module->nonces_found = 0;
+    module->hw_errors = 0;
+    module->nonce_difficulty_sum = 0;
+    module->hw_error_difficulty_sum = 0;
     module->best_nonce_diff = nvs_config_get_u64(NVS_CONFIG_BEST_DIFF, 0);
     module->best_session_nonce_diff = 0;
     module->start_time = esp_timer_get_time();
@@ -83,6 +89,12 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     //Initialize power_fault fault mode
     module->power_fault = 0;
 
+    // there is no work until the pool sends some
+    module->has_work = false;
+    module->work_changed_us = esp_timer_get_time();
+    module->last_notify_us = 0;
+    module->handshake_us = 0;
+
     // set the best diff string
     _suffix_string(module->best_nonce_diff, module->best_diff_string, DIFF_STRING_SIZE, 0);
     _suffix_string(module->best_session_nonce_diff, module->best_session_diff_string, DIFF_STRING_SIZE, 0);
@@ -140,11 +152,27 @@ static int compare_rejected_reason_stats(const void *a, const void *b) {
     return (eb->count > ea->count) - (ea->count > eb->count);
 }
 
+// pools word it differently ("Stale share", "stale-prevblk", "Job not found"), all mean the job was already gone
+static bool _is_stale_reason(const char * error_msg)
+{
+    char reason[64];
+    size_t i = 0;
+    for (; i < sizeof(reason) - 1 && error_msg[i] != '\0'; i++) {
+        reason[i] = tolower((unsigned char) error_msg[i]);
+    }
+    reason[i] = '\0';
+
+    return strstr(reason, "stale") != NULL || strstr(reason, "job not found") != NULL;
+}
+
 void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, char * error_msg)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
     module->shares_rejected++;
+    if (_is_stale_reason(error_msg)) {
+        module->shares_stale++;
+    }
 
     for (int i = 0; i < module->rejected_reason_stats_count; i++) {
         if (strncmp(module->rejected_reason_stats[i].message, error_msg, sizeof(module->rejected_reason_stats[i].message) - 1) == 0) {
@@ -191,14 +219,48 @@ void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime)
     settimeofday(&tv, NULL);
 }
 
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint8_t job_id)
+void SYSTEM_notify_handshake(GlobalState * GLOBAL_STATE)
+{
+    // the pool answered the subscribe, the chips come back up while it sends the first job
+    GLOBAL_STATE->SYSTEM_MODULE.handshake_us = esp_timer_get_time();
+    POWER_MANAGEMENT_wake();
+}
+
+void SYSTEM_notify_work(GlobalState * GLOBAL_STATE, bool has_work)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    module->handshake_us = 0;
+    if (has_work) {
+        module->last_notify_us = esp_timer_get_time();
+    }
+    if (module->has_work == has_work) {
+        return;
+    }
+    module->has_work = has_work;
+    module->work_changed_us = esp_timer_get_time();
+    POWER_MANAGEMENT_wake();
+}
+
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint32_t asic_difficulty, bm_job * job)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
+    module->nonces_found++;
+
+    // a nonce that just meets the mask is 1/65536 short of its difficulty, the diff 1 target isn't a power of two,
+    // anything below that is a hardware error. Both are weighted by the mask, a nonce at 1024 stands for 4x the work of one at 256
+    if (found_diff < asic_difficulty * (65535.0 / 65536.0)) {
+        module->hw_errors++;
+        module->hw_error_difficulty_sum += asic_difficulty;
+        return;
+    }
+    module->nonce_difficulty_sum += asic_difficulty;
+
     // Calculate the time difference in seconds with sub-second precision
     // hashrate = (nonce_difficulty * 2^32) / time_to_find
 
-    module->historical_hashrate[module->historical_hashrate_rolling_index] = GLOBAL_STATE->ASIC_difficulty;
+    module->historical_hashrate[module->historical_hashrate_rolling_index] = asic_difficulty;
     module->historical_hashrate_time_stamps[module->historical_hashrate_rolling_index] = esp_timer_get_time();
 
     module->historical_hashrate_rolling_index = (module->historical_hashrate_rolling_index + 1) % HISTORY_LENGTH;
@@ -231,7 +293,7 @@ void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, ui
     // logArrayContents(historical_hashrate, HISTORY_LENGTH);
     // logArrayContents(historical_hashrate_time_stamps, HISTORY_LENGTH);
 
-    _check_for_best_diff(GLOBAL_STATE, found_diff, job_id);
+    _check_for_best_diff(GLOBAL_STATE, found_diff, job);
 }
 
 static double _calculate_network_difficulty(uint32_t nBits)
@@ -246,7 +308,7 @@ static double _calculate_network_difficulty(uint32_t nBits)
     return difficulty;
 }
 
-static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id)
+static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, bm_job * job)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
@@ -255,7 +317,7 @@ static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_
         _suffix_string((uint64_t) diff, module->best_session_diff_string, DIFF_STRING_SIZE, 0);
     }
 
-    double network_diff = _calculate_network_difficulty(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->target);
+    double network_diff = _calculate_network_difficulty(job->target);
     if (diff > network_diff) {
         module->FOUND_BLOCK = true;
         ESP_LOGI(TAG, "FOUND BLOCK!!!!!!!!!!!!!!!!!!!!!! %f > %f", diff, network_diff);
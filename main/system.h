@@ -9,8 +9,12 @@ esp_err_t SYSTEM_init_peripherals(GlobalState * GLOBAL_STATE);
 
 void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE);
 void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, char * error_msg);
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint8_t job_id);
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint32_t asic_difficulty, bm_job * job);
 void SYSTEM_notify_mining_started(GlobalState * GLOBAL_STATE);
 void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime);
+// the pool connection is being set up
+void SYSTEM_notify_handshake(GlobalState * GLOBAL_STATE);
+// a mining.notify arrived, or the connection with the jobs it sent is gone
+void SYSTEM_notify_work(GlobalState * GLOBAL_STATE, bool has_work);
 
 #endif /* SYSTEM_H_ */
@@ -5,6 +5,7 @@
 #include "serial.h"
 #include <string.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_config.h"
 #include "utils.h"
 #include "stratum_task.h"
@@ -12,56 +13,81 @@
 
 static const char *TAG = "asic_result";
 
+// one instance per chain, pvParameters is the AsicChain it reads results from
 void ASIC_result_task(void *pvParameters)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    AsicChain *chain = (AsicChain *)pvParameters;
+    GlobalState *GLOBAL_STATE = (GlobalState *)chain->global_state;
 
     while (1)
     {
+        ASIC_check_link(GLOBAL_STATE, chain->index);
+        ASIC_update_ticket_mask(GLOBAL_STATE, chain);
+        ASIC_check_stall(GLOBAL_STATE, chain);
+
         //task_result *asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE);
-        task_result *asic_result = ASIC_process_work(GLOBAL_STATE);
+        task_result *asic_result = ASIC_process_work(GLOBAL_STATE, chain);
 
         if (asic_result == NULL)
         {
             continue;
         }
 
+        // every nonce the chain sends counts towards its rate, and is worth the mask it was found with
+        int64_t now_us = esp_timer_get_time();
+        uint32_t asic_difficulty = ticket_mask_difficulty_at(&chain->ticket_mask, now_us);
+        ticket_mask_record_nonce(&chain->ticket_mask);
+        chain_watchdog_nonce(&chain->watchdog, now_us);
+
         uint8_t job_id = asic_result->job_id;
 
-        if (GLOBAL_STATE->valid_jobs[job_id] == 0)
+        if (chain->valid_jobs[job_id] == 0)
         {
-            ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
+            ESP_LOGW(TAG, "Invalid job nonce found on chain %u, 0x%02X", chain->index, job_id);
+            continue;
+        }
+
+        // overlapping nonce ranges, UART re-reports and job id reuse can all produce the same share twice
+        if (share_filter_check(&GLOBAL_STATE->duplicate_share_filter, chain->active_jobs[job_id],
+                               asic_result->nonce, asic_result->rolled_version)) {
+            ESP_LOGW(TAG, "Duplicate nonce dropped, job 0x%02X nonce %08" PRIX32, job_id, asic_result->nonce);
             continue;
         }
 
         // check the nonce difficulty
         double nonce_diff = test_nonce_value(
-            GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id],
+            chain->active_jobs[job_id],
             asic_result->nonce,
             asic_result->rolled_version);
 
         //log the ASIC response
-        ESP_LOGI(TAG, "Ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %ld.", asic_result->rolled_version, asic_result->nonce, nonce_diff, GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff);
+        ESP_LOGI(TAG, "Ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %ld.", asic_result->rolled_version, asic_result->nonce, nonce_diff, chain->active_jobs[job_id]->pool_diff);
 
-        if (nonce_diff >= GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff)
+        // the chains share the message id, the socket and the accounting in SYSTEM_notify_found_nonce
+        int ret = 0;
+        int submit_errno = 0;
+        pthread_mutex_lock(&GLOBAL_STATE->share_lock);
+        if (nonce_diff >= chain->active_jobs[job_id]->pool_diff)
         {
             char * user = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_user : GLOBAL_STATE->SYSTEM_MODULE.pool_user;
-            int ret = STRATUM_V1_submit_share(
+            ret = STRATUM_V1_submit_share(
                 GLOBAL_STATE->sock,
                 GLOBAL_STATE->send_uid++,
                 user,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->jobid,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->extranonce2,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->ntime,
+                chain->active_jobs[job_id]->jobid,
+                chain->active_jobs[job_id]->extranonce2,
+                chain->active_jobs[job_id]->ntime,
                 asic_result->nonce,
-                asic_result->rolled_version ^ GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version);
-
-            if (ret < 0) {
-                ESP_LOGI(TAG, "Unable to write share to socket. Closing connection. Ret: %d (errno %d: %s)", ret, errno, strerror(errno));
-                stratum_close_connection(GLOBAL_STATE);
-            }
+                asic_result->rolled_version ^ chain->active_jobs[job_id]->version);
+            submit_errno = errno;
         }
 
-        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, job_id);
+        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, asic_difficulty, chain->active_jobs[job_id]);
+        pthread_mutex_unlock(&GLOBAL_STATE->share_lock);
+
+        if (ret < 0) {
+            ESP_LOGI(TAG, "Unable to write share to socket. Closing connection. Ret: %d (errno %d: %s)", ret, submit_errno, strerror(submit_errno));
+            stratum_close_connection(GLOBAL_STATE);
+        }
     }
 }
@@ -3,6 +3,7 @@
 #include "serial.h"
 #include <string.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -11,31 +12,62 @@
 
 static const char *TAG = "ASIC_task";
 
-// static bm_job ** active_jobs; is required to keep track of the active jobs since the
-
-void ASIC_task(void *pvParameters)
+void ASIC_chain_init(AsicChain * chain, uint8_t index, void * global_state)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    chain->index = index;
+    chain->global_state = global_state;
+    chain->job_id = 0;
 
-    //initialize the semaphore
-    GLOBAL_STATE->ASIC_TASK_MODULE.semaphore = xSemaphoreCreateBinary();
+    queue_init(&chain->jobs_queue);
+    pthread_mutex_init(&chain->valid_jobs_lock, NULL);
+    pthread_mutex_init(&chain->send_lock, NULL);
+    pthread_mutex_init(&chain->frequency_lock, NULL);
+    chain->semaphore = xSemaphoreCreateBinary();
+    chain_watchdog_init(&chain->watchdog, esp_timer_get_time());
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs = malloc(sizeof(bm_job *) * 128);
-    GLOBAL_STATE->valid_jobs = malloc(sizeof(uint8_t) * 128);
-    for (int i = 0; i < 128; i++)
+    for (int i = 0; i < ASIC_JOB_ID_COUNT; i++)
+    {
+        chain->active_jobs[i] = NULL;
+        chain->valid_jobs[i] = 0;
+    }
+}
+
+int ASIC_jobs_queued(AsicTaskModule * module)
+{
+    int count = 0;
+    for (int i = 0; i < module->chain_count; i++)
     {
-        GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[i] = NULL;
-        GLOBAL_STATE->valid_jobs[i] = 0;
+        count += module->chains[i].jobs_queue.count;
     }
+    return count;
+}
+
+void ASIC_jobs_queue_clear_all(AsicTaskModule * module)
+{
+    for (int i = 0; i < module->chain_count; i++)
+    {
+        ASIC_jobs_queue_clear(&module->chains[i].jobs_queue);
+        xSemaphoreGive(module->chains[i].semaphore);
+    }
+}
 
-    ESP_LOGI(TAG, "ASIC Job Interval: %.2f ms", GLOBAL_STATE->asic_job_frequency_ms);
-    SYSTEM_notify_mining_started(GLOBAL_STATE);
-    ESP_LOGI(TAG, "ASIC Ready!");
+// one instance per chain, pvParameters is the AsicChain it sends work to
+void ASIC_task(void *pvParameters)
+{
+    AsicChain *chain = (AsicChain *)pvParameters;
+    GlobalState *GLOBAL_STATE = (GlobalState *)chain->global_state;
+
+    ESP_LOGI(TAG, "Chain %u ASIC Job Interval: %.2f ms", chain->index, GLOBAL_STATE->asic_job_frequency_ms);
+    if (chain->index == 0)
+    {
+        SYSTEM_notify_mining_started(GLOBAL_STATE);
+    }
+    ESP_LOGI(TAG, "Chain %u ASIC Ready!", chain->index);
 
     while (1)
     {
 
-        bm_job *next_bm_job = (bm_job *)queue_dequeue(&GLOBAL_STATE->ASIC_jobs_queue);
+        bm_job *next_bm_job = (bm_job *)queue_dequeue(&chain->jobs_queue);
 
         if (next_bm_job->pool_diff != GLOBAL_STATE->stratum_difficulty)
         {
@@ -43,12 +75,31 @@ void ASIC_task(void *pvParameters)
             GLOBAL_STATE->stratum_difficulty = next_bm_job->pool_diff;
         }
 
+        int64_t job_start_us = esp_timer_get_time();
+
+        // a recovery in progress holds the lock until the chain takes work again
+        pthread_mutex_lock(&chain->send_lock);
+
         //(*GLOBAL_STATE->ASIC_functions.send_work_fn)(GLOBAL_STATE, next_bm_job); // send the job to the ASIC
-        ASIC_send_work(GLOBAL_STATE, next_bm_job);
+        ASIC_send_work(GLOBAL_STATE, chain, next_bm_job);
+
+        // The job is shifted out in the background, the transmit time counts towards the job interval
+        SERIAL_wait_tx_done(chain->index, GLOBAL_STATE->asic_job_frequency_ms);
+
+        pthread_mutex_unlock(&chain->send_lock);
+        chain_watchdog_job_sent(&chain->watchdog, esp_timer_get_time());
 
-        // Time to execute the above code is ~0.3ms
         // Delay for ASIC(s) to finish the job
-        //vTaskDelay((GLOBAL_STATE->asic_job_frequency_ms - 0.3) / portTICK_PERIOD_MS);
-        xSemaphoreTake(GLOBAL_STATE->ASIC_TASK_MODULE.semaphore, (GLOBAL_STATE->asic_job_frequency_ms / portTICK_PERIOD_MS));
+        double remaining_ms = GLOBAL_STATE->asic_job_frequency_ms - (esp_timer_get_time() - job_start_us) / 1000.0;
+        if (remaining_ms < 0) {
+            remaining_ms = 0;
+        }
+        xSemaphoreTake(chain->semaphore, (remaining_ms / portTICK_PERIOD_MS));
+
+        // the interval is shared by all chains, one of them keeps it trimmed
+        if (chain->index == 0)
+        {
+            ASIC_trim_job_interval(GLOBAL_STATE);
+        }
     }
 }
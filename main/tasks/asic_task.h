@@ -1,19 +1,74 @@
 #ifndef ASIC_TASK_H_
 #define ASIC_TASK_H_
 
+#include <pthread.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "chain_watchdog.h"
+#include "common.h"
 #include "mining.h"
+#include "serial.h"
+#include "ticket_mask.h"
+#include "work_queue.h"
+
+#define ASIC_MAX_CHAINS SERIAL_MAX_CHAINS
+
+// job ids are 7 bits on every chip
+#define ASIC_JOB_ID_COUNT 128
+
+// Everything that belongs to one ASIC chain, the chain index selects its UART and reset line
 typedef struct
 {
+    uint8_t index;
+    // chips that answered during ASIC_init
+    uint8_t asic_count;
+
+    // filled by create_jobs_task, drained by this chain's ASIC_task
+    work_queue jobs_queue;
+
     // ASIC may not return the nonce in the same order as the jobs were sent
     // it also may return a previous nonce under some circumstances
     // so we keep a list of jobs indexed by the job id
-    bm_job **active_jobs;
-    //semaphone
+    bm_job * active_jobs[ASIC_JOB_ID_COUNT];
+    uint8_t valid_jobs[ASIC_JOB_ID_COUNT];
+    pthread_mutex_t valid_jobs_lock;
+
+    // last job id handed out by the driver, every chain has its own id space
+    uint8_t job_id;
+    // filled in by ASIC_process_work, only read by this chain's result task
+    task_result result;
+    // difficulty the chips report nonces at, adjusted by this chain's result task
+    ticket_mask ticket_mask;
+
+    // wakes ASIC_task early when work is abandoned
     SemaphoreHandle_t semaphore;
+    // held by ASIC_task while a job goes out, and by the result task while it recovers the chain
+    pthread_mutex_t send_lock;
+    // held while the chip frequencies change, by the power task and by a chain reset, taken after send_lock
+    pthread_mutex_t frequency_lock;
+    // notices a chain that gets work but stopped returning nonces
+    chain_watchdog watchdog;
+
+    // GlobalState, the tasks of a chain only get the chain as their parameter
+    void * global_state;
+} AsicChain;
+
+typedef struct
+{
+    AsicChain chains[ASIC_MAX_CHAINS];
+    uint8_t chain_count;
+    // stall recoveries of all chains, for the API
+    chain_recovery_log recovery_log;
 } AsicTaskModule;
 
+void ASIC_chain_init(AsicChain * chain, uint8_t index, void * global_state);
+
+/// @brief jobs waiting on all chains
+int ASIC_jobs_queued(AsicTaskModule * module);
+
+/// @brief drops the queued jobs of every chain and wakes their tasks
+void ASIC_jobs_queue_clear_all(AsicTaskModule * module);
+
 void ASIC_task(void *pvParameters);
 
 #endif /* ASIC_TASK_H_ */
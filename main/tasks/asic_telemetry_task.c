@@ -0,0 +1,42 @@
+#include "esp_log.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "global_state.h"
+#include "asic.h"
+#include "asic_telemetry.h"
+#include "asic_telemetry_task.h"
+
+// every register is read from all chips once per period, spread out so a read
+// never costs more UART time than a fraction of a single job
+#define TELEMETRY_PERIOD_MS 5000
+
+static const char *TAG = "asic_telemetry";
+
+static const uint8_t telemetry_registers[] = {
+    ASIC_REG_PLL0_PARAMETER,
+    ASIC_REG_NONCE_ERROR_COUNTER,
+    ASIC_REG_NONCE_OVERFLOW_COUNTER,
+    ASIC_REG_ANALOG_MUX_CONTROL,
+};
+
+void ASIC_telemetry_task(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    asic_telemetry_init(GLOBAL_STATE->ASIC_TASK_MODULE.chain_count, ASIC_get_asic_count(GLOBAL_STATE));
+    ESP_LOGI(TAG, "Polling %d register(s) on %d chip(s)", (int) sizeof(telemetry_registers), asic_telemetry_chip_count());
+
+    while (1)
+    {
+        for (int i = 0; i < (int) sizeof(telemetry_registers); i++)
+        {
+            // responses are matched by chip and register address in receive_work, no need to wait for them here,
+            // a chain that is training its link or recovering is skipped over until it is back
+            ASIC_read_register(GLOBAL_STATE, telemetry_registers[i]);
+            vTaskDelay((TELEMETRY_PERIOD_MS / sizeof(telemetry_registers)) / portTICK_PERIOD_MS);
+        }
+
+    }
+}
@@ -0,0 +1,6 @@
+#ifndef ASIC_TELEMETRY_TASK_H_
+#define ASIC_TELEMETRY_TASK_H_
+
+void ASIC_telemetry_task(void *pvParameters);
+
+#endif
@@ -59,17 +59,32 @@ void create_jobs_task(void *pvParameters)
         if (GLOBAL_STATE->abandon_work == 1)
         {
             GLOBAL_STATE->abandon_work = 0;
-            ASIC_jobs_queue_clear(&GLOBAL_STATE->ASIC_jobs_queue);
-            xSemaphoreGive(GLOBAL_STATE->ASIC_TASK_MODULE.semaphore);
+            ASIC_jobs_queue_clear_all(&GLOBAL_STATE->ASIC_TASK_MODULE);
         }
 
         STRATUM_V1_free_mining_notify(mining_notification);
     }
 }
 
+// the chain with the fewest queued jobs, every chain is fed from the same notification
+static AsicChain *least_loaded_chain(GlobalState *GLOBAL_STATE)
+{
+    AsicTaskModule *module = &GLOBAL_STATE->ASIC_TASK_MODULE;
+    AsicChain *least_loaded = &module->chains[0];
+
+    for (int i = 1; i < module->chain_count; i++)
+    {
+        if (module->chains[i].jobs_queue.count < least_loaded->jobs_queue.count)
+        {
+            least_loaded = &module->chains[i];
+        }
+    }
+    return least_loaded;
+}
+
 static bool should_generate_more_work(GlobalState *GLOBAL_STATE)
 {
-    return GLOBAL_STATE->ASIC_jobs_queue.count < QUEUE_LOW_WATER_MARK;
+    return least_loaded_chain(GLOBAL_STATE)->jobs_queue.count < QUEUE_LOW_WATER_MARK;
 }
 
 static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint32_t extranonce_2)
@@ -111,7 +126,8 @@ static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification
     queued_next_job->jobid = strdup(notification->job_id);
     queued_next_job->version_mask = GLOBAL_STATE->version_mask;
 
-    queue_enqueue(&GLOBAL_STATE->ASIC_jobs_queue, queued_next_job);
+    // every job has its own extranonce_2, so chains never hash the same range
+    queue_enqueue(&least_loaded_chain(GLOBAL_STATE)->jobs_queue, queued_next_job);
 
     free(coinbase_tx);
     free(merkle_root);
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "global_state.h"
+#include "nvs_config.h"
+#include "thermal.h"
+#include "power.h"
+#include "fan_control.h"
+#include "fan_controller_task.h"
+
+// the chip heats up within seconds of a frequency step, the fan has to follow faster than the power task polls
+#define FAN_POLL_RATE 500
+#define FAN_MIN_PERCENT 15
+#define FAN_MAX_PERCENT 100
+#define FAN_GAINS_LENGTH 64
+
+static const char * TAG = "fan_controller";
+
+static fan_gains _load_gains(void)
+{
+    fan_gains gains = {
+        .kp = FAN_CONTROL_DEFAULT_KP,
+        .ki = FAN_CONTROL_DEFAULT_KI,
+        .kd = FAN_CONTROL_DEFAULT_KD,
+        .kff = FAN_CONTROL_DEFAULT_KFF,
+        .period_s = FAN_CONTROL_DEFAULT_PERIOD_S,
+    };
+
+    char * text = nvs_config_get_string(NVS_CONFIG_FAN_GAINS, "");
+    if (text[0] != '\0' && !fan_gains_parse(text, &gains)) {
+        ESP_LOGW(TAG, "Ignoring stored fan gains: %s", text);
+    }
+    free(text);
+    return gains;
+}
+
+static void _store_gains(const fan_gains * gains)
+{
+    char text[FAN_GAINS_LENGTH];
+    fan_gains_format(gains, text, sizeof(text));
+    nvs_config_set_string(NVS_CONFIG_FAN_GAINS, text);
+}
+
+void FAN_CONTROLLER_task(void * pvParameters)
+{
+    ESP_LOGI(TAG, "Starting");
+
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    fan_gains gains = _load_gains();
+    fan_controller controller;
+    fan_autotune tuner;
+    // the controller takes over from whatever speed the fan was left at
+    bool controlling = false;
+    int64_t last_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "Fan gains P %.3f I %.4f D %.3f FF %.3f, period %.1fs", gains.kp, gains.ki, gains.kd, gains.kff, gains.period_s);
+
+    while (1) {
+        int64_t now_us = esp_timer_get_time();
+        float dt_s = (now_us - last_us) / 1e6;
+        last_us = now_us;
+
+        power_management->fan_rpm = Thermal_get_fan_speed(GLOBAL_STATE->device_model);
+        power_management->chip_temp_avg = Thermal_get_chip_temp(GLOBAL_STATE);
+        // read here rather than taken from the power task, a frequency step has to show up within a sample
+        float power = Power_get_power(GLOBAL_STATE);
+        float setpoint = nvs_config_get_u16(NVS_CONFIG_TEMP_TARGET, 60);
+        float percent;
+
+        if (power_management->thermal_derate > 0) {
+            // a derated board runs its fan flat out whatever the setting
+            if (power_management->fan_autotuning) {
+                ESP_LOGW(TAG, "Fan autotune cancelled, the board is derated");
+                power_management->fan_autotuning = false;
+            }
+            controlling = false;
+            percent = FAN_MAX_PERCENT;
+        } else if (nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, 1) != 1) {
+            power_management->fan_autotuning = false;
+            controlling = false;
+            percent = nvs_config_get_u16(NVS_CONFIG_FAN_SPEED, 100);
+        } else if (power_management->chip_temp_avg < 0) {
+            // Ignore invalid temperature readings (-1) during startup
+            vTaskDelay(FAN_POLL_RATE / portTICK_PERIOD_MS);
+            continue;
+        } else {
+            // picked up once the fan is under automatic control, cleared once the relay test starts
+            if (nvs_config_get_u16(NVS_CONFIG_FAN_AUTOTUNE, 0) == 1) {
+                nvs_config_set_u16(NVS_CONFIG_FAN_AUTOTUNE, 0);
+                fan_autotune_start(&tuner, setpoint, controlling ? controller.output : power_management->fan_perc,
+                                   FAN_MIN_PERCENT, FAN_MAX_PERCENT, now_us / 1000);
+                power_management->fan_autotuning = true;
+                ESP_LOGI(TAG, "Fan autotune around %.0fC, fan %.0f-%.0f%%", setpoint, tuner.low, tuner.high);
+            }
+
+            if (power_management->fan_autotuning) {
+                percent = fan_autotune_update(&tuner, power_management->chip_temp_avg, now_us / 1000);
+                if (tuner.state != FAN_AUTOTUNE_RUNNING) {
+                    power_management->fan_autotuning = false;
+                    if (fan_autotune_gains(&tuner, &gains)) {
+                        _store_gains(&gains);
+                        ESP_LOGI(TAG, "Fan autotune done, P %.3f I %.4f D %.3f, period %.1fs", gains.kp, gains.ki, gains.kd, gains.period_s);
+                    } else {
+                        ESP_LOGW(TAG, "Fan autotune failed, keeping the stored gains");
+                    }
+                    controlling = false;
+                }
+            } else {
+                if (!controlling) {
+                    fan_controller_init(&controller, &gains, FAN_MIN_PERCENT, FAN_MAX_PERCENT, power_management->fan_perc);
+                    controlling = true;
+                }
+                percent = fan_controller_update(&controller, power_management->chip_temp_avg, setpoint, power, dt_s);
+                ESP_LOGD(TAG, "Temp: %.1f°C, SetPoint: %.1f°C, Power: %.1fW, Output: %.1f%%",
+                         power_management->chip_temp_avg, setpoint, power, percent);
+            }
+        }
+
+        power_management->fan_perc = percent;
+        Thermal_set_fan_percent(GLOBAL_STATE->device_model, percent / 100.0);
+
+        vTaskDelay(FAN_POLL_RATE / portTICK_PERIOD_MS);
+    }
+}
@@ -0,0 +1,6 @@
+#ifndef FAN_CONTROLLER_TASK_H_
+#define FAN_CONTROLLER_TASK_H_
+
+void FAN_CONTROLLER_task(void * pvParameters);
+
+#endif
@@ -1,6 +1,9 @@
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "INA260.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "global_state.h"
@@ -11,9 +14,13 @@
 #include "TPS546.h"
 #include "vcore.h"
 #include "thermal.h"
-#include "PID.h"
 #include "power.h"
 #include "asic.h"
+#include "asic_telemetry.h"
+#include "autotune.h"
+#include "power_cap.h"
+#include "thermal_governor.h"
+#include "power_profile.h"
 
 #define POLL_RATE 1800
 #define MAX_TEMP 90.0
@@ -27,55 +34,564 @@
 #define TPS546_THROTTLE_TEMP 105.0
 #define TPS546_MAX_TEMP 145.0
 
+// a new core voltage counts as reached once two readings this far apart agree
+#define VCORE_SETTLE_POLL_MS 10
+#define VCORE_SETTLE_TIMEOUT_MS 500
+#define VCORE_SETTLED_MV 3
+
+// autotune grid, overclocking lets the sweep go this far past the settings AxeOS offers
+#define AUTOTUNE_FREQUENCY_STEP 25
+#define AUTOTUNE_VOLTAGE_STEP 50
+#define AUTOTUNE_OVERCLOCK_FREQUENCY 100
+#define AUTOTUNE_OVERCLOCK_VOLTAGE 100
+#define AUTOTUNE_CURVE_LENGTH 1024
+
+// a regulator warning takes a step off the frequency, given back one at a time once it stayed quiet
+#define FAULT_DERATE_STEP 0.1
+#define FAULT_DERATE_MAX_STEPS 5
+#define FAULT_STEP_INTERVAL_MS 2000
+#define FAULT_RESTORE_INTERVAL_MS 300000
+// a converter that shut itself off is turned back on, waiting longer after each restart in a row
+#define FAULT_RECOVERY_INTERVAL_MS 10000
+#define FAULT_RECOVERY_MAX_INTERVAL_MS 300000
+
+// without a valid job for the timeout the chips drop to this clock and the lowest voltage of their range,
+// a subscribe in flight counts as work on the way for a while
+#define IDLE_TIMEOUT_DEFAULT_S 60
+#define IDLE_FREQUENCY 50
+#define IDLE_HANDSHAKE_MS 30000
+// a job is still worth hashing this long after its notify, longer than pools go between notifies
+#define IDLE_NOTIFY_STALE_MS 120000
+// time at speed after leaving idle before it may idle again, a pool that answers and then drops
+// doesn't ramp the chips up and down on every reconnect
+#define IDLE_HOLDOFF_MS 300000
+
+// POSIX TZ the schedule is read in, the wall clock from the pool is UTC
+#define SCHEDULE_TZ_DEFAULT "UTC0"
+#define SCHEDULE_TZ_LENGTH 64
+
+// STATUS_WORD bits of a warning or fault on the output or the input, the temperature is the thermal governor's
+// and the regulator restarts on its own after an overtemperature fault
+#define FAULT_STATUS_BITS (TPS546_STATUS_VOUT | TPS546_STATUS_IOUT | TPS546_STATUS_INPUT | \
+                           TPS546_STATUS_VOUT_OV | TPS546_STATUS_IOUT_OC | TPS546_STATUS_VIN_UV)
+
 static const char * TAG = "power_management";
 
-double pid_input = 0.0;
-double pid_output = 0.0;
-double pid_setPoint = 60.0;
-double pid_p = 4.0;
-double pid_i = 0.2;
-double pid_d = 3.0;
+static TaskHandle_t power_task;
+
+static autotune tuner;
+// the curve is only searched again on request once a sweep came back empty
+static bool autotune_failed;
+static uint16_t autotune_objective_applied;
+static uint16_t autotune_power_cap_applied;
+
+static power_cap cap;
+
+static thermal_governor governor;
+
+static uint8_t fault_steps;
+static int64_t fault_changed_ms;
+static int64_t fault_recovered_ms;
+static uint32_t fault_recovery_interval_ms = FAULT_RECOVERY_INTERVAL_MS;
+
+// the profile last written to the settings, changes made by hand hold until the next transition
+static power_profile schedule_applied;
+static char schedule_active[POWER_PROFILE_NAME_LENGTH];
+static char schedule_tz[SCHEDULE_TZ_LENGTH];
+// the cap in force before the schedule first set one, restored when no profile is scheduled any more
+static uint16_t schedule_cap_before = POWER_PROFILE_UNSET;
+static uint16_t schedule_cap = POWER_PROFILE_UNSET;
+
+// settings the loop acts on, a change wakes it instead of waiting out the poll
+static const char * const setting_keys[] = {
+    NVS_CONFIG_ASIC_FREQ,
+    NVS_CONFIG_ASIC_VOLTAGE,
+    NVS_CONFIG_ASIC_CHIP_FREQ,
+    NVS_CONFIG_POWER_CAP,
+    NVS_CONFIG_AUTOTUNE,
+    NVS_CONFIG_AUTOTUNE_POWER,
+    NVS_CONFIG_AUTOTUNE_SWEEP,
+    NVS_CONFIG_OVERHEAT_MODE,
+    NVS_CONFIG_IDLE_TIMEOUT,
+    NVS_CONFIG_PROFILES,
+    NVS_CONFIG_SCHEDULE,
+    NVS_CONFIG_SCHEDULE_TZ,
+};
+
+// waits for the regulator to arrive at a new setpoint so a frequency ramp can follow right away
+static void _wait_for_vcore(GlobalState * GLOBAL_STATE)
+{
+    int16_t previous = VCORE_get_voltage_mv(GLOBAL_STATE);
+
+    for (int waited = 0; waited < VCORE_SETTLE_TIMEOUT_MS; waited += VCORE_SETTLE_POLL_MS) {
+        vTaskDelay(VCORE_SETTLE_POLL_MS / portTICK_PERIOD_MS);
+        int16_t voltage = VCORE_get_voltage_mv(GLOBAL_STATE);
+        // the first reading may still be from before the regulator started moving
+        if (waited > 0 && abs(voltage - previous) <= VCORE_SETTLED_MV) {
+            ESP_LOGI(TAG, "vcore settled at %dmV after %dms", voltage, waited + VCORE_SETTLE_POLL_MS);
+            return;
+        }
+        previous = voltage;
+    }
+    ESP_LOGW(TAG, "vcore still moving after %dms", VCORE_SETTLE_TIMEOUT_MS);
+}
+
+static void _set_asic_frequency(GlobalState * GLOBAL_STATE, uint16_t asic_frequency, uint16_t last_asic_frequency)
+{
+    ESP_LOGI(TAG, "New ASIC frequency requested: %uMHz (current: %uMHz)", asic_frequency, last_asic_frequency);
+
+    bool success = ASIC_set_frequency(GLOBAL_STATE, (float)asic_frequency);
+
+    if (success) {
+        GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value = (float)asic_frequency;
+    }
+}
+
+static void _autotune_limits(GlobalState * GLOBAL_STATE, autotune_limits * limits)
+{
+    // the ranges GET_system_asic offers for each chip
+    switch (GLOBAL_STATE->asic_model) {
+        case ASIC_BM1370:
+            *limits = (autotune_limits) {.min_frequency = 400, .max_frequency = 625, .min_voltage = 1000, .max_voltage = 1250};
+            break;
+        case ASIC_BM1368:
+        case ASIC_BM1366:
+            *limits = (autotune_limits) {.min_frequency = 400, .max_frequency = 575, .min_voltage = 1100, .max_voltage = 1300};
+            break;
+        case ASIC_BM1397:
+            *limits = (autotune_limits) {.min_frequency = 400, .max_frequency = 600, .min_voltage = 1100, .max_voltage = 1500};
+            break;
+        default:
+            *limits = (autotune_limits) {.min_frequency = 400, .max_frequency = 450, .min_voltage = 1200, .max_voltage = 1300};
+    }
+
+    if (nvs_config_get_u16(NVS_CONFIG_OVERCLOCK_ENABLED, 0) == 1) {
+        limits->max_frequency += AUTOTUNE_OVERCLOCK_FREQUENCY;
+        limits->max_voltage += AUTOTUNE_OVERCLOCK_VOLTAGE;
+    }
+    limits->frequency_step = AUTOTUNE_FREQUENCY_STEP;
+    limits->voltage_step = AUTOTUNE_VOLTAGE_STEP;
+    limits->max_power = Power_get_max_settings(GLOBAL_STATE);
+
+    uint16_t chips = 0;
+    for (uint8_t chain = 0; chain < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; chain++) {
+        chips += GLOBAL_STATE->ASIC_TASK_MODULE.chains[chain].asic_count;
+    }
+    limits->hashrate_per_mhz = ASIC_get_small_core_count(GLOBAL_STATE) * chips / 1000.0;
+}
+
+// picks the point for the objective from the stored curve and makes it the configured setpoint
+static void _autotune_apply(uint16_t objective, uint16_t power_cap, uint16_t * core_voltage, uint16_t * asic_frequency)
+{
+    autotune_objective_applied = objective;
+    autotune_power_cap_applied = power_cap;
+
+    char * text = nvs_config_get_string(NVS_CONFIG_AUTOTUNE_CURVE, "");
+    autotune_point curve[AUTOTUNE_MAX_POINTS];
+    uint8_t count = autotune_curve_parse(text, curve, AUTOTUNE_MAX_POINTS);
+    free(text);
+
+    const autotune_point * point = autotune_select(curve, count, objective, power_cap);
+    if (point == NULL) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Autotune objective %u: %uMHz at %umV, %.1f GH/s, %.1f W, %.1f J/TH",
+             objective, point->frequency, point->voltage, point->hashrate, point->power, autotune_efficiency(point));
+    // only written on a change, the sweep may pick the same point again
+    if (point->voltage != *core_voltage) {
+        nvs_config_set_u16(NVS_CONFIG_ASIC_VOLTAGE, point->voltage);
+        *core_voltage = point->voltage;
+    }
+    if (point->frequency != *asic_frequency) {
+        nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, point->frequency);
+        *asic_frequency = point->frequency;
+    }
+}
+
+static void _autotune_finish(GlobalState * GLOBAL_STATE)
+{
+    autotune_point curve[AUTOTUNE_MAX_POINTS];
+    uint8_t count = autotune_pareto(tuner.points, tuner.count, curve);
+
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.autotuning = false;
+    if (count == 0) {
+        ESP_LOGW(TAG, "Autotune found no stable setting, keeping the configured one");
+        autotune_failed = true;
+        return;
+    }
+
+    char * text = malloc(AUTOTUNE_CURVE_LENGTH);
+    autotune_curve_format(curve, count, text, AUTOTUNE_CURVE_LENGTH);
+    nvs_config_set_string(NVS_CONFIG_AUTOTUNE_CURVE, text);
+    free(text);
+
+    ESP_LOGI(TAG, "Autotune done, %u of %u points on the curve", count, tuner.count);
+    // the selection runs again against the new curve
+    autotune_objective_applied = AUTOTUNE_OFF;
+}
+
+// runs a sweep when one is requested or there is no curve yet, then keeps the setpoint on the chosen objective,
+// during a sweep the setpoint comes from the tuner
+static void _autotune(GlobalState * GLOBAL_STATE, uint16_t * core_voltage, uint16_t * asic_frequency)
+{
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    SystemModule * sys_module = &GLOBAL_STATE->SYSTEM_MODULE;
+    uint16_t objective = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE, AUTOTUNE_OFF);
+    int64_t now_ms = esp_timer_get_time() / 1000;
+
+    if (objective == AUTOTUNE_OFF) {
+        if (power_management->autotuning) {
+            ESP_LOGI(TAG, "Autotune sweep cancelled");
+            power_management->autotuning = false;
+        }
+        autotune_objective_applied = AUTOTUNE_OFF;
+        return;
+    }
+
+    // the chip count and the nonces the sweep goes by only exist once mining started
+    if (!GLOBAL_STATE->ASIC_initalized) {
+        return;
+    }
+
+    bool sweep_requested = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_SWEEP, 0) == 1;
+    if (!power_management->autotuning && !sweep_requested) {
+        char * text = nvs_config_get_string(NVS_CONFIG_AUTOTUNE_CURVE, "");
+        bool have_curve = text[0] != '\0';
+        free(text);
+
+        if (have_curve || autotune_failed) {
+            uint16_t power_cap = nvs_config_get_u16(NVS_CONFIG_AUTOTUNE_POWER, Power_get_max_settings(GLOBAL_STATE));
+            if (objective != autotune_objective_applied || power_cap != autotune_power_cap_applied) {
+                _autotune_apply(objective, power_cap, core_voltage, asic_frequency);
+            }
+            return;
+        }
+        // an objective without a curve needs a sweep first
+    }
+
+    if (sweep_requested || !power_management->autotuning) {
+        nvs_config_set_u16(NVS_CONFIG_AUTOTUNE_SWEEP, 0);
+        autotune_failed = false;
+
+        autotune_limits limits;
+        _autotune_limits(GLOBAL_STATE, &limits);
+        autotune_start(&tuner, &limits, now_ms);
+        power_management->autotuning = true;
+        ESP_LOGI(TAG, "Autotune sweep %u-%uMHz, %u-%umV, up to %.0f W",
+                 limits.min_frequency, limits.max_frequency, limits.min_voltage, limits.max_voltage, limits.max_power);
+    }
+
+    autotune_counters counters = {
+        .nonces = sys_module->nonces_found - sys_module->hw_errors,
+        .difficulty_sum = sys_module->nonce_difficulty_sum,
+        .hw_error_difficulty_sum = sys_module->hw_error_difficulty_sum,
+    };
+    // the chips count errors of their own and report their PLL lock through the register telemetry
+    for (uint16_t chip = 0; chip < asic_telemetry_chip_count(); chip++) {
+        const asic_chip_telemetry * telemetry = asic_telemetry_get(chip);
+        if (telemetry->seen) {
+            counters.chip_errors += telemetry->nonce_errors;
+            counters.unlocked_chips += !telemetry->pll_locked;
+        }
+    }
+    if (autotune_sample(&tuner, now_ms, &counters, power_management->power)) {
+        if (tuner.state == AUTOTUNE_DONE) {
+            _autotune_finish(GLOBAL_STATE);
+            return;
+        }
+        ESP_LOGI(TAG, "Autotune trying %uMHz at %umV", tuner.frequency, tuner.voltage);
+    }
+
+    *core_voltage = tuner.voltage;
+    *asic_frequency = tuner.frequency;
+}
+
+// the thermal governor, a core regulator fault or missing work can hold the chips below the setpoint the tuner
+// is measuring, it starts that point over instead of recording what the lower frequency did
+static void _autotune_derated(GlobalState * GLOBAL_STATE, uint16_t core_voltage, uint16_t asic_frequency)
+{
+    if (!GLOBAL_STATE->POWER_MANAGEMENT_MODULE.autotuning ||
+        (core_voltage == tuner.voltage && asic_frequency == tuner.frequency)) {
+        return;
+    }
+
+    if (autotune_derated(&tuner, esp_timer_get_time() / 1000)) {
+        if (tuner.state == AUTOTUNE_DONE) {
+            _autotune_finish(GLOBAL_STATE);
+            return;
+        }
+        ESP_LOGW(TAG, "Autotune point held down by a derate, trying %uMHz at %umV", tuner.frequency, tuner.voltage);
+    }
+}
+
+// holds the power under the configured cap by running the chips below the configured frequency,
+// the core voltage follows the autotune curve down where there is one,
+// applied_frequency is what the chips ran at while the power was read, derates included
+static void _power_cap(GlobalState * GLOBAL_STATE, uint16_t applied_frequency, uint16_t * core_voltage, uint16_t * asic_frequency)
+{
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    // the board isn't rated for more than its max setting, a higher cap means that
+    float target = nvs_config_get_u16(NVS_CONFIG_POWER_CAP, 0);
+    if (target > Power_get_max_settings(GLOBAL_STATE)) {
+        target = Power_get_max_settings(GLOBAL_STATE);
+    }
+    // a sweep measures the chips at the setpoints it picks
+    cap.target = power_management->autotuning || !GLOBAL_STATE->ASIC_initalized ? 0 : target;
+
+    if (power_cap_update(&cap, power_management->power, applied_frequency, *asic_frequency, esp_timer_get_time() / 1000) &&
+        cap.frequency < *asic_frequency) {
+        ESP_LOGI(TAG, "Power cap %.0f W: %.1f W, allowing %.0fMHz", cap.target, cap.power, cap.frequency);
+    }
+
+    power_management->power_limited = cap.frequency < *asic_frequency;
+    if (!power_management->power_limited) {
+        return;
+    }
+    *asic_frequency = cap.frequency;
+
+    char * text = nvs_config_get_string(NVS_CONFIG_AUTOTUNE_CURVE, "");
+    autotune_point curve[AUTOTUNE_MAX_POINTS];
+    uint8_t count = autotune_curve_parse(text, curve, AUTOTUNE_MAX_POINTS);
+    free(text);
+
+    uint16_t voltage = autotune_voltage_for(curve, count, *asic_frequency);
+    if (voltage > 0 && voltage < *core_voltage) {
+        *core_voltage = voltage;
+    }
+}
+
+// drops to the idle setpoint once there was no valid job for the timeout, and comes back up as soon as
+// the pool answers a subscribe so the chips are at speed by the first notify
+static void _idle(GlobalState * GLOBAL_STATE, uint16_t * core_voltage, uint16_t * asic_frequency)
+{
+    static int64_t left_idle_us;
+
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    SystemModule * sys_module = &GLOBAL_STATE->SYSTEM_MODULE;
+    int64_t now_us = esp_timer_get_time();
+    uint16_t timeout_s = nvs_config_get_u16(NVS_CONFIG_IDLE_TIMEOUT, IDLE_TIMEOUT_DEFAULT_S);
+
+    // the jobs of a connected pool go stale when it stops sending notifies
+    int64_t no_work_since_us = sys_module->has_work ? sys_module->last_notify_us + IDLE_NOTIFY_STALE_MS * 1000LL
+                                                    : sys_module->work_changed_us;
+    bool handshake = sys_module->handshake_us > 0 && now_us - sys_module->handshake_us < IDLE_HANDSHAKE_MS * 1000LL;
+    bool idle = timeout_s > 0 && GLOBAL_STATE->ASIC_initalized && !handshake &&
+                now_us - no_work_since_us >= timeout_s * 1000000LL;
+    if (idle && !power_management->idle && left_idle_us > 0 && now_us - left_idle_us < IDLE_HOLDOFF_MS * 1000LL) {
+        idle = false;
+    }
 
-PIDController pid;
+    if (idle != power_management->idle) {
+        if (idle) {
+            ESP_LOGI(TAG, "No valid job for %us, idling", timeout_s);
+        } else {
+            ESP_LOGI(TAG, "Work on the way, leaving idle");
+            left_idle_us = now_us;
+        }
+        power_management->idle = idle;
+    }
+    if (!idle) {
+        return;
+    }
+
+    autotune_limits limits;
+    _autotune_limits(GLOBAL_STATE, &limits);
+    if (*asic_frequency > IDLE_FREQUENCY) {
+        *asic_frequency = IDLE_FREQUENCY;
+    }
+    if (*core_voltage > limits.min_voltage) {
+        *core_voltage = limits.min_voltage;
+    }
+}
+
+// writes the profile the schedule has in force into the settings, the loop then ramps to it like to any
+// other change, needs the wall clock the pool sets with the job time
+static void _schedule(GlobalState * GLOBAL_STATE)
+{
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    char * tz = nvs_config_get_string(NVS_CONFIG_SCHEDULE_TZ, SCHEDULE_TZ_DEFAULT);
+    if (strncmp(tz, schedule_tz, sizeof(schedule_tz)) != 0) {
+        strncpy(schedule_tz, tz, sizeof(schedule_tz) - 1);
+        setenv("TZ", schedule_tz, 1);
+        tzset();
+    }
+    free(tz);
+
+    if (GLOBAL_STATE->SYSTEM_MODULE.lastClockSync == 0) {
+        return;
+    }
+
+    char * text = nvs_config_get_string(NVS_CONFIG_SCHEDULE, "");
+    power_schedule_entry entries[POWER_SCHEDULE_MAX_ENTRIES];
+    uint8_t entry_count = power_schedule_parse(text, entries, POWER_SCHEDULE_MAX_ENTRIES);
+    free(text);
+
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    int active = power_schedule_active(entries, entry_count,
+                                       local.tm_wday * POWER_SCHEDULE_MINUTES_PER_DAY + local.tm_hour * 60 + local.tm_min);
+
+    text = nvs_config_get_string(NVS_CONFIG_PROFILES, "");
+    power_profile profiles[POWER_PROFILE_MAX_COUNT];
+    uint8_t profile_count = power_profiles_parse(text, profiles, POWER_PROFILE_MAX_COUNT);
+    free(text);
+
+    const power_profile * profile = active >= 0 ? power_profile_find(profiles, profile_count, entries[active].profile) : NULL;
+    if (profile == NULL) {
+        if (schedule_active[0] != '\0') {
+            ESP_LOGI(TAG, "No power profile scheduled, keeping the settings of %s", schedule_active);
+        }
+        // a cap changed by hand since holds, otherwise the one from before the schedule comes back
+        if (schedule_cap != POWER_PROFILE_UNSET && nvs_config_get_u16(NVS_CONFIG_POWER_CAP, 0) == schedule_cap) {
+            ESP_LOGI(TAG, "Restoring the power cap of %uW", schedule_cap_before);
+            nvs_config_set_u16(NVS_CONFIG_POWER_CAP, schedule_cap_before);
+        }
+        schedule_cap_before = POWER_PROFILE_UNSET;
+        schedule_cap = POWER_PROFILE_UNSET;
+        memset(&schedule_applied, 0, sizeof(schedule_applied));
+        schedule_active[0] = '\0';
+        power_management->active_profile = NULL;
+        return;
+    }
+    if (memcmp(profile, &schedule_applied, sizeof(schedule_applied)) == 0) {
+        return;
+    }
+
+    char settings[POWER_PROFILE_NAME_LENGTH + 24];
+    power_profiles_format(profile, 1, settings, sizeof(settings));
+    ESP_LOGI(TAG, "Switching to power profile %s", settings);
+    if (profile->frequency != POWER_PROFILE_UNSET && profile->frequency > 0) {
+        nvs_config_set_u16(NVS_CONFIG_ASIC_FREQ, profile->frequency);
+    }
+    if (profile->voltage != POWER_PROFILE_UNSET && profile->voltage > 0) {
+        nvs_config_set_u16(NVS_CONFIG_ASIC_VOLTAGE, profile->voltage);
+    }
+    if (profile->temp_target != POWER_PROFILE_UNSET && profile->temp_target > 0) {
+        nvs_config_set_u16(NVS_CONFIG_TEMP_TARGET, profile->temp_target);
+    }
+    // 0 turns the cap off
+    if (profile->power_cap != POWER_PROFILE_UNSET) {
+        if (schedule_cap_before == POWER_PROFILE_UNSET) {
+            schedule_cap_before = nvs_config_get_u16(NVS_CONFIG_POWER_CAP, 0);
+        }
+        nvs_config_set_u16(NVS_CONFIG_POWER_CAP, profile->power_cap);
+        schedule_cap = profile->power_cap;
+    }
+    schedule_applied = *profile;
+    strcpy(schedule_active, profile->name);
+    power_management->active_profile = schedule_active;
+}
+
+// reacts to the regulator status, right away when SMBALERT woke the loop, otherwise at the poll
+static void _power_fault(GlobalState * GLOBAL_STATE, uint16_t * last_core_voltage)
+{
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    bool alert = VCORE_take_alert();
+    uint16_t status;
+
+    if (VCORE_get_status(GLOBAL_STATE, &status) != ESP_OK) {
+        return;
+    }
+
+    if ((status & TPS546_STATUS_OFF) && (status & FAULT_STATUS_BITS) && *last_core_voltage > 0) {
+        // the latched fault keeps the output off until the flags are cleared and it is commanded on again
+        if (now_ms - fault_recovered_ms >= fault_recovery_interval_ms) {
+            ESP_LOGE(TAG, "Core regulator shut off (status %04X), turning it back on", status);
+            VCORE_check_fault(GLOBAL_STATE);
+            VCORE_clear_faults(GLOBAL_STATE);
+            // the loop sets the voltage again
+            *last_core_voltage = 0;
+            fault_recovered_ms = now_ms;
+            if (fault_recovery_interval_ms < FAULT_RECOVERY_MAX_INTERVAL_MS) {
+                fault_recovery_interval_ms *= 2;
+            }
+            power_management->fault_recoveries++;
+            // it comes back at a lower frequency
+            fault_steps = FAULT_DERATE_MAX_STEPS;
+            fault_changed_ms = now_ms;
+        }
+    } else if (status & FAULT_STATUS_BITS) {
+        if ((alert || now_ms - fault_changed_ms >= FAULT_STEP_INTERVAL_MS) && fault_steps < FAULT_DERATE_MAX_STEPS) {
+            fault_steps++;
+            fault_changed_ms = now_ms;
+            ESP_LOGW(TAG, "Core regulator warning (status %04X), frequency derated %u%%",
+                     status, (unsigned) (fault_steps * FAULT_DERATE_STEP * 100));
+        }
+        VCORE_check_fault(GLOBAL_STATE);
+        // the flags are latched, cleared they show whether the condition comes back
+        VCORE_clear_faults(GLOBAL_STATE);
+    } else if (fault_steps > 0 && now_ms - fault_changed_ms >= FAULT_RESTORE_INTERVAL_MS) {
+        fault_steps--;
+        fault_changed_ms = now_ms;
+        ESP_LOGI(TAG, "Core regulator quiet, frequency derated %u%%", (unsigned) (fault_steps * FAULT_DERATE_STEP * 100));
+    } else if (fault_steps == 0 && now_ms - fault_recovered_ms >= FAULT_RECOVERY_MAX_INTERVAL_MS) {
+        fault_recovery_interval_ms = FAULT_RECOVERY_INTERVAL_MS;
+    }
+
+    power_management->fault_derate = fault_steps * FAULT_DERATE_STEP * 100;
+}
+
+void POWER_MANAGEMENT_wake(void)
+{
+    if (power_task != NULL) {
+        xTaskNotifyGive(power_task);
+    }
+}
 
 void POWER_MANAGEMENT_task(void * pvParameters)
 {
     ESP_LOGI(TAG, "Starting");
 
+    power_task = xTaskGetCurrentTaskHandle();
+
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
-    
-    // Initialize PID controller
-    pid_setPoint = (double)nvs_config_get_u16(NVS_CONFIG_TEMP_TARGET, pid_setPoint);
-    pid_init(&pid, &pid_input, &pid_output, &pid_setPoint, pid_p, pid_i, pid_d, PID_P_ON_E, PID_DIRECT);
-    pid_set_sample_time(&pid, POLL_RATE - 1);
-    pid_set_output_limits(&pid, 15, 100);
-    pid_set_mode(&pid, AUTOMATIC);
-    pid_set_controller_direction(&pid, PID_REVERSE);
-    pid_initialize(&pid);
+
 
     PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
     SystemModule * sys_module = &GLOBAL_STATE->SYSTEM_MODULE;
 
     power_management->frequency_multiplier = 1;
 
+    for (int i = 0; i < sizeof(setting_keys) / sizeof(setting_keys[0]); i++) {
+        nvs_config_subscribe(setting_keys[i], nvs_config_notify_task, xTaskGetCurrentTaskHandle());
+    }
+
     //int last_frequency_increase = 0;
     //uint16_t frequency_target = nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY);
 
     vTaskDelay(500 / portTICK_PERIOD_MS);
     uint16_t last_core_voltage = 0.0;
     uint16_t last_asic_frequency = power_management->frequency_value;
-    
-    while (1) {
+    char * last_chip_frequencies = nvs_config_get_string(NVS_CONFIG_ASIC_CHIP_FREQ, "");
+    power_cap_init(&cap, 0, last_asic_frequency);
+
+    thermal_limits limits = {
+        .chip_throttle = THROTTLE_TEMP,
+        .chip_max = MAX_TEMP,
+        .vr_throttle = TPS546_THROTTLE_TEMP,
+        .vr_max = TPS546_MAX_TEMP,
+    };
+    thermal_governor_init(&governor, &limits);
+    power_management->thermal_stage = thermal_governor_stage_name(governor.stage);
 
-        // Refresh PID setpoint from NVS in case it was changed via API
-        pid_setPoint = (double)nvs_config_get_u16(NVS_CONFIG_TEMP_TARGET, pid_setPoint);
+    // without the pin the status is still looked at every poll
+    if (VCORE_enable_alert(GLOBAL_STATE, xTaskGetCurrentTaskHandle()) == ESP_OK) {
+        ESP_LOGI(TAG, "Core regulator faults wake the power loop");
+    }
+
+    while (1) {
+        _power_fault(GLOBAL_STATE, &last_core_voltage);
+        _schedule(GLOBAL_STATE);
 
         power_management->voltage = Power_get_input_voltage(GLOBAL_STATE);
         power_management->power = Power_get_power(GLOBAL_STATE);
 
-        power_management->fan_rpm = Thermal_get_fan_speed(GLOBAL_STATE->device_model);
-        power_management->chip_temp_avg = Thermal_get_chip_temp(GLOBAL_STATE);
-
+        // the chip temperature and the fan are the fan controller's, it samples them faster
         power_management->vr_temp = Power_get_vreg_temp(GLOBAL_STATE);
 
 
@@ -84,8 +600,16 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         //     goto looper;
         // }
 
-        //overheat mode if the voltage regulator or ASIC is too hot
-        if ((power_management->vr_temp > TPS546_THROTTLE_TEMP || power_management->chip_temp_avg > THROTTLE_TEMP) && (power_management->frequency_value > 50 || power_management->voltage > 1000)) {
+        // above the throttle points the frequency comes down in steps and goes back up once the board cooled off
+        if (thermal_governor_update(&governor, power_management->chip_temp_avg, power_management->vr_temp, esp_timer_get_time() / 1000)) {
+            ESP_LOGW(TAG, "Thermal %s: VR %.1fC, ASIC %.1fC, frequency derated %u%%", thermal_governor_stage_name(governor.stage),
+                     power_management->vr_temp, power_management->chip_temp_avg, (unsigned) (governor.steps * THERMAL_DERATE_STEP * 100));
+        }
+        power_management->thermal_stage = thermal_governor_stage_name(governor.stage);
+        power_management->thermal_derate = governor.steps * THERMAL_DERATE_STEP * 100;
+
+        // only a runaway past the absolute limits turns the core off
+        if (governor.stage == THERMAL_RUNAWAY && (power_management->frequency_value > 50 || power_management->voltage > 1000)) {
             ESP_LOGE(TAG, "OVERHEAT! VR: %fC ASIC %fC", power_management->vr_temp, power_management->chip_temp_avg );
             power_management->fan_perc = 100;
             Thermal_set_fan_percent(GLOBAL_STATE->device_model, 1);
@@ -100,25 +624,6 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             nvs_config_set_u16(NVS_CONFIG_OVERHEAT_MODE, 1);
             exit(EXIT_FAILURE);
         }
-        //enable the PID auto control for the FAN if set
-        if (nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, 1) == 1) {
-            // Ignore invalid temperature readings (-1) during startup
-            if (power_management->chip_temp_avg >= 0) {
-                pid_input = power_management->chip_temp_avg;
-                pid_compute(&pid);
-                power_management->fan_perc = (uint16_t) pid_output;
-                Thermal_set_fan_percent(GLOBAL_STATE->device_model, pid_output / 100.0);
-                ESP_LOGI(TAG, "Temp: %.1f°C, SetPoint: %.1f°C, Output: %.1f%%", pid_input, pid_setPoint, pid_output);
-            } else {
-                ESP_LOGW(TAG, "Ignoring invalid temperature reading: %.1f°C", power_management->chip_temp_avg);
-            }
-
-        } else {
-            float fs = (float) nvs_config_get_u16(NVS_CONFIG_FAN_SPEED, 100);
-            power_management->fan_perc = fs;
-            Thermal_set_fan_percent(GLOBAL_STATE->device_model, (float) fs / 100.0);
-        }
-
         // Read the state of plug sense pin
         // if (power_management->HAS_PLUG_SENSE) {
         //     int gpio_plug_sense_state = gpio_get_level(GPIO_PLUG_SENSE);
@@ -131,22 +636,45 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         // New voltage and frequency adjustment code
         uint16_t core_voltage = nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE, CONFIG_ASIC_VOLTAGE);
         uint16_t asic_frequency = nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, CONFIG_ASIC_FREQUENCY);
+        _autotune(GLOBAL_STATE, &core_voltage, &asic_frequency);
+        _power_cap(GLOBAL_STATE, last_asic_frequency, &core_voltage, &asic_frequency);
+        asic_frequency = thermal_governor_frequency(&governor, asic_frequency);
+        asic_frequency *= 1 - fault_steps * FAULT_DERATE_STEP;
+        _idle(GLOBAL_STATE, &core_voltage, &asic_frequency);
+        _autotune_derated(GLOBAL_STATE, core_voltage, asic_frequency);
+
+        // lower the clock before the voltage and raise the voltage before the clock,
+        // the chips never run faster than the voltage they are on allows
+        if (asic_frequency < last_asic_frequency) {
+            _set_asic_frequency(GLOBAL_STATE, asic_frequency, last_asic_frequency);
+            last_asic_frequency = asic_frequency;
+        }
 
         if (core_voltage != last_core_voltage) {
             ESP_LOGI(TAG, "setting new vcore voltage to %umV", core_voltage);
             VCORE_set_voltage((double) core_voltage / 1000.0, GLOBAL_STATE);
+            if (asic_frequency > last_asic_frequency) {
+                _wait_for_vcore(GLOBAL_STATE);
+            }
             last_core_voltage = core_voltage;
         }
 
-        if (asic_frequency != last_asic_frequency) {
-            ESP_LOGI(TAG, "New ASIC frequency requested: %uMHz (current: %uMHz)", asic_frequency, last_asic_frequency);
-            
-            bool success = ASIC_set_frequency(GLOBAL_STATE, (float)asic_frequency);
-            
-            if (success) {
-                power_management->frequency_value = (float)asic_frequency;
+        // new per chip caps are applied by ramping the chips to the current board frequency again
+        char * chip_frequencies = nvs_config_get_string(NVS_CONFIG_ASIC_CHIP_FREQ, "");
+        if (strcmp(chip_frequencies, last_chip_frequencies) != 0) {
+            ESP_LOGI(TAG, "New per chip frequency caps: %s", chip_frequencies);
+            ASIC_set_chip_frequency_caps(GLOBAL_STATE, chip_frequencies);
+            if (asic_frequency == last_asic_frequency) {
+                ASIC_set_frequency(GLOBAL_STATE, power_management->frequency_value);
             }
-            
+            free(last_chip_frequencies);
+            last_chip_frequencies = chip_frequencies;
+        } else {
+            free(chip_frequencies);
+        }
+
+        if (asic_frequency > last_asic_frequency) {
+            _set_asic_frequency(GLOBAL_STATE, asic_frequency, last_asic_frequency);
             last_asic_frequency = asic_frequency;
         }
 
@@ -161,6 +689,6 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         VCORE_check_fault(GLOBAL_STATE);
 
         // looper:
-        vTaskDelay(POLL_RATE / portTICK_PERIOD_MS);
+        ulTaskNotifyTake(pdTRUE, POLL_RATE / portTICK_PERIOD_MS);
     }
 }
@@ -13,8 +13,28 @@ typedef struct
     float frequency_value;
     float power;
     float current;
+    // a sweep is driving the voltage and frequency
+    bool autotuning;
+    // the power cap holds the frequency below the configured one
+    bool power_limited;
+    // thermal governor stage and the share of the frequency it took off, in percent
+    const char * thermal_stage;
+    uint8_t thermal_derate;
+    // share of the frequency taken off after core regulator warnings, in percent,
+    // and the times the regulator was turned back on after a fault shut it off
+    uint8_t fault_derate;
+    uint16_t fault_recoveries;
+    // no valid job for the idle timeout, the chips run at the idle setpoint
+    bool idle;
+    // name of the power profile the schedule has in force, NULL without one
+    const char * active_profile;
+    // the fan runs a relay test instead of the controller
+    bool fan_autotuning;
 } PowerManagementModule;
 
 void POWER_MANAGEMENT_task(void * pvParameters);
 
+// runs the loop now instead of at the next poll
+void POWER_MANAGEMENT_wake(void);
+
 #endif
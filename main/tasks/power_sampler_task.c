@@ -0,0 +1,140 @@
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "global_state.h"
+#include "nvs_config.h"
+#include "power.h"
+#include "power_sampler_task.h"
+
+// the rate is rounded to whole ticks, 30 Hz runs at 33 Hz on a 10 ms tick
+#define SAMPLE_RATE_DEFAULT 20
+#define SAMPLE_RATE_MIN 10
+#define SAMPLE_RATE_MAX 50
+
+static const char * TAG = "power_sampler";
+
+static sample_history * history;
+static SemaphoreHandle_t history_lock;
+static uint16_t sample_rate = SAMPLE_RATE_DEFAULT;
+
+// integrated from the same samples, held under the history lock
+static energy_meter meter;
+static bool metering;
+
+static void _load_rate(const char * key, void * context)
+{
+    uint16_t rate = nvs_config_get_u16(NVS_CONFIG_SAMPLE_RATE, SAMPLE_RATE_DEFAULT);
+
+    if (rate < SAMPLE_RATE_MIN) {
+        rate = SAMPLE_RATE_MIN;
+    } else if (rate > SAMPLE_RATE_MAX) {
+        rate = SAMPLE_RATE_MAX;
+    }
+    sample_rate = rate;
+}
+
+const sample_history * power_sampler_acquire(void)
+{
+    if (history == NULL) {
+        return NULL;
+    }
+    xSemaphoreTake(history_lock, portMAX_DELAY);
+    return history;
+}
+
+void power_sampler_release(void)
+{
+    xSemaphoreGive(history_lock);
+}
+
+uint16_t power_sampler_rate(void)
+{
+    return sample_rate;
+}
+
+bool power_sampler_energy(double * total_wh, double * session_wh, energy_window windows[ENERGY_WINDOWS])
+{
+    if (!metering) {
+        return false;
+    }
+
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    xSemaphoreTake(history_lock, portMAX_DELAY);
+    *total_wh = meter.total_wh;
+    *session_wh = meter.session_wh;
+    for (int length = 0; length < ENERGY_WINDOWS; length++) {
+        energy_meter_window(&meter, length, now_ms, &windows[length]);
+    }
+    xSemaphoreGive(history_lock);
+    return true;
+}
+
+// flash wears with every write, the counter only goes out every so often and when the device restarts
+static void _checkpoint(void)
+{
+    xSemaphoreTake(history_lock, portMAX_DELAY);
+    uint64_t total_mwh = meter.total_wh * 1000;
+    energy_meter_checkpointed(&meter, esp_timer_get_time() / 1000);
+    xSemaphoreGive(history_lock);
+
+    nvs_config_set_u64(NVS_CONFIG_ENERGY_TOTAL, total_mwh);
+}
+
+void POWER_SAMPLER_task(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    sample_history * buffer = heap_caps_malloc(sizeof(sample_history), GLOBAL_STATE->psram_is_available ? MALLOC_CAP_SPIRAM : MALLOC_CAP_8BIT);
+    history_lock = xSemaphoreCreateMutex();
+    if (buffer == NULL || history_lock == NULL) {
+        ESP_LOGE(TAG, "No memory for the sample history");
+        vTaskDelete(NULL);
+        return;
+    }
+    sample_history_init(buffer);
+    history = buffer;
+
+    energy_meter_init(&meter, nvs_config_get_u64(NVS_CONFIG_ENERGY_TOTAL, 0) / 1000.0, esp_timer_get_time() / 1000);
+    metering = true;
+    esp_register_shutdown_handler(_checkpoint);
+    ESP_LOGI(TAG, "Energy counter at %.3f kWh", meter.total_wh / 1000);
+
+    _load_rate(NVS_CONFIG_SAMPLE_RATE, NULL);
+    nvs_config_subscribe(NVS_CONFIG_SAMPLE_RATE, _load_rate, NULL);
+    ESP_LOGI(TAG, "Sampling at %u Hz", sample_rate);
+
+    TickType_t last_wake = xTaskGetTickCount();
+    while (1) {
+        // the electrical readings come off the bus at the sample rate, the temperatures and the fan
+        // don't move that fast and are taken from the tasks that already read them
+        float values[SAMPLE_CHANNELS] = {
+            [SAMPLE_VOLTAGE] = Power_get_input_voltage(GLOBAL_STATE),
+            [SAMPLE_CURRENT] = Power_get_current(GLOBAL_STATE),
+            [SAMPLE_POWER] = Power_get_power(GLOBAL_STATE),
+            [SAMPLE_VR_TEMP] = power_management->vr_temp,
+            [SAMPLE_CHIP_TEMP] = power_management->chip_temp_avg,
+            [SAMPLE_FAN_RPM] = power_management->fan_rpm,
+        };
+
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        xSemaphoreTake(history_lock, portMAX_DELAY);
+        sample_history_add(history, now_ms, values);
+        energy_meter_add_power(&meter, now_ms, values[SAMPLE_POWER]);
+        // the work the hashrate estimator runs on, counted over the same windows as the energy
+        energy_meter_add_work(&meter, now_ms, GLOBAL_STATE->SYSTEM_MODULE.nonce_difficulty_sum, GLOBAL_STATE->SYSTEM_MODULE.shares_accepted);
+        bool checkpoint = energy_meter_checkpoint_due(&meter, now_ms);
+        xSemaphoreGive(history_lock);
+
+        if (checkpoint) {
+            _checkpoint();
+        }
+
+        TickType_t period = pdMS_TO_TICKS(1000 / sample_rate);
+        vTaskDelayUntil(&last_wake, period > 0 ? period : 1);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef POWER_SAMPLER_TASK_H_
+#define POWER_SAMPLER_TASK_H_
+
+#include "energy_meter.h"
+#include "sample_history.h"
+
+void POWER_SAMPLER_task(void * pvParameters);
+
+/// @brief the history with the sampler held off, NULL before it started, power_sampler_release when done
+const sample_history * power_sampler_acquire(void);
+void power_sampler_release(void);
+
+/// @brief samples per second
+uint16_t power_sampler_rate(void);
+
+/// @brief lifetime and since boot energy in Wh and the efficiency windows, false before the sampler started
+bool power_sampler_energy(double * total_wh, double * session_wh, energy_window windows[ENERGY_WINDOWS]);
+
+#endif
@@ -58,12 +58,17 @@ void cleanQueue(GlobalState * GLOBAL_STATE) {
     GLOBAL_STATE->abandon_work = 1;
     queue_clear(&GLOBAL_STATE->stratum_queue);
 
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    ASIC_jobs_queue_clear(&GLOBAL_STATE->ASIC_jobs_queue);
-    for (int i = 0; i < 128; i = i + 4) {
-        GLOBAL_STATE->valid_jobs[i] = 0;
+    for (int c = 0; c < GLOBAL_STATE->ASIC_TASK_MODULE.chain_count; c++) {
+        AsicChain * chain = &GLOBAL_STATE->ASIC_TASK_MODULE.chains[c];
+        pthread_mutex_lock(&chain->valid_jobs_lock);
+        ASIC_jobs_queue_clear(&chain->jobs_queue);
+        for (int i = 0; i < ASIC_JOB_ID_COUNT; i = i + 4) {
+            chain->valid_jobs[i] = 0;
+        }
+        pthread_mutex_unlock(&chain->valid_jobs_lock);
     }
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+
+    share_filter_clear(&GLOBAL_STATE->duplicate_share_filter);
 }
 
 void stratum_reset_uid(GlobalState * GLOBAL_STATE)
@@ -84,6 +89,7 @@ void stratum_close_connection(GlobalState * GLOBAL_STATE)
     shutdown(GLOBAL_STATE->sock, SHUT_RDWR);
     close(GLOBAL_STATE->sock);
     cleanQueue(GLOBAL_STATE);
+    SYSTEM_notify_work(GLOBAL_STATE, false);
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 }
 
@@ -223,6 +229,7 @@ void stratum_task(void * pvParameters)
             GLOBAL_STATE->SYSTEM_MODULE.rejected_reason_stats_count = 0;
             GLOBAL_STATE->SYSTEM_MODULE.shares_accepted = 0;
             GLOBAL_STATE->SYSTEM_MODULE.shares_rejected = 0;
+            GLOBAL_STATE->SYSTEM_MODULE.shares_stale = 0;
 
             ESP_LOGI(TAG, "Switching target due to too many failures (retries: %d)...", retry_attempts);
             retry_attempts = 0;
@@ -280,9 +287,12 @@ void stratum_task(void * pvParameters)
             ESP_LOGE(TAG, "Fail to setsockopt SO_RCVTIMEO ");
         }
 
-        stratum_reset_uid(GLOBAL_STATE);
         cleanQueue(GLOBAL_STATE);
 
+        // a share submitted by a result task in between would take one of the handshake ids
+        pthread_mutex_lock(&GLOBAL_STATE->share_lock);
+        stratum_reset_uid(GLOBAL_STATE);
+
         ///// Start Stratum Action
         // mining.configure - ID: 1
         STRATUM_V1_configure_version_rolling(GLOBAL_STATE->sock, GLOBAL_STATE->send_uid++, &GLOBAL_STATE->version_mask);
@@ -298,6 +308,7 @@ void stratum_task(void * pvParameters)
 
         //mining.suggest_difficulty - ID: 4
         STRATUM_V1_suggest_difficulty(GLOBAL_STATE->sock, GLOBAL_STATE->send_uid++, STRATUM_DIFFICULTY);
+        pthread_mutex_unlock(&GLOBAL_STATE->share_lock);
 
         // Everything is set up, lets make sure we don't abandon work unnecessarily.
         GLOBAL_STATE->abandon_work = 0;
@@ -317,8 +328,9 @@ void stratum_task(void * pvParameters)
 
             if (stratum_api_v1_message.method == MINING_NOTIFY) {
                 SYSTEM_notify_new_ntime(GLOBAL_STATE, stratum_api_v1_message.mining_notification->ntime);
+                SYSTEM_notify_work(GLOBAL_STATE, true);
                 if (stratum_api_v1_message.should_abandon_work &&
-                    (GLOBAL_STATE->stratum_queue.count > 0 || GLOBAL_STATE->ASIC_jobs_queue.count > 0)) {
+                    (GLOBAL_STATE->stratum_queue.count > 0 || ASIC_jobs_queued(&GLOBAL_STATE->ASIC_TASK_MODULE) > 0)) {
                     cleanQueue(GLOBAL_STATE);
                 }
                 if (GLOBAL_STATE->stratum_queue.count == QUEUE_SIZE) {
@@ -341,6 +353,7 @@ void stratum_task(void * pvParameters)
             } else if (stratum_api_v1_message.method == STRATUM_RESULT_SUBSCRIBE) {
                 GLOBAL_STATE->extranonce_str = stratum_api_v1_message.extranonce_str;
                 GLOBAL_STATE->extranonce_2_len = stratum_api_v1_message.extranonce_2_len;
+                SYSTEM_notify_handshake(GLOBAL_STATE);
             } else if (stratum_api_v1_message.method == CLIENT_RECONNECT) {
                 ESP_LOGE(TAG, "Pool requested client reconnect...");
                 stratum_close_connection(GLOBAL_STATE);